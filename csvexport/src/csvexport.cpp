@@ -8,14 +8,26 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <math.h>
 #include <stdio.h>
 #include <stdint.h>
 
 #include "../../server/TracyFileRead.hpp"
+#include "../../server/TracyTaskDispatch.hpp"
 #include "../../server/TracyWorker.hpp"
+#include "../../server/TracyZoneTree.hpp"
 #include "../../getopt/getopt.h"
+#include "../../zstd/zstd.h"
+
+#ifdef __APPLE__
+#  define ftello64(x) ftello(x)
+#elif defined _WIN32
+#  define ftello64(x) _ftelli64(x)
+#endif
 
 void print_usage_exit(int e)
 {
@@ -30,6 +42,7 @@ void print_usage_exit(int e)
     fprintf(stderr, "  -e, --self        Get self times\n");
     fprintf(stderr, "  -u, --unwrap      Report each zone event\n");
     fprintf(stderr, "  -m, --messages    Report only messages\n");
+    fprintf(stderr, "  -b, --binary arg  Write each zone event to a columnar binary file\n");
 
     exit(e);
 }
@@ -38,6 +51,7 @@ struct Args {
     const char* filter;
     const char* separator;
     const char* trace_file;
+    const char* binary_file;
     bool case_sensitive;
     bool self_time;
     bool unwrap;
@@ -51,7 +65,7 @@ Args parse_args(int argc, char** argv)
         print_usage_exit(1);
     }
 
-    Args args = { "", ",", "", false, false, false, false };
+    Args args = { "", ",", "", nullptr, false, false, false, false };
 
     struct option long_opts[] = {
         { "help", no_argument, NULL, 'h' },
@@ -61,11 +75,12 @@ Args parse_args(int argc, char** argv)
         { "self", no_argument, NULL, 'e' },
         { "unwrap", no_argument, NULL, 'u' },
         { "messages", no_argument, NULL, 'm' },
+        { "binary", required_argument, NULL, 'b' },
         { NULL, 0, NULL, 0 }
     };
 
     int c;
-    while ((c = getopt_long(argc, argv, "hf:s:ceum", long_opts, NULL)) != -1)
+    while ((c = getopt_long(argc, argv, "hf:s:ceumb:", long_opts, NULL)) != -1)
     {
         switch (c)
         {
@@ -90,6 +105,9 @@ Args parse_args(int argc, char** argv)
         case 'm':
             args.unwrapMessages = true;
             break;
+        case 'b':
+            args.binary_file = optarg;
+            break;
         default:
             print_usage_exit(1);
             break;
@@ -181,6 +199,452 @@ int64_t GetZoneChildTimeFast(
     return time;
 }
 
+// Columnar binary output. All values are little-endian. The file is laid out as:
+//
+//   "TRACYCOL" magic, u32 format version
+//   chunks, each:
+//     u32 row count
+//     for each column: u32 compressed size, zstd frame with the raw column data
+//   footer:
+//     u32 thread count, then for each thread: u64 thread id, string name
+//     u32 source location count, then for each: i32 id, string name, string file, u32 line
+//     u32 name count, then for each: string name
+//     u32 chunk count, then for each: u64 file offset of the chunk
+//     u64 total row count
+//   u64 footer offset, "TRACYCOL" magic
+//
+// Strings are stored as u32 length followed by the bytes. The columns of each chunk are:
+// start (i64 ns), end (i64 ns), self (i64 ns), thread (u32 index into the thread table),
+// srcloc (i32 id into the source location table), name (u32 index into the name table). Zones are stored
+// per thread, in the order they appear on the timeline.
+static constexpr char ColumnarMagic[8] = { 'T', 'R', 'A', 'C', 'Y', 'C', 'O', 'L' };
+enum { ColumnarVersion = 1 };
+enum { ColumnarChunkZones = 64 * 1024 };
+
+// Chunks hold at most ColumnarChunkZones rows, so the u32 sizes in the file can't overflow.
+static_assert(ZSTD_COMPRESSBOUND(ColumnarChunkZones * sizeof(int64_t)) <= UINT32_MAX, "Columnar chunk too large");
+
+// A chunk is a range of sibling zones, each with its whole subtree. A zone with a subtree too
+// large for one chunk is a head chunk with a single row, and its children are split into chunks
+// of their own, which follow it in the file.
+struct ColumnarChunk
+{
+    uint32_t thread;
+    const tracy::Vector<tracy::short_ptr<tracy::ZoneEvent>>* vec;
+    size_t begin;
+    size_t end;
+    bool head;
+
+    std::vector<int64_t> start;
+    std::vector<int64_t> end_time;
+    std::vector<int64_t> self;
+    std::vector<uint32_t> name;
+    std::vector<int32_t> srcloc;
+
+    std::unordered_set<int32_t> srcloc_set;
+
+    // Name dictionary local to the chunk, remapped to the global table before compression.
+    std::unordered_map<const char*, uint32_t> name_map;
+    std::vector<const char*> names;
+    std::vector<uint32_t> name_remap;
+
+    std::vector<std::vector<char>> columns;
+    const char* error;
+};
+
+template<typename T>
+void for_each_zone(const tracy::Vector<tracy::short_ptr<tracy::ZoneEvent>>& vec, size_t begin, size_t end, T&& func)
+{
+    if (vec.is_magic())
+    {
+        auto& v = *(const tracy::Vector<tracy::ZoneEvent>*)&vec;
+        for (size_t i = begin; i < end; i++) func(v[i]);
+    }
+    else
+    {
+        for (size_t i = begin; i < end; i++) func(*vec[i]);
+    }
+}
+
+void add_chunks(
+    tracy::Worker& worker,
+    std::vector<ColumnarChunk>& chunks,
+    uint32_t thread,
+    const tracy::Vector<tracy::short_ptr<tracy::ZoneEvent>>& vec
+){
+    tracy::SplitZones(worker, vec, ColumnarChunkZones, [&](size_t begin, size_t end, bool large) {
+        chunks.emplace_back(ColumnarChunk { thread, &vec, begin, end, large });
+        if (large) add_chunks(worker, chunks, thread, worker.GetZoneChildren(tracy::ZoneAt(vec, begin).Child()));
+    });
+}
+
+void collect_zone(
+    tracy::Worker& worker,
+    const tracy::ZoneEvent& zone,
+    const std::unordered_set<int32_t>* srcloc_filter,
+    ColumnarChunk& chunk
+){
+    const auto zone_end = worker.GetZoneEnd(zone);
+    int64_t child_time = 0;
+    if (zone.HasChildren())
+    {
+        auto& children = worker.GetZoneChildren(zone.Child());
+        for_each_zone(children, 0, children.size(), [&](const tracy::ZoneEvent& child) {
+            child_time += worker.GetZoneEnd(child) - child.Start();
+        });
+    }
+
+    // Unfinished zones are skipped, the same as in the statistics.
+    const auto id = worker.GetZoneSrcLoc(zone);
+    if (zone.IsEndValid() && (!srcloc_filter || srcloc_filter->count(id) != 0))
+    {
+        auto& srcloc = worker.GetSourceLocation(id);
+        const auto name = worker.GetZoneName(zone, srcloc);
+        auto it = chunk.name_map.find(name);
+        if (it == chunk.name_map.end())
+        {
+            it = chunk.name_map.emplace(name, uint32_t(chunk.names.size())).first;
+            chunk.names.push_back(name);
+        }
+
+        chunk.start.push_back(zone.Start());
+        chunk.end_time.push_back(zone_end);
+        chunk.self.push_back(zone_end - zone.Start() - child_time);
+        chunk.name.push_back(it->second);
+        chunk.srcloc.push_back(id);
+        chunk.srcloc_set.emplace(id);
+    }
+}
+
+void collect_zones(
+    tracy::Worker& worker,
+    const tracy::Vector<tracy::short_ptr<tracy::ZoneEvent>>& vec,
+    size_t begin,
+    size_t end,
+    const std::unordered_set<int32_t>* srcloc_filter,
+    ColumnarChunk& chunk
+){
+    for_each_zone(vec, begin, end, [&](const tracy::ZoneEvent& zone) {
+        collect_zone(worker, zone, srcloc_filter, chunk);
+        if (zone.HasChildren())
+        {
+            auto& children = worker.GetZoneChildren(zone.Child());
+            collect_zones(worker, children, 0, children.size(), srcloc_filter, chunk);
+        }
+    });
+}
+
+// Returns the zstd error name on failure.
+template<typename T>
+const char* compress_column(const std::vector<T>& data, std::vector<std::vector<char>>& columns)
+{
+    const auto size = data.size() * sizeof(T);
+    std::vector<char> out(ZSTD_compressBound(size));
+    const auto csize = ZSTD_compress(out.data(), out.size(), data.data(), size, 3);
+    if (ZSTD_isError(csize)) return ZSTD_getErrorName(csize);
+    out.resize(csize);
+    columns.emplace_back(std::move(out));
+    return nullptr;
+}
+
+template<typename T>
+void write_value(FILE* f, T val)
+{
+    fwrite(&val, 1, sizeof(T), f);
+}
+
+void write_string(FILE* f, const char* str)
+{
+    const auto len = uint32_t(strlen(str));
+    write_value(f, len);
+    fwrite(str, 1, len, f);
+}
+
+int write_columnar(const Args& args, tracy::Worker& worker)
+{
+    FILE* f = fopen(args.binary_file, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "Could not open file %s\n", args.binary_file);
+        return 1;
+    }
+
+    std::unordered_set<int32_t> srcloc_filter;
+    if (args.filter[0] != '\0')
+    {
+        for (auto id : worker.GetMatchingSourceLocation(args.filter, !args.case_sensitive)) srcloc_filter.emplace(id);
+    }
+    const auto filter = args.filter[0] != '\0' ? &srcloc_filter : nullptr;
+
+    std::vector<ColumnarChunk> chunks;
+    const auto& threads = worker.GetThreadData();
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        add_chunks(worker, chunks, uint32_t(i), threads[i]->timeline);
+    }
+
+    fwrite(ColumnarMagic, 1, sizeof(ColumnarMagic), f);
+    write_value<uint32_t>(f, ColumnarVersion);
+
+    // Chunks are processed in batches, so that only a bounded part of the output is kept in
+    // memory. Within a batch, zones are collected and columns compressed in parallel.
+    std::unordered_map<std::string_view, uint32_t> name_map;
+    std::unordered_set<int32_t> srcloc_set;
+    std::vector<const char*> names;
+    std::vector<uint64_t> offsets;
+    uint64_t rows = 0;
+
+    const auto workers = std::max<int>(1, std::thread::hardware_concurrency() - 1);
+    tracy::TaskDispatch td(workers, "Columnar export");
+    const auto batch_size = size_t(workers + 1) * 4;
+    for (size_t batch = 0; batch < chunks.size(); batch += batch_size)
+    {
+        const auto batch_end = std::min(batch + batch_size, chunks.size());
+        for (size_t i = batch; i < batch_end; i++)
+        {
+            td.Queue([&worker, filter, &chunk = chunks[i]] {
+                if (chunk.head)
+                {
+                    collect_zone(worker, tracy::ZoneAt(*chunk.vec, chunk.begin), filter, chunk);
+                }
+                else
+                {
+                    collect_zones(worker, *chunk.vec, chunk.begin, chunk.end, filter, chunk);
+                }
+            });
+        }
+        td.Sync();
+
+        for (size_t i = batch; i < batch_end; i++)
+        {
+            auto& chunk = chunks[i];
+            srcloc_set.insert(chunk.srcloc_set.begin(), chunk.srcloc_set.end());
+            chunk.name_remap.reserve(chunk.names.size());
+            for (auto& name : chunk.names)
+            {
+                auto it = name_map.find(name);
+                if (it == name_map.end())
+                {
+                    it = name_map.emplace(name, uint32_t(names.size())).first;
+                    names.push_back(name);
+                }
+                chunk.name_remap.push_back(it->second);
+            }
+            td.Queue([&chunk] {
+                for (auto& v : chunk.name) v = chunk.name_remap[v];
+                const std::vector<uint32_t> thread(chunk.start.size(), chunk.thread);
+                if ((chunk.error = compress_column(chunk.start, chunk.columns))) return;
+                if ((chunk.error = compress_column(chunk.end_time, chunk.columns))) return;
+                if ((chunk.error = compress_column(chunk.self, chunk.columns))) return;
+                if ((chunk.error = compress_column(thread, chunk.columns))) return;
+                if ((chunk.error = compress_column(chunk.srcloc, chunk.columns))) return;
+                chunk.error = compress_column(chunk.name, chunk.columns);
+            });
+        }
+        td.Sync();
+
+        for (size_t i = batch; i < batch_end; i++)
+        {
+            if (chunks[i].error)
+            {
+                fprintf(stderr, "Could not compress column: %s\n", chunks[i].error);
+                fclose(f);
+                return 1;
+            }
+        }
+
+        for (size_t i = batch; i < batch_end; i++)
+        {
+            auto& chunk = chunks[i];
+            if (!chunk.start.empty())
+            {
+                offsets.push_back(uint64_t(ftello64(f)));
+                write_value<uint32_t>(f, uint32_t(chunk.start.size()));
+                for (auto& column : chunk.columns)
+                {
+                    write_value<uint32_t>(f, uint32_t(column.size()));
+                    fwrite(column.data(), 1, column.size(), f);
+                }
+                rows += chunk.start.size();
+            }
+            chunk = {};
+        }
+    }
+
+    const uint64_t footer = uint64_t(ftello64(f));
+    write_value<uint32_t>(f, uint32_t(threads.size()));
+    for (auto& thread : threads)
+    {
+        write_value<uint64_t>(f, thread->id);
+        write_string(f, worker.GetThreadName(thread->id));
+    }
+
+    std::vector<int32_t> srclocs(srcloc_set.begin(), srcloc_set.end());
+    std::sort(srclocs.begin(), srclocs.end());
+    write_value<uint32_t>(f, uint32_t(srclocs.size()));
+    for (auto& id : srclocs)
+    {
+        auto& srcloc = worker.GetSourceLocation(id);
+        write_value<int32_t>(f, id);
+        write_string(f, get_name(id, worker));
+        write_string(f, worker.GetString(srcloc.file));
+        write_value<uint32_t>(f, srcloc.line);
+    }
+
+    write_value<uint32_t>(f, uint32_t(names.size()));
+    for (auto& name : names) write_string(f, name);
+
+    write_value<uint32_t>(f, uint32_t(offsets.size()));
+    for (auto& offset : offsets) write_value<uint64_t>(f, offset);
+    write_value<uint64_t>(f, rows);
+
+    write_value<uint64_t>(f, footer);
+    fwrite(ColumnarMagic, 1, sizeof(ColumnarMagic), f);
+    fclose(f);
+
+    return 0;
+}
+
+enum { UnwrapChunkZones = 64 * 1024 };
+
+template <typename ZoneData>
+std::string format_zones(
+    const tracy::Worker& worker,
+    const Args& args,
+    int32_t srcloc_id,
+    const ZoneData& zone_data,
+    size_t first,
+    size_t last
+){
+    std::string out;
+    std::vector<std::string> values(6);
+
+    values[0] = get_name(srcloc_id, worker);
+
+    const auto& srcloc = worker.GetSourceLocation(srcloc_id);
+    values[1] = worker.GetString(srcloc.file);
+    values[2] = std::to_string(srcloc.line);
+
+    for (size_t i = first; i < last; i++)
+    {
+        const auto& zone_thread_data = zone_data.zones[i];
+        const auto zone_event = zone_thread_data.Zone();
+        const auto tId = zone_thread_data.Thread();
+        const auto start = zone_event->Start();
+        const auto end = zone_event->End();
+
+        values[3] = std::to_string(start);
+
+        auto timespan = end - start;
+        if (args.self_time) {
+            timespan -= GetZoneChildTimeFast(worker, *zone_event);
+        }
+        values[4] = std::to_string(timespan);
+        values[5] = std::to_string(tId);
+
+        out += join(values, args.separator);
+        out += '\n';
+    }
+    return out;
+}
+
+// Self times of the finished zones, grouped by source location. Each zone is visited once in a
+// walk of the zone tree, which sums the children durations on the way back up.
+using SelfTimes = std::unordered_map<int32_t, std::vector<int64_t>>;
+
+int64_t collect_self_times(
+    const tracy::Worker& worker,
+    const tracy::Vector<tracy::short_ptr<tracy::ZoneEvent>>& vec,
+    SelfTimes& out
+){
+    int64_t total = 0;
+    for_each_zone(vec, 0, vec.size(), [&](const tracy::ZoneEvent& zone) {
+        const auto child_time = zone.HasChildren() ? collect_self_times(worker, worker.GetZoneChildren(zone.Child()), out) : 0;
+        if (!zone.IsEndValid()) return;
+        const auto timespan = zone.End() - zone.Start();
+        out[worker.GetZoneSrcLoc(zone)].push_back(timespan - child_time);
+        total += timespan;
+    });
+    return total;
+}
+
+// Nearest-rank percentiles. Instead of sorting, each percentile is found with a selection,
+// which only has to look at the part of the data that's above the previous percentile.
+void get_percentiles(std::vector<int64_t>& data, const double* percentiles, int64_t* out, size_t count)
+{
+    auto first = data.begin();
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto rank = std::max<size_t>(1, size_t(ceil(percentiles[i] * data.size())));
+        const auto nth = data.begin() + std::min(rank, data.size()) - 1;
+        std::nth_element(first, nth, data.end());
+        out[i] = *nth;
+        first = nth;
+    }
+}
+
+template <typename ZoneData>
+std::string format_stats(
+    const tracy::Worker& worker,
+    const Args& args,
+    int32_t srcloc_id,
+    const ZoneData& zone_data,
+    int64_t last_time,
+    std::vector<int64_t>* self_times
+){
+    std::vector<std::string> values(13);
+
+    values[0] = get_name(srcloc_id, worker);
+
+    const auto& srcloc = worker.GetSourceLocation(srcloc_id);
+    values[1] = worker.GetString(srcloc.file);
+    values[2] = std::to_string(srcloc.line);
+
+    const auto time = args.self_time ? zone_data.selfTotal : zone_data.total;
+    values[3] = std::to_string(time);
+    values[4] = std::to_string(100. * time / last_time);
+
+    values[5] = std::to_string(zone_data.zones.size());
+
+    const auto avg = (args.self_time ? zone_data.selfTotal : zone_data.total)
+        / zone_data.zones.size();
+    values[6] = std::to_string(avg);
+
+    const auto tmin = args.self_time ? zone_data.selfMin : zone_data.min;
+    const auto tmax = args.self_time ? zone_data.selfMax : zone_data.max;
+    values[7] = std::to_string(tmin);
+    values[8] = std::to_string(tmax);
+
+    const auto sz = zone_data.zones.size();
+    const auto ss = zone_data.sumSq
+        - 2. * zone_data.total * avg
+        + avg * avg * sz;
+    double std = 0;
+    if( sz > 1 )
+        std = sqrt(ss / (sz - 1));
+    values[9] = std::to_string(std);
+
+    std::vector<int64_t> durations;
+    if (!self_times)
+    {
+        durations.reserve(sz);
+        for (auto& v : zone_data.zones)
+        {
+            const auto zone = v.Zone();
+            if (zone->IsEndValid()) durations.push_back(zone->End() - zone->Start());
+        }
+    }
+    auto& times = self_times ? *self_times : durations;
+    static constexpr double percentiles[] = { 0.5, 0.9, 0.99 };
+    int64_t p[3] = {};
+    if (!times.empty()) get_percentiles(times, percentiles, p, 3);
+    values[10] = std::to_string(p[0]);
+    values[11] = std::to_string(p[1]);
+    values[12] = std::to_string(p[2]);
+
+    return join(values, args.separator) + '\n';
+}
+
 int main(int argc, char** argv)
 {
 #ifdef _WIN32
@@ -202,7 +666,16 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    auto worker = tracy::Worker(*f);
+    if (args.binary_file)
+    {
+        // Only the zone timelines are needed, there's no use for the statistics or other data.
+        auto worker = tracy::Worker(*f, tracy::EventType::None, false);
+        return write_columnar(args, worker);
+    }
+
+    // Zones are always loaded. Other data is only needed when listing messages.
+    const auto events = args.unwrapMessages ? tracy::EventType::Messages : tracy::EventType::None;
+    auto worker = tracy::Worker(*f, events);
 
     if (args.unwrapMessages) 
     {
@@ -277,75 +750,97 @@ int main(int argc, char** argv)
     {
         columns = {
             "name", "src_file", "src_line", "total_ns", "total_perc",
-            "counts", "mean_ns", "min_ns", "max_ns", "std_ns"
+            "counts", "mean_ns", "min_ns", "max_ns", "std_ns",
+            "p50_ns", "p90_ns", "p99_ns"
         };
     }
     std::string header = join(columns, args.separator);
     printf("%s\n", header.data());
 
-    const auto last_time = worker.GetLastTime();
-    for(auto& it : slz_selected)
+    // Rows are formatted in parallel. Each unit covers a source location, or a range of its
+    // zones in the unwrapped mode. Units are processed in batches, which are printed in order
+    // before the next batch starts.
+    struct Unit
     {
-        std::vector<std::string> values(columns.size());
-
-        values[0] = get_name(it->first, worker);
+        size_t idx;
+        size_t begin;
+        size_t end;
+        std::string out;
+    };
+    std::vector<Unit> units;
+    for (size_t i = 0; i < slz_selected.size(); i++)
+    {
+        if (args.unwrap)
+        {
+            const auto sz = slz_selected[i]->second.zones.size();
+            for (size_t j = 0; j < sz; j += UnwrapChunkZones)
+            {
+                units.push_back({ i, j, std::min<size_t>(j + UnwrapChunkZones, sz), {} });
+            }
+        }
+        else
+        {
+            units.push_back({ i, 0, 0, {} });
+        }
+    }
 
-        const auto& srcloc = worker.GetSourceLocation(it->first);
-        values[1] = worker.GetString(srcloc.file);
-        values[2] = std::to_string(srcloc.line);
+    const auto workers = std::max<int>(1, std::thread::hardware_concurrency() - 1);
+    tracy::TaskDispatch td(workers, "CSV export");
 
-        const auto& zone_data = it->second;
+    // Self time percentiles need the self time of every zone. These are found in one pass over
+    // each thread, instead of summing the children of each zone separately.
+    SelfTimes self_times;
+    if (args.self_time && !args.unwrap)
+    {
+        const auto& threads = worker.GetThreadData();
+        std::vector<SelfTimes> thread_self_times(threads.size());
+        for (size_t i = 0; i < threads.size(); i++)
+        {
+            td.Queue([&worker, &timeline = threads[i]->timeline, &out = thread_self_times[i]] {
+                collect_self_times(worker, timeline, out);
+            });
+        }
+        td.Sync();
+        for (auto& thread : thread_self_times)
+        {
+            for (auto& v : thread)
+            {
+                auto& dst = self_times[v.first];
+                if (dst.empty()) dst = std::move(v.second);
+                else dst.insert(dst.end(), v.second.begin(), v.second.end());
+            }
+            SelfTimes().swap(thread);
+        }
+        // Rows are formatted in parallel, so the map must not change from here on.
+        for (auto& it : slz_selected) self_times[it->first];
+    }
 
-        if (args.unwrap)
+    const auto batch_size = size_t(workers + 1) * 4;
+    const auto last_time = worker.GetLastTime();
+    for (size_t batch = 0; batch < units.size(); batch += batch_size)
+    {
+        const auto batch_end = std::min(batch + batch_size, units.size());
+        for (size_t i = batch; i < batch_end; i++)
         {
-            int i = 0;
-            for (const auto& zone_thread_data : zone_data.zones) {
-                const auto zone_event = zone_thread_data.Zone();
-                const auto tId = zone_thread_data.Thread();
-                const auto start = zone_event->Start();
-                const auto end = zone_event->End();
-
-                values[3] = std::to_string(start);
-
-                auto timespan = end - start;
-                if (args.self_time) {
-                    timespan -= GetZoneChildTimeFast(worker, *zone_event);
+            td.Queue([&, &unit = units[i]] {
+                auto& it = slz_selected[unit.idx];
+                if (args.unwrap)
+                {
+                    unit.out = format_zones(worker, args, it->first, it->second, unit.begin, unit.end);
                 }
-                values[4] = std::to_string(timespan);
-                values[5] = std::to_string(tId);
-
-                std::string row = join(values, args.separator);
-                printf("%s\n", row.data());
-            }
+                else
+                {
+                    auto self = args.self_time ? &self_times.find(it->first)->second : nullptr;
+                    unit.out = format_stats(worker, args, it->first, it->second, last_time, self);
+                    if (self) std::vector<int64_t>().swap(*self);
+                }
+            });
         }
-        else
+        td.Sync();
+        for (size_t i = batch; i < batch_end; i++)
         {
-            const auto time = args.self_time ? zone_data.selfTotal : zone_data.total;
-            values[3] = std::to_string(time);
-            values[4] = std::to_string(100. * time / last_time);
-
-            values[5] = std::to_string(zone_data.zones.size());
-
-            const auto avg = (args.self_time ? zone_data.selfTotal : zone_data.total)
-                / zone_data.zones.size();
-            values[6] = std::to_string(avg);
-
-            const auto tmin = args.self_time ? zone_data.selfMin : zone_data.min;
-            const auto tmax = args.self_time ? zone_data.selfMax : zone_data.max;
-            values[7] = std::to_string(tmin);
-            values[8] = std::to_string(tmax);
-
-            const auto sz = zone_data.zones.size();
-            const auto ss = zone_data.sumSq
-                - 2. * zone_data.total * avg
-                + avg * avg * sz;
-            double std = 0;
-            if( sz > 1 )
-                std = sqrt(ss / (sz - 1));
-            values[9] = std::to_string(std);
-
-            std::string row = join(values, args.separator);
-            printf("%s\n", row.data());
+            fwrite(units[i].out.data(), 1, units[i].out.size(), stdout);
+            units[i].out = {};
         }
     }
 
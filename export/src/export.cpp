@@ -0,0 +1,1050 @@
+#ifdef _WIN32
+#  include <windows.h>
+#endif
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <deque>
+#include <inttypes.h>
+#include <limits>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../../server/TracyFileRead.hpp"
+#include "../../server/TracyFileWrite.hpp"
+#include "../../server/TracyPrint.hpp"
+#include "../../server/TracyTaskDispatch.hpp"
+#include "../../server/TracyWorker.hpp"
+#include "../../server/TracyZoneTree.hpp"
+#include "../../getopt/getopt.h"
+
+void Usage()
+{
+    printf( "Usage: export [options] input.tracy output\n\n" );
+    printf( "  -f format: output format, chrome (JSON) or perfetto (protobuf)\n" );
+    printf( "      The default is chrome for .json output files, perfetto otherwise.\n" );
+    printf( "  -s flags: skip selected data:\n" );
+    printf( "      g: GPU zones, l: locks, m: messages, p: plots, c: context switches\n" );
+    printf( "  -j: number of threads to use for encoding (-1 to use all cores)\n" );
+
+    exit( 1 );
+}
+
+enum class Format
+{
+    Chrome,
+    Perfetto
+};
+
+constexpr const char* GpuContextNames[] = {
+    "Invalid",
+    "OpenGL",
+    "Vulkan",
+    "OpenCL",
+    "Direct3D 12",
+    "Direct3D 11"
+};
+
+// Each exported timeline is a track. Thread tracks map to their thread, other tracks get a
+// synthetic thread id in the chrome format.
+struct Track
+{
+    std::string name;
+    uint64_t pid;
+    uint64_t tid;
+    bool isThread;
+    bool isCounter;
+    bool bytes;
+};
+
+// A unit of work, encoded independently of the others. Large timelines are split into several
+// units by zone count, including the children, so that the amount of output buffered in memory
+// stays bounded. A single zone with a subtree too large for one unit is a streamed unit instead.
+struct Unit
+{
+    enum class Type
+    {
+        Zones,
+        GpuZones,
+        Lock,
+        Cpu,
+        Plot,
+        Messages
+    };
+
+    Type type;
+    uint64_t track;
+    const void* data;
+    size_t begin;
+    size_t end;
+    bool stream;
+};
+
+enum { UnitZones = 64 * 1024 };
+enum { UnitItems = 1024 * 1024 };
+enum { FlushSize = 16 * 1024 * 1024 };
+
+// Streamed units are encoded on the main thread, between the parallel batches, and their output
+// is written to the file whenever the buffer fills up.
+struct Stream
+{
+    FILE* file;
+    size_t written;
+
+    tracy_force_inline void Poll( tracy::BufferWrite& buf )
+    {
+        if( buf.GetSize() >= FlushSize ) Flush( buf );
+    }
+
+    void Flush( tracy::BufferWrite& buf )
+    {
+        fwrite( buf.GetData(), 1, buf.GetSize(), file );
+        written += buf.GetSize();
+        buf.Clear();
+    }
+};
+
+static tracy_force_inline void WriteString( tracy::BufferWrite& buf, const char* str )
+{
+    buf.Write( str, strlen( str ) );
+}
+
+static tracy_force_inline void WriteUInt( tracy::BufferWrite& buf, uint64_t val )
+{
+    char tmp[24];
+    auto ptr = tmp + sizeof( tmp );
+    do
+    {
+        *--ptr = '0' + val % 10;
+        val /= 10;
+    }
+    while( val != 0 );
+    buf.Write( ptr, tmp + sizeof( tmp ) - ptr );
+}
+
+class ChromeEncoder
+{
+public:
+    ChromeEncoder( tracy::BufferWrite& buf, const std::vector<Track>& tracks, Stream* stream = nullptr ) : m_buf( buf ), m_tracks( tracks ), m_stream( stream ) {}
+
+    tracy_force_inline void Poll() { if( m_stream ) m_stream->Poll( m_buf ); }
+
+    void Begin( uint64_t track, const char* name, int64_t start, int64_t end, const char* text, const char* file, uint32_t line )
+    {
+        WriteString( m_buf, ",\n{\"ph\":\"X\",\"name\":" );
+        WriteEscaped( name );
+        WriteTime( "ts", start );
+        WriteTime( "dur", end - start );
+        WriteThread( track );
+        if( file && *file )
+        {
+            WriteString( m_buf, ",\"loc\":\"" );
+            WriteEscapedRaw( file );
+            m_buf.Write( ":", 1 );
+            WriteUInt( m_buf, line );
+            m_buf.Write( "\"", 1 );
+        }
+        if( text )
+        {
+            WriteString( m_buf, ",\"args\":{\"text\":" );
+            WriteEscaped( text );
+            m_buf.Write( "}", 1 );
+        }
+        m_buf.Write( "}", 1 );
+    }
+
+    void End( uint64_t, int64_t ) {}
+
+    void Instant( uint64_t track, const char* name, int64_t time )
+    {
+        WriteString( m_buf, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":" );
+        WriteEscaped( name );
+        WriteTime( "ts", time );
+        WriteThread( track );
+        m_buf.Write( "}", 1 );
+    }
+
+    // The counter name is also used as the argument name, which import-chrome uses as the plot name.
+    void Counter( uint64_t track, int64_t time, double value )
+    {
+        auto& t = m_tracks[track];
+        WriteString( m_buf, ",\n{\"ph\":\"C\",\"name\":" );
+        WriteEscaped( t.name.c_str() );
+        WriteTime( "ts", time );
+        WriteString( m_buf, ",\"pid\":" );
+        WriteUInt( m_buf, t.pid );
+        WriteString( m_buf, ",\"args\":{" );
+        WriteEscaped( t.name.c_str() );
+        char tmp[64];
+        const auto len = snprintf( tmp, sizeof( tmp ), ":%.17g}}", value );
+        m_buf.Write( tmp, len );
+    }
+
+    void WriteThread( uint64_t track )
+    {
+        auto& t = m_tracks[track];
+        WriteString( m_buf, ",\"pid\":" );
+        WriteUInt( m_buf, t.pid );
+        WriteString( m_buf, ",\"tid\":" );
+        WriteUInt( m_buf, t.tid );
+    }
+
+    void WriteEscaped( const char* str )
+    {
+        m_buf.Write( "\"", 1 );
+        WriteEscapedRaw( str );
+        m_buf.Write( "\"", 1 );
+    }
+
+private:
+    // Timestamps are in microseconds, with nanosecond precision.
+    void WriteTime( const char* key, int64_t ns )
+    {
+        m_buf.Write( ",\"", 2 );
+        WriteString( m_buf, key );
+        m_buf.Write( "\":", 2 );
+        if( ns < 0 )
+        {
+            m_buf.Write( "-", 1 );
+            ns = -ns;
+        }
+        WriteUInt( m_buf, uint64_t( ns ) / 1000 );
+        const auto frac = uint32_t( uint64_t( ns ) % 1000 );
+        if( frac != 0 )
+        {
+            const char tmp[4] = { '.', char( '0' + frac / 100 ), char( '0' + frac / 10 % 10 ), char( '0' + frac % 10 ) };
+            m_buf.Write( tmp, 4 );
+        }
+    }
+
+    void WriteEscapedRaw( const char* str )
+    {
+        auto start = str;
+        while( *str )
+        {
+            const auto c = (uint8_t)*str;
+            if( c >= 0x20 && c != '"' && c != '\\' )
+            {
+                str++;
+                continue;
+            }
+            m_buf.Write( start, str - start );
+            char tmp[8];
+            switch( c )
+            {
+            case '"': m_buf.Write( "\\\"", 2 ); break;
+            case '\\': m_buf.Write( "\\\\", 2 ); break;
+            case '\n': m_buf.Write( "\\n", 2 ); break;
+            case '\t': m_buf.Write( "\\t", 2 ); break;
+            case '\r': m_buf.Write( "\\r", 2 ); break;
+            default: m_buf.Write( tmp, snprintf( tmp, sizeof( tmp ), "\\u%04x", c ) ); break;
+            }
+            start = ++str;
+        }
+        m_buf.Write( start, str - start );
+    }
+
+    tracy::BufferWrite& m_buf;
+    const std::vector<Track>& m_tracks;
+    Stream* m_stream;
+};
+
+// Field numbers of the Perfetto trace protos (protos/perfetto/trace/...).
+namespace Pf
+{
+enum { TracePacket = 1 };
+namespace Packet { enum { Timestamp = 8, SequenceId = 10, TrackEvent = 11, InternedData = 12, SequenceFlags = 13, TrackDescriptor = 60 }; }
+enum { SeqIncrementalStateCleared = 1, SeqNeedsIncrementalState = 2 };
+namespace TrackEvent { enum { DebugAnnotations = 4, Type = 9, NameIid = 10, TrackUuid = 11, DoubleCounterValue = 44, SourceLocationIid = 34 }; }
+enum { TypeSliceBegin = 1, TypeSliceEnd = 2, TypeInstant = 3, TypeCounter = 4 };
+namespace Annotation { enum { StringValue = 6, Name = 10 }; }
+namespace InternedData { enum { EventNames = 2, SourceLocations = 4 }; }
+namespace InternedString { enum { Iid = 1, Name = 2 }; }
+namespace SourceLocation { enum { Iid = 1, FileName = 2, FunctionName = 3, LineNumber = 4 }; }
+namespace TrackDescriptor { enum { Uuid = 1, Name = 2, Process = 3, Thread = 4, ParentUuid = 5, Counter = 8 }; }
+namespace ProcessDescriptor { enum { Pid = 1, ProcessName = 6 }; }
+namespace ThreadDescriptor { enum { Pid = 1, Tid = 2, ThreadName = 5 }; }
+namespace CounterDescriptor { enum { Unit = 3 }; }
+enum { UnitSizeBytes = 3 };
+}
+
+// Protobuf message builder. Nested messages are built separately and then embedded.
+class ProtoMessage
+{
+public:
+    void Clear() { m_buf.clear(); }
+    const char* Data() const { return m_buf.data(); }
+    size_t Size() const { return m_buf.size(); }
+
+    void Varint( uint32_t id, uint64_t val ) { Tag( id, 0 ); Raw( val ); }
+    void Double( uint32_t id, double val ) { Tag( id, 1 ); m_buf.append( (const char*)&val, sizeof( val ) ); }
+    void Bytes( uint32_t id, const char* data, size_t size ) { Tag( id, 2 ); Raw( size ); m_buf.append( data, size ); }
+    void String( uint32_t id, const char* str ) { Bytes( id, str, strlen( str ) ); }
+    void Message( uint32_t id, const ProtoMessage& msg ) { Bytes( id, msg.Data(), msg.Size() ); }
+
+private:
+    tracy_force_inline void Tag( uint32_t id, uint32_t type ) { Raw( ( uint64_t( id ) << 3 ) | type ); }
+    tracy_force_inline void Raw( uint64_t val )
+    {
+        while( val >= 0x80 )
+        {
+            m_buf.push_back( char( val | 0x80 ) );
+            val >>= 7;
+        }
+        m_buf.push_back( char( val ) );
+    }
+
+    std::string m_buf;
+};
+
+// Each encoder writes its own packet sequence, with its own interning tables. Track uuids are
+// track indices offset by one, as uuid 0 means no track. Packet timestamps are unsigned, so all
+// times are shifted by the offset, which moves the earliest exported event to zero if it is negative.
+class PerfettoEncoder
+{
+public:
+    PerfettoEncoder( tracy::BufferWrite& buf, uint32_t sequence, int64_t offset, Stream* stream = nullptr ) : m_buf( buf ), m_sequence( sequence ), m_offset( offset ), m_first( true ), m_stream( stream ) {}
+
+    tracy_force_inline void Poll() { if( m_stream ) m_stream->Poll( m_buf ); }
+
+    void Begin( uint64_t track, const char* name, int64_t start, int64_t, const char* text, const char* file, uint32_t line )
+    {
+        m_event.Clear();
+        m_interned.Clear();
+        m_event.Varint( Pf::TrackEvent::Type, Pf::TypeSliceBegin );
+        m_event.Varint( Pf::TrackEvent::TrackUuid, track + 1 );
+        m_event.Varint( Pf::TrackEvent::NameIid, InternName( name ) );
+        if( file && *file ) m_event.Varint( Pf::TrackEvent::SourceLocationIid, InternSourceLocation( name, file, line ) );
+        if( text )
+        {
+            m_tmp.Clear();
+            m_tmp.String( Pf::Annotation::Name, "text" );
+            m_tmp.String( Pf::Annotation::StringValue, text );
+            m_event.Message( Pf::TrackEvent::DebugAnnotations, m_tmp );
+        }
+        WritePacket( start );
+    }
+
+    void End( uint64_t track, int64_t end )
+    {
+        m_event.Clear();
+        m_interned.Clear();
+        m_event.Varint( Pf::TrackEvent::Type, Pf::TypeSliceEnd );
+        m_event.Varint( Pf::TrackEvent::TrackUuid, track + 1 );
+        WritePacket( end );
+    }
+
+    void Instant( uint64_t track, const char* name, int64_t time )
+    {
+        m_event.Clear();
+        m_interned.Clear();
+        m_event.Varint( Pf::TrackEvent::Type, Pf::TypeInstant );
+        m_event.Varint( Pf::TrackEvent::TrackUuid, track + 1 );
+        m_event.Varint( Pf::TrackEvent::NameIid, InternName( name ) );
+        WritePacket( time );
+    }
+
+    void Counter( uint64_t track, int64_t time, double value )
+    {
+        m_event.Clear();
+        m_interned.Clear();
+        m_event.Varint( Pf::TrackEvent::Type, Pf::TypeCounter );
+        m_event.Varint( Pf::TrackEvent::TrackUuid, track + 1 );
+        m_event.Double( Pf::TrackEvent::DoubleCounterValue, value );
+        WritePacket( time );
+    }
+
+    static void WriteTrackDescriptor( tracy::BufferWrite& buf, uint64_t uuid, uint64_t parent, const Track& track, uint64_t processPid, const char* processName )
+    {
+        ProtoMessage desc, sub, packet, trace;
+        desc.Varint( Pf::TrackDescriptor::Uuid, uuid );
+        if( parent != 0 ) desc.Varint( Pf::TrackDescriptor::ParentUuid, parent );
+        if( processName )
+        {
+            sub.Varint( Pf::ProcessDescriptor::Pid, processPid );
+            sub.String( Pf::ProcessDescriptor::ProcessName, processName );
+            desc.Message( Pf::TrackDescriptor::Process, sub );
+        }
+        else if( track.isThread )
+        {
+            sub.Varint( Pf::ThreadDescriptor::Pid, track.pid );
+            sub.Varint( Pf::ThreadDescriptor::Tid, track.tid );
+            sub.String( Pf::ThreadDescriptor::ThreadName, track.name.c_str() );
+            desc.Message( Pf::TrackDescriptor::Thread, sub );
+        }
+        else
+        {
+            desc.String( Pf::TrackDescriptor::Name, track.name.c_str() );
+            if( track.isCounter )
+            {
+                if( track.bytes ) sub.Varint( Pf::CounterDescriptor::Unit, Pf::UnitSizeBytes );
+                desc.Message( Pf::TrackDescriptor::Counter, sub );
+            }
+        }
+        packet.Message( Pf::Packet::TrackDescriptor, desc );
+        trace.Message( Pf::TracePacket, packet );
+        buf.Write( trace.Data(), trace.Size() );
+    }
+
+private:
+    uint64_t InternName( const char* name )
+    {
+        auto it = m_names.find( name );
+        if( it != m_names.end() ) return it->second;
+        const auto iid = m_names.size() + 1;
+        m_names.emplace( name, iid );
+        m_tmp.Clear();
+        m_tmp.Varint( Pf::InternedString::Iid, iid );
+        m_tmp.String( Pf::InternedString::Name, name );
+        m_interned.Message( Pf::InternedData::EventNames, m_tmp );
+        return iid;
+    }
+
+    uint64_t InternSourceLocation( const char* name, const char* file, uint32_t line )
+    {
+        auto& lines = m_sourceLocations[file];
+        auto it = lines.find( line );
+        if( it != lines.end() ) return it->second;
+        const auto iid = ++m_sourceLocationCount;
+        lines.emplace( line, iid );
+        m_tmp.Clear();
+        m_tmp.Varint( Pf::SourceLocation::Iid, iid );
+        m_tmp.String( Pf::SourceLocation::FileName, file );
+        m_tmp.String( Pf::SourceLocation::FunctionName, name );
+        m_tmp.Varint( Pf::SourceLocation::LineNumber, line );
+        m_interned.Message( Pf::InternedData::SourceLocations, m_tmp );
+        return iid;
+    }
+
+    void WritePacket( int64_t time )
+    {
+        m_packet.Clear();
+        assert( time + m_offset >= 0 );
+        m_packet.Varint( Pf::Packet::Timestamp, uint64_t( time + m_offset ) );
+        m_packet.Varint( Pf::Packet::SequenceId, m_sequence );
+        m_packet.Varint( Pf::Packet::SequenceFlags, m_first ? ( Pf::SeqIncrementalStateCleared | Pf::SeqNeedsIncrementalState ) : Pf::SeqNeedsIncrementalState );
+        m_first = false;
+        if( m_interned.Size() != 0 ) m_packet.Message( Pf::Packet::InternedData, m_interned );
+        m_packet.Message( Pf::Packet::TrackEvent, m_event );
+
+        m_trace.Clear();
+        m_trace.Message( Pf::TracePacket, m_packet );
+        m_buf.Write( m_trace.Data(), m_trace.Size() );
+    }
+
+    tracy::BufferWrite& m_buf;
+    uint32_t m_sequence;
+    int64_t m_offset;
+    bool m_first;
+    Stream* m_stream;
+
+    std::unordered_map<const char*, uint64_t> m_names;
+    std::unordered_map<const char*, std::unordered_map<uint32_t, uint64_t>> m_sourceLocations;
+    uint64_t m_sourceLocationCount = 0;
+
+    ProtoMessage m_event, m_interned, m_packet, m_trace, m_tmp;
+};
+
+template<typename T, typename F>
+static tracy_force_inline void ForEach( const tracy::Vector<tracy::short_ptr<T>>& vec, size_t begin, size_t end, F&& func )
+{
+    if( vec.is_magic() )
+    {
+        auto& v = *(const tracy::Vector<T>*)&vec;
+        for( size_t i=begin; i<end; i++ ) func( v[i] );
+    }
+    else
+    {
+        for( size_t i=begin; i<end; i++ ) func( *vec[i] );
+    }
+}
+
+template<typename Encoder>
+static void EncodeZones( tracy::Worker& worker, const tracy::Vector<tracy::short_ptr<tracy::ZoneEvent>>& vec, size_t begin, size_t end, uint64_t track, Encoder& enc )
+{
+    ForEach( vec, begin, end, [&] ( const tracy::ZoneEvent& zone ) {
+        const auto zoneEnd = worker.GetZoneEnd( zone );
+        auto& srcloc = worker.GetSourceLocation( worker.GetZoneSrcLoc( zone ) );
+        const char* text = nullptr;
+        if( worker.HasZoneExtra( zone ) )
+        {
+            auto& extra = worker.GetZoneExtra( zone );
+            if( extra.text.Active() ) text = worker.GetString( extra.text );
+        }
+        enc.Begin( track, worker.GetZoneName( zone, srcloc ), zone.Start(), zoneEnd, text, worker.GetString( srcloc.file ), srcloc.line );
+        if( zone.HasChildren() )
+        {
+            auto& children = worker.GetZoneChildren( zone.Child() );
+            EncodeZones( worker, children, 0, children.size(), track, enc );
+        }
+        enc.End( track, zoneEnd );
+        enc.Poll();
+    } );
+}
+
+template<typename Encoder>
+static void EncodeGpuZones( tracy::Worker& worker, const tracy::Vector<tracy::short_ptr<tracy::GpuEvent>>& vec, size_t begin, size_t end, uint64_t track, Encoder& enc )
+{
+    ForEach( vec, begin, end, [&] ( const tracy::GpuEvent& zone ) {
+        if( zone.GpuStart() < 0 ) return;
+        const auto zoneEnd = worker.GetZoneEnd( zone );
+        auto& srcloc = worker.GetSourceLocation( zone.SrcLoc() );
+        enc.Begin( track, worker.GetZoneName( zone ), zone.GpuStart(), zoneEnd, nullptr, worker.GetString( srcloc.file ), srcloc.line );
+        if( zone.Child() >= 0 )
+        {
+            auto& children = worker.GetGpuChildren( zone.Child() );
+            EncodeGpuZones( worker, children, 0, children.size(), track, enc );
+        }
+        enc.End( track, zoneEnd );
+        enc.Poll();
+    } );
+}
+
+template<typename T>
+static void AddZoneUnits( tracy::Worker& worker, std::vector<Unit>& units, Unit::Type type, uint64_t track, const void* data, const tracy::Vector<tracy::short_ptr<T>>& vec )
+{
+    tracy::SplitZones( worker, vec, UnitZones, [&] ( size_t begin, size_t end, bool large ) {
+        units.emplace_back( Unit { type, track, data, begin, end, large } );
+    } );
+}
+
+// Lock timelines are split into ranges of UnitItems events. Each range starts with the per-thread
+// state left behind by the previous one.
+struct LockState
+{
+    int64_t wait = -1;
+    int64_t hold = -1;
+    uint32_t depth = 0;
+};
+
+struct LockRange
+{
+    const tracy::LockMap* lock;
+    LockState state[64];
+};
+
+// Only advances the lock state, used to find where each lock range starts.
+struct NullEncoder
+{
+    void Begin( uint64_t, const char*, int64_t, int64_t, const char*, const char*, uint32_t ) {}
+    void End( uint64_t, int64_t ) {}
+};
+
+// Lock unit tracks are consecutive, one for each thread in the lock's thread list.
+template<typename Encoder>
+static void EncodeLock( const tracy::LockMap& lock, size_t begin, size_t end, LockState* state, const char* name, uint64_t track, Encoder& enc )
+{
+    for( size_t i=begin; i<end; i++ )
+    {
+        auto& ev = *lock.timeline[i].ptr;
+        auto& s = state[ev.thread];
+        const auto t = track + ev.thread;
+        const auto time = ev.Time();
+        switch( ev.type )
+        {
+        case tracy::LockEvent::Type::Wait:
+        case tracy::LockEvent::Type::WaitShared:
+            if( s.depth == 0 ) s.wait = time;
+            break;
+        case tracy::LockEvent::Type::Obtain:
+        case tracy::LockEvent::Type::ObtainShared:
+            if( s.depth++ != 0 ) break;
+            if( s.wait >= 0 )
+            {
+                enc.Begin( t, "Waiting", s.wait, time, nullptr, nullptr, 0 );
+                enc.End( t, time );
+                s.wait = -1;
+            }
+            s.hold = time;
+            break;
+        case tracy::LockEvent::Type::Release:
+        case tracy::LockEvent::Type::ReleaseShared:
+            if( s.depth == 0 || --s.depth != 0 ) break;
+            enc.Begin( t, name, s.hold, time, nullptr, nullptr, 0 );
+            enc.End( t, time );
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+template<typename Encoder>
+static void EncodeUnit( tracy::Worker& worker, const Unit& unit, const std::unordered_map<uint64_t, uint64_t>& threadTracks, const std::vector<Track>& tracks, Encoder& enc )
+{
+    switch( unit.type )
+    {
+    case Unit::Type::Zones:
+        EncodeZones( worker, ((const tracy::ThreadData*)unit.data)->timeline, unit.begin, unit.end, unit.track, enc );
+        break;
+    case Unit::Type::GpuZones:
+        EncodeGpuZones( worker, ((const tracy::GpuCtxThreadData*)unit.data)->timeline, unit.begin, unit.end, unit.track, enc );
+        break;
+    case Unit::Type::Lock:
+    {
+        auto& range = *(const LockRange*)unit.data;
+        LockState state[64];
+        std::copy( range.state, range.state + 64, state );
+        EncodeLock( *range.lock, unit.begin, unit.end, state, tracks[unit.track].name.c_str(), unit.track + 1, enc );
+        break;
+    }
+    case Unit::Type::Cpu:
+    {
+        auto& cs = ((const tracy::CpuData*)unit.data)->cs;
+        for( size_t i=unit.begin; i<unit.end; i++ )
+        {
+            auto& v = cs[i];
+            if( !v.IsEndValid() ) continue;
+            const auto tid = worker.DecompressThreadExternal( v.Thread() );
+            const auto name = worker.IsThreadLocal( tid ) ? worker.GetThreadName( tid ) : worker.GetExternalName( tid ).second;
+            enc.Begin( unit.track, name, v.Start(), v.End(), nullptr, nullptr, 0 );
+            enc.End( unit.track, v.End() );
+        }
+        break;
+    }
+    case Unit::Type::Plot:
+    {
+        auto& data = ((const tracy::PlotData*)unit.data)->data;
+        for( size_t i=unit.begin; i<unit.end; i++ ) enc.Counter( unit.track, data[i].time.Val(), data[i].val );
+        break;
+    }
+    case Unit::Type::Messages:
+    {
+        auto& msgs = worker.GetMessages();
+        for( size_t i=unit.begin; i<unit.end; i++ )
+        {
+            auto& msg = *msgs[i];
+            auto it = threadTracks.find( worker.DecompressThread( msg.thread ) );
+            if( it == threadTracks.end() ) continue;
+            enc.Instant( it->second, worker.GetString( msg.ref ), msg.time );
+        }
+        break;
+    }
+    default:
+        assert( false );
+        break;
+    }
+}
+
+// Earliest event time in the unit. Children never start before their parent, so only the
+// top-level zones need to be checked.
+static int64_t FirstTime( tracy::Worker& worker, const Unit& unit )
+{
+    int64_t time = std::numeric_limits<int64_t>::max();
+    switch( unit.type )
+    {
+    case Unit::Type::Zones:
+        ForEach( ((const tracy::ThreadData*)unit.data)->timeline, unit.begin, unit.end, [&] ( const tracy::ZoneEvent& zone ) { time = std::min( time, zone.Start() ); } );
+        break;
+    case Unit::Type::GpuZones:
+        ForEach( ((const tracy::GpuCtxThreadData*)unit.data)->timeline, unit.begin, unit.end, [&] ( const tracy::GpuEvent& zone ) { if( zone.GpuStart() >= 0 ) time = std::min( time, zone.GpuStart() ); } );
+        break;
+    case Unit::Type::Lock:
+    {
+        auto& timeline = ((const LockRange*)unit.data)->lock->timeline;
+        for( size_t i=unit.begin; i<unit.end; i++ ) time = std::min( time, timeline[i].ptr->Time() );
+        break;
+    }
+    case Unit::Type::Cpu:
+        time = ((const tracy::CpuData*)unit.data)->cs[unit.begin].Start();
+        break;
+    case Unit::Type::Plot:
+        time = ((const tracy::PlotData*)unit.data)->data[unit.begin].time.Val();
+        break;
+    case Unit::Type::Messages:
+        time = worker.GetMessages()[unit.begin]->time;
+        break;
+    default:
+        assert( false );
+        break;
+    }
+    return time;
+}
+
+int main( int argc, char** argv )
+{
+#ifdef _WIN32
+    if( !AttachConsole( ATTACH_PARENT_PROCESS ) )
+    {
+        AllocConsole();
+        SetConsoleMode( GetStdHandle( STD_OUTPUT_HANDLE ), 0x07 );
+    }
+#endif
+
+    const char* format = nullptr;
+    bool exportGpu = true;
+    uint32_t events = tracy::EventType::Locks | tracy::EventType::Messages | tracy::EventType::Plots | tracy::EventType::Memory | tracy::EventType::ContextSwitches;
+    int threads = -1;
+
+    int c;
+    while( ( c = getopt( argc, argv, "f:s:j:" ) ) != -1 )
+    {
+        switch( c )
+        {
+        case 'f':
+            format = optarg;
+            break;
+        case 's':
+        {
+            auto ptr = optarg;
+            while( *ptr )
+            {
+                switch( *ptr++ )
+                {
+                case 'g':
+                    exportGpu = false;
+                    break;
+                case 'l':
+                    events &= ~tracy::EventType::Locks;
+                    break;
+                case 'm':
+                    events &= ~tracy::EventType::Messages;
+                    break;
+                case 'p':
+                    // Memory events are only loaded for the memory usage plots.
+                    events &= ~( tracy::EventType::Plots | tracy::EventType::Memory );
+                    break;
+                case 'c':
+                    events &= ~tracy::EventType::ContextSwitches;
+                    break;
+                default:
+                    Usage();
+                    break;
+                }
+            }
+            break;
+        }
+        case 'j':
+            threads = atoi( optarg );
+            break;
+        default:
+            Usage();
+            break;
+        }
+    }
+    if( argc != optind + 2 ) Usage();
+
+    const char* input = argv[optind];
+    const char* output = argv[optind+1];
+
+    Format fmt;
+    if( format )
+    {
+        if( strcmp( format, "chrome" ) == 0 ) fmt = Format::Chrome;
+        else if( strcmp( format, "perfetto" ) == 0 ) fmt = Format::Perfetto;
+        else Usage();
+    }
+    else
+    {
+        const auto sz = strlen( output );
+        fmt = sz > 5 && strcmp( output + sz - 5, ".json" ) == 0 ? Format::Chrome : Format::Perfetto;
+    }
+    if( threads <= 0 ) threads = std::max<int>( 1, std::thread::hardware_concurrency() );
+
+    auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( input ) );
+    if( !f )
+    {
+        fprintf( stderr, "Cannot open input file!\n" );
+        exit( 1 );
+    }
+
+    printf( "Loading...\r" );
+    fflush( stdout );
+    const auto t0 = std::chrono::high_resolution_clock::now();
+
+    std::unique_ptr<tracy::Worker> wptr;
+    try
+    {
+        wptr = std::make_unique<tracy::Worker>( *f, (tracy::EventType::Type)events, false );
+    }
+    catch( const tracy::UnsupportedVersion& e )
+    {
+        fprintf( stderr, "The file you are trying to open is from the future version.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::NotTracyDump& e )
+    {
+        fprintf( stderr, "The file you are trying to open is not a tracy dump.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::FileReadError& e )
+    {
+        fprintf( stderr, "The file you are trying to open cannot be mapped to memory.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::LegacyVersion& e )
+    {
+        fprintf( stderr, "The file you are trying to open is from a legacy version.\n" );
+        exit( 1 );
+    }
+    auto& worker = *wptr;
+    f.reset();
+
+    const auto t1 = std::chrono::high_resolution_clock::now();
+
+    // Track 0 is the process. Track uuids are indices into the track list.
+    std::vector<Track> tracks;
+    std::vector<uint64_t> trackParents;
+    std::vector<Unit> units;
+    std::deque<LockRange> lockRanges;
+    std::unordered_map<uint64_t, uint64_t> threadTracks;
+
+    const auto pid = worker.GetPid();
+    uint64_t nextTid = 0x7F000000;
+    const auto addTrack = [&] ( std::string name, bool isThread, uint64_t tid, uint64_t parent, bool isCounter = false, bool bytes = false ) -> uint64_t {
+        uint64_t tpid = pid;
+        if( !isThread ) tid = nextTid++;
+        else if( tid > std::numeric_limits<uint32_t>::max() )
+        {
+            // Pseudo thread ids of imported traces encode the pid in the upper half. The importer
+            // also prefixes the thread name with both ids, which would be added again on re-import.
+            tpid = tid >> 32;
+            tid &= 0xFFFFFFFF;
+            char prefix[64];
+            const auto len = snprintf( prefix, sizeof( prefix ), "(PID %" PRIu64 " TID %" PRIu64 ") ", tpid, tid );
+            if( name.compare( 0, len, prefix ) == 0 ) name.erase( 0, len );
+        }
+        tracks.emplace_back( Track { std::move( name ), tpid, tid, isThread, isCounter, bytes } );
+        trackParents.emplace_back( parent );
+        return tracks.size() - 1;
+    };
+    addTrack( worker.GetCaptureProgram(), false, 0, 0 );
+
+    for( auto& td : worker.GetThreadData() )
+    {
+        const auto track = addTrack( worker.GetThreadName( td->id ), true, td->id, 0 );
+        threadTracks.emplace( td->id, track );
+        AddZoneUnits( worker, units, Unit::Type::Zones, track, td, td->timeline );
+    }
+    if( events & tracy::EventType::Messages )
+    {
+        for( auto& msg : worker.GetMessages() )
+        {
+            const auto tid = worker.DecompressThread( msg->thread );
+            if( threadTracks.find( tid ) == threadTracks.end() ) threadTracks.emplace( tid, addTrack( worker.GetThreadName( tid ), true, tid, 0 ) );
+        }
+        const auto& msgs = worker.GetMessages();
+        for( size_t i=0; i<msgs.size(); i+=UnitItems )
+        {
+            units.emplace_back( Unit { Unit::Type::Messages, 0, nullptr, i, std::min<size_t>( i + UnitItems, msgs.size() ), false } );
+        }
+    }
+    if( exportGpu )
+    {
+        const auto& gpuData = worker.GetGpuData();
+        for( size_t i=0; i<gpuData.size(); i++ )
+        {
+            auto& ctx = *gpuData[i];
+            char buf[256];
+            if( ctx.name.Active() ) snprintf( buf, sizeof( buf ), "%s", worker.GetString( ctx.name ) );
+            else snprintf( buf, sizeof( buf ), "%s context %zu", GpuContextNames[(int)ctx.type], i );
+            for( auto& td : ctx.threadData )
+            {
+                std::string name = buf;
+                if( ctx.threadData.size() > 1 ) name += std::string( " (" ) + worker.GetThreadName( td.first ) + ")";
+                const auto track = addTrack( std::move( name ), false, 0, 0 );
+                AddZoneUnits( worker, units, Unit::Type::GpuZones, track, &td.second, td.second.timeline );
+            }
+        }
+    }
+    if( events & tracy::EventType::Locks )
+    {
+        for( auto& v : worker.GetLockMap() )
+        {
+            auto& lock = *v.second;
+            if( !lock.valid || lock.timeline.empty() ) continue;
+            char buf[256];
+            if( lock.customName.Active() ) snprintf( buf, sizeof( buf ), "Lock #%" PRIu32 ": %s", v.first, worker.GetString( lock.customName ) );
+            else snprintf( buf, sizeof( buf ), "Lock #%" PRIu32 ": %s", v.first, worker.GetString( worker.GetSourceLocation( lock.srcloc ).function ) );
+            // The lock track only carries the lock name, the per-thread tracks follow it.
+            const auto track = addTrack( buf, false, 0, 0 );
+            for( auto& tid : lock.threadList )
+            {
+                const auto it = threadTracks.find( tid );
+                addTrack( std::string( buf ) + " (" + worker.GetThreadName( tid ) + ")", false, 0, it != threadTracks.end() ? it->second : 0 );
+            }
+            LockRange range = { &lock };
+            NullEncoder null;
+            const auto size = lock.timeline.size();
+            for( size_t i=0; i<size; i+=UnitItems )
+            {
+                const auto end = std::min<size_t>( i + UnitItems, size );
+                lockRanges.emplace_back( range );
+                units.emplace_back( Unit { Unit::Type::Lock, track, &lockRanges.back(), i, end, false } );
+                if( end != size ) EncodeLock( lock, i, end, range.state, nullptr, 0, null );
+            }
+        }
+    }
+    if( events & tracy::EventType::ContextSwitches )
+    {
+        const auto cpuData = worker.GetCpuData();
+        for( int i=0; i<worker.GetCpuDataCpuCount(); i++ )
+        {
+            auto& cs = cpuData[i].cs;
+            if( cs.empty() ) continue;
+            char buf[32];
+            snprintf( buf, sizeof( buf ), "CPU %i", i );
+            const auto track = addTrack( buf, false, 0, 0 );
+            for( size_t j=0; j<cs.size(); j+=UnitItems )
+            {
+                units.emplace_back( Unit { Unit::Type::Cpu, track, &cpuData[i], j, std::min<size_t>( j + UnitItems, cs.size() ), false } );
+            }
+        }
+    }
+    if( events & tracy::EventType::Plots )
+    {
+        for( auto& plot : worker.GetPlots() )
+        {
+            if( plot->data.empty() ) continue;
+            std::string name;
+            switch( plot->type )
+            {
+            case tracy::PlotType::Memory:
+                name = plot->name == 0 ? "Memory usage" : worker.GetString( plot->name );
+                break;
+            case tracy::PlotType::SysTime:
+                name = "CPU usage";
+                break;
+            default:
+                name = worker.GetString( plot->name );
+                break;
+            }
+            const auto track = addTrack( std::move( name ), false, 0, 0, true, plot->format == tracy::PlotValueFormatting::Memory );
+            for( size_t j=0; j<plot->data.size(); j+=UnitItems )
+            {
+                units.emplace_back( Unit { Unit::Type::Plot, track, plot, j, std::min<size_t>( j + UnitItems, plot->data.size() ), false } );
+            }
+        }
+    }
+
+    FILE* out = fopen( output, "wb" );
+    if( !out )
+    {
+        fprintf( stderr, "Cannot open output file!\n" );
+        exit( 1 );
+    }
+
+    // Track metadata first, then the units. Units are encoded in parallel, in batches which are
+    // written out in order before the next batch starts, so that only a bounded number of
+    // encoded units is held in memory. Streamed units end the batch and are encoded on their own.
+    size_t written = 0;
+    {
+        tracy::BufferWrite buf;
+        if( fmt == Format::Chrome )
+        {
+            ChromeEncoder enc( buf, tracks );
+            WriteString( buf, "{\"traceEvents\":[\n{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" );
+            WriteUInt( buf, pid );
+            WriteString( buf, ",\"args\":{\"name\":" );
+            enc.WriteEscaped( tracks[0].name.c_str() );
+            WriteString( buf, "}}" );
+            for( size_t i=1; i<tracks.size(); i++ )
+            {
+                if( tracks[i].isCounter ) continue;
+                WriteString( buf, ",\n{\"ph\":\"M\",\"name\":\"thread_name\"" );
+                enc.WriteThread( i );
+                WriteString( buf, ",\"args\":{\"name\":" );
+                enc.WriteEscaped( tracks[i].name.c_str() );
+                WriteString( buf, "}}" );
+            }
+        }
+        else
+        {
+            PerfettoEncoder::WriteTrackDescriptor( buf, 1, 0, tracks[0], pid, tracks[0].name.c_str() );
+            for( size_t i=1; i<tracks.size(); i++ )
+            {
+                PerfettoEncoder::WriteTrackDescriptor( buf, i + 1, trackParents[i] != 0 ? trackParents[i] + 1 : 1, tracks[i], pid, nullptr );
+            }
+        }
+        fwrite( buf.GetData(), 1, buf.GetSize(), out );
+        written += buf.GetSize();
+    }
+
+    {
+        int64_t offset = 0;
+        if( fmt == Format::Perfetto )
+        {
+            for( auto& unit : units ) offset = std::max( offset, -FirstTime( worker, unit ) );
+        }
+
+        const auto encode = [&] ( tracy::BufferWrite& buf, size_t idx, Stream* stream ) {
+            auto& unit = units[idx];
+            if( fmt == Format::Chrome )
+            {
+                ChromeEncoder enc( buf, tracks, stream );
+                EncodeUnit( worker, unit, threadTracks, tracks, enc );
+            }
+            else
+            {
+                PerfettoEncoder enc( buf, uint32_t( idx + 1 ), offset, stream );
+                EncodeUnit( worker, unit, threadTracks, tracks, enc );
+            }
+        };
+
+        const auto batchSize = size_t( threads * 2 );
+        std::vector<std::unique_ptr<tracy::BufferWrite>> buffers( batchSize );
+        for( auto& v : buffers ) v = std::make_unique<tracy::BufferWrite>();
+
+        tracy::TaskDispatch td( threads - 1, "Export" );
+        size_t batch = 0;
+        while( batch < units.size() )
+        {
+            size_t num = 0;
+            if( units[batch].stream )
+            {
+                auto& buf = *buffers[0];
+                buf.Clear();
+                Stream stream { out, 0 };
+                encode( buf, batch, &stream );
+                stream.Flush( buf );
+                written += stream.written;
+                num = 1;
+            }
+            else
+            {
+                while( num < batchSize && batch + num < units.size() && !units[batch + num].stream ) num++;
+                for( size_t i=0; i<num; i++ )
+                {
+                    td.Queue( [&, i, batch] {
+                        auto& buf = *buffers[i];
+                        buf.Clear();
+                        encode( buf, batch + i, nullptr );
+                    } );
+                }
+                td.Sync();
+                for( size_t i=0; i<num; i++ )
+                {
+                    fwrite( buffers[i]->GetData(), 1, buffers[i]->GetSize(), out );
+                    written += buffers[i]->GetSize();
+                }
+            }
+            batch += num;
+            printf( "\33[2KExporting... %zu/%zu\r", batch, units.size() );
+            fflush( stdout );
+        }
+    }
+
+    if( fmt == Format::Chrome )
+    {
+        const char footer[] = "\n],\"displayTimeUnit\":\"ns\"}\n";
+        fwrite( footer, 1, sizeof( footer ) - 1, out );
+        written += sizeof( footer ) - 1;
+    }
+    fclose( out );
+
+    const auto t2 = std::chrono::high_resolution_clock::now();
+    printf( "\33[2KLoaded in %s, exported %s in %s\n",
+        tracy::TimeToString( std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() ),
+        tracy::MemSizeToString( written ),
+        tracy::TimeToString( std::chrono::duration_cast<std::chrono::nanoseconds>( t2 - t1 ).count() ) );
+
+    return 0;
+}
@@ -2,11 +2,16 @@
 #  include <windows.h>
 #endif
 
-#include <fstream>
+#include <algorithm>
+#include <istream>
+#include <optional>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <streambuf>
 #include <string.h>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 
 #include <sys/stat.h>
@@ -22,6 +27,7 @@
 
 #include "../../server/TracyFileWrite.hpp"
 #include "../../server/TracyMmap.hpp"
+#include "../../server/TracyTaskDispatch.hpp"
 #include "../../server/TracyWorker.hpp"
 #include "../../zstd/zstd.h"
 
@@ -30,6 +36,7 @@ using json = nlohmann::json;
 void Usage()
 {
     printf( "Usage: import-chrome input.json output.tracy\n\n" );
+    printf( "The input file may be zstd-compressed.\n\n" );
     printf( "The following chrome-tracing phases are supported:\n\n" );
     printf( "  b/B/e/E - Timeline events such as ZoneNamed\n" );
     printf( "  X - Timeline events such as ZoneNamed\n" );
@@ -40,105 +47,211 @@ void Usage()
     exit( 1 );
 }
 
-int main( int argc, char** argv )
+// Decompresses a memory-mapped zstd stream on demand, so that the parser never sees
+// more than a single block of the decompressed input.
+class ZstdStreamBuf : public std::streambuf
 {
-#ifdef _WIN32
-    if( !AttachConsole( ATTACH_PARENT_PROCESS ) )
+public:
+    ZstdStreamBuf( const char* data, size_t size )
+        : m_ctx( ZSTD_createDStream() )
+        , m_in { data, size, 0 }
+        , m_buf( new char[ZSTD_DStreamOutSize()] )
+        , m_last( 0 )
+        , m_error( nullptr )
     {
-        AllocConsole();
-        SetConsoleMode( GetStdHandle( STD_OUTPUT_HANDLE ), 0x07 );
+        ZSTD_initDStream( m_ctx );
     }
-#endif
 
-    tracy::FileCompression clev = tracy::FileCompression::Fast;
+    ~ZstdStreamBuf()
+    {
+        ZSTD_freeDStream( m_ctx );
+        delete[] m_buf;
+    }
 
-    if( argc != 3 ) Usage();
+    const char* GetError() const { return m_error; }
 
-    const char* input = argv[1];
-    const char* output = argv[2];
+protected:
+    int_type underflow() override
+    {
+        if( gptr() < egptr() ) return traits_type::to_int_type( *gptr() );
+        while( m_in.pos < m_in.size )
+        {
+            ZSTD_outBuffer out = { m_buf, ZSTD_DStreamOutSize(), 0 };
+            m_last = ZSTD_decompressStream( m_ctx, &out, &m_in );
+            if( ZSTD_isError( m_last ) )
+            {
+                m_error = ZSTD_getErrorName( m_last );
+                return traits_type::eof();
+            }
+            if( out.pos > 0 )
+            {
+                setg( m_buf, m_buf, m_buf + out.pos );
+                return traits_type::to_int_type( *m_buf );
+            }
+        }
+        if( m_last != 0 ) m_error = "truncated input";
+        return traits_type::eof();
+    }
 
-    printf( "Loading...\r" );
-    fflush( stdout );
+private:
+    ZSTD_DStream* m_ctx;
+    ZSTD_inBuffer m_in;
+    char* m_buf;
+    size_t m_last;
+    const char* m_error;
+};
+
+// SAX consumer which locates the event array (either the root array, or the "traceEvents"
+// array of the root object) and builds a small DOM for one event at a time. Each event is
+// passed to the handler as soon as it is complete and then discarded.
+template<typename Handler>
+class TraceEventParser
+{
+    using Dom = nlohmann::detail::json_sax_dom_parser<json>;
+
+public:
+    TraceEventParser( Handler& handler )
+        : m_handler( handler )
+        , m_depth( 0 )
+        , m_eventsDepth( -1 )
+        , m_eventsKey( false )
+        , m_found( false )
+        , m_count( 0 )
+    {
+    }
+
+    bool FoundEvents() const { return m_found; }
 
-    json j;
+    bool null() { return !m_dom || m_dom->null(); }
+    bool boolean( bool val ) { return !m_dom || m_dom->boolean( val ); }
+    bool number_integer( json::number_integer_t val ) { return !m_dom || m_dom->number_integer( val ); }
+    bool number_unsigned( json::number_unsigned_t val ) { return !m_dom || m_dom->number_unsigned( val ); }
+    bool number_float( json::number_float_t val, const json::string_t& s ) { return !m_dom || m_dom->number_float( val, s ); }
+    bool string( json::string_t& val ) { return !m_dom || m_dom->string( val ); }
+    bool binary( json::binary_t& val ) { return !m_dom || m_dom->binary( val ); }
+
+    bool key( json::string_t& val )
+    {
+        if( m_dom ) return m_dom->key( val );
+        if( m_depth == 1 ) m_eventsKey = val == "traceEvents";
+        return true;
+    }
 
-    const auto fnsz = strlen( input );
-    if( fnsz > 4 && memcmp( input+fnsz-4, ".zst", 4 ) == 0 )
+    bool start_object( size_t elements )
     {
-        FILE* f = fopen( input, "rb" );
-        if( !f )
+        if( !m_dom && m_depth == m_eventsDepth )
         {
-            fprintf( stderr, "Cannot open input file!\n" );
-            exit( 1 );
+            m_event = json();
+            m_dom.emplace( m_event );
         }
-        struct stat64 sb;
-        if( stat64( input, &sb ) != 0 )
+        m_depth++;
+        return !m_dom || m_dom->start_object( elements );
+    }
+
+    bool end_object()
+    {
+        m_depth--;
+        if( !m_dom ) return true;
+        if( !m_dom->end_object() ) return false;
+        if( m_depth == m_eventsDepth )
         {
-            fprintf( stderr, "Cannot open input file!\n" );
-            fclose( f );
-            exit( 1 );
+            m_dom.reset();
+            m_handler( m_event );
+            if( ( ++m_count & 0xFFFFF ) == 0 )
+            {
+                printf( "\33[2KParsing... %zu events\r", m_count );
+                fflush( stdout );
+            }
         }
+        return true;
+    }
 
-        const auto zsz = sb.st_size;
-        auto zbuf = (char*)mmap( nullptr, zsz, PROT_READ, MAP_SHARED, fileno( f ), 0 );
-        fclose( f );
-        if( !zbuf )
+    bool start_array( size_t elements )
+    {
+        if( !m_dom && ( m_depth == 0 || ( m_depth == 1 && m_eventsKey ) ) )
         {
-            fprintf( stderr, "Cannot mmap input file!\n" );
-            exit( 1 );
+            m_eventsDepth = m_depth + 1;
+            m_found = true;
         }
+        m_depth++;
+        return !m_dom || m_dom->start_array( elements );
+    }
+
+    bool end_array()
+    {
+        m_depth--;
+        if( m_dom ) return m_dom->end_array();
+        if( m_depth + 1 == m_eventsDepth ) m_eventsDepth = -1;
+        return true;
+    }
+
+    bool parse_error( size_t pos, const std::string&, const nlohmann::detail::exception& ex )
+    {
+        fprintf( stderr, "\nCannot parse input file at byte %zu: %s\n", pos, ex.what() );
+        return false;
+    }
 
-        auto zctx = ZSTD_createDStream();
-        ZSTD_initDStream( zctx );
+private:
+    Handler& m_handler;
+    json m_event;
+    std::optional<Dom> m_dom;
+    int m_depth;
+    int m_eventsDepth;
+    bool m_eventsKey;
+    bool m_found;
+    size_t m_count;
+};
 
-        enum { tmpSize = 64*1024 };
-        auto tmp = new char[tmpSize];
+int main( int argc, char** argv )
+{
+#ifdef _WIN32
+    if( !AttachConsole( ATTACH_PARENT_PROCESS ) )
+    {
+        AllocConsole();
+        SetConsoleMode( GetStdHandle( STD_OUTPUT_HANDLE ), 0x07 );
+    }
+#endif
 
-        ZSTD_inBuffer_s zin = { zbuf, (size_t)zsz };
-        ZSTD_outBuffer_s zout = { tmp, (size_t)tmpSize };
+    tracy::FileCompression clev = tracy::FileCompression::Fast;
 
-        std::vector<uint8_t> buf;
-        buf.reserve( 1024*1024 );
+    if( argc != 3 ) Usage();
 
-        while( zin.pos < zin.size )
-        {
-            const auto res = ZSTD_decompressStream( zctx, &zout, &zin );
-            if( ZSTD_isError( res ) )
-            {
-                ZSTD_freeDStream( zctx );
-                delete[] tmp;
-                fprintf( stderr, "Couldn't decompress input file (%s)!\n", ZSTD_getErrorName( res ) );
-                exit( 1 );
-            }
-            if( zout.pos > 0 )
-            {
-                const auto bsz = buf.size();
-                buf.resize( bsz + zout.pos );
-                memcpy( buf.data() + bsz, tmp, zout.pos );
-                zout.pos = 0;
-            }
-        }
+    const char* input = argv[1];
+    const char* output = argv[2];
 
-        ZSTD_freeDStream( zctx );
-        delete[] tmp;
-        munmap( zbuf, zsz );
+    printf( "Loading...\r" );
+    fflush( stdout );
 
-        j = json::parse( buf.begin(), buf.end() );
+    FILE* f = fopen( input, "rb" );
+    if( !f )
+    {
+        fprintf( stderr, "Cannot open input file!\n" );
+        exit( 1 );
     }
-    else
+    struct stat64 sb;
+    if( stat64( input, &sb ) != 0 )
     {
-        std::ifstream is( input );
-        if( !is.is_open() )
-        {
-            fprintf( stderr, "Cannot open input file!\n" );
-            exit( 1 );
-        }
-        is >> j;
-        is.close();
+        fprintf( stderr, "Cannot open input file!\n" );
+        fclose( f );
+        exit( 1 );
     }
-
-    printf( "\33[2KParsing...\r" );
-    fflush( stdout );
+    const auto fsz = size_t( sb.st_size );
+    if( fsz == 0 )
+    {
+        fprintf( stderr, "Input file is empty!\n" );
+        fclose( f );
+        exit( 1 );
+    }
+    auto fbuf = (const char*)mmap( nullptr, fsz, PROT_READ, MAP_SHARED, fileno( f ), 0 );
+    fclose( f );
+    if( fbuf == (const char*)-1 )
+    {
+        fprintf( stderr, "Cannot mmap input file!\n" );
+        exit( 1 );
+    }
+#ifndef _WIN32
+    madvise( (void*)fbuf, fsz, MADV_SEQUENTIAL );
+#endif
 
     // encode a pair of "real pid, real tid" from a trace into a
     // pseudo thread ID living in the single namespace of Tracy threads.
@@ -149,8 +262,35 @@ int main( int argc, char** argv )
         uint64_t pseudo_tid; // fake thread id, unique within Tracy
     };
 
+    // Timeline events are gathered per thread, so that each thread can be sorted independently.
+    // Strings and source locations are interned in the worker as events are parsed, an event
+    // with no source location ends a zone.
+    struct Event
+    {
+        uint64_t timestamp;
+        int32_t srcloc;
+        tracy::StringIdx text;
+    };
+
+    struct ThreadTimeline
+    {
+        uint64_t tid;
+        std::vector<Event> events;
+    };
+
+    auto&& getFilename = [](const char* in) {
+        auto out = in;
+        while (*out) ++out;
+        --out;
+        while (out > in && (*out != '/' || *out != '\\')) out--;
+        return out;
+    };
+
+    tracy::Worker worker( getFilename(output), getFilename(input) );
+
     std::vector<PidTidEncoder> tid_encoders;
-    std::vector<tracy::Worker::ImportEventTimeline> timeline;
+    std::vector<ThreadTimeline> threadTimelines;
+    std::unordered_map<uint64_t, size_t> threadTimelineMap;
     std::vector<tracy::Worker::ImportEventMessages> messages;
     std::vector<tracy::Worker::ImportEventPlots> plots;
     std::unordered_map<uint64_t, std::string> threadNames;
@@ -182,79 +322,82 @@ int main( int argc, char** argv )
         }
     };
 
-    if( j.is_object() && j.contains( "traceEvents" ) )
-    {
-        j = j["traceEvents"];
-    }
+    const auto getTimeline = [&]( uint64_t tid ) -> std::vector<Event>& {
+        auto it = threadTimelineMap.find( tid );
+        if( it == threadTimelineMap.end() )
+        {
+            it = threadTimelineMap.emplace( tid, threadTimelines.size() ).first;
+            threadTimelines.emplace_back( ThreadTimeline { tid } );
+        }
+        return threadTimelines[it->second].events;
+    };
 
-    if( !j.is_array() )
-    {
-        fprintf( stderr, "Input must be either an array of events or an object containing an array of events under \"traceEvents\" key.\n" );
-        exit( 1 );
-    }
+    const auto storeString = [&worker]( std::string_view str ) { return worker.StoreString( str.data(), str.size() ).idx; };
 
-    for( auto& v : j )
-    {
-        const auto type = v["ph"].get<std::string>();
+    // Interns the zone name, location and arguments of an event that starts a zone.
+    const auto getZone = [&]( json& v ) -> Event {
+        Event ev = { 0, 0 };
 
-        std::string zoneText = "";
         if( v.contains( "args" ) )
         {
+            std::string zoneText;
             for( auto& kv : v["args"].items() )
             {
-                const auto val = kv.value();
-                const std::string s = val.is_string() ? val.get<std::string>() : val.dump();
-                zoneText += kv.key() + ": " + s + "\n";
+                const auto& val = kv.value();
+                zoneText += kv.key();
+                zoneText += ": ";
+                zoneText += val.is_string() ? val.get_ref<const std::string&>() : val.dump();
+                zoneText += "\n";
             }
+            if( !zoneText.empty() ) ev.text.SetIdx( storeString( zoneText ) );
         }
 
-        std::string locFile;
+        std::string_view locFile;
         uint32_t locLine = 0;
         if( v.contains( "loc" ) )
         {
-            auto loc = v["loc"].get<std::string>();
+            const std::string_view loc = v["loc"].get_ref<const std::string&>();
             const auto lpos = loc.find_last_of( ':' );
-            if( lpos == std::string::npos )
+            if( lpos == std::string_view::npos )
             {
-                std::swap( loc, locFile );
+                locFile = loc;
             }
             else
             {
                 locFile = loc.substr( 0, lpos );
-                locLine = atoi( loc.c_str() + lpos + 1 );
+                locLine = atoi( loc.data() + lpos + 1 );
             }
         }
 
+        ev.srcloc = worker.ImportSourceLocation( storeString( v["name"].get_ref<const std::string&>() ), storeString( locFile ), locLine );
+        return ev;
+    };
+
+    auto processEvent = [&]( json& v ) {
+        const auto& type = v["ph"].get_ref<const std::string&>();
+
         if( type == "b" || type == "B" )
         {
-            timeline.emplace_back( tracy::Worker::ImportEventTimeline {
-                getPseudoTid(v),
-                uint64_t( v["ts"].get<double>() * 1000. ),
-                v["name"].get<std::string>(),
-                std::move(zoneText),
-                false,
-                std::move(locFile),
-                locLine
-            } );
+            const auto tid = getPseudoTid(v);
+            auto ev = getZone( v );
+            ev.timestamp = uint64_t( v["ts"].get<double>() * 1000. );
+            getTimeline( tid ).emplace_back( ev );
         }
         else if( type == "e" || type == "E" )
         {
-            timeline.emplace_back( tracy::Worker::ImportEventTimeline {
-                getPseudoTid(v),
-                uint64_t( v["ts"].get<double>() * 1000. ),
-                "",
-                std::move(zoneText),
-                true
-            } );
+            const auto tid = getPseudoTid(v);
+            getTimeline( tid ).emplace_back( Event { uint64_t( v["ts"].get<double>() * 1000. ), 0 } );
         }
         else if( type == "X" )
         {
             const auto tid = getPseudoTid(v);
             const auto ts0 = uint64_t( v["ts"].get<double>() * 1000. );
             const auto ts1 = ts0 + uint64_t( v["dur"].get<double>() * 1000. );
-            const auto name = v["name"].get<std::string>();
-            timeline.emplace_back( tracy::Worker::ImportEventTimeline { tid, ts0, name, std::move(zoneText), false, std::move(locFile), locLine } );
-            timeline.emplace_back( tracy::Worker::ImportEventTimeline { tid, ts1, "", "", true } );
+            auto ev = getZone( v );
+            ev.timestamp = ts0;
+            auto& timeline = getTimeline( tid );
+            timeline.emplace_back( ev );
+            timeline.emplace_back( Event { ts1, 0 } );
         }
         else if( type == "i" || type == "I" )
         {
@@ -310,16 +453,67 @@ int main( int argc, char** argv )
                 threadNames[tid] = v["args"]["name"].get<std::string>();
             }
         }
+    };
+
+    printf( "\33[2KParsing...\r" );
+    fflush( stdout );
+
+    TraceEventParser<decltype(processEvent)> parser( processEvent );
+    bool parsed;
+    if( fsz >= 4 && memcmp( fbuf, "\x28\xB5\x2F\xFD", 4 ) == 0 )
+    {
+        ZstdStreamBuf zbuf( fbuf, fsz );
+        std::istream is( &zbuf );
+        parsed = json::sax_parse( is, &parser );
+        if( zbuf.GetError() )
+        {
+            fprintf( stderr, "Couldn't decompress input file (%s)!\n", zbuf.GetError() );
+            exit( 1 );
+        }
+    }
+    else if( fsz >= 2 && memcmp( fbuf, "\x1F\x8B", 2 ) == 0 )
+    {
+        fprintf( stderr, "Gzip-compressed input is not supported. Decompress the file, or recompress it with zstd.\n" );
+        exit( 1 );
+    }
+    else
+    {
+        parsed = json::sax_parse( fbuf, fbuf + fsz, &parser );
+    }
+    munmap( (void*)fbuf, fsz );
+    if( !parsed ) exit( 1 );
+
+    if( !parser.FoundEvents() )
+    {
+        fprintf( stderr, "Input must be either an array of events or an object containing an array of events under \"traceEvents\" key.\n" );
+        exit( 1 );
+    }
+
+    printf( "\33[2KSorting...\r" );
+    fflush( stdout );
+
+    {
+        tracy::TaskDispatch td( std::max<int>( 1, std::thread::hardware_concurrency() - 1 ), "Import sort" );
+        for( auto& v : threadTimelines )
+        {
+            td.Queue( [&v] { std::stable_sort( v.events.begin(), v.events.end(), [] ( const auto& l, const auto& r ) { return l.timestamp < r.timestamp; } ); } );
+        }
+        td.Queue( [&messages] { std::stable_sort( messages.begin(), messages.end(), [] ( const auto& l, const auto& r ) { return l.timestamp < r.timestamp; } ); } );
+        for( auto& v : plots )
+        {
+            td.Queue( [&v] { std::stable_sort( v.data.begin(), v.data.end(), [] ( const auto& l, const auto& r ) { return l.first < r.first; } ); } );
+        }
+        td.Sync();
     }
 
-    std::stable_sort( timeline.begin(), timeline.end(), [] ( const auto& l, const auto& r ) { return l.timestamp < r.timestamp; } );
-    std::stable_sort( messages.begin(), messages.end(), [] ( const auto& l, const auto& r ) { return l.timestamp < r.timestamp; } );
-    for( auto& v : plots ) std::stable_sort( v.data.begin(), v.data.end(), [] ( const auto& l, const auto& r ) { return l.first < r.first; } );
+    // Threads are laid out in order of their first event, which is the order in which they
+    // would appear on a globally sorted timeline.
+    std::stable_sort( threadTimelines.begin(), threadTimelines.end(), [] ( const auto& l, const auto& r ) { return l.events[0].timestamp < r.events[0].timestamp; } );
 
-    uint64_t mts = 0;
-    if( !timeline.empty() )
+    uint64_t mts = std::numeric_limits<uint64_t>::max();
+    for( auto& v : threadTimelines )
     {
-        mts = timeline[0].timestamp;
+        if( mts > v.events[0].timestamp ) mts = v.events[0].timestamp;
     }
     if( !messages.empty() )
     {
@@ -329,25 +523,38 @@ int main( int argc, char** argv )
     {
         if( mts > plot.data[0].first ) mts = plot.data[0].first;
     }
-    for( auto& v : timeline ) v.timestamp -= mts;
-    for( auto& v : messages ) v.timestamp -= mts;
-    for( auto& plot : plots )
-    {
-        for( auto& v : plot.data ) v.first -= mts;
-    }
+    if( mts == std::numeric_limits<uint64_t>::max() ) mts = 0;
 
     printf( "\33[2KProcessing...\r" );
     fflush( stdout );
 
-    auto&& getFilename = [](const char* in) {
-        auto out = in;
-        while (*out) ++out;
-        --out;
-        while (out > in && (*out != '/' || *out != '\\')) out--;
-        return out;
-    };
+    // Each thread is handed over to the worker and released before the next one.
+    for( auto& v : threadTimelines )
+    {
+        for( auto& ev : v.events )
+        {
+            if( ev.srcloc != 0 )
+            {
+                worker.ImportZoneBegin( v.tid, ev.timestamp - mts, ev.srcloc, ev.text );
+            }
+            else
+            {
+                worker.ImportZoneEnd( v.tid, ev.timestamp - mts );
+            }
+        }
+        std::vector<Event>().swap( v.events );
+    }
 
-    tracy::Worker worker( getFilename(output), getFilename(input), timeline, messages, plots, threadNames );
+    for( auto& v : messages ) v.timestamp -= mts;
+    worker.ImportMessages( messages );
+    std::vector<tracy::Worker::ImportEventMessages>().swap( messages );
+
+    for( auto& plot : plots )
+    {
+        for( auto& v : plot.data ) v.first -= mts;
+    }
+    worker.ImportPlots( plots );
+    worker.ImportFinish( threadNames );
 
     auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output, clev ) );
     if( !w )
@@ -0,0 +1,1081 @@
+#ifdef _WIN32
+#  include <windows.h>
+#endif
+
+#include <algorithm>
+#include <inttypes.h>
+#include <limits>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifdef _MSC_VER
+#  define stat64 _stat64
+#endif
+#if defined __APPLE__
+#  define stat64 stat
+#endif
+
+#include "../../public/common/TracyForceInline.hpp"
+#include "../../server/TracyFileWrite.hpp"
+#include "../../server/TracyMmap.hpp"
+#include "../../server/TracyTaskDispatch.hpp"
+#include "../../server/TracyWorker.hpp"
+
+void Usage()
+{
+    printf( "Usage: import-perfetto input.perfetto-trace output.tracy\n\n" );
+    printf( "Converts Perfetto protobuf traces. The following data is supported:\n\n" );
+    printf( "  Track events - slices are converted to zones, instant events to messages\n" );
+    printf( "    * Messages containing the word \"frame\" are interpreted as frame events such as FrameMarkNamed\n" );
+    printf( "  Counter tracks - counter values are converted to plots\n" );
+    printf( "  Track descriptors - thread and track names are used to name threads\n" );
+    exit( 1 );
+}
+
+// Protobuf wire format reader working directly on the input buffer. Length-delimited
+// fields point into the buffer, nothing is copied.
+struct ProtoField
+{
+    enum Type { Varint = 0, Fixed64 = 1, Length = 2, Fixed32 = 5 };
+
+    uint32_t id;
+    uint32_t type;
+    uint64_t value;
+    const uint8_t* data;
+    uint64_t size;
+
+    std::string_view String() const { return std::string_view( (const char*)data, size ); }
+    double Double() const { double v; memcpy( &v, &value, sizeof( v ) ); return v; }
+};
+
+class ProtoReader
+{
+public:
+    ProtoReader( const uint8_t* ptr, uint64_t size ) : m_ptr( ptr ), m_end( ptr + size ), m_error( false ) {}
+    explicit ProtoReader( const ProtoField& field ) : ProtoReader( field.data, field.size ) {}
+
+    bool Next( ProtoField& field )
+    {
+        if( m_ptr == m_end ) return false;
+        uint64_t tag;
+        if( !ReadVarint( tag ) ) return Fail();
+        field.id = uint32_t( tag >> 3 );
+        field.type = uint32_t( tag & 7 );
+        switch( field.type )
+        {
+        case ProtoField::Varint:
+            if( !ReadVarint( field.value ) ) return Fail();
+            break;
+        case ProtoField::Fixed64:
+            if( m_end - m_ptr < 8 ) return Fail();
+            memcpy( &field.value, m_ptr, 8 );
+            m_ptr += 8;
+            break;
+        case ProtoField::Length:
+            if( !ReadVarint( field.size ) || uint64_t( m_end - m_ptr ) < field.size ) return Fail();
+            field.data = m_ptr;
+            m_ptr += field.size;
+            break;
+        case ProtoField::Fixed32:
+        {
+            if( m_end - m_ptr < 4 ) return Fail();
+            uint32_t v;
+            memcpy( &v, m_ptr, 4 );
+            field.value = v;
+            m_ptr += 4;
+            break;
+        }
+        default:
+            return Fail();
+        }
+        return true;
+    }
+
+    bool HasError() const { return m_error; }
+    const uint8_t* GetPosition() const { return m_ptr; }
+
+    tracy_force_inline bool ReadVarint( uint64_t& value )
+    {
+        uint64_t v = 0;
+        for( int shift = 0; shift < 64 && m_ptr != m_end; shift += 7 )
+        {
+            const auto b = *m_ptr++;
+            v |= uint64_t( b & 0x7F ) << shift;
+            if( ( b & 0x80 ) == 0 )
+            {
+                value = v;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    bool Fail()
+    {
+        m_error = true;
+        m_ptr = m_end;
+        return false;
+    }
+
+    const uint8_t* m_ptr;
+    const uint8_t* m_end;
+    bool m_error;
+};
+
+// Repeated scalar fields may be encoded either one value per field, or packed.
+template<typename T>
+static void ReadRepeated( const ProtoField& field, std::vector<T>& out )
+{
+    if( field.type == ProtoField::Length )
+    {
+        ProtoReader rd( field );
+        uint64_t v;
+        while( rd.GetPosition() != field.data + field.size && rd.ReadVarint( v ) ) out.emplace_back( T( v ) );
+    }
+    else
+    {
+        out.emplace_back( T( field.value ) );
+    }
+}
+
+// Field numbers of the Perfetto trace protos (protos/perfetto/trace/...).
+namespace Pf
+{
+enum { TracePacket = 1 };
+
+namespace Packet { enum {
+    ClockSnapshot = 6,
+    Timestamp = 8,
+    SequenceId = 10,
+    TrackEvent = 11,
+    InternedData = 12,
+    SequenceFlags = 13,
+    IncrementalStateCleared = 41,
+    CompressedPackets = 50,
+    TimestampClockId = 58,
+    Defaults = 59,
+    TrackDescriptor = 60
+}; }
+
+enum { SeqIncrementalStateCleared = 1 };
+
+namespace ClockSnapshot { enum { Clocks = 1, PrimaryTraceClock = 2 }; }
+namespace Clock { enum { Id = 1, Timestamp = 2, IsIncremental = 3, UnitMultiplierNs = 4 }; }
+enum { ClockBoottime = 6, ClockFirstSequenceScoped = 64 };
+
+namespace Defaults { enum { TrackEventDefaults = 11, TimestampClockId = 58 }; }
+namespace TrackEventDefaults { enum { TrackUuid = 11, ExtraCounterTrackUuids = 31, ExtraDoubleCounterTrackUuids = 45 }; }
+
+namespace TrackEvent { enum {
+    DebugAnnotations = 4,
+    Type = 9,
+    NameIid = 10,
+    TrackUuid = 11,
+    ExtraCounterValues = 12,
+    Name = 23,
+    CounterValue = 30,
+    ExtraCounterTrackUuids = 31,
+    SourceLocation = 33,
+    SourceLocationIid = 34,
+    DoubleCounterValue = 44,
+    ExtraDoubleCounterTrackUuids = 45,
+    ExtraDoubleCounterValues = 46
+}; }
+enum { TypeSliceBegin = 1, TypeSliceEnd = 2, TypeInstant = 3, TypeCounter = 4 };
+
+namespace Annotation { enum {
+    NameIid = 1,
+    BoolValue = 2,
+    UintValue = 3,
+    IntValue = 4,
+    DoubleValue = 5,
+    StringValue = 6,
+    PointerValue = 7,
+    LegacyJsonValue = 9,
+    Name = 10
+}; }
+
+namespace InternedData { enum { EventNames = 2, AnnotationNames = 3, SourceLocations = 4 }; }
+namespace InternedString { enum { Iid = 1, Name = 2 }; }
+namespace SourceLocation { enum { Iid = 1, FileName = 2, FunctionName = 3, LineNumber = 4 }; }
+
+namespace TrackDescriptor { enum { Uuid = 1, Name = 2, Process = 3, Thread = 4, ParentUuid = 5, Counter = 8, StaticName = 10 }; }
+namespace ProcessDescriptor { enum { Pid = 1, ProcessName = 6 }; }
+namespace ThreadDescriptor { enum { Pid = 1, Tid = 2, ThreadName = 5 }; }
+namespace CounterDescriptor { enum { Unit = 3, UnitMultiplier = 4, IsIncremental = 5 }; }
+enum { UnitSizeBytes = 3 };
+}
+
+// Names and source locations are interned in the worker as soon as they are decoded.
+struct SourceLoc
+{
+    uint32_t file;
+    uint32_t function;
+    uint32_t line;
+};
+
+struct SequenceClock
+{
+    uint64_t value;
+    uint64_t multiplier;
+    int64_t offset;
+    bool incremental;
+};
+
+// Interned data and packet defaults, valid until the sequence clears its incremental state.
+struct SequenceState
+{
+    std::unordered_map<uint64_t, uint32_t> eventNames;
+    std::unordered_map<uint64_t, std::string_view> annotationNames;
+    std::unordered_map<uint64_t, SourceLoc> sourceLocations;
+    std::unordered_map<uint32_t, SequenceClock> clocks;
+
+    uint32_t clockId = 0;
+    uint64_t trackUuid = 0;
+    std::vector<uint64_t> extraCounterTracks;
+    std::vector<uint64_t> extraDoubleCounterTracks;
+
+    void Clear()
+    {
+        eventNames.clear();
+        annotationNames.clear();
+        sourceLocations.clear();
+        clocks.clear();
+        clockId = 0;
+        trackUuid = 0;
+        extraCounterTracks.clear();
+        extraDoubleCounterTracks.clear();
+    }
+};
+
+// Slice begin or end event. The end of a slice has no source location.
+struct Slice
+{
+    uint64_t timestamp;
+    int32_t srcloc;
+    tracy::StringIdx text;
+};
+
+// Events are gathered per track, as track descriptors may appear anywhere in the trace.
+// The tid fields of messages hold the track uuid until tracks are resolved to threads.
+struct Track
+{
+    uint64_t parent = 0;
+    std::string_view name;
+    std::string_view processName;
+    uint64_t pid = 0;
+    uint64_t tid = 0;
+    bool isProcess = false;
+    bool isThread = false;
+    bool isCounter = false;
+    bool incremental = false;
+    bool bytes = false;
+    int64_t multiplier = 1;
+
+    std::vector<Slice> slices;
+    std::vector<std::pair<int64_t, double>> counter;
+};
+
+class PerfettoDecoder
+{
+public:
+    PerfettoDecoder( tracy::Worker& worker ) : m_worker( worker ), m_emptyString( worker.StoreString( "", 0 ).idx ), m_compressedPackets( 0 ), m_packets( 0 ) {}
+
+    bool DecodePacket( const ProtoField& packet );
+
+    uint64_t GetCompressedPackets() const { return m_compressedPackets; }
+
+    void Finish();
+
+private:
+    void DecodeClockSnapshot( const ProtoField& field, SequenceState& seq );
+    void DecodeInternedData( const ProtoField& field, SequenceState& seq );
+    void DecodeDefaults( const ProtoField& field, SequenceState& seq );
+    void DecodeTrackDescriptor( const ProtoField& field );
+    void DecodeTrackEvent( const ProtoField& field, uint64_t timestamp, SequenceState& seq );
+    void AppendAnnotation( const ProtoField& field, const SequenceState& seq, std::string& text );
+    uint64_t ConvertTimestamp( uint64_t ts, uint32_t clockId, SequenceState& seq );
+
+    void AddCounterValue( uint64_t track, uint64_t timestamp, double value );
+    uint64_t GetProcessId( uint64_t uuid );
+    uint32_t StoreString( std::string_view str ) { return m_worker.StoreString( str.data(), str.size() ).idx; }
+
+    tracy::Worker& m_worker;
+    uint32_t m_emptyString;
+
+    std::unordered_map<uint32_t, SequenceState> m_sequences;
+    std::unordered_map<uint64_t, Track> m_tracks;
+    std::unordered_map<uint32_t, int64_t> m_clockOffsets;
+
+    std::vector<tracy::Worker::ImportEventMessages> m_messages;
+
+    uint64_t m_compressedPackets;
+    uint64_t m_packets;
+};
+
+bool PerfettoDecoder::DecodePacket( const ProtoField& packet )
+{
+    // Incremental state has to be handled before anything else in the packet, regardless of field order.
+    ProtoField trackEvent = {}, internedData = {}, defaults = {}, trackDescriptor = {}, clockSnapshot = {};
+    uint64_t timestamp = 0;
+    uint32_t clockId = 0;
+    uint32_t sequenceId = 0;
+    bool hasTimestamp = false;
+    bool clearState = false;
+
+    ProtoReader rd( packet );
+    ProtoField f;
+    while( rd.Next( f ) )
+    {
+        switch( f.id )
+        {
+        case Pf::Packet::Timestamp: timestamp = f.value; hasTimestamp = true; break;
+        case Pf::Packet::TimestampClockId: clockId = uint32_t( f.value ); break;
+        case Pf::Packet::SequenceId: sequenceId = uint32_t( f.value ); break;
+        case Pf::Packet::SequenceFlags: if( f.value & Pf::SeqIncrementalStateCleared ) clearState = true; break;
+        case Pf::Packet::IncrementalStateCleared: if( f.value ) clearState = true; break;
+        case Pf::Packet::TrackEvent: trackEvent = f; break;
+        case Pf::Packet::InternedData: internedData = f; break;
+        case Pf::Packet::Defaults: defaults = f; break;
+        case Pf::Packet::TrackDescriptor: trackDescriptor = f; break;
+        case Pf::Packet::ClockSnapshot: clockSnapshot = f; break;
+        case Pf::Packet::CompressedPackets: m_compressedPackets++; break;
+        default: break;
+        }
+    }
+    if( rd.HasError() ) return false;
+
+    auto& seq = m_sequences[sequenceId];
+    if( clearState ) seq.Clear();
+    if( clockSnapshot.data ) DecodeClockSnapshot( clockSnapshot, seq );
+    if( defaults.data ) DecodeDefaults( defaults, seq );
+    if( internedData.data ) DecodeInternedData( internedData, seq );
+    if( trackDescriptor.data ) DecodeTrackDescriptor( trackDescriptor );
+    if( trackEvent.data && hasTimestamp ) DecodeTrackEvent( trackEvent, ConvertTimestamp( timestamp, clockId, seq ), seq );
+
+    if( ( ++m_packets & 0xFFFFF ) == 0 )
+    {
+        printf( "\33[2KParsing... %" PRIu64 " packets\r", m_packets );
+        fflush( stdout );
+    }
+    return true;
+}
+
+void PerfettoDecoder::DecodeClockSnapshot( const ProtoField& field, SequenceState& seq )
+{
+    struct Entry
+    {
+        uint32_t id;
+        uint64_t timestamp;
+        uint64_t multiplier;
+        bool incremental;
+    };
+    std::vector<Entry> entries;
+    uint32_t primary = Pf::ClockBoottime;
+
+    ProtoReader rd( field );
+    ProtoField f;
+    while( rd.Next( f ) )
+    {
+        if( f.id == Pf::ClockSnapshot::PrimaryTraceClock )
+        {
+            primary = uint32_t( f.value );
+        }
+        else if( f.id == Pf::ClockSnapshot::Clocks && f.type == ProtoField::Length )
+        {
+            Entry e = { 0, 0, 1, false };
+            ProtoReader crd( f );
+            ProtoField cf;
+            while( crd.Next( cf ) )
+            {
+                switch( cf.id )
+                {
+                case Pf::Clock::Id: e.id = uint32_t( cf.value ); break;
+                case Pf::Clock::Timestamp: e.timestamp = cf.value; break;
+                case Pf::Clock::IsIncremental: e.incremental = cf.value != 0; break;
+                case Pf::Clock::UnitMultiplierNs: if( cf.value != 0 ) e.multiplier = cf.value; break;
+                default: break;
+                }
+            }
+            entries.emplace_back( e );
+        }
+    }
+
+    // All timestamps are converted to the domain of the primary trace clock.
+    auto ref = std::find_if( entries.begin(), entries.end(), [primary] ( const auto& e ) { return e.id == primary; } );
+    for( auto& e : entries )
+    {
+        const auto offset = ref != entries.end() ? int64_t( ref->timestamp * ref->multiplier - e.timestamp * e.multiplier ) : 0;
+        if( e.id >= Pf::ClockFirstSequenceScoped )
+        {
+            seq.clocks[e.id] = SequenceClock { e.timestamp, e.multiplier, offset, e.incremental };
+        }
+        else if( ref != entries.end() )
+        {
+            m_clockOffsets[e.id] = offset;
+        }
+    }
+}
+
+void PerfettoDecoder::DecodeInternedData( const ProtoField& field, SequenceState& seq )
+{
+    ProtoReader rd( field );
+    ProtoField f;
+    while( rd.Next( f ) )
+    {
+        if( f.type != ProtoField::Length ) continue;
+        if( f.id == Pf::InternedData::EventNames || f.id == Pf::InternedData::AnnotationNames )
+        {
+            uint64_t iid = 0;
+            std::string_view name;
+            ProtoReader srd( f );
+            ProtoField sf;
+            while( srd.Next( sf ) )
+            {
+                if( sf.id == Pf::InternedString::Iid ) iid = sf.value;
+                else if( sf.id == Pf::InternedString::Name && sf.type == ProtoField::Length ) name = sf.String();
+            }
+            if( f.id == Pf::InternedData::EventNames )
+            {
+                seq.eventNames[iid] = StoreString( name );
+            }
+            else
+            {
+                seq.annotationNames[iid] = name;
+            }
+        }
+        else if( f.id == Pf::InternedData::SourceLocations )
+        {
+            uint64_t iid = 0;
+            SourceLoc loc = { m_emptyString, m_emptyString, 0 };
+            ProtoReader srd( f );
+            ProtoField sf;
+            while( srd.Next( sf ) )
+            {
+                switch( sf.id )
+                {
+                case Pf::SourceLocation::Iid: iid = sf.value; break;
+                case Pf::SourceLocation::FileName: if( sf.type == ProtoField::Length ) loc.file = StoreString( sf.String() ); break;
+                case Pf::SourceLocation::FunctionName: if( sf.type == ProtoField::Length ) loc.function = StoreString( sf.String() ); break;
+                case Pf::SourceLocation::LineNumber: loc.line = uint32_t( sf.value ); break;
+                default: break;
+                }
+            }
+            seq.sourceLocations[iid] = loc;
+        }
+    }
+}
+
+void PerfettoDecoder::DecodeDefaults( const ProtoField& field, SequenceState& seq )
+{
+    ProtoReader rd( field );
+    ProtoField f;
+    while( rd.Next( f ) )
+    {
+        if( f.id == Pf::Defaults::TimestampClockId )
+        {
+            seq.clockId = uint32_t( f.value );
+        }
+        else if( f.id == Pf::Defaults::TrackEventDefaults && f.type == ProtoField::Length )
+        {
+            seq.extraCounterTracks.clear();
+            seq.extraDoubleCounterTracks.clear();
+            ProtoReader drd( f );
+            ProtoField df;
+            while( drd.Next( df ) )
+            {
+                switch( df.id )
+                {
+                case Pf::TrackEventDefaults::TrackUuid: seq.trackUuid = df.value; break;
+                case Pf::TrackEventDefaults::ExtraCounterTrackUuids: ReadRepeated( df, seq.extraCounterTracks ); break;
+                case Pf::TrackEventDefaults::ExtraDoubleCounterTrackUuids: ReadRepeated( df, seq.extraDoubleCounterTracks ); break;
+                default: break;
+                }
+            }
+        }
+    }
+}
+
+void PerfettoDecoder::DecodeTrackDescriptor( const ProtoField& field )
+{
+    uint64_t uuid = 0;
+    ProtoField process = {}, thread = {}, counter = {};
+    std::string_view name;
+    uint64_t parent = 0;
+
+    ProtoReader rd( field );
+    ProtoField f;
+    while( rd.Next( f ) )
+    {
+        switch( f.id )
+        {
+        case Pf::TrackDescriptor::Uuid: uuid = f.value; break;
+        case Pf::TrackDescriptor::ParentUuid: parent = f.value; break;
+        case Pf::TrackDescriptor::Name: case Pf::TrackDescriptor::StaticName: if( f.type == ProtoField::Length ) name = f.String(); break;
+        case Pf::TrackDescriptor::Process: process = f; break;
+        case Pf::TrackDescriptor::Thread: thread = f; break;
+        case Pf::TrackDescriptor::Counter: counter = f; break;
+        default: break;
+        }
+    }
+
+    auto& track = m_tracks[uuid];
+    track.parent = parent;
+    if( !name.empty() ) track.name = name;
+    if( process.data )
+    {
+        track.isProcess = true;
+        ProtoReader prd( process );
+        while( prd.Next( f ) )
+        {
+            if( f.id == Pf::ProcessDescriptor::Pid ) track.pid = uint32_t( f.value );
+            else if( f.id == Pf::ProcessDescriptor::ProcessName && f.type == ProtoField::Length ) track.processName = f.String();
+        }
+    }
+    if( thread.data )
+    {
+        track.isThread = true;
+        ProtoReader trd( thread );
+        while( trd.Next( f ) )
+        {
+            switch( f.id )
+            {
+            case Pf::ThreadDescriptor::Pid: track.pid = uint32_t( f.value ); break;
+            case Pf::ThreadDescriptor::Tid: track.tid = uint32_t( f.value ); break;
+            case Pf::ThreadDescriptor::ThreadName: if( f.type == ProtoField::Length ) track.name = f.String(); break;
+            default: break;
+            }
+        }
+    }
+    if( counter.data )
+    {
+        track.isCounter = true;
+        ProtoReader crd( counter );
+        while( crd.Next( f ) )
+        {
+            switch( f.id )
+            {
+            case Pf::CounterDescriptor::Unit: track.bytes = f.value == Pf::UnitSizeBytes; break;
+            case Pf::CounterDescriptor::UnitMultiplier: if( f.value != 0 ) track.multiplier = int64_t( f.value ); break;
+            case Pf::CounterDescriptor::IsIncremental: track.incremental = f.value != 0; break;
+            default: break;
+            }
+        }
+    }
+}
+
+void PerfettoDecoder::AppendAnnotation( const ProtoField& field, const SequenceState& seq, std::string& text )
+{
+    std::string_view name;
+    std::string value;
+    char buf[64];
+
+    ProtoReader rd( field );
+    ProtoField f;
+    while( rd.Next( f ) )
+    {
+        switch( f.id )
+        {
+        case Pf::Annotation::NameIid:
+        {
+            auto it = seq.annotationNames.find( f.value );
+            if( it != seq.annotationNames.end() ) name = it->second;
+            break;
+        }
+        case Pf::Annotation::Name:
+            if( f.type == ProtoField::Length ) name = f.String();
+            break;
+        case Pf::Annotation::BoolValue:
+            value = f.value ? "true" : "false";
+            break;
+        case Pf::Annotation::UintValue:
+            snprintf( buf, sizeof( buf ), "%" PRIu64, f.value );
+            value = buf;
+            break;
+        case Pf::Annotation::IntValue:
+            snprintf( buf, sizeof( buf ), "%" PRId64, int64_t( f.value ) );
+            value = buf;
+            break;
+        case Pf::Annotation::DoubleValue:
+            snprintf( buf, sizeof( buf ), "%g", f.Double() );
+            value = buf;
+            break;
+        case Pf::Annotation::PointerValue:
+            snprintf( buf, sizeof( buf ), "0x%" PRIx64, f.value );
+            value = buf;
+            break;
+        case Pf::Annotation::StringValue:
+        case Pf::Annotation::LegacyJsonValue:
+            if( f.type == ProtoField::Length ) value = f.String();
+            break;
+        default:
+            break;
+        }
+    }
+
+    text.append( name );
+    text += ": ";
+    text += value;
+    text += '\n';
+}
+
+void PerfettoDecoder::DecodeTrackEvent( const ProtoField& field, uint64_t timestamp, SequenceState& seq )
+{
+    uint64_t type = 0;
+    uint64_t trackUuid = seq.trackUuid;
+    uint32_t name = m_emptyString;
+    std::string text;
+    SourceLoc loc = { m_emptyString, m_emptyString, 0 };
+    bool hasCounter = false;
+    double counterValue = 0;
+    std::vector<uint64_t> extraCounterTracks, extraDoubleCounterTracks;
+    std::vector<int64_t> extraCounterValues;
+    std::vector<double> extraDoubleCounterValues;
+
+    ProtoReader rd( field );
+    ProtoField f;
+    while( rd.Next( f ) )
+    {
+        switch( f.id )
+        {
+        case Pf::TrackEvent::Type:
+            type = f.value;
+            break;
+        case Pf::TrackEvent::TrackUuid:
+            trackUuid = f.value;
+            break;
+        case Pf::TrackEvent::Name:
+            if( f.type == ProtoField::Length ) name = StoreString( f.String() );
+            break;
+        case Pf::TrackEvent::NameIid:
+        {
+            auto it = seq.eventNames.find( f.value );
+            if( it != seq.eventNames.end() ) name = it->second;
+            break;
+        }
+        case Pf::TrackEvent::DebugAnnotations:
+            if( f.type == ProtoField::Length ) AppendAnnotation( f, seq, text );
+            break;
+        case Pf::TrackEvent::SourceLocationIid:
+        {
+            auto it = seq.sourceLocations.find( f.value );
+            if( it != seq.sourceLocations.end() ) loc = it->second;
+            break;
+        }
+        case Pf::TrackEvent::SourceLocation:
+        {
+            if( f.type != ProtoField::Length ) break;
+            ProtoReader lrd( f );
+            ProtoField lf;
+            while( lrd.Next( lf ) )
+            {
+                if( lf.id == Pf::SourceLocation::FileName && lf.type == ProtoField::Length ) loc.file = StoreString( lf.String() );
+                else if( lf.id == Pf::SourceLocation::FunctionName && lf.type == ProtoField::Length ) loc.function = StoreString( lf.String() );
+                else if( lf.id == Pf::SourceLocation::LineNumber ) loc.line = uint32_t( lf.value );
+            }
+            break;
+        }
+        case Pf::TrackEvent::CounterValue:
+            counterValue = double( int64_t( f.value ) );
+            hasCounter = true;
+            break;
+        case Pf::TrackEvent::DoubleCounterValue:
+            counterValue = f.Double();
+            hasCounter = true;
+            break;
+        case Pf::TrackEvent::ExtraCounterTrackUuids:
+            ReadRepeated( f, extraCounterTracks );
+            break;
+        case Pf::TrackEvent::ExtraCounterValues:
+            ReadRepeated( f, extraCounterValues );
+            break;
+        case Pf::TrackEvent::ExtraDoubleCounterTrackUuids:
+            ReadRepeated( f, extraDoubleCounterTracks );
+            break;
+        case Pf::TrackEvent::ExtraDoubleCounterValues:
+            if( f.type == ProtoField::Length )
+            {
+                for( uint64_t i=0; i+8<=f.size; i+=8 )
+                {
+                    double v;
+                    memcpy( &v, f.data + i, sizeof( v ) );
+                    extraDoubleCounterValues.emplace_back( v );
+                }
+            }
+            else
+            {
+                extraDoubleCounterValues.emplace_back( f.Double() );
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    switch( type )
+    {
+    case Pf::TypeSliceBegin:
+    {
+        if( name == m_emptyString ) name = loc.function;
+        tracy::StringIdx textIdx;
+        if( !text.empty() ) textIdx.SetIdx( StoreString( text ) );
+        m_tracks[trackUuid].slices.emplace_back( Slice { timestamp, m_worker.ImportSourceLocation( name, loc.file, loc.line ), textIdx } );
+        break;
+    }
+    case Pf::TypeSliceEnd:
+        m_tracks[trackUuid].slices.emplace_back( Slice { timestamp, 0 } );
+        break;
+    case Pf::TypeInstant:
+        m_messages.emplace_back( tracy::Worker::ImportEventMessages { trackUuid, timestamp, m_worker.GetString( tracy::StringIdx( name ) ) } );
+        break;
+    case Pf::TypeCounter:
+        if( hasCounter ) AddCounterValue( trackUuid, timestamp, counterValue );
+        break;
+    default:
+        break;
+    }
+
+    // Extra counter values are sampled together with any event type.
+    const auto& counterTracks = extraCounterTracks.empty() ? seq.extraCounterTracks : extraCounterTracks;
+    const auto cnum = std::min( counterTracks.size(), extraCounterValues.size() );
+    for( size_t i=0; i<cnum; i++ ) AddCounterValue( counterTracks[i], timestamp, double( extraCounterValues[i] ) );
+    const auto& doubleTracks = extraDoubleCounterTracks.empty() ? seq.extraDoubleCounterTracks : extraDoubleCounterTracks;
+    const auto dnum = std::min( doubleTracks.size(), extraDoubleCounterValues.size() );
+    for( size_t i=0; i<dnum; i++ ) AddCounterValue( doubleTracks[i], timestamp, extraDoubleCounterValues[i] );
+}
+
+uint64_t PerfettoDecoder::ConvertTimestamp( uint64_t ts, uint32_t clockId, SequenceState& seq )
+{
+    if( clockId == 0 ) clockId = seq.clockId;
+    if( clockId >= Pf::ClockFirstSequenceScoped )
+    {
+        auto it = seq.clocks.find( clockId );
+        if( it == seq.clocks.end() ) return ts;
+        auto& clock = it->second;
+        if( clock.incremental )
+        {
+            clock.value += ts;
+            ts = clock.value;
+        }
+        return ts * clock.multiplier + clock.offset;
+    }
+    if( clockId != 0 )
+    {
+        auto it = m_clockOffsets.find( clockId );
+        if( it != m_clockOffsets.end() ) return ts + it->second;
+    }
+    return ts;
+}
+
+void PerfettoDecoder::AddCounterValue( uint64_t track, uint64_t timestamp, double value )
+{
+    m_tracks[track].counter.emplace_back( int64_t( timestamp ), value );
+}
+
+uint64_t PerfettoDecoder::GetProcessId( uint64_t uuid )
+{
+    // Guards against malformed parent loops.
+    for( int i=0; i<64; i++ )
+    {
+        auto it = m_tracks.find( uuid );
+        if( it == m_tracks.end() ) return 0;
+        if( it->second.isProcess || it->second.isThread ) return it->second.pid;
+        uuid = it->second.parent;
+    }
+    return 0;
+}
+
+void PerfettoDecoder::Finish()
+{
+    std::vector<tracy::Worker::ImportEventPlots> plots;
+    std::unordered_map<uint64_t, std::string> threadNames;
+
+    // Thread tracks are mapped to a pseudo thread id encoding the (pid, tid) pair, the same as in
+    // import-chrome. Other tracks with slices (e.g. async tracks) get their own pseudo thread.
+    std::unordered_map<uint64_t, uint64_t> trackThread;
+    uint32_t nextTrackThread = 0x80000000;
+    const auto getThread = [&] ( uint64_t uuid ) -> uint64_t {
+        auto it = trackThread.find( uuid );
+        if( it != trackThread.end() ) return it->second;
+        auto& track = m_tracks[uuid];
+        uint64_t tid;
+        std::string name;
+        if( track.isThread )
+        {
+            tid = ( track.tid & 0xFFFFFFFF ) | ( track.pid << 32 );
+            name = track.name;
+        }
+        else
+        {
+            tid = nextTrackThread++ | ( GetProcessId( uuid ) << 32 );
+            if( !track.name.empty() )
+            {
+                name = track.name;
+            }
+            else if( !track.processName.empty() )
+            {
+                name = track.processName;
+            }
+            else
+            {
+                char buf[64];
+                snprintf( buf, sizeof( buf ), "Track %" PRIu64, uuid );
+                name = buf;
+            }
+        }
+        if( !name.empty() ) threadNames.emplace( tid, std::move( name ) );
+        trackThread.emplace( uuid, tid );
+        return tid;
+    };
+
+    struct ThreadTimeline
+    {
+        uint64_t tid;
+        std::vector<Slice> slices;
+    };
+    std::vector<ThreadTimeline> threadTimelines;
+    std::unordered_map<uint64_t, size_t> threadTimelineMap;
+
+    for( auto& it : m_tracks )
+    {
+        auto& track = it.second;
+        if( !track.slices.empty() )
+        {
+            const auto tid = getThread( it.first );
+            auto tit = threadTimelineMap.find( tid );
+            if( tit == threadTimelineMap.end() )
+            {
+                threadTimelineMap.emplace( tid, threadTimelines.size() );
+                threadTimelines.emplace_back( ThreadTimeline { tid, std::move( track.slices ) } );
+            }
+            else
+            {
+                auto& dst = threadTimelines[tit->second].slices;
+                dst.insert( dst.end(), track.slices.begin(), track.slices.end() );
+                std::vector<Slice>().swap( track.slices );
+            }
+        }
+        if( !track.counter.empty() )
+        {
+            if( track.incremental )
+            {
+                double sum = 0;
+                for( auto& v : track.counter ) v.second = sum += v.second;
+            }
+            if( track.multiplier != 1 )
+            {
+                for( auto& v : track.counter ) v.second *= track.multiplier;
+            }
+            std::string name;
+            if( !track.name.empty() )
+            {
+                name = track.name;
+            }
+            else
+            {
+                char buf[64];
+                snprintf( buf, sizeof( buf ), "Counter %" PRIu64, it.first );
+                name = buf;
+            }
+            plots.emplace_back( tracy::Worker::ImportEventPlots {
+                std::move( name ),
+                track.bytes ? tracy::PlotValueFormatting::Memory : tracy::PlotValueFormatting::Number,
+                std::move( track.counter )
+            } );
+        }
+    }
+
+    auto& messages = m_messages;
+    for( auto& v : messages ) v.tid = getThread( v.tid );
+
+    tracy::TaskDispatch td( std::max<int>( 1, std::thread::hardware_concurrency() - 1 ), "Import sort" );
+    for( auto& v : threadTimelines )
+    {
+        td.Queue( [&v] { std::stable_sort( v.slices.begin(), v.slices.end(), [] ( const auto& l, const auto& r ) { return l.timestamp < r.timestamp; } ); } );
+    }
+    td.Queue( [&messages] { std::stable_sort( messages.begin(), messages.end(), [] ( const auto& l, const auto& r ) { return l.timestamp < r.timestamp; } ); } );
+    for( auto& v : plots )
+    {
+        td.Queue( [&v] { std::stable_sort( v.data.begin(), v.data.end(), [] ( const auto& l, const auto& r ) { return l.first < r.first; } ); } );
+    }
+    td.Sync();
+
+    std::stable_sort( threadTimelines.begin(), threadTimelines.end(), [] ( const auto& l, const auto& r ) { return l.slices[0].timestamp < r.slices[0].timestamp; } );
+
+    uint64_t mts = std::numeric_limits<uint64_t>::max();
+    for( auto& v : threadTimelines )
+    {
+        if( mts > v.slices[0].timestamp ) mts = v.slices[0].timestamp;
+    }
+    if( !messages.empty() )
+    {
+        if( mts > messages[0].timestamp ) mts = messages[0].timestamp;
+    }
+    for( auto& plot : plots )
+    {
+        if( mts > uint64_t( plot.data[0].first ) ) mts = plot.data[0].first;
+    }
+    if( mts == std::numeric_limits<uint64_t>::max() ) mts = 0;
+
+    // The time base is only known once the whole trace is decoded. Each thread is handed over
+    // to the worker and released before the next one.
+    for( auto& v : threadTimelines )
+    {
+        for( auto& slice : v.slices )
+        {
+            if( slice.srcloc != 0 )
+            {
+                m_worker.ImportZoneBegin( v.tid, slice.timestamp - mts, slice.srcloc, slice.text );
+            }
+            else
+            {
+                m_worker.ImportZoneEnd( v.tid, slice.timestamp - mts );
+            }
+        }
+        std::vector<Slice>().swap( v.slices );
+    }
+
+    for( auto& v : messages ) v.timestamp -= mts;
+    m_worker.ImportMessages( messages );
+    std::vector<tracy::Worker::ImportEventMessages>().swap( messages );
+
+    for( auto& plot : plots )
+    {
+        for( auto& v : plot.data ) v.first -= mts;
+    }
+    m_worker.ImportPlots( plots );
+    m_worker.ImportFinish( threadNames );
+}
+
+int main( int argc, char** argv )
+{
+#ifdef _WIN32
+    if( !AttachConsole( ATTACH_PARENT_PROCESS ) )
+    {
+        AllocConsole();
+        SetConsoleMode( GetStdHandle( STD_OUTPUT_HANDLE ), 0x07 );
+    }
+#endif
+
+    tracy::FileCompression clev = tracy::FileCompression::Fast;
+
+    if( argc != 3 ) Usage();
+
+    const char* input = argv[1];
+    const char* output = argv[2];
+
+    printf( "Loading...\r" );
+    fflush( stdout );
+
+    FILE* f = fopen( input, "rb" );
+    if( !f )
+    {
+        fprintf( stderr, "Cannot open input file!\n" );
+        exit( 1 );
+    }
+    struct stat64 sb;
+    if( stat64( input, &sb ) != 0 )
+    {
+        fprintf( stderr, "Cannot open input file!\n" );
+        fclose( f );
+        exit( 1 );
+    }
+    const auto fsz = size_t( sb.st_size );
+    if( fsz == 0 )
+    {
+        fprintf( stderr, "Input file is empty!\n" );
+        fclose( f );
+        exit( 1 );
+    }
+    auto fbuf = (const uint8_t*)mmap( nullptr, fsz, PROT_READ, MAP_SHARED, fileno( f ), 0 );
+    fclose( f );
+    if( fbuf == (const uint8_t*)-1 )
+    {
+        fprintf( stderr, "Cannot mmap input file!\n" );
+        exit( 1 );
+    }
+    if( fsz >= 4 && memcmp( fbuf, "\x28\xB5\x2F\xFD", 4 ) == 0 )
+    {
+        fprintf( stderr, "Compressed input is not supported, decompress the file first.\n" );
+        exit( 1 );
+    }
+#ifndef _WIN32
+    madvise( (void*)fbuf, fsz, MADV_SEQUENTIAL );
+#endif
+
+    printf( "\33[2KParsing...\r" );
+    fflush( stdout );
+
+    auto&& getFilename = [](const char* in) {
+        auto out = in;
+        while (*out) ++out;
+        --out;
+        while (out > in && (*out != '/' || *out != '\\')) out--;
+        return out;
+    };
+
+    tracy::Worker worker( getFilename(output), getFilename(input) );
+
+    // The input is a Trace message, i.e. a sequence of TracePacket fields. Pages which were
+    // already parsed are dropped from the process, so that the mapping of a large trace
+    // doesn't stay resident. Annotation and track names still point into the mapping and
+    // are paged back in from the file if needed.
+    PerfettoDecoder decoder( worker );
+    ProtoReader rd( fbuf, fsz );
+    ProtoField packet;
+#ifndef _WIN32
+    enum { ReleaseChunk = 64 * 1024 * 1024 };
+    size_t released = 0;
+#endif
+    while( rd.Next( packet ) )
+    {
+        if( packet.id != Pf::TracePacket || packet.type != ProtoField::Length ) continue;
+        if( !decoder.DecodePacket( packet ) )
+        {
+            fprintf( stderr, "\nMalformed packet at byte %zu, stopping.\n", size_t( packet.data - fbuf ) );
+            break;
+        }
+#ifndef _WIN32
+        const auto pos = size_t( rd.GetPosition() - fbuf );
+        if( pos - released >= ReleaseChunk )
+        {
+            const auto end = pos & ~size_t( ReleaseChunk - 1 );
+            madvise( (void*)( fbuf + released ), end - released, MADV_DONTNEED );
+            released = end;
+        }
+#endif
+    }
+    if( rd.HasError() ) fprintf( stderr, "\nInput file is truncated or malformed, using data read so far.\n" );
+    if( decoder.GetCompressedPackets() != 0 ) fprintf( stderr, "\nSkipped %" PRIu64 " compressed packet bundles, which are not supported.\n", decoder.GetCompressedPackets() );
+
+    printf( "\33[2KProcessing...\r" );
+    fflush( stdout );
+
+    decoder.Finish();
+    munmap( (void*)fbuf, fsz );
+
+    auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output, clev ) );
+    if( !w )
+    {
+        fprintf( stderr, "Cannot open output file!\n" );
+        exit( 1 );
+    }
+    printf( "\33[2KSaving...\r" );
+    fflush( stdout );
+    worker.Write( *w, false );
+
+    printf( "\33[2KCleanup...\n" );
+    fflush( stdout );
+
+    return 0;
+}
@@ -0,0 +1,559 @@
+#ifdef _WIN32
+#  include <windows.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <inttypes.h>
+#include <limits>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../../server/TracyFileRead.hpp"
+#include "../../server/TracyFileWrite.hpp"
+#include "../../server/TracyPrint.hpp"
+#include "../../server/TracyWorker.hpp"
+#include "../../zstd/zstd.h"
+#include "../../getopt/getopt.h"
+
+void Usage()
+{
+    printf( "Usage: merge [options] input.tracy [input.tracy ...] output.tracy\n\n" );
+    printf( "  -m marker: align the inputs on their first message containing the marker text\n" );
+    printf( "  -n: don't align the inputs, keep the time base of each trace\n" );
+    printf( "      By default the inputs are aligned by their capture start time, with a resolution\n" );
+    printf( "      of one second.\n" );
+    printf( "  -s begin:end: only keep the given time window, for example -s 1.5:2.25 or -s 200ms:300ms\n" );
+    printf( "      Times are relative to the first input and take ns, us, ms or s suffixes (default: s).\n" );
+    printf( "  -d: drop the data which can't be merged instead of failing\n" );
+    printf( "  -z level: use Zstd compression with given compression level\n" );
+    printf( "  -j: number of threads to use (-1 to use all cores)\n\n" );
+    printf( "Zones, messages, frames and plots are carried over. Inputs with GPU zones, locks, memory\n" );
+    printf( "events, callstacks, sampling data, context switches or frame images are rejected, unless\n" );
+    printf( "-d is given.\n" );
+
+    exit( 1 );
+}
+
+enum class Align
+{
+    None,
+    Clock,
+    Marker
+};
+
+// The kept time range in the time base of one input, and the offset which moves the
+// input's times into the merged time base.
+struct Window
+{
+    int64_t begin;
+    int64_t end;
+    int64_t offset;
+};
+
+struct Input
+{
+    const char* path;
+    std::unique_ptr<tracy::Worker> worker;
+    Window window;
+    std::string prefix;
+};
+
+static bool ParseTime( const char* str, int64_t& out )
+{
+    char* end;
+    const auto val = strtod( str, &end );
+    if( end == str ) return false;
+    double mul;
+    if( strcmp( end, "ns" ) == 0 ) mul = 1;
+    else if( strcmp( end, "us" ) == 0 ) mul = 1e3;
+    else if( strcmp( end, "ms" ) == 0 ) mul = 1e6;
+    else if( *end == '\0' || strcmp( end, "s" ) == 0 ) mul = 1e9;
+    else return false;
+    out = int64_t( val * mul );
+    return true;
+}
+
+static tracy_force_inline const tracy::ZoneEvent& GetZone( const tracy::Vector<tracy::short_ptr<tracy::ZoneEvent>>& vec, size_t idx )
+{
+    if( vec.is_magic() ) return ( *(const tracy::Vector<tracy::ZoneEvent>*)&vec )[idx];
+    return *vec[idx];
+}
+
+// Sibling zones don't overlap, so their end times are sorted as well and the first zone
+// reaching into the window can be found with a binary search.
+static size_t FirstZone( tracy::Worker& worker, const tracy::Vector<tracy::short_ptr<tracy::ZoneEvent>>& vec, int64_t begin )
+{
+    size_t lo = 0;
+    size_t hi = vec.size();
+    while( lo < hi )
+    {
+        const auto mid = ( lo + hi ) / 2;
+        if( worker.GetZoneEnd( GetZone( vec, mid ) ) < begin ) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+struct ZoneCopy
+{
+    tracy::Worker& src;
+    tracy::Worker& dst;
+    Window window;
+    std::unordered_map<int16_t, int32_t> srclocMap;
+    size_t zones;
+};
+
+// Zones go straight into the merged worker, which keeps the source location and string of each
+// input only once.
+static void CopyZones( ZoneCopy& ctx, const tracy::Vector<tracy::short_ptr<tracy::ZoneEvent>>& vec, uint64_t tid )
+{
+    auto& src = ctx.src;
+    auto& window = ctx.window;
+    for( size_t i=FirstZone( src, vec, window.begin ); i<vec.size(); i++ )
+    {
+        auto& zone = GetZone( vec, i );
+        if( zone.Start() > window.end ) break;
+        const auto srclocId = src.GetZoneSrcLoc( zone );
+        auto& srcloc = src.GetSourceLocation( srclocId );
+
+        tracy::StringIdx text;
+        bool customName = false;
+        if( src.HasZoneExtra( zone ) )
+        {
+            auto& extra = src.GetZoneExtra( zone );
+            if( extra.text.Active() )
+            {
+                const auto str = src.GetString( extra.text );
+                text.SetIdx( ctx.dst.StoreString( str, strlen( str ) ).idx );
+            }
+            customName = extra.name.Active();
+        }
+
+        int32_t dstSrcloc;
+        auto it = customName ? ctx.srclocMap.end() : ctx.srclocMap.find( srclocId );
+        if( it != ctx.srclocMap.end() )
+        {
+            dstSrcloc = it->second;
+        }
+        else
+        {
+            const auto name = src.GetZoneName( zone, srcloc );
+            const auto file = src.GetString( srcloc.file );
+            dstSrcloc = ctx.dst.ImportSourceLocation( ctx.dst.StoreString( name, strlen( name ) ).idx, ctx.dst.StoreString( file, strlen( file ) ).idx, srcloc.line );
+            if( !customName ) ctx.srclocMap.emplace( srclocId, dstSrcloc );
+        }
+
+        ctx.dst.ImportZoneBegin( tid, std::max( zone.Start(), window.begin ) + window.offset, dstSrcloc, text );
+        if( zone.HasChildren() ) CopyZones( ctx, src.GetZoneChildren( zone.Child() ), tid );
+        ctx.dst.ImportZoneEnd( tid, std::min( src.GetZoneEnd( zone ), window.end ) + window.offset );
+        ctx.zones++;
+    }
+}
+
+static std::unique_ptr<tracy::Worker> Load( const char* input, bool drop )
+{
+    auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( input ) );
+    if( !f )
+    {
+        fprintf( stderr, "Cannot open input file %s!\n", input );
+        exit( 1 );
+    }
+
+    try
+    {
+        // Without -d the data which can't be merged is loaded as well, so that it can be reported.
+        auto events = tracy::EventType::Messages | tracy::EventType::Plots;
+        if( !drop ) events |= tracy::EventType::Locks | tracy::EventType::Memory | tracy::EventType::FrameImages | tracy::EventType::ContextSwitches | tracy::EventType::Samples;
+        return std::make_unique<tracy::Worker>( *f, (tracy::EventType::Type)events, false );
+    }
+    catch( const tracy::UnsupportedVersion& e )
+    {
+        fprintf( stderr, "%s is from the future version.\n", input );
+    }
+    catch( const tracy::NotTracyDump& e )
+    {
+        fprintf( stderr, "%s is not a tracy dump.\n", input );
+    }
+    catch( const tracy::FileReadError& e )
+    {
+        fprintf( stderr, "%s cannot be mapped to memory.\n", input );
+    }
+    catch( const tracy::LegacyVersion& e )
+    {
+        fprintf( stderr, "%s is from a legacy version.\n", input );
+    }
+    exit( 1 );
+}
+
+// Lists the kinds of data in the input which the merged trace can't carry.
+static std::string UnsupportedData( const tracy::Worker& worker )
+{
+    std::string ret;
+    const auto add = [&ret] ( bool present, const char* name ) {
+        if( !present ) return;
+        if( !ret.empty() ) ret += ", ";
+        ret += name;
+    };
+
+    bool memory = false;
+    for( auto& v : worker.GetMemNameMap() ) memory |= !v.second->data.empty();
+    bool vsync = false;
+    for( auto& v : worker.GetFrames() ) vsync |= v->name >> 63 != 0;
+
+    add( worker.GetGpuZoneCount() != 0, "GPU zones" );
+    add( !worker.GetLockMap().empty(), "locks" );
+    add( memory, "memory events" );
+    add( worker.GetCallstackPayloadCount() != 0, "callstacks" );
+    add( worker.GetCallstackSampleCount() != 0, "samples" );
+    add( worker.HasContextSwitches(), "context switches" );
+    add( vsync, "vsync frames" );
+    add( worker.GetFrameImageCount() != 0, "frame images" );
+    return ret;
+}
+
+static int64_t FindMarker( const tracy::Worker& worker, const char* marker )
+{
+    for( auto& msg : worker.GetMessages() )
+    {
+        if( strstr( worker.GetString( msg->ref ), marker ) ) return msg->time;
+    }
+    return -1;
+}
+
+int main( int argc, char** argv )
+{
+#ifdef _WIN32
+    if( !AttachConsole( ATTACH_PARENT_PROCESS ) )
+    {
+        AllocConsole();
+        SetConsoleMode( GetStdHandle( STD_OUTPUT_HANDLE ), 0x07 );
+    }
+#endif
+
+    Align align = Align::Clock;
+    const char* marker = nullptr;
+    bool slice = false;
+    bool drop = false;
+    int64_t sliceBegin = std::numeric_limits<int64_t>::min();
+    int64_t sliceEnd = std::numeric_limits<int64_t>::max();
+    int zstdLevel = 3;
+    int threads = -1;
+
+    int c;
+    while( ( c = getopt( argc, argv, "m:ns:dz:j:" ) ) != -1 )
+    {
+        switch( c )
+        {
+        case 'm':
+            align = Align::Marker;
+            marker = optarg;
+            break;
+        case 'n':
+            align = Align::None;
+            break;
+        case 's':
+        {
+            std::string range( optarg );
+            const auto sep = range.find( ':' );
+            if( sep == std::string::npos ) Usage();
+            range[sep] = '\0';
+            if( !ParseTime( range.c_str(), sliceBegin ) || !ParseTime( range.c_str() + sep + 1, sliceEnd ) || sliceEnd < sliceBegin ) Usage();
+            slice = true;
+            break;
+        }
+        case 'd':
+            drop = true;
+            break;
+        case 'z':
+            zstdLevel = atoi( optarg );
+            if( zstdLevel > ZSTD_maxCLevel() || zstdLevel < ZSTD_minCLevel() )
+            {
+                printf( "Available Zstd compression levels range: %i - %i\n", ZSTD_minCLevel(), ZSTD_maxCLevel() );
+                exit( 1 );
+            }
+            break;
+        case 'j':
+            threads = atoi( optarg );
+            break;
+        default:
+            Usage();
+            break;
+        }
+    }
+    if( argc < optind + 2 ) Usage();
+    if( threads <= 0 ) threads = std::max<int>( 1, std::thread::hardware_concurrency() );
+
+    const auto numInputs = argc - optind - 1;
+    const char* output = argv[argc-1];
+    const bool merging = numInputs > 1;
+
+    if( merging && align == Align::Clock )
+    {
+        fprintf( stderr, "Aligning the inputs by their capture start time, which is only stored with a resolution of one second. Use -m for an exact alignment.\n" );
+    }
+
+    const auto t0 = std::chrono::high_resolution_clock::now();
+
+    std::vector<Input> inputs( numInputs );
+    std::unordered_map<std::string, int> programCount;
+    std::string program;
+
+    uint64_t refCaptureTime = 0;
+    int64_t refMarker = 0;
+    int64_t minTime = 0;
+
+    // All inputs are loaded first, as the time base of the merged trace depends on each of them.
+    for( int i=0; i<numInputs; i++ )
+    {
+        auto& in = inputs[i];
+        in.path = argv[optind+i];
+        printf( "\33[2KLoading %s...\r", in.path );
+        fflush( stdout );
+
+        in.worker = Load( in.path, drop );
+        auto& worker = *in.worker;
+
+        if( !drop )
+        {
+            const auto unsupported = UnsupportedData( worker );
+            if( !unsupported.empty() )
+            {
+                fprintf( stderr, "\33[2K%s contains data which can't be merged (%s). Use -d to drop it.\n", in.path, unsupported.c_str() );
+                exit( 1 );
+            }
+        }
+
+        int64_t offset = 0;
+        switch( align )
+        {
+        case Align::Clock:
+            if( i == 0 ) refCaptureTime = worker.GetCaptureTime();
+            offset = ( int64_t( worker.GetCaptureTime() ) - int64_t( refCaptureTime ) ) * 1000000000ll;
+            break;
+        case Align::Marker:
+        {
+            const auto time = FindMarker( worker, marker );
+            if( time < 0 )
+            {
+                fprintf( stderr, "\33[2KNo message containing \"%s\" found in %s!\n", marker, in.path );
+                exit( 1 );
+            }
+            if( i == 0 ) refMarker = time;
+            offset = refMarker - time;
+            break;
+        }
+        default:
+            break;
+        }
+
+        auto& window = in.window;
+        window = Window { std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), offset };
+        if( slice )
+        {
+            window.begin = sliceBegin - offset;
+            window.end = sliceEnd - offset;
+        }
+
+        // Names are prefixed with the program name when merging. Repeated programs are numbered,
+        // so that their frame sets and plots stay apart.
+        if( merging )
+        {
+            in.prefix = worker.GetCaptureProgram();
+            const auto count = ++programCount[in.prefix];
+            if( count > 1 ) in.prefix += " #" + std::to_string( count );
+            in.prefix += ": ";
+        }
+        if( i != 0 ) program += " + ";
+        program += worker.GetCaptureProgram();
+
+        if( slice ) continue;
+        for( auto& thread : worker.GetThreadData() )
+        {
+            if( !thread->timeline.empty() ) minTime = std::min( minTime, GetZone( thread->timeline, 0 ).Start() + offset );
+        }
+        if( !worker.GetMessages().empty() ) minTime = std::min( minTime, worker.GetMessages().front()->time + offset );
+        for( auto& fd : worker.GetFrames() )
+        {
+            if( fd->name >> 63 == 0 && !fd->frames.empty() ) minTime = std::min( minTime, fd->frames.front().start + offset );
+        }
+        for( auto& plot : worker.GetPlots() )
+        {
+            if( !plot->data.empty() ) minTime = std::min( minTime, plot->data.front().time.Val() + offset );
+        }
+    }
+
+    // A slice starts at the window begin. Otherwise the time base of the first input is kept,
+    // unless other inputs begin before it.
+    const int64_t base = slice ? sliceBegin : minTime;
+
+    const auto getFilename = [] ( const char* path ) {
+        auto ptr = path + strlen( path );
+        while( ptr > path && ptr[-1] != '/' && ptr[-1] != '\\' ) ptr--;
+        return ptr;
+    };
+
+    tracy::Worker merged( getFilename( output ), program.c_str() );
+
+    std::vector<tracy::Worker::ImportEventMessages> messages;
+    std::unordered_map<uint64_t, std::string> threadNames;
+    std::unordered_set<uint64_t> usedPids;
+    size_t zoneCount = 0;
+    size_t frameCount = 0;
+    size_t plotCount = 0;
+
+    for( auto& in : inputs )
+    {
+        printf( "\33[2KConverting %s...\r", in.path );
+        fflush( stdout );
+
+        auto& worker = *in.worker;
+        auto& window = in.window;
+        const auto offset = window.offset - base;
+        const auto& prefix = in.prefix;
+
+        // Each input gets its own process id in the merged trace, so that threads with the
+        // same id in different processes stay apart. A single input keeps its thread ids.
+        std::unordered_map<uint64_t, uint64_t> pidMap;
+        const auto mapThread = [&] ( uint64_t tid ) -> uint64_t {
+            const bool encoded = tid > std::numeric_limits<uint32_t>::max();
+            auto outTid = tid;
+            if( merging )
+            {
+                const auto srcPid = encoded ? tid >> 32 : worker.GetPid();
+                auto it = pidMap.find( srcPid );
+                if( it == pidMap.end() )
+                {
+                    auto pid = srcPid;
+                    if( pid == 0 || usedPids.find( pid ) != usedPids.end() )
+                    {
+                        pid = 1;
+                        while( usedPids.find( pid ) != usedPids.end() ) pid++;
+                    }
+                    usedPids.emplace( pid );
+                    it = pidMap.emplace( srcPid, pid ).first;
+                }
+                outTid = ( it->second << 32 ) | ( tid & 0xFFFFFFFF );
+            }
+            if( threadNames.find( outTid ) == threadNames.end() )
+            {
+                // The importer prefixes the names of pid encoded threads with both ids, which
+                // it would add again when the merged trace is built.
+                std::string name = worker.GetThreadName( tid );
+                if( encoded )
+                {
+                    char buf[64];
+                    const auto len = snprintf( buf, sizeof( buf ), "(PID %" PRIu64 " TID %" PRIu64 ") ", tid >> 32, tid & 0xFFFFFFFF );
+                    if( name.compare( 0, len, buf ) == 0 ) name.erase( 0, len );
+                }
+                threadNames.emplace( outTid, prefix + name );
+            }
+            return outTid;
+        };
+
+        ZoneCopy zones { worker, merged, Window { window.begin, window.end, offset }, {}, 0 };
+        for( auto& thread : worker.GetThreadData() )
+        {
+            CopyZones( zones, thread->timeline, mapThread( thread->id ) );
+        }
+        zoneCount += zones.zones;
+
+        const auto inWindow = [&window] ( int64_t time ) { return time >= window.begin && time <= window.end; };
+
+        for( auto& msg : worker.GetMessages() )
+        {
+            if( !inWindow( msg->time ) ) continue;
+            messages.emplace_back( tracy::Worker::ImportEventMessages { mapThread( worker.DecompressThread( msg->thread ) ), uint64_t( msg->time + offset ), worker.GetString( msg->ref ) } );
+        }
+
+        // The default frame set of a single input stays the default one.
+        std::vector<tracy::Worker::ImportEventFrames> frames;
+        for( auto& fd : worker.GetFrames() )
+        {
+            if( fd->name >> 63 != 0 ) continue;
+            tracy::Worker::ImportEventFrames out { fd->name == 0 && !merging ? std::string() : prefix + ( fd->name == 0 ? "Frame" : worker.GetString( fd->name ) ), fd->continuous != 0, {} };
+            for( auto& frame : fd->frames )
+            {
+                if( !inWindow( frame.start ) ) continue;
+                const auto end = frame.end >= 0 ? std::min( frame.end, window.end ) : -1;
+                out.frames.emplace_back( frame.start + offset, end >= 0 ? end + offset : -1 );
+            }
+            if( out.frames.empty() ) continue;
+            frameCount += out.frames.size();
+            frames.emplace_back( std::move( out ) );
+        }
+        merged.ImportFrames( frames );
+
+        std::vector<tracy::Worker::ImportEventPlots> plots;
+        for( auto& plot : worker.GetPlots() )
+        {
+            if( plot->data.empty() ) continue;
+            std::string name;
+            switch( plot->type )
+            {
+            case tracy::PlotType::Memory:
+                name = plot->name == 0 ? "Memory usage" : worker.GetString( plot->name );
+                break;
+            case tracy::PlotType::SysTime:
+                name = "CPU usage";
+                break;
+            default:
+                name = worker.GetString( plot->name );
+                break;
+            }
+
+            tracy::Worker::ImportEventPlots out { prefix + name, plot->format, {} };
+            auto& data = plot->data;
+            auto it = std::lower_bound( data.begin(), data.end(), window.begin, [] ( const auto& l, const auto& r ) { return l.time.Val() < r; } );
+            // Keep the value the plot has when the window begins.
+            if( it != data.begin() && ( it == data.end() || it->time.Val() > window.begin ) )
+            {
+                out.data.emplace_back( window.begin + offset, ( it - 1 )->val );
+            }
+            for( ; it != data.end() && it->time.Val() <= window.end; ++it )
+            {
+                out.data.emplace_back( it->time.Val() + offset, it->val );
+            }
+            if( !out.data.empty() ) plots.emplace_back( std::move( out ) );
+        }
+        merged.ImportPlots( plots );
+        plotCount += plots.size();
+
+        in.worker.reset();
+    }
+
+    // Messages of the inputs are kept as they are, even if they mention frames.
+    std::stable_sort( messages.begin(), messages.end(), [] ( const auto& l, const auto& r ) { return l.timestamp < r.timestamp; } );
+    merged.ImportMessages( messages, false );
+    merged.ImportFinish( threadNames );
+
+    auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output, tracy::FileCompression::Zstd, zstdLevel, threads ) );
+    if( !w )
+    {
+        fprintf( stderr, "Cannot open output file!\n" );
+        exit( 1 );
+    }
+    printf( "\33[2KSaving...\r" );
+    fflush( stdout );
+    merged.Write( *w, false );
+    w->Finish();
+
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    printf( "\33[2K%i input%s, %s zones, %s messages, %s frames, %s plots written in %s\n",
+        numInputs, numInputs == 1 ? "" : "s",
+        tracy::RealToString( zoneCount ),
+        tracy::RealToString( messages.size() ),
+        tracy::RealToString( frameCount ),
+        tracy::RealToString( plotCount ),
+        tracy::TimeToString( std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() ) );
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef __TRACYBACKGROUNDJOB_HPP__
+#define __TRACYBACKGROUNDJOB_HPP__
+
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <utility>
+
+namespace tracy
+{
+
+// A thread running a long job of the view, which can be asked to stop at any time. The job
+// polls IsStopping() and takes locks held by the UI thread, e.g. the worker data lock, through
+// Lock(), so that it never blocks a stop request.
+class BackgroundJob
+{
+public:
+    ~BackgroundJob() { Stop(); }
+
+    template<typename F>
+    void Start( F&& func )
+    {
+        assert( !m_thread.joinable() );
+        m_thread = std::thread( std::forward<F>( func ) );
+    }
+
+    // Stops the job and waits for it to return. The job may be started again afterwards.
+    void Stop()
+    {
+        if( !m_thread.joinable() ) return;
+        m_stop.store( true, std::memory_order_relaxed );
+        m_thread.join();
+        m_stop.store( false, std::memory_order_relaxed );
+    }
+
+    // A job which has returned on its own still counts as started, until it is stopped.
+    bool IsStarted() const { return m_thread.joinable(); }
+    bool IsStopping() const { return m_stop.load( std::memory_order_relaxed ); }
+
+    // Returns false, without the lock taken, if the job was asked to stop while waiting.
+    template<typename L>
+    bool Lock( L& lock ) const
+    {
+        while( !lock.try_lock() )
+        {
+            if( IsStopping() ) return false;
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        }
+        return true;
+    }
+
+    // Returns false if the job was asked to stop while waiting.
+    bool Wait( int ms ) const
+    {
+        for( int i=0; i<ms; i+=10 )
+        {
+            if( IsStopping() ) return false;
+            std::this_thread::sleep_for( std::chrono::milliseconds( std::min( 10, ms - i ) ) );
+        }
+        return !IsStopping();
+    }
+
+private:
+    std::thread m_thread;
+    std::atomic<bool> m_stop { false };
+};
+
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <limits>
+
+#include "TracyMemIndex.hpp"
+
+namespace tracy
+{
+
+void MemIndex::Update( const MemData& mem )
+{
+    const auto size = mem.data.size();
+    const auto fsz = mem.frees.size();
+    if( m_events == size && m_frees == fsz ) return;
+
+    std::vector<size_t> dirty;
+    if( m_events < size )
+    {
+        if( m_levels.empty() ) m_levels.emplace_back();
+        auto& level = m_levels[0];
+        const auto b0 = m_events >> BlockBits;
+        const auto b1 = ( size - 1 ) >> BlockBits;
+        level.resize( b1 + 1, std::numeric_limits<int64_t>::min() );
+        for( size_t i=m_events; i<size; i++ )
+        {
+            auto& ev = mem.data[i];
+            auto& v = level[i >> BlockBits];
+            v = std::max( v, FreeKey( ev ) );
+            AddFootprint( ev.Ptr() >> ChunkBits, ( ev.Ptr() + ev.Size() ) >> ChunkBits );
+        }
+        for( size_t b=b0; b<=b1; b++ ) dirty.emplace_back( b );
+    }
+
+    // Blocks of previously seen allocations were indexed as never freed.
+    const auto prevBlocks = dirty.size();
+    for( size_t i=m_frees; i<fsz; i++ )
+    {
+        const auto idx = mem.frees[i];
+        if( idx < m_events ) dirty.emplace_back( idx >> BlockBits );
+    }
+    if( dirty.size() != prevBlocks )
+    {
+        std::sort( dirty.begin() + prevBlocks, dirty.end() );
+        for( size_t i=prevBlocks; i<dirty.size(); i++ )
+        {
+            if( i == prevBlocks || dirty[i] != dirty[i-1] ) m_levels[0][dirty[i]] = CalcBlock( mem, dirty[i] );
+        }
+        std::sort( dirty.begin(), dirty.end() );
+        dirty.erase( std::unique( dirty.begin(), dirty.end() ), dirty.end() );
+    }
+
+    m_events = size;
+    m_frees = fsz;
+    if( !dirty.empty() ) Propagate( dirty );
+}
+
+int64_t MemIndex::CalcBlock( const MemData& mem, size_t block ) const
+{
+    const auto i0 = block << BlockBits;
+    const auto i1 = std::min<size_t>( i0 + ( 1 << BlockBits ), mem.data.size() );
+    auto ret = std::numeric_limits<int64_t>::min();
+    for( size_t i=i0; i<i1; i++ ) ret = std::max( ret, FreeKey( mem.data[i] ) );
+    return ret;
+}
+
+void MemIndex::Propagate( std::vector<size_t>& dirty )
+{
+    for( size_t l=0; m_levels[l].size() > 1; l++ )
+    {
+        if( m_levels.size() == l+1 ) m_levels.emplace_back();
+        const auto& src = m_levels[l];
+        auto& dst = m_levels[l+1];
+        dst.resize( ( src.size() + 1 ) / 2, std::numeric_limits<int64_t>::min() );
+
+        size_t num = 0;
+        for( auto v : dirty )
+        {
+            const auto p = v / 2;
+            if( num != 0 && dirty[num-1] == p ) continue;
+            const auto c = p * 2;
+            dst[p] = c+1 < src.size() ? std::max( src[c], src[c+1] ) : src[c];
+            dirty[num++] = p;
+        }
+        dirty.resize( num );
+    }
+}
+
+void MemIndex::GetLive( const MemData& mem, size_t first, size_t last, int64_t time, std::vector<uint32_t>& out ) const
+{
+    if( first >= last ) return;
+    if( !m_levels.empty() )
+    {
+        GetLiveImpl( mem, m_levels.size() - 1, 0, first, last, time, out );
+        first = std::max( first, m_events );
+    }
+    for( size_t i=first; i<last; i++ )
+    {
+        const auto tf = mem.data[i].TimeFree();
+        if( tf < 0 || tf >= time ) out.emplace_back( uint32_t( i ) );
+    }
+}
+
+void MemIndex::GetLiveImpl( const MemData& mem, size_t level, size_t node, size_t first, size_t last, int64_t time, std::vector<uint32_t>& out ) const
+{
+    const auto shift = level + BlockBits;
+    const auto i0 = std::max( first, node << shift );
+    const auto i1 = std::min( { last, m_events, ( node + 1 ) << shift } );
+    if( i0 >= i1 ) return;
+    if( m_levels[level][node] < time ) return;
+
+    if( level == 0 )
+    {
+        for( size_t i=i0; i<i1; i++ )
+        {
+            const auto tf = mem.data[i].TimeFree();
+            if( tf < 0 || tf >= time ) out.emplace_back( uint32_t( i ) );
+        }
+    }
+    else
+    {
+        const auto c = node * 2;
+        GetLiveImpl( mem, level-1, c, first, last, time, out );
+        if( c+1 < m_levels[level-1].size() ) GetLiveImpl( mem, level-1, c+1, first, last, time, out );
+    }
+}
+
+void MemIndex::GetFreed( const MemData& mem, size_t first, size_t last, int64_t t0, int64_t t1, std::vector<uint32_t>& out ) const
+{
+    if( first >= last ) return;
+    if( m_levels.empty() )
+    {
+        for( size_t i=first; i<last; i++ )
+        {
+            const auto tf = mem.data[i].TimeFree();
+            if( tf >= 0 && tf >= t0 && tf <= t1 ) out.emplace_back( uint32_t( i ) );
+        }
+        return;
+    }
+
+    auto data = mem.data.data();
+    auto it = std::lower_bound( mem.frees.begin(), mem.frees.begin() + m_frees, t0, [data] ( const auto& l, const auto& r ) { return data[l].TimeFree() < r; } );
+    const auto end = mem.frees.begin() + m_frees;
+    while( it != end && data[*it].TimeFree() <= t1 )
+    {
+        if( *it >= first && *it < last ) out.emplace_back( *it );
+        ++it;
+    }
+    for( size_t i=m_frees; i<mem.frees.size(); i++ )
+    {
+        const auto idx = mem.frees[i];
+        const auto tf = data[idx].TimeFree();
+        if( idx >= first && idx < last && tf >= t0 && tf <= t1 ) out.emplace_back( idx );
+    }
+}
+
+void MemIndex::AddFootprint( uint64_t c0, uint64_t c1 )
+{
+    for(;;)
+    {
+        const auto page = c0 / PageChunks;
+        auto it = m_footprint.find( page );
+        if( it == m_footprint.end() ) it = m_footprint.emplace( page, FootprintPage {} ).first;
+        auto& bits = it->second;
+
+        const auto pageEnd = ( page + 1 ) * PageChunks - 1;
+        const auto b0 = c0 % PageChunks;
+        const auto b1 = std::min( c1, pageEnd ) % PageChunks;
+        for( auto w = b0 / 64; w <= b1 / 64; w++ )
+        {
+            const auto lo = w == b0 / 64 ? b0 % 64 : 0;
+            const auto hi = w == b1 / 64 ? b1 % 64 : 63;
+            const auto mask = ( ~uint64_t( 0 ) >> ( 63 - hi ) ) & ( ~uint64_t( 0 ) << lo );
+            bits[w] |= mask;
+        }
+
+        if( c1 <= pageEnd ) return;
+        c0 = pageEnd + 1;
+    }
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef __TRACYMEMINDEX_HPP__
+#define __TRACYMEMINDEX_HPP__
+
+#include <array>
+#include <stdint.h>
+#include <vector>
+
+#include "../server/TracyEvent.hpp"
+#include "../server/tracy_robin_hood.h"
+
+namespace tracy
+{
+
+// Index of the allocation events of a memory pool, answering which allocations are live at
+// a given point in time. The events are already ordered by allocation time, so the index keeps
+// the latest free time of each block of events (unfreed allocations count as never freed) in
+// a max pyramid. Blocks and pyramid nodes in which everything was freed before the queried
+// time are skipped, making the query cost proportional to the size of the live set.
+class MemIndex
+{
+public:
+    enum { BlockBits = 6 };
+    enum { ChunkBits = 10 };
+    enum { PageChunks = 1024 };
+
+    // One bit per 2^ChunkBits bytes of the address space ever used by the pool.
+    using FootprintPage = std::array<uint64_t, PageChunks / 64>;
+    using Footprint = unordered_flat_map<uint64_t, FootprintPage>;
+
+    // Processes events and frees which appeared since the last call. Frees have to be in
+    // time order.
+    void Update( const MemData& mem );
+
+    bool IsEmpty() const { return m_levels.empty(); }
+
+    // Appends indices of allocations in the [first, last) event range which are not freed
+    // before the given time. Events not yet covered by the index are scanned.
+    void GetLive( const MemData& mem, size_t first, size_t last, int64_t time, std::vector<uint32_t>& out ) const;
+    // Appends indices of allocations in the [first, last) event range freed in the [t0, t1] time range.
+    void GetFreed( const MemData& mem, size_t first, size_t last, int64_t t0, int64_t t1, std::vector<uint32_t>& out ) const;
+
+    const Footprint& GetFootprint() const { return m_footprint; }
+
+private:
+    static tracy_force_inline int64_t FreeKey( const MemEvent& ev ) { return ev.TimeFree() < 0 ? std::numeric_limits<int64_t>::max() : ev.TimeFree(); }
+
+    int64_t CalcBlock( const MemData& mem, size_t block ) const;
+    void Propagate( std::vector<size_t>& dirty );
+    void GetLiveImpl( const MemData& mem, size_t level, size_t node, size_t first, size_t last, int64_t time, std::vector<uint32_t>& out ) const;
+    void AddFootprint( uint64_t c0, uint64_t c1 );
+
+    size_t m_events = 0;
+    size_t m_frees = 0;
+    std::vector<std::vector<int64_t>> m_levels;
+    Footprint m_footprint;
+};
+
+}
+
+#endif
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+#include "TracyTextIndex.hpp"
+#include "../public/common/TracyForceInline.hpp"
+
+namespace tracy
+{
+
+static tracy_force_inline uint32_t Lower( uint8_t c )
+{
+    return ( c >= 'A' && c <= 'Z' ) ? c + ( 'a' - 'A' ) : c;
+}
+
+void TextIndex::Add( const char* text )
+{
+    const auto block = uint32_t( m_size >> BlockBits ) + 1;
+    m_size++;
+
+    auto ptr = (const uint8_t*)text;
+    if( !ptr[0] || !ptr[1] ) return;
+    uint32_t tri = ( Lower( ptr[0] ) << 8 ) | Lower( ptr[1] );
+    ptr += 2;
+    while( *ptr )
+    {
+        tri = ( ( tri << 8 ) | Lower( *ptr++ ) ) & 0xFFFFFF;
+        auto& posting = m_postings[tri];
+        if( posting.last == block ) continue;
+        auto delta = block - posting.last;
+        while( delta >= 0x80 )
+        {
+            posting.data.emplace_back( uint8_t( delta | 0x80 ) );
+            delta >>= 7;
+        }
+        posting.data.emplace_back( uint8_t( delta ) );
+        posting.last = block;
+        posting.count++;
+    }
+}
+
+void TextIndex::Decode( const Posting& posting, std::vector<uint32_t>& out )
+{
+    out.clear();
+    out.reserve( posting.count );
+    uint32_t block = 0;
+    auto ptr = posting.data.data();
+    const auto end = ptr + posting.data.size();
+    while( ptr != end )
+    {
+        uint32_t delta = 0;
+        int shift = 0;
+        while( *ptr & 0x80 )
+        {
+            delta |= uint32_t( *ptr++ & 0x7F ) << shift;
+            shift += 7;
+        }
+        delta |= uint32_t( *ptr++ ) << shift;
+        block += delta;
+        out.emplace_back( block - 1 );
+    }
+}
+
+bool TextIndex::Find( const std::vector<std::string>& strings, std::vector<uint32_t>& blocks ) const
+{
+    std::vector<uint32_t> trigrams;
+    for( auto& str : strings )
+    {
+        auto ptr = (const uint8_t*)str.c_str();
+        for( size_t i=2; i<str.size(); i++ )
+        {
+            trigrams.emplace_back( ( Lower( ptr[i-2] ) << 16 ) | ( Lower( ptr[i-1] ) << 8 ) | Lower( ptr[i] ) );
+        }
+    }
+    if( trigrams.empty() ) return false;
+    std::sort( trigrams.begin(), trigrams.end() );
+    trigrams.erase( std::unique( trigrams.begin(), trigrams.end() ), trigrams.end() );
+
+    blocks.clear();
+    std::vector<const Posting*> postings;
+    postings.reserve( trigrams.size() );
+    for( auto tri : trigrams )
+    {
+        auto it = m_postings.find( tri );
+        if( it == m_postings.end() ) return true;
+        postings.emplace_back( &it->second );
+    }
+
+    // Intersect starting from the rarest trigram, to keep the candidate list short.
+    std::sort( postings.begin(), postings.end(), []( const auto& l, const auto& r ) { return l->count < r->count; } );
+    Decode( *postings[0], blocks );
+    std::vector<uint32_t> tmp;
+    for( size_t i=1; i<postings.size() && !blocks.empty(); i++ )
+    {
+        Decode( *postings[i], tmp );
+        blocks.erase( std::set_intersection( blocks.begin(), blocks.end(), tmp.begin(), tmp.end(), blocks.begin() ), blocks.end() );
+    }
+    return true;
+}
+
+void TextIndex::GetRegexLiterals( const char* re, std::vector<std::string>& out )
+{
+    // Top level alternation makes all literals optional.
+    int depth = 0;
+    for( auto ptr = re; *ptr; ptr++ )
+    {
+        if( *ptr == '\\' )
+        {
+            if( !*++ptr ) break;
+        }
+        else if( *ptr == '[' )
+        {
+            ptr++;
+            if( *ptr == '^' ) ptr++;
+            if( *ptr == ']' ) ptr++;
+            while( *ptr && *ptr != ']' )
+            {
+                if( *ptr == '\\' && ptr[1] ) ptr++;
+                ptr++;
+            }
+            if( !*ptr ) break;
+        }
+        else if( *ptr == '(' ) depth++;
+        else if( *ptr == ')' ) depth--;
+        else if( *ptr == '|' && depth == 0 ) return;
+    }
+
+    std::string run;
+    auto flush = [&run, &out] {
+        if( run.size() >= 3 ) out.emplace_back( run );
+        run.clear();
+    };
+
+    size_t i = 0;
+    while( re[i] )
+    {
+        char lit;
+        auto next = i + 1;
+        const auto c = re[i];
+        if( c == '\\' )
+        {
+            if( !re[next] ) break;
+            lit = re[next++];
+            // Escaped letters and digits are character classes, anchors, back references or
+            // character codes. Operands of the latter must not be taken as literals.
+            if( ( lit >= 'a' && lit <= 'z' ) || ( lit >= 'A' && lit <= 'Z' ) || ( lit >= '0' && lit <= '9' ) )
+            {
+                if( lit == 'x' || lit == 'u' )
+                {
+                    const auto end = next + ( lit == 'x' ? 2 : 4 );
+                    while( next < end && isxdigit( (unsigned char)re[next] ) ) next++;
+                }
+                else if( lit == 'c' )
+                {
+                    if( isalpha( (unsigned char)re[next] ) ) next++;
+                }
+                else if( lit >= '0' && lit <= '9' )
+                {
+                    while( re[next] >= '0' && re[next] <= '9' ) next++;
+                }
+                flush();
+                i = next;
+                continue;
+            }
+        }
+        else if( c == '[' )
+        {
+            if( re[next] == '^' ) next++;
+            if( re[next] == ']' ) next++;
+            while( re[next] && re[next] != ']' )
+            {
+                if( re[next] == '\\' && re[next+1] ) next++;
+                next++;
+            }
+            if( re[next] ) next++;
+            flush();
+            i = next;
+            continue;
+        }
+        else if( c == '(' )
+        {
+            int level = 1;
+            while( re[next] && level > 0 )
+            {
+                if( re[next] == '\\' && re[next+1] ) next++;
+                else if( re[next] == '(' ) level++;
+                else if( re[next] == ')' ) level--;
+                next++;
+            }
+            flush();
+            i = next;
+            continue;
+        }
+        else if( c == '{' )
+        {
+            while( re[next] && re[next-1] != '}' ) next++;
+            flush();
+            i = next;
+            continue;
+        }
+        else if( strchr( ".^$)*+?", c ) )
+        {
+            flush();
+            i = next;
+            continue;
+        }
+        else
+        {
+            lit = c;
+        }
+
+        // Quantifiers which allow zero repetitions make the literal optional.
+        const auto q = re[next];
+        if( q == '*' || q == '?' || q == '{' )
+        {
+            flush();
+        }
+        else
+        {
+            run += lit;
+            if( q == '+' ) flush();
+        }
+        i = next;
+    }
+    flush();
+}
+
+}
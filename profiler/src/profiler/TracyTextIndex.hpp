@@ -0,0 +1,48 @@
+#ifndef __TRACYTEXTINDEX_HPP__
+#define __TRACYTEXTINDEX_HPP__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "../server/tracy_robin_hood.h"
+
+namespace tracy
+{
+
+// Case insensitive trigram index of a list of texts, e.g. messages. Texts are grouped in blocks
+// of 2^BlockBits consecutive entries and each trigram keeps a delta encoded list of the blocks
+// in which it appears. Lookups return candidate blocks, which have to be verified by the caller.
+class TextIndex
+{
+public:
+    enum { BlockBits = 4 };
+
+    // Appends a text. Its id is the number of previously added texts.
+    void Add( const char* text );
+    size_t Size() const { return m_size; }
+
+    // Sets blocks to the ascending list of blocks which may hold texts containing all of the strings.
+    // Returns false if the strings are too short to narrow down the search.
+    bool Find( const std::vector<std::string>& strings, std::vector<uint32_t>& blocks ) const;
+
+    // Appends strings which have to be present in any match of the regular expression.
+    static void GetRegexLiterals( const char* re, std::vector<std::string>& out );
+
+private:
+    struct Posting
+    {
+        std::vector<uint8_t> data;  // varint encoded deltas of block numbers, plus one
+        uint32_t last = 0;          // last block number, plus one
+        uint32_t count = 0;
+    };
+
+    static void Decode( const Posting& posting, std::vector<uint32_t>& out );
+
+    unordered_flat_map<uint32_t, Posting> m_postings;
+    size_t m_size = 0;
+};
+
+}
+
+#endif
@@ -26,6 +26,15 @@ struct TimelineDraw
     uint32_t num;
 };
 
+struct ZoneLodDraw
+{
+    uint16_t depth;
+    int32_t srcloc;     // dominant zone, only for depth 0
+    Int48 start;
+    Int48 end;
+    uint64_t num;       // number of zones starting in the range, only for depth 0
+};
+
 
 enum class ContextSwitchDrawType : uint8_t
 {
@@ -135,8 +135,9 @@ void TimelineItemPlot::Preprocess( const TimelineContext& ctx, TaskDispatch& td,
         const auto nspx = ctx.nspx;
         const auto MinVisNs = int64_t( round( MinVisSize * nspx ) );
 
+        m_plot->UpdateLod();
         auto& vec = m_plot->data;
-        vec.ensure_sorted();
+        auto& lod = m_plot->lod;
         if( vec.front().time.Val() > vEnd || vec.back().time.Val() < vStart )
         {
             m_plot->rMin = 0;
@@ -151,23 +152,12 @@ void TimelineItemPlot::Preprocess( const TimelineContext& ctx, TaskDispatch& td,
         if( end != vec.end() ) end++;
         if( it != vec.begin() ) it--;
 
-        double min = it->val;
-        double max = it->val;
         const auto num = end - it;
-        if( num > 1000000 )
-        {
-            min = m_plot->min;
-            max = m_plot->max;
-        }
-        else
-        {
-            auto tmp = it;
-            while( ++tmp < end )
-            {
-                if( tmp->val < min ) min = tmp->val;
-                else if( tmp->val > max ) max = tmp->val;
-            }
-        }
+        uint32_t imin, imax;
+        double sum;
+        lod.Query( vec.data(), it - vec.begin(), end - vec.begin(), imin, imax, sum );
+        double min = vec[imin].val;
+        double max = vec[imax].val;
         if( min == max )
         {
             min--;
@@ -198,38 +188,16 @@ void TimelineItemPlot::Preprocess( const TimelineContext& ctx, TaskDispatch& td,
             }
             else
             {
-                // Sync with View::DrawPlot()!
-                constexpr int NumSamples = 256;
-                uint32_t samples[NumSamples];
-                uint32_t cnt = 0;
-                uint32_t offset = it - vec.begin();
-                if( rsz < NumSamples )
-                {
-                    for( cnt=0; cnt<rsz; cnt++ )
-                    {
-                        samples[cnt] = offset + cnt;
-                    }
-                }
-                else
-                {
-                    const auto skip = ( rsz + NumSamples - 1 ) / NumSamples;
-                    const auto limit = rsz / skip;
-                    for( cnt=0; cnt<limit; cnt++ )
-                    {
-                        samples[cnt] = offset + cnt * skip;
-                    }
-                    if( cnt == limit ) cnt--;
-                    samples[cnt++] = offset + rsz - 1;
-                }
+                const uint32_t offset = it - vec.begin();
                 it = next;
 
-                pdqsort_branchless( samples, samples+cnt, [&vec] ( const auto& l, const auto& r ) { return vec[l].val < vec[r].val; } );
+                lod.Query( vec.data(), offset, offset + rsz, imin, imax, sum );
 
                 assert( rsz > 0 );
                 m_draw.emplace_back( rsz );
                 m_draw.emplace_back( offset );
-                m_draw.emplace_back( samples[0] );
-                m_draw.emplace_back( samples[cnt-1] );
+                m_draw.emplace_back( imin );
+                m_draw.emplace_back( imax );
             }
         }
     } );
@@ -9,6 +9,7 @@
 #include "TracyTimelineItemThread.hpp"
 #include "TracyView.hpp"
 #include "TracyWorker.hpp"
+#include "TracyZoneLod.hpp"
 
 namespace tracy
 {
@@ -260,7 +261,7 @@ void TimelineItemThread::HeaderExtraContents( const TimelineContext& ctx, int of
 
 bool TimelineItemThread::DrawContents( const TimelineContext& ctx, int& offset )
 {
-    m_view.DrawThread( ctx, *m_thread, m_draw, m_ctxDraw, m_samplesDraw, m_lockDraw, offset, m_depth, m_hasCtxSwitch, m_hasSamples );
+    m_view.DrawThread( ctx, *m_thread, m_draw, m_ctxDraw, m_samplesDraw, m_lockDraw, m_lodDraw, offset, m_depth, m_hasCtxSwitch, m_hasSamples );
     if( m_depth == 0 && !m_hasMessages )
     {
         auto& crash = m_worker.GetCrashEvent();
@@ -279,6 +280,7 @@ void TimelineItemThread::DrawFinished()
     m_samplesDraw.clear();
     m_ctxDraw.clear();
     m_draw.clear();
+    m_lodDraw.clear();
     m_msgDraw.clear();
     m_lockDraw.clear();
 }
@@ -288,6 +290,7 @@ void TimelineItemThread::Preprocess( const TimelineContext& ctx, TaskDispatch& t
     assert( m_samplesDraw.empty() );
     assert( m_ctxDraw.empty() );
     assert( m_draw.empty() );
+    assert( m_lodDraw.empty() );
     assert( m_msgDraw.empty() );
     assert( m_lockDraw.empty() );
 
@@ -300,7 +303,24 @@ void TimelineItemThread::Preprocess( const TimelineContext& ctx, TaskDispatch& t
         else
 #endif
         {
-            m_depth = PreprocessZoneLevel( ctx, m_thread->timeline, 0, visible );
+            // When zoomed out far enough, zones are drawn from the summary. Zones not yet
+            // included in it are processed as usual.
+            const auto lod = m_view.GetZoneLod( m_thread->id );
+            const auto level = lod ? lod->FindLevel( int64_t( round( GetScale() * MinVisSize * ctx.nspx ) ) ) : -1;
+            if( level >= 0 && lod->GetEnd() > ctx.vStart )
+            {
+                m_depth = PreprocessZoneLod( ctx, *lod, level, std::min( ctx.vEnd, lod->GetEnd() ), visible );
+                if( lod->GetEnd() < ctx.vEnd )
+                {
+                    auto tail = ctx;
+                    tail.vStart = lod->GetEnd() + 1;
+                    m_depth = std::max( m_depth, PreprocessZoneLevel( tail, m_thread->timeline, 0, visible ) );
+                }
+            }
+            else
+            {
+                m_depth = PreprocessZoneLevel( ctx, m_thread->timeline, 0, visible );
+            }
         }
     } );
 
@@ -468,6 +488,77 @@ int TimelineItemThread::PreprocessZoneLevel( const TimelineContext& ctx, const V
     return maxdepth;
 }
 
+int TimelineItemThread::PreprocessZoneLod( const TimelineContext& ctx, const ZoneLod& lod, int level, int64_t vEnd, bool visible )
+{
+    const auto vStart = ctx.vStart;
+    const auto MinVisNs = int64_t( round( GetScale() * MinVisSize * ctx.nspx ) );
+
+    int maxdepth = 0;
+    const auto& buckets = lod.GetLevel( level );
+    if( !buckets.empty() )
+    {
+        const auto base = lod.GetBase();
+        const auto bsz = lod.GetBucketSize( level );
+        const auto b0 = size_t( std::max<int64_t>( 0, ( vStart - base ) / bsz ) );
+        const auto b1 = std::min( buckets.size(), size_t( std::max<int64_t>( 0, ( vEnd - base ) / bsz + 1 ) ) );
+
+        // Runs of occupied buckets are emitted for each depth. As zones nest, a bucket occupies
+        // all depths up to its own, so the open runs form a stack.
+        struct Run
+        {
+            int64_t start;
+            uint64_t num;
+            ZoneLod::Bucket dominant;
+        };
+        std::vector<Run> runs;
+        int prev = 0;
+        for( size_t i=b0; i<=b1; i++ )
+        {
+            const auto bstart = base + int64_t( i ) * bsz;
+            const int depth = i < b1 ? buckets[i].depth : 0;
+            if( depth < prev && visible )
+            {
+                const auto rend = std::min( bstart, vEnd );
+                for( int d=depth; d<prev; d++ )
+                {
+                    auto& r = runs[d];
+                    m_lodDraw.emplace_back( ZoneLodDraw { uint16_t( d ), r.dominant.srcloc, r.start, rend, r.num } );
+                }
+            }
+            else if( depth > prev )
+            {
+                if( runs.size() < size_t( depth ) ) runs.resize( depth );
+                for( int d=prev; d<depth; d++ ) runs[d] = Run { bstart, 0, ZoneLod::Bucket {} };
+                if( depth > maxdepth ) maxdepth = depth;
+            }
+            if( depth > 0 )
+            {
+                auto& r = runs[0];
+                r.num += buckets[i].num;
+                r.dominant = ZoneLod::Merge( r.dominant, buckets[i] );
+            }
+            prev = depth;
+        }
+    }
+
+    // Zones wide enough to be seen are drawn individually on top of the summary.
+    for( size_t d=0; d<lod.GetLargeDepth(); d++ )
+    {
+        const auto& zones = lod.GetLargeZones( d );
+        auto it = std::lower_bound( zones.begin(), zones.end(), vStart, [this] ( const auto& l, const auto& r ) { return m_worker.GetZoneEnd( *l ) < r; } );
+        for( ; it != zones.end(); ++it )
+        {
+            auto& ev = **it;
+            if( ev.Start() >= vEnd ) break;
+            if( m_worker.GetZoneEnd( ev ) - ev.Start() < MinVisNs * ZoneLod::LargeZoneBuckets ) continue;
+            if( int( d ) >= maxdepth ) maxdepth = d + 1;
+            if( visible ) m_draw.emplace_back( TimelineDraw { TimelineDrawType::Zone, uint16_t( d ), (void**)&ev } );
+        }
+    }
+
+    return maxdepth;
+}
+
 void TimelineItemThread::PreprocessContextSwitches( const TimelineContext& ctx, const ContextSwitch& ctxSwitch, bool visible )
 {
     const auto nspx = ctx.nspx;
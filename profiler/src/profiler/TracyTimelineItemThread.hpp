@@ -8,6 +8,8 @@
 namespace tracy
 {
 
+class ZoneLod;
+
 class TimelineItemThread final : public TimelineItem
 {
 public:
@@ -42,6 +44,8 @@ private:
     template<typename Adapter, typename V>
     int PreprocessZoneLevel( const TimelineContext& ctx, const V& vec, int depth, bool visible );
 
+    int PreprocessZoneLod( const TimelineContext& ctx, const ZoneLod& lod, int level, int64_t vEnd, bool visible );
+
     void PreprocessContextSwitches( const TimelineContext& ctx, const ContextSwitch& ctxSwitch, bool visible );
     void PreprocessSamples( const TimelineContext& ctx, const Vector<SampleData>& vec, bool visible, int yPos );
     void PreprocessMessages( const TimelineContext& ctx, const Vector<short_ptr<MessageData>>& vec, uint64_t tid, bool visible, int yPos );
@@ -53,6 +57,7 @@ private:
     std::vector<SamplesDraw> m_samplesDraw;
     std::vector<ContextSwitchDraw> m_ctxDraw;
     std::vector<TimelineDraw> m_draw;
+    std::vector<ZoneLodDraw> m_lodDraw;
     std::vector<MessagesDraw> m_msgDraw;
     std::vector<std::unique_ptr<LockDraw>> m_lockDraw;
     int m_depth;
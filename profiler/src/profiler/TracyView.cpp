@@ -108,6 +108,20 @@ View::~View()
     m_userData.SaveAnnotations( m_annotations );
     m_userData.SaveSourceSubstitutions( m_sourceSubstitutions );
 
+    m_findZone.job.Stop();
+    m_flameGraph.job.Stop();
+    m_zoneLod.job.Stop();
+    m_memIndex.job.Stop();
+    m_textIndex.job.Stop();
+    // Task groups wait for their cancelled tasks to leave the pool when they are destroyed.
+    if( m_statTasks ) m_statTasks->Cancel();
+    if( m_memAnalysisTasks ) m_memAnalysisTasks->Cancel();
+    if( m_sampleStatTasks ) m_sampleStatTasks->Cancel();
+    if( m_compare.tasks ) m_compare.tasks->Cancel();
+    m_statTasks.reset();
+    m_memAnalysisTasks.reset();
+    m_sampleStatTasks.reset();
+    m_compare.tasks.reset();
     if( m_compare.loadThread.joinable() ) m_compare.loadThread.join();
     if( m_saveThread.joinable() ) m_saveThread.join();
 
@@ -115,6 +129,12 @@ View::~View()
     if( m_playback.texture ) FreeTexture( m_playback.texture, m_cbMainThread );
 }
 
+TaskDispatch& View::GetTaskDispatch()
+{
+    if( !m_taskDispatch ) m_taskDispatch = std::make_unique<TaskDispatch>( std::max<int>( 1, std::thread::hardware_concurrency() - 1 ), "Analysis" );
+    return *m_taskDispatch;
+}
+
 void View::InitTextEditor()
 {
     m_sourceView = std::make_unique<SourceView>();
@@ -799,6 +819,10 @@ bool View::DrawImpl()
     }
     std::lock_guard<std::mutex> lock( m_worker.GetDataLock() );
     m_worker.DoPostponedWork();
+    if( !m_zoneLod.job.IsStarted() )
+    {
+        m_zoneLod.job.Start( [this, isStatic = m_worker.IsDataStatic()] { ZoneLodJob( isStatic ); } );
+    }
     if( !m_worker.IsDataStatic() )
     {
         if( m_worker.IsConnected() )
@@ -895,6 +919,8 @@ bool View::DrawImpl()
         {
             m_showWaitStacks = true;
         }
+        ToggleButton( ICON_FA_FIRE_FLAME_CURVED " Flame graph", m_flameGraph.show );
+        ToggleButton( ICON_FA_FONT " Zone text", m_zoneText.show );
         ImGui::EndPopup();
     }
     if( m_sscb )
@@ -1096,6 +1122,7 @@ bool View::DrawImpl()
     if( m_showOptions ) DrawOptions();
     if( m_showMessages ) DrawMessages();
     if( m_findZone.show ) DrawFindZone();
+    else m_findZone.StopJob();
     if( m_showStatistics ) DrawStatistics();
     if( m_memInfo.show ) DrawMemory();
     if( m_memInfo.showAllocList ) DrawAllocList();
@@ -1112,6 +1139,8 @@ bool View::DrawImpl()
     if( m_sampleParents.symAddr != 0 ) DrawSampleParents();
     if( m_showRanges ) DrawRanges();
     if( m_showWaitStacks ) DrawWaitStacks();
+    if( m_flameGraph.show ) DrawFlameGraph();
+    if( m_zoneText.show ) DrawZoneTextSearch();
 
     if( m_setRangePopup.active )
     {
@@ -1146,6 +1175,12 @@ bool View::DrawImpl()
             m_memInfo.range.min = s;
             m_memInfo.range.max = e;
         }
+        if( ImGui::Selectable( ICON_FA_FIRE_FLAME_CURVED " Limit flame graph range" ) )
+        {
+            m_flameGraph.range.active = true;
+            m_flameGraph.range.min = s;
+            m_flameGraph.range.max = e;
+        }
         ImGui::Separator();
         if( ImGui::Selectable( ICON_FA_NOTE_STICKY " Add annotation" ) )
         {
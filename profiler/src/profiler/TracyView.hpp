@@ -5,6 +5,7 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -12,15 +13,19 @@
 #include "imgui.h"
 
 #include "TracyAchievements.hpp"
+#include "TracyBackgroundJob.hpp"
 #include "TracyBadVersion.hpp"
 #include "TracyBuzzAnim.hpp"
 #include "TracyConfig.hpp"
 #include "TracyDecayValue.hpp"
+#include "TracyMemIndex.hpp"
 #include "TracySourceContents.hpp"
+#include "TracyTextIndex.hpp"
 #include "TracyTimelineController.hpp"
 #include "TracyUserData.hpp"
 #include "TracyUtility.hpp"
 #include "TracyViewData.hpp"
+#include "TracyZoneLod.hpp"
 #include "../server/TracyFileWrite.hpp"
 #include "../server/TracyShortPtr.hpp"
 #include "../server/TracyWorker.hpp"
@@ -51,6 +56,56 @@ struct CpuUsageDraw;
 struct CpuCtxDraw;
 struct LockDraw;
 struct PlotDraw;
+struct ZoneLodDraw;
+
+// Flame graph call tree node. Nodes are stored in an array, with item 0 being the root.
+struct FlameGraphItem
+{
+    uint32_t key;       // zone source location, or function name string for samples
+    uint32_t parent;
+    uint32_t child;     // first child, 0 if none
+    uint32_t sibling;   // next child of the parent, 0 if none
+    int64_t time;       // zone time, or sample count
+};
+
+// Allocation counts of a call stack, binned by the base 2 logarithm of the value.
+struct MemHistogram
+{
+    enum { Buckets = 48 };
+
+    uint64_t lifetime[Buckets];     // freed allocations, by lifetime in ns
+    uint64_t size[Buckets];         // all allocations, by size in bytes
+    uint64_t active;                // allocations which were not freed
+};
+
+struct MemFragmentation
+{
+    int64_t time;
+    uint64_t usage;                 // live bytes
+    uint64_t pages;                 // 4 KB pages holding live allocations
+};
+
+// Sorted durations of a zone source location or a frame set, as shown in the compare histogram.
+struct CompareDist
+{
+    std::vector<int64_t> sorted;
+    size_t num = 0;                 // processed zones or frames
+    int64_t total = 0;
+    float average = 0;
+    float median = 0;
+    std::atomic<bool> ready = false;
+};
+
+// Source location present in both compared traces.
+struct CompareSrcLocDiff
+{
+    int32_t srcloc[2];
+    size_t count[2];
+    double mean[2];
+    double sd[2];
+    int64_t median[2];              // -1 if not calculated
+    double t;                       // Welch's t statistic of the mean change
+};
 
 
 class View
@@ -91,6 +146,7 @@ class View
         size_t count;
         int64_t total;
         uint16_t threadNum;
+        unordered_flat_map<uint16_t, uint32_t> threads;
     };
 
 public:
@@ -148,9 +204,16 @@ public:
     void HighlightThread( uint64_t thread );
     void ZoomToRange( int64_t start, int64_t end, bool pause = true );
     bool DrawPlot( const TimelineContext& ctx, PlotData& plot, const std::vector<uint32_t>& plotDraw, int& offset );
-    void DrawThread( const TimelineContext& ctx, const ThreadData& thread, const std::vector<TimelineDraw>& draw, const std::vector<ContextSwitchDraw>& ctxDraw, const std::vector<SamplesDraw>& samplesDraw, const std::vector<std::unique_ptr<LockDraw>>& lockDraw, int& offset, int depth, bool hasCtxSwitches, bool hasSamples );
+    void DrawThread( const TimelineContext& ctx, const ThreadData& thread, const std::vector<TimelineDraw>& draw, const std::vector<ContextSwitchDraw>& ctxDraw, const std::vector<SamplesDraw>& samplesDraw, const std::vector<std::unique_ptr<LockDraw>>& lockDraw, const std::vector<ZoneLodDraw>& lodDraw, int& offset, int depth, bool hasCtxSwitches, bool hasSamples );
     void DrawThreadMessagesList( const TimelineContext& ctx, const std::vector<MessagesDraw>& drawList, int offset, uint64_t tid );
     void DrawThreadOverlays( const ThreadData& thread, const ImVec2& ul, const ImVec2& dr );
+    void DrawZoneLodList( const TimelineContext& ctx, const std::vector<ZoneLodDraw>& drawList, int offset, uint64_t tid );
+
+    const ZoneLod* GetZoneLod( uint64_t thread ) const
+    {
+        auto it = m_zoneLod.threads.find( thread );
+        return it != m_zoneLod.threads.end() ? it->second.get() : nullptr;
+    }
     bool DrawGpu( const TimelineContext& ctx, const GpuCtxData& gpu, int& offset );
     bool DrawCpuData( const TimelineContext& ctx, const std::vector<CpuUsageDraw>& cpuDraw, const std::vector<std::vector<CpuCtxDraw>>& ctxDraw, int& offset, bool hasCpuData );
 
@@ -223,6 +286,29 @@ private:
         uint32_t count;
     };
 
+    // Compact per-symbol sample counters, indexed by symbol address.
+    struct SymCounters
+    {
+        void Add( uint64_t symAddr, uint32_t incl, uint32_t excl )
+        {
+            auto it = index.emplace( symAddr, uint32_t( data.size() ) );
+            if( it.second )
+            {
+                data.push_back( SymList { symAddr, incl, excl, 0 } );
+            }
+            else
+            {
+                auto& v = data[it.first->second];
+                v.incl += incl;
+                v.excl += excl;
+            }
+        }
+        void Clear() { index.clear(); data.clear(); }
+
+        unordered_flat_map<uint64_t, uint32_t> index;
+        std::vector<SymList> data;
+    };
+
     void InitTextEditor();
     void SetupConfig( const Config& config );
     void Achieve( const char* id );
@@ -249,8 +335,19 @@ private:
     void DrawOptions();
     void DrawMessages();
     void DrawMessageLine( const MessageData& msg, bool hasCallstack, int& idx );
+    bool PassMessageFilter( const char* text ) const;
+    size_t GetMessageFilterCandidates( std::vector<uint32_t>& blocks ) const;
+    void DrawZoneTextSearch();
+    void FindZoneText();
+    void TextIndexJob( bool isStatic );
     void DrawFindZone();
     void AccumulationModeComboBox();
+    TaskDispatch& GetTaskDispatch();
+    void UpdateStatisticsCache();
+    void CalcStatisticsCache( int32_t srcloc, const RangeSlim& range, AccumulationMode accumulationMode, StatisticsCache& cache );
+    void UpdateSampleStatistics();
+    bool CountSampleCallstack( uint32_t callstack, uint32_t count, SymCounters& out ) const;
+    bool IsSampleThreadHidden( uint64_t tid ) const;
     void DrawStatistics();
     void DrawSamplesStatistics(Vector<SymList>& data, int64_t timeRange, AccumulationMode accumulationMode);
     void DrawMemory();
@@ -271,6 +368,12 @@ private:
     void DrawRangeEntry( Range& range, const char* label, uint32_t color, const char* popupLabel, int id );
     void DrawSourceTooltip( const char* filename, uint32_t line, int before = 3, int after = 3, bool separateTooltip = true );
     void DrawWaitStacks();
+    void DrawFlameGraph();
+    void DrawFlameGraphItem( uint32_t idx, int depth, double pos, double pxscale, const ImVec2& wpos, float w, int& maxDepth );
+    void FlameGraphJob( int mode, RangeSlim range, bool isStatic, TaskDispatch* dispatch );
+    void ZoneLodJob( bool isStatic );
+    void MemIndexJob( bool isStatic );
+    const MemIndex& GetMemIndex( uint64_t pool ) const;
 
     void ListMemData( std::vector<const MemEvent*>& vec, const std::function<void(const MemEvent*)>& DrawAddress, int64_t startTime = -1, uint64_t pool = 0 );
 
@@ -326,6 +429,7 @@ private:
     void CallstackTooltipContents( uint32_t idx );
     void CrashTooltip();
 
+    bool GetZoneAncestors( const ThreadData& thread, const ZoneEvent& zone, std::vector<const ZoneEvent*>& ancestors ) const;
     const ZoneEvent* GetZoneParent( const ZoneEvent& zone ) const;
     const ZoneEvent* GetZoneParent( const ZoneEvent& zone, uint64_t tid ) const;
     const ZoneEvent* GetZoneChild( const ZoneEvent& zone, int64_t time ) const;
@@ -346,9 +450,15 @@ private:
 #ifndef TRACY_NO_STATISTICS
     void FindZones();
     void FindZonesCompare();
+    const CompareDist* GetCompareDist( int k, int idx );
+    void CalcCompareDiffAll();
+    void DrawCompareDiffAll();
 #endif
 
     std::vector<MemoryPage> GetMemoryPages() const;
+    void UpdateMemoryAnalysis( const MemData& mem );
+    void DrawMemoryAnalysis( const MemData& mem );
+    void DrawMemHistogram( const uint64_t* data, bool time, float width, bool tooltip );
 
     void SmallCallstackButton( const char* name, uint32_t callstack, int& idx, bool tooltip = true );
     void DrawCallstackCalls( uint32_t callstack, uint16_t limit ) const;
@@ -362,12 +472,12 @@ private:
     bool GetZoneRunningTime( const ContextSwitch* ctx, const ZoneEvent& ev, int64_t& time, uint64_t& cnt );
     const char* GetThreadContextData( uint64_t thread, bool& local, bool& untracked, const char*& program );
 
-    tracy_force_inline void CalcZoneTimeData( unordered_flat_map<int16_t, ZoneTimeData>& data, int64_t& ztime, const ZoneEvent& zone );
-    tracy_force_inline void CalcZoneTimeData( const ContextSwitch* ctx, unordered_flat_map<int16_t, ZoneTimeData>& data, int64_t& ztime, const ZoneEvent& zone );
+    tracy_force_inline void CalcZoneTimeData( unordered_flat_map<int32_t, ZoneTimeData>& data, int64_t& ztime, const ZoneEvent& zone );
+    tracy_force_inline void CalcZoneTimeData( const ContextSwitch* ctx, unordered_flat_map<int32_t, ZoneTimeData>& data, int64_t& ztime, const ZoneEvent& zone );
     template<typename Adapter, typename V>
-    void CalcZoneTimeDataImpl( const V& children, unordered_flat_map<int16_t, ZoneTimeData>& data, int64_t& ztime );
+    void CalcZoneTimeDataImpl( const V& children, unordered_flat_map<int32_t, ZoneTimeData>& data, int64_t& ztime );
     template<typename Adapter, typename V>
-    void CalcZoneTimeDataImpl( const V& children, const ContextSwitch* ctx, unordered_flat_map<int16_t, ZoneTimeData>& data, int64_t& ztime );
+    void CalcZoneTimeDataImpl( const V& children, const ContextSwitch* ctx, unordered_flat_map<int32_t, ZoneTimeData>& data, int64_t& ztime );
 
     void SetPlaybackFrame( uint32_t idx );
     bool Save( const char* fn, FileCompression comp, int zlevel, bool buildDict, int streams );
@@ -433,7 +543,7 @@ private:
 
     const ZoneEvent* m_zoneInfoWindow = nullptr;
     const ZoneEvent* m_zoneHighlight;
-    DecayValue<int16_t> m_zoneSrcLocHighlight = 0;
+    DecayValue<int32_t> m_zoneSrcLocHighlight = 0;
     LockHighlight m_lockHighlight { -1 };
     LockHighlight m_nextLockHighlight;
     DecayValue<const MessageData*> m_msgHighlight = nullptr;
@@ -460,6 +570,9 @@ private:
     size_t m_prevMessages = 0;
     bool m_messagesShowCallstack = false;
     Vector<uint32_t> m_msgList;
+    bool m_messageRegex = false;
+    bool m_messageRegexValid = true;
+    std::regex m_messageRe;
     bool m_disconnectIssued = false;
     DecayValue<uint64_t> m_drawThreadMigrations = 0;
     DecayValue<uint64_t> m_drawThreadHighlight = 0;
@@ -503,6 +616,7 @@ private:
     bool m_relativeInlines = false;
     bool m_statShowAddress = false;
     bool m_statShowKernel = true;
+    std::vector<uint64_t> m_statHiddenThreads;
     bool m_groupChildrenLocations = false;
     bool m_allocTimeRelativeToZone = true;
     bool m_ctxSwitchTimeRelativeToZone = true;
@@ -592,9 +706,76 @@ private:
     RangeSlim m_setRangePopup;
     bool m_setRangePopupOpen = false;
 
-    unordered_flat_map<int16_t, StatisticsCache> m_statCache;
+    unordered_flat_map<int32_t, StatisticsCache> m_statCache;
     unordered_flat_map<int16_t, StatisticsCache> m_gpuStatCache;
 
+    // Analysis tasks of loaded traces run on one thread pool, created on first use. Each window
+    // queues its tasks in its own group, which is waited for and cancelled separately.
+    std::unique_ptr<TaskDispatch> m_taskDispatch;
+
+    // Range limited statistics are calculated by m_statTasks, each handling a batch of source
+    // locations. With a live capture the tasks take the data lock. The results replace
+    // m_statCache entries when all are done.
+    struct {
+        bool active = false;
+        RangeSlim range;
+        AccumulationMode accumulationMode;
+        std::vector<int32_t> srcloc;
+        std::vector<StatisticsCache> result;
+        std::atomic<size_t> done;
+    } m_statJob;
+    std::unique_ptr<TaskGroup> m_statTasks;
+
+    // Lifetime, size and fragmentation analysis of a memory pool. Loaded traces are processed by
+    // m_memAnalysisTasks, each handling a block of events or a group of fragmentation samples.
+    // Live captures are analyzed on the UI thread, on request.
+    struct {
+        enum { BlockSize = 1024 * 1024 };
+        enum { Samples = 256 };
+        enum { SamplesPerTask = 8 };
+
+        bool active = false;
+        bool valid = false;
+        bool refresh = false;
+        uint64_t pool = 0;
+        RangeSlim range;
+        size_t events = 0;
+        std::vector<unordered_flat_map<uint32_t, MemHistogram>> blocks;
+        unordered_flat_map<uint32_t, MemHistogram> callstacks;
+        MemHistogram total;
+        std::vector<MemFragmentation> fragmentation;
+        size_t jobs = 0;
+        std::atomic<size_t> done;
+    } m_memAnalysis;
+    std::unique_ptr<TaskGroup> m_memAnalysisTasks;
+
+    // Sample statistics limited to a time range, or to a subset of threads. The samples are
+    // processed by m_sampleStatTasks, each handling a block of samples of one thread, and the
+    // per task counters are merged when all are done. Live captures are then updated
+    // incrementally on the UI thread, processing only the samples which arrived since the last
+    // frame.
+    struct {
+        enum { BlockSize = 1024 * 1024 };
+
+        struct Block
+        {
+            SymCounters symbols;
+            unordered_flat_map<uint32_t, uint32_t> pending;
+        };
+
+        bool active = false;
+        bool valid = false;
+        RangeSlim range;
+        std::vector<uint64_t> hidden;
+        SymCounters symbols;
+        std::vector<Block> blocks;
+        unordered_flat_map<uint64_t, size_t> processed;
+        unordered_flat_map<uint32_t, uint32_t> pending;
+        size_t jobs = 0;
+        std::atomic<size_t> done;
+    } m_sampleStat;
+    std::unique_ptr<TaskGroup> m_sampleStatTasks;
+
     unordered_flat_map<const void*, bool> m_visMap;
 
     void(*m_cbMainThread)(const std::function<void()>&, bool);
@@ -616,7 +797,7 @@ private:
 
         bool show = false;
         bool ignoreCase = false;
-        std::vector<int16_t> match;
+        std::vector<int32_t> match;
         unordered_flat_map<uint64_t, Group> groups;
         size_t processed;
         uint16_t groupId;
@@ -632,9 +813,9 @@ private:
         SortBy sortBy = SortBy::Count;
         Region highlight;
         int64_t hlOrig_t0, hlOrig_t1;
-        int64_t numBins = -1;
         std::unique_ptr<int64_t[]> bins, binTime, selBin;
         Vector<int64_t> sorted, selSort;
+        Vector<int64_t> sortedSums, selSortSums;
         size_t sortedNum = 0, selSortNum, selSortActive;
         float average, selAverage;
         float median, selMedian;
@@ -650,11 +831,29 @@ private:
         Range range;
         RangeSlim rangeSlim;
 
+        // The histogram is binned by the job, with the parameters last requested by the UI thread.
+        // The published bins may lag behind the request for a few frames.
+        struct BinParams
+        {
+            int64_t numBins = -1;
+            bool logTime = false;
+            bool cumulateTime = false;
+            bool trim = false;
+            bool highlightActive = false;
+            bool selActive = false;
+            int minBinVal = 1;
+            int64_t hmin = 0, hmax = 0;
+
+            bool operator==( const BinParams& ) const = default;
+        };
+
+        BinParams binParams;
+        bool binsDirty = true;
         struct
         {
-            int numBins = -1;
-            ptrdiff_t distBegin;
-            ptrdiff_t distEnd;
+            BinParams params;
+            bool valid = false;
+            int64_t tmin, tmax, total;
         } binCache;
 
         struct {
@@ -663,6 +862,38 @@ private:
             bool enabled = false;
         } samples;
 
+        // Zone matching, sorting, grouping and binning run in a background job, which resumes from
+        // the sortedNum, processed and selSortNum counters. Results are published under jobLock.
+        // With a live capture the job keeps running and picks up the zones as they arrive.
+        struct JobParams
+        {
+            int32_t srcloc;
+            Worker::ZoneThreadData* zones;
+            size_t zsz;
+            int64_t tmin, tmax;
+            bool rangeActive;
+            int64_t rangeMin, rangeMax;
+            bool selfTime, runningTime, samples;
+            GroupBy groupBy;
+            bool highlightActive;
+            int64_t hmin, hmax;
+            uint64_t selGroup;
+            ImGuiTextFilter textFilter;
+            unordered_flat_map<uint64_t, const ContextSwitch*> ctxSwitch;
+        };
+
+        JobParams jobParams;
+        BackgroundJob job;
+        std::mutex jobLock;
+        std::atomic<bool> jobDone { false };
+        size_t jobSize = 0;
+
+        void StopJob()
+        {
+            job.Stop();
+            jobDone.store( false, std::memory_order_relaxed );
+        }
+
         void Reset()
         {
             ResetMatch();
@@ -677,6 +908,7 @@ private:
         {
             ResetGroups();
             sorted.clear();
+            sortedSums.clear();
             sortedNum = 0;
             average = 0;
             median = 0;
@@ -697,18 +929,21 @@ private:
 
         void ResetSelection()
         {
+            StopJob();
+            jobSize = 0;
             selSort.clear();
+            selSortSums.clear();
             selSortNum = 0;
             selSortActive = 0;
             selAverage = 0;
             selMedian = 0;
             selTotal = 0;
             selTime = 0;
-            binCache.numBins = -1;
+            binsDirty = true;
             samples.scheduleUpdate = true;
         }
 
-        void ShowZone( int16_t srcloc, const char* name )
+        void ShowZone( int32_t srcloc, const char* name )
         {
             show = true;
             range.active = false;
@@ -717,7 +952,7 @@ private:
             strcpy( pattern, name );
         }
 
-        void ShowZone( int16_t srcloc, const char* name, int64_t limitMin, int64_t limitMax )
+        void ShowZone( int32_t srcloc, const char* name, int64_t limitMin, int64_t limitMax )
         {
             assert( limitMin <= limitMax );
             show = true;
@@ -731,6 +966,9 @@ private:
     } m_findZone;
 
     tracy_force_inline uint64_t GetSelectionTarget( const Worker::ZoneThreadData& ev, FindZone::GroupBy groupBy ) const;
+    void FindZoneJob( bool isStatic );
+    void FindZoneProcess( const FindZone::JobParams& params, std::unique_lock<std::mutex>* dataLock );
+    void FindZoneBins();
 
     struct CompVal
     {
@@ -738,6 +976,23 @@ private:
         double v1;
     };
 
+    // Inputs of the compare histogram bins. The bins are recalculated only when these change.
+    struct CompareBinKey
+    {
+        const CompareDist* dist[2] = {};
+        size_t num[2] = {};
+        int64_t numBins = 0;
+        int minBinVal = 0;
+        bool logTime = false;
+        bool normalize = false;
+
+        bool operator==( const CompareBinKey& other ) const
+        {
+            return dist[0] == other.dist[0] && dist[1] == other.dist[1] && num[0] == other.num[0] && num[1] == other.num[1] &&
+                numBins == other.numBins && minBinVal == other.minBinVal && logTime == other.logTime && normalize == other.normalize;
+        }
+    };
+
     struct {
         bool show = false;
         bool ignoreCase = false;
@@ -747,7 +1002,7 @@ private:
         std::thread loadThread;
         BadVersionState badVer;
         char pattern[1024] = {};
-        std::vector<int16_t> match[2];
+        std::vector<int32_t> match[2];
         int selMatch[2] = { 0, 0 };
         bool logVal = false;
         bool logTime = true;
@@ -755,11 +1010,8 @@ private:
         bool normalize = true;
         int64_t numBins = -1;
         std::unique_ptr<CompVal[]> bins, binTime;
-        std::vector<int64_t> sorted[2];
-        size_t sortedNum[2] = { 0, 0 };
-        float average[2];
-        float median[2];
-        int64_t total[2];
+        CompareBinKey binKey;
+        int64_t binMin, binMax;
         int minBinVal = 1;
         int compareMode = 0;
         bool diffDone = false;
@@ -768,20 +1020,49 @@ private:
         std::vector<const char*> secondUnique;
         std::vector<std::pair<const char*, std::string>> diffs;
 
+        // Distributions of loaded traces are sorted by tasks, ahead of the medians of the diff of
+        // all source locations. Live capture data is processed on the UI thread. Entries are
+        // keyed by compare mode and source location or frame set.
+        enum { DistCacheSize = 16 };
+        std::unique_ptr<TaskGroup> tasks;
+        unordered_flat_map<uint64_t, std::shared_ptr<CompareDist>> dist[2];
+        bool diffAllDone = false;
+        std::vector<CompareSrcLocDiff> diffAll;
+        size_t diffAllJobs = 0;
+        std::atomic<size_t> diffAllMedians;
+
         void ResetSelection()
         {
-            for( int i=0; i<2; i++ )
+            binKey = {};
+        }
+
+        // Waits for the running tasks. Distributions which were not calculated are dropped.
+        void StopJobs()
+        {
+            if( !tasks ) return;
+            tasks->Cancel();
+            tasks->Sync();
+            for( auto& map : dist )
             {
-                sorted[i].clear();
-                sortedNum[i] = 0;
-                average[i] = 0;
-                median[i] = 0;
-                total[i] = 0;
+                auto it = map.begin();
+                while( it != map.end() )
+                {
+                    if( it->second->ready.load( std::memory_order_acquire ) )
+                    {
+                        ++it;
+                    }
+                    else
+                    {
+                        it = map.erase( it );
+                    }
+                }
             }
         }
 
         void Reset()
         {
+            // Median tasks write to the diffAll entries.
+            if( diffAllMedians.load( std::memory_order_acquire ) != diffAllJobs ) StopJobs();
             ResetSelection();
             for( int i=0; i<2; i++ )
             {
@@ -789,6 +1070,10 @@ private:
                 selMatch[i] = 0;
             }
             diffDone = false;
+            diffAllDone = false;
+            diffAll.clear();
+            diffAllJobs = 0;
+            diffAllMedians.store( 0, std::memory_order_relaxed );
             thisUnique.clear();
             secondUnique.clear();
             diffs.clear();
@@ -805,6 +1090,55 @@ private:
         Range range;
     } m_memInfo;
 
+    // The call tree is aggregated by a background job, which publishes snapshots of it in items.
+    // During live capture the job keeps running and picks up new data under the data lock.
+    struct {
+        enum { Zones, Samples };
+
+        bool show = false;
+        int mode = Zones;
+        Range range;
+        RangeSlim jobRange;
+        int jobMode = -1;
+        std::vector<FlameGraphItem> items;
+        bool complete = false;
+        uint32_t zoom = 0;
+        BackgroundJob job;
+        std::mutex lock;
+    } m_flameGraph;
+
+    // Zone summaries are only accessed with the worker data lock held.
+    struct {
+        unordered_flat_map<uint64_t, std::unique_ptr<ZoneLod>> threads;
+        BackgroundJob job;
+    } m_zoneLod;
+
+    // Memory pool indices are only accessed with the worker data lock held. Pools without an
+    // index yet use the empty one, which falls back to scanning the events.
+    struct {
+        unordered_flat_map<uint64_t, std::unique_ptr<MemIndex>> pools;
+        MemIndex empty;
+        BackgroundJob job;
+    } m_memIndex;
+
+    // Trigram indices of message texts and zone texts, built by a background job. Messages are
+    // indexed during live capture too, zone texts only in loaded traces.
+    struct {
+        std::unique_ptr<TextIndex> messages;
+        std::unique_ptr<TextIndex> zones;
+        std::vector<const ZoneEvent*> zoneList;
+        bool isStatic;
+        BackgroundJob job;
+    } m_textIndex;
+
+    struct {
+        bool show = false;
+        char pattern[1024] = {};
+        bool regex = false;
+        bool invalid = false;
+        std::vector<const ZoneEvent*> result;
+    } m_zoneText;
+
     struct {
         std::vector<int64_t> data;
         const FrameData* frameSet = nullptr;
@@ -843,7 +1177,7 @@ private:
     struct TimeDistribution {
         bool runningTime = false;
         bool exclusiveTime = true;
-        unordered_flat_map<int16_t, ZoneTimeData> data;
+        unordered_flat_map<int32_t, ZoneTimeData> data;
         const ZoneEvent* dataValidFor = nullptr;
         float fztime;
     } m_timeDist;
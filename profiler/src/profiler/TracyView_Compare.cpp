@@ -1,3 +1,4 @@
+#include <cmath>
 #include <numeric>
 #include <sstream>
 
@@ -51,6 +52,215 @@ extern double s_time;
             }
         }
     }
+
+static void UpdateCompareDist( CompareDist& dist, const Worker& worker, int mode, int idx )
+{
+    const auto size = mode == 0 ? worker.GetZonesForSourceLocation( idx ).zones.size() : worker.GetFrames()[idx]->frames.size();
+    if( dist.num == size ) return;
+
+    auto& vec = dist.sorted;
+    vec.reserve( size );
+    int64_t total = dist.total;
+    size_t i;
+    if( mode == 0 )
+    {
+        auto& zones = worker.GetZonesForSourceLocation( idx ).zones;
+        for( i=dist.num; i<size; i++ )
+        {
+            auto& zone = *zones[i].Zone();
+            const auto t = zone.End() - zone.Start();
+            vec.emplace_back( t );
+            total += t;
+        }
+    }
+    else
+    {
+        auto& frameSet = *worker.GetFrames()[idx];
+        for( i=dist.num; i<size; i++ )
+        {
+            if( worker.GetFrameEnd( frameSet, i ) == worker.GetLastTime() ) break;
+            const auto t = worker.GetFrameTime( frameSet, i );
+            vec.emplace_back( t );
+            total += t;
+        }
+    }
+    auto mid = vec.begin() + dist.num;
+    pdqsort_branchless( mid, vec.end() );
+    std::inplace_merge( vec.begin(), mid, vec.end() );
+
+    if( i != 0 )
+    {
+        dist.average = float( total ) / i;
+        dist.median = vec[i/2];
+    }
+    dist.total = total;
+    dist.num = i;
+}
+
+const CompareDist* View::GetCompareDist( int k, int idx )
+{
+    auto& worker = k == 0 ? m_worker : *m_compare.second;
+    const auto mode = m_compare.compareMode;
+    const auto key = ( uint64_t( mode ) << 32 ) | uint32_t( idx );
+    auto& map = m_compare.dist[k];
+
+    auto it = map.find( key );
+    if( it != map.end() )
+    {
+        auto& dist = *it->second;
+        if( !dist.ready.load( std::memory_order_acquire ) ) return nullptr;
+        if( !worker.IsDataStatic() ) UpdateCompareDist( dist, worker, mode, idx );
+        return &dist;
+    }
+
+    if( map.size() >= m_compare.DistCacheSize )
+    {
+        it = map.begin();
+        while( it != map.end() )
+        {
+            if( it->second->ready.load( std::memory_order_acquire ) )
+            {
+                it = map.erase( it );
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    auto dist = std::make_shared<CompareDist>();
+    map.emplace( key, dist );
+    if( mode == 0 ) worker.GetZonesForSourceLocation( idx ).zones.ensure_sorted();
+    if( !worker.IsDataStatic() )
+    {
+        UpdateCompareDist( *dist, worker, mode, idx );
+        dist->ready.store( true, std::memory_order_relaxed );
+        return dist.get();
+    }
+
+    // The distribution is shown as soon as it is ready, so it goes ahead of the diff medians.
+    if( !m_compare.tasks ) m_compare.tasks = std::make_unique<TaskGroup>( GetTaskDispatch(), TaskDispatch::Priority::Low );
+    m_compare.tasks->Queue( [dist, &worker, mode, idx] {
+        UpdateCompareDist( *dist, worker, mode, idx );
+        dist->ready.store( true, std::memory_order_release );
+    }, TaskDispatch::Priority::High );
+    return nullptr;
+}
+
+static std::string CompareSrcLocKey( const Worker& worker, const SourceLocation& srcloc )
+{
+    std::string ret = worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function );
+    ret += '\0';
+    ret += worker.GetString( srcloc.file );
+    return ret;
+}
+
+void View::CalcCompareDiffAll()
+{
+    m_compare.diffAllDone = true;
+    m_compare.diffAll.clear();
+
+    // Source locations are matched by name and file. Line numbers break ties.
+    unordered_flat_map<std::string, std::vector<int32_t>> groups[2];
+    for( int k=0; k<2; k++ )
+    {
+        auto& worker = k == 0 ? m_worker : *m_compare.second;
+        for( auto& v : worker.GetSourceLocationZones() )
+        {
+            if( v.second.zones.empty() ) continue;
+            groups[k][CompareSrcLocKey( worker, worker.GetSourceLocation( v.first ) )].emplace_back( v.first );
+        }
+    }
+
+    auto& diffAll = m_compare.diffAll;
+    for( auto& g0 : groups[0] )
+    {
+        auto it = groups[1].find( g0.first );
+        if( it == groups[1].end() ) continue;
+        auto& g1 = it->second;
+        if( g0.second.size() == 1 && g1.size() == 1 )
+        {
+            diffAll.emplace_back( CompareSrcLocDiff { { g0.second[0], g1[0] } } );
+        }
+        else
+        {
+            for( auto s0 : g0.second )
+            {
+                const auto line = m_worker.GetSourceLocation( s0 ).line;
+                auto s1 = std::find_if( g1.begin(), g1.end(), [this, line] ( const auto& v ) { return m_compare.second->GetSourceLocation( v ).line == line; } );
+                if( s1 != g1.end() ) diffAll.emplace_back( CompareSrcLocDiff { { s0, *s1 } } );
+            }
+        }
+    }
+
+    size_t zonesTotal = 0;
+    for( auto& v : diffAll )
+    {
+        for( int k=0; k<2; k++ )
+        {
+            auto& worker = k == 0 ? m_worker : *m_compare.second;
+            auto& zoneData = worker.GetZonesForSourceLocation( v.srcloc[k] );
+            const auto sz = zoneData.zones.size();
+            const auto avg = double( zoneData.total ) / sz;
+            const auto ss = zoneData.sumSq - 2. * zoneData.total * avg + avg * avg * sz;
+            v.count[k] = sz;
+            v.mean[k] = avg;
+            v.sd[k] = sz > 1 ? sqrt( std::max( 0., ss / ( sz - 1 ) ) ) : 0;
+            v.median[k] = -1;
+            zonesTotal += sz;
+        }
+        const auto se = v.sd[0] * v.sd[0] / v.count[0] + v.sd[1] * v.sd[1] / v.count[1];
+        v.t = se > 0 ? ( v.mean[1] - v.mean[0] ) / sqrt( se ) : 0;
+    }
+    pdqsort_branchless( diffAll.begin(), diffAll.end(), []( const auto& lhs, const auto& rhs ) { return fabs( lhs.t ) > fabs( rhs.t ); } );
+
+    // Medians need all zone times. Zones of a live capture can't be read outside of the data lock.
+    if( diffAll.empty() || !m_worker.IsDataStatic() ) return;
+
+    for( auto& v : diffAll )
+    {
+        m_worker.GetZonesForSourceLocation( v.srcloc[0] ).zones.ensure_sorted();
+        m_compare.second->GetZonesForSourceLocation( v.srcloc[1] ).zones.ensure_sorted();
+    }
+
+    const auto workers = std::max<int>( 1, std::thread::hardware_concurrency() - 1 );
+    if( !m_compare.tasks ) m_compare.tasks = std::make_unique<TaskGroup>( GetTaskDispatch(), TaskDispatch::Priority::Low );
+    m_compare.diffAllJobs = diffAll.size();
+
+    const auto batchSize = std::max<size_t>( 64 * 1024, zonesTotal / ( workers * 8 ) );
+    size_t i = 0;
+    while( i < diffAll.size() )
+    {
+        const auto begin = i;
+        size_t batch = 0;
+        while( i < diffAll.size() && batch < batchSize )
+        {
+            batch += diffAll[i].count[0] + diffAll[i].count[1];
+            i++;
+        }
+        m_compare.tasks->Queue( [this, begin, end = i] {
+            std::vector<int64_t> times;
+            for( size_t j=begin; j<end; j++ )
+            {
+                if( m_compare.tasks->IsCancelled() ) return;
+                auto& v = m_compare.diffAll[j];
+                for( int k=0; k<2; k++ )
+                {
+                    const auto& worker = k == 0 ? m_worker : *m_compare.second;
+                    auto& zones = worker.GetZonesForSourceLocation( v.srcloc[k] ).zones;
+                    times.clear();
+                    times.reserve( zones.size() );
+                    for( auto& zone : zones ) times.emplace_back( zone.Zone()->End() - zone.Zone()->Start() );
+                    auto mid = times.begin() + times.size() / 2;
+                    std::nth_element( times.begin(), mid, times.end() );
+                    v.median[k] = *mid;
+                }
+            }
+            m_compare.diffAllMedians.fetch_add( end - begin, std::memory_order_release );
+        } );
+    }
+}
 #endif
 
 bool View::FindMatchingZone( int prev0, int prev1, int flags )
@@ -221,6 +431,118 @@ static void PrintSpeedupOrSlowdown( double time_this, double time_external, cons
     TextDisabledUnformatted(")");
 }
 
+#ifndef TRACY_NO_STATISTICS
+void View::DrawCompareDiffAll()
+{
+    if( !m_compare.diffAllDone ) CalcCompareDiffAll();
+
+    if( !m_worker.IsDataStatic() )
+    {
+        if( ImGui::Button( ICON_FA_ARROWS_ROTATE " Refresh" ) ) m_compare.Reset();
+        ImGui::SameLine();
+    }
+    TextFocused( "Matched source locations:", RealToString( m_compare.diffAll.size() ) );
+    ImGui::SameLine();
+    DrawHelpMarker( "Zones with the same name and source file in both traces, ordered by the significance of the mean time change. The p-value is the probability of seeing such a change if the mean time did not change (Welch's t-test). Click on a row to compare its histograms." );
+
+    const bool medians = m_compare.diffAllJobs != 0 && m_compare.diffAllMedians.load( std::memory_order_acquire ) == m_compare.diffAllJobs;
+    if( m_compare.diffAllJobs != 0 && !medians )
+    {
+        ImGui::SameLine();
+        ImGui::Spacing();
+        ImGui::SameLine();
+        TextDisabledUnformatted( "Calculating medians" );
+        ImGui::SameLine();
+        DrawWaitingDots( s_time );
+    }
+
+    if( m_compare.diffAll.empty() )
+    {
+        ImGui::TextUnformatted( "No matching source locations." );
+        return;
+    }
+
+    ImGui::Separator();
+    int select = -1;
+    if( ImGui::BeginTable( "##diffall", 7, ImGuiTableFlags_Resizable | ImGuiTableFlags_Hideable | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_ScrollY ) )
+    {
+        ImGui::TableSetupScrollFreeze( 0, 1 );
+        ImGui::TableSetupColumn( "Name", ImGuiTableColumnFlags_NoHide );
+        ImGui::TableSetupColumn( "Location" );
+        ImGui::TableSetupColumn( "Counts", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Mean time", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Median time", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Change", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "p-value", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableHeadersRow();
+
+        ImGuiListClipper clipper;
+        clipper.Begin( m_compare.diffAll.size() );
+        while( clipper.Step() )
+        {
+            for( int i=clipper.DisplayStart; i<clipper.DisplayEnd; i++ )
+            {
+                auto& v = m_compare.diffAll[i];
+                auto& srcloc = m_worker.GetSourceLocation( v.srcloc[0] );
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::PushID( i );
+                if( ImGui::Selectable( m_worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function ), false, ImGuiSelectableFlags_SpanAllColumns ) ) select = i;
+                ImGui::PopID();
+                ImGui::TableNextColumn();
+                TextDisabledUnformatted( LocationToString( m_worker.GetString( srcloc.file ), srcloc.line ) );
+                ImGui::TableNextColumn();
+                ImGui::Text( "%s / %s", RealToString( v.count[0] ), RealToString( v.count[1] ) );
+                ImGui::TableNextColumn();
+                ImGui::Text( "%s / %s", TimeToString( v.mean[0] ), TimeToString( v.mean[1] ) );
+                ImGui::TableNextColumn();
+                if( medians )
+                {
+                    ImGui::Text( "%s / %s", TimeToString( v.median[0] ), TimeToString( v.median[1] ) );
+                }
+                else
+                {
+                    TextDisabledUnformatted( "-" );
+                }
+                ImGui::TableNextColumn();
+                const auto change = v.mean[0] / v.mean[1] - 1;
+                ImGui::TextColored( change <= 0 ? ImVec4( 0.1f, 0.6f, 0.1f, 1.0f ) : ImVec4( 0.8f, 0.1f, 0.1f, 1.0f ), "%+.2f%%", change * 100 );
+                ImGui::TableNextColumn();
+                if( v.t == 0 )
+                {
+                    TextDisabledUnformatted( "-" );
+                }
+                else
+                {
+                    ImGui::Text( "%.3g", erfc( fabs( v.t ) / sqrt( 2. ) ) );
+                }
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    if( select >= 0 )
+    {
+        const auto srcloc0 = m_compare.diffAll[select].srcloc[0];
+        const auto srcloc1 = m_compare.diffAll[select].srcloc[1];
+        auto& srcloc = m_worker.GetSourceLocation( srcloc0 );
+        const auto name = m_worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function );
+        const auto len = std::min<size_t>( strlen( name ), sizeof( m_compare.pattern ) - 1 );
+        memcpy( m_compare.pattern, name, len );
+        m_compare.pattern[len] = '\0';
+        m_compare.compareMode = 0;
+        m_compare.Reset();
+        FindZonesCompare();
+        for( int k=0; k<2; k++ )
+        {
+            auto it = std::find( m_compare.match[k].begin(), m_compare.match[k].end(), k == 0 ? srcloc0 : srcloc1 );
+            if( it != m_compare.match[k].end() ) m_compare.selMatch[k] = int( it - m_compare.match[k].begin() );
+        }
+    }
+}
+#endif
+
 void View::DrawCompare()
 {
     const auto scale = GetScale();
@@ -320,6 +642,9 @@ void View::DrawCompare()
     if( ImGui::Button( ICON_FA_TRASH_CAN " Unload" ) )
     {
         m_compare.Reset();
+        m_compare.StopJobs();
+        m_compare.dist[0].clear();
+        m_compare.dist[1].clear();
         m_compare.second.reset();
         m_compare.userData.reset();
         ImGui::End();
@@ -336,6 +661,8 @@ void View::DrawCompare()
     ImGui::RadioButton( "Frames", &m_compare.compareMode, 1 );
     ImGui::SameLine();
     ImGui::RadioButton( "Source diff", &m_compare.compareMode, 2 );
+    ImGui::SameLine();
+    ImGui::RadioButton( "All zones", &m_compare.compareMode, 3 );
     if( oldMode != m_compare.compareMode )
     {
         m_compare.Reset();
@@ -486,6 +813,12 @@ void View::DrawCompare()
         }
         ImGui::EndChild();
     }
+    else if( m_compare.compareMode == 3 )
+    {
+        ImGui::Separator();
+        ImGui::BeginChild( "##compare" );
+        DrawCompareDiffAll();
+    }
     else
     {
         bool findClicked = false;
@@ -715,53 +1048,25 @@ void View::DrawCompare()
             size_t size0, size1;
             int64_t total0, total1;
             double sumSq0, sumSq1;
+            const CompareDist* dist[2];
 
             if( m_compare.compareMode == 0 )
             {
                 auto& zoneData0 = m_worker.GetZonesForSourceLocation( m_compare.match[0][m_compare.selMatch[0]] );
                 auto& zoneData1 = m_compare.second->GetZonesForSourceLocation( m_compare.match[1][m_compare.selMatch[1]] );
-                auto& zones0 = zoneData0.zones;
-                auto& zones1 = zoneData1.zones;
-                zones0.ensure_sorted();
-                zones1.ensure_sorted();
 
                 tmin = std::min( zoneData0.min, zoneData1.min );
                 tmax = std::max( zoneData0.max, zoneData1.max );
 
-                size0 = zones0.size();
-                size1 = zones1.size();
+                size0 = zoneData0.zones.size();
+                size1 = zoneData1.zones.size();
                 total0 = zoneData0.total;
                 total1 = zoneData1.total;
                 sumSq0 = zoneData0.sumSq;
                 sumSq1 = zoneData1.sumSq;
 
-                const size_t zsz[2] = { size0, size1 };
-                for( int k=0; k<2; k++ )
-                {
-                    if( m_compare.sortedNum[k] != zsz[k] )
-                    {
-                        auto& zones = k == 0 ? zones0 : zones1;
-                        auto& vec = m_compare.sorted[k];
-                        vec.reserve( zsz[k] );
-                        int64_t total = m_compare.total[k];
-                        size_t i;
-                        for( i=m_compare.sortedNum[k]; i<zsz[k]; i++ )
-                        {
-                            auto& zone = *zones[i].Zone();
-                            const auto t = zone.End() - zone.Start();
-                            vec.emplace_back( t );
-                            total += t;
-                        }
-                        auto mid = vec.begin() + m_compare.sortedNum[k];
-                        pdqsort_branchless( mid, vec.end() );
-                        std::inplace_merge( vec.begin(), mid, vec.end() );
-
-                        m_compare.average[k] = float( total ) / i;
-                        m_compare.median[k] = vec[i/2];
-                        m_compare.total[k] = total;
-                        m_compare.sortedNum[k] = i;
-                    }
-                }
+                dist[0] = GetCompareDist( 0, m_compare.match[0][m_compare.selMatch[0]] );
+                dist[1] = GetCompareDist( 1, m_compare.match[1][m_compare.selMatch[1]] );
             }
             else
             {
@@ -780,37 +1085,17 @@ void View::DrawCompare()
                 sumSq0 = f0->sumSq;
                 sumSq1 = f1->sumSq;
 
-                const size_t zsz[2] = { size0, size1 };
-                for( int k=0; k<2; k++ )
-                {
-                    if( m_compare.sortedNum[k] != zsz[k] )
-                    {
-                        auto& frameSet = k == 0 ? f0 : f1;
-                        auto worker = k == 0 ? &m_worker : m_compare.second.get();
-                        auto& vec = m_compare.sorted[k];
-                        vec.reserve( zsz[k] );
-                        int64_t total = m_compare.total[k];
-                        size_t i;
-                        for( i=m_compare.sortedNum[k]; i<zsz[k]; i++ )
-                        {
-                            if( worker->GetFrameEnd( *frameSet, i ) == worker->GetLastTime() ) break;
-                            const auto t = worker->GetFrameTime( *frameSet, i );
-                            vec.emplace_back( t );
-                            total += t;
-                        }
-                        auto mid = vec.begin() + m_compare.sortedNum[k];
-                        pdqsort_branchless( mid, vec.end() );
-                        std::inplace_merge( vec.begin(), mid, vec.end() );
-
-                        m_compare.average[k] = float( total ) / i;
-                        m_compare.median[k] = vec[i/2];
-                        m_compare.total[k] = total;
-                        m_compare.sortedNum[k] = i;
-                    }
-                }
+                dist[0] = GetCompareDist( 0, m_compare.selMatch[0] );
+                dist[1] = GetCompareDist( 1, m_compare.selMatch[1] );
             }
 
-            if( tmin != std::numeric_limits<int64_t>::max() )
+            if( !dist[0] || !dist[1] )
+            {
+                ImGui::TextUnformatted( "Calculating distributions" );
+                ImGui::SameLine();
+                DrawWaitingDots( s_time );
+            }
+            else if( tmin != std::numeric_limits<int64_t>::max() )
             {
                 TextDisabledUnformatted( "Minimum values in bin:" );
                 ImGui::SameLine();
@@ -848,14 +1133,12 @@ void View::DrawCompare()
                             m_compare.numBins = numBins;
                             m_compare.bins = std::make_unique<CompVal[]>( numBins );
                             m_compare.binTime = std::make_unique<CompVal[]>( numBins );
+                            m_compare.binKey = {};
                         }
 
                         const auto& bins = m_compare.bins;
                         const auto& binTime = m_compare.binTime;
 
-                        memset( bins.get(), 0, sizeof( CompVal ) * numBins );
-                        memset( binTime.get(), 0, sizeof( CompVal ) * numBins );
-
                         double adj0 = 1;
                         double adj1 = 1;
                         if( m_compare.normalize )
@@ -870,109 +1153,130 @@ void View::DrawCompare()
                             }
                         }
 
-                        const auto& sorted = m_compare.sorted;
-                        auto sBegin0 = sorted[0].begin();
-                        auto sBegin1 = sorted[1].begin();
-                        auto sEnd0 = sorted[0].end();
-                        auto sEnd1 = sorted[1].end();
-
-                        if( m_compare.minBinVal > 1 )
+                        CompareBinKey key;
+                        key.dist[0] = dist[0];
+                        key.dist[1] = dist[1];
+                        key.num[0] = dist[0]->sorted.size();
+                        key.num[1] = dist[1]->sorted.size();
+                        key.numBins = numBins;
+                        key.minBinVal = m_compare.minBinVal;
+                        key.logTime = m_compare.logTime;
+                        key.normalize = m_compare.normalize;
+                        if( !( key == m_compare.binKey ) )
                         {
+                            m_compare.binKey = key;
+
+                            memset( bins.get(), 0, sizeof( CompVal ) * numBins );
+                            memset( binTime.get(), 0, sizeof( CompVal ) * numBins );
+
+                            auto sBegin0 = dist[0]->sorted.begin();
+                            auto sBegin1 = dist[1]->sorted.begin();
+                            auto sEnd0 = dist[0]->sorted.end();
+                            auto sEnd1 = dist[1]->sorted.end();
+
+                            if( m_compare.minBinVal > 1 )
+                            {
+                                if( m_compare.logTime )
+                                {
+                                    const auto tMinLog = log10( tmin );
+                                    const auto zmax = ( log10( tmax ) - tMinLog ) / numBins;
+                                    int64_t i;
+                                    for( i=0; i<numBins; i++ )
+                                    {
+                                        const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( i+1 ) * zmax ) );
+                                        auto nit0 = std::lower_bound( sBegin0, sEnd0, nextBinVal );
+                                        auto nit1 = std::lower_bound( sBegin1, sEnd1, nextBinVal );
+                                        const auto distance0 = std::distance( sBegin0, nit0 );
+                                        const auto distance1 = std::distance( sBegin1, nit1 );
+                                        if( distance0 >= m_compare.minBinVal || distance1 >= m_compare.minBinVal ) break;
+                                        sBegin0 = nit0;
+                                        sBegin1 = nit1;
+                                    }
+                                    for( int64_t j=numBins-1; j>i; j-- )
+                                    {
+                                        const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( j-1 ) * zmax ) );
+                                        auto nit0 = std::lower_bound( sBegin0, sEnd0, nextBinVal );
+                                        auto nit1 = std::lower_bound( sBegin1, sEnd1, nextBinVal );
+                                        const auto distance0 = std::distance( nit0, sEnd0 );
+                                        const auto distance1 = std::distance( nit1, sEnd1 );
+                                        if( distance0 >= m_compare.minBinVal || distance1 >= m_compare.minBinVal ) break;
+                                        sEnd0 = nit0;
+                                        sEnd1 = nit1;
+                                    }
+                                }
+                                else
+                                {
+                                    const auto zmax = tmax - tmin;
+                                    int64_t i;
+                                    for( i=0; i<numBins; i++ )
+                                    {
+                                        const auto nextBinVal = tmin + ( i+1 ) * zmax / numBins;
+                                        auto nit0 = std::lower_bound( sBegin0, sEnd0, nextBinVal );
+                                        auto nit1 = std::lower_bound( sBegin1, sEnd1, nextBinVal );
+                                        const auto distance0 = std::distance( sBegin0, nit0 );
+                                        const auto distance1 = std::distance( sBegin1, nit1 );
+                                        if( distance0 >= m_compare.minBinVal || distance1 >= m_compare.minBinVal ) break;
+                                        sBegin0 = nit0;
+                                        sBegin1 = nit1;
+                                    }
+                                    for( int64_t j=numBins-1; j>i; j-- )
+                                    {
+                                        const auto nextBinVal = tmin + ( j-1 ) * zmax / numBins;
+                                        auto nit0 = std::lower_bound( sBegin0, sEnd0, nextBinVal );
+                                        auto nit1 = std::lower_bound( sBegin1, sEnd1, nextBinVal );
+                                        const auto distance0 = std::distance( nit0, sEnd0 );
+                                        const auto distance1 = std::distance( nit1, sEnd1 );
+                                        if( distance0 >= m_compare.minBinVal || distance1 >= m_compare.minBinVal ) break;
+                                        sEnd0 = nit0;
+                                        sEnd1 = nit1;
+                                    }
+                                }
+
+                                tmin = std::min( *sBegin0, *sBegin1 );
+                                tmax = std::max( *(sEnd0-1), *(sEnd1-1) );
+                            }
+
+                            auto zit0 = sBegin0;
+                            auto zit1 = sBegin1;
                             if( m_compare.logTime )
                             {
                                 const auto tMinLog = log10( tmin );
                                 const auto zmax = ( log10( tmax ) - tMinLog ) / numBins;
-                                int64_t i;
-                                for( i=0; i<numBins; i++ )
+                                for( int64_t i=0; i<numBins; i++ )
                                 {
                                     const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( i+1 ) * zmax ) );
-                                    auto nit0 = std::lower_bound( sBegin0, sEnd0, nextBinVal );
-                                    auto nit1 = std::lower_bound( sBegin1, sEnd1, nextBinVal );
-                                    const auto distance0 = std::distance( sBegin0, nit0 );
-                                    const auto distance1 = std::distance( sBegin1, nit1 );
-                                    if( distance0 >= m_compare.minBinVal || distance1 >= m_compare.minBinVal ) break;
-                                    sBegin0 = nit0;
-                                    sBegin1 = nit1;
-                                }
-                                for( int64_t j=numBins-1; j>i; j-- )
-                                {
-                                    const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( j-1 ) * zmax ) );
-                                    auto nit0 = std::lower_bound( sBegin0, sEnd0, nextBinVal );
-                                    auto nit1 = std::lower_bound( sBegin1, sEnd1, nextBinVal );
-                                    const auto distance0 = std::distance( nit0, sEnd0 );
-                                    const auto distance1 = std::distance( nit1, sEnd1 );
-                                    if( distance0 >= m_compare.minBinVal || distance1 >= m_compare.minBinVal ) break;
-                                    sEnd0 = nit0;
-                                    sEnd1 = nit1;
+                                    auto nit0 = std::lower_bound( zit0, sEnd0, nextBinVal );
+                                    auto nit1 = std::lower_bound( zit1, sEnd1, nextBinVal );
+                                    bins[i].v0 += adj0 * std::distance( zit0, nit0 );
+                                    bins[i].v1 += adj1 * std::distance( zit1, nit1 );
+                                    binTime[i].v0 += adj0 * std::accumulate( zit0, nit0, int64_t( 0 ) );
+                                    binTime[i].v1 += adj1 * std::accumulate( zit1, nit1, int64_t( 0 ) );
+                                    zit0 = nit0;
+                                    zit1 = nit1;
                                 }
                             }
                             else
                             {
                                 const auto zmax = tmax - tmin;
-                                int64_t i;
-                                for( i=0; i<numBins; i++ )
+                                for( int64_t i=0; i<numBins; i++ )
                                 {
                                     const auto nextBinVal = tmin + ( i+1 ) * zmax / numBins;
-                                    auto nit0 = std::lower_bound( sBegin0, sEnd0, nextBinVal );
-                                    auto nit1 = std::lower_bound( sBegin1, sEnd1, nextBinVal );
-                                    const auto distance0 = std::distance( sBegin0, nit0 );
-                                    const auto distance1 = std::distance( sBegin1, nit1 );
-                                    if( distance0 >= m_compare.minBinVal || distance1 >= m_compare.minBinVal ) break;
-                                    sBegin0 = nit0;
-                                    sBegin1 = nit1;
-                                }
-                                for( int64_t j=numBins-1; j>i; j-- )
-                                {
-                                    const auto nextBinVal = tmin + ( j-1 ) * zmax / numBins;
-                                    auto nit0 = std::lower_bound( sBegin0, sEnd0, nextBinVal );
-                                    auto nit1 = std::lower_bound( sBegin1, sEnd1, nextBinVal );
-                                    const auto distance0 = std::distance( nit0, sEnd0 );
-                                    const auto distance1 = std::distance( nit1, sEnd1 );
-                                    if( distance0 >= m_compare.minBinVal || distance1 >= m_compare.minBinVal ) break;
-                                    sEnd0 = nit0;
-                                    sEnd1 = nit1;
+                                    auto nit0 = std::lower_bound( zit0, sEnd0, nextBinVal );
+                                    auto nit1 = std::lower_bound( zit1, sEnd1, nextBinVal );
+                                    bins[i].v0 += adj0 * std::distance( zit0, nit0 );
+                                    bins[i].v1 += adj1 * std::distance( zit1, nit1 );
+                                    binTime[i].v0 += adj0 * std::accumulate( zit0, nit0, int64_t( 0 ) );
+                                    binTime[i].v1 += adj1 * std::accumulate( zit1, nit1, int64_t( 0 ) );
+                                    zit0 = nit0;
+                                    zit1 = nit1;
                                 }
                             }
 
-                            tmin = std::min( *sBegin0, *sBegin1 );
-                            tmax = std::max( *(sEnd0-1), *(sEnd1-1) );
-                        }
-
-                        auto zit0 = sBegin0;
-                        auto zit1 = sBegin1;
-                        if( m_compare.logTime )
-                        {
-                            const auto tMinLog = log10( tmin );
-                            const auto zmax = ( log10( tmax ) - tMinLog ) / numBins;
-                            for( int64_t i=0; i<numBins; i++ )
-                            {
-                                const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( i+1 ) * zmax ) );
-                                auto nit0 = std::lower_bound( zit0, sEnd0, nextBinVal );
-                                auto nit1 = std::lower_bound( zit1, sEnd1, nextBinVal );
-                                bins[i].v0 += adj0 * std::distance( zit0, nit0 );
-                                bins[i].v1 += adj1 * std::distance( zit1, nit1 );
-                                binTime[i].v0 += adj0 * std::accumulate( zit0, nit0, int64_t( 0 ) );
-                                binTime[i].v1 += adj1 * std::accumulate( zit1, nit1, int64_t( 0 ) );
-                                zit0 = nit0;
-                                zit1 = nit1;
-                            }
-                        }
-                        else
-                        {
-                            const auto zmax = tmax - tmin;
-                            for( int64_t i=0; i<numBins; i++ )
-                            {
-                                const auto nextBinVal = tmin + ( i+1 ) * zmax / numBins;
-                                auto nit0 = std::lower_bound( zit0, sEnd0, nextBinVal );
-                                auto nit1 = std::lower_bound( zit1, sEnd1, nextBinVal );
-                                bins[i].v0 += adj0 * std::distance( zit0, nit0 );
-                                bins[i].v1 += adj1 * std::distance( zit1, nit1 );
-                                binTime[i].v0 += adj0 * std::accumulate( zit0, nit0, int64_t( 0 ) );
-                                binTime[i].v1 += adj1 * std::accumulate( zit1, nit1, int64_t( 0 ) );
-                                zit0 = nit0;
-                                zit1 = nit1;
-                            }
+                            m_compare.binMin = tmin;
+                            m_compare.binMax = tmax;
                         }
+                        tmin = m_compare.binMin;
+                        tmax = m_compare.binMax;
 
                         double maxVal;
                         if( cumulateTime )
@@ -1008,17 +1312,17 @@ void View::DrawCompare()
 
                         TextColoredUnformatted( ImVec4( 0xDD/511.f, 0xDD/511.f, 0x22/511.f, 1.f ), ICON_FA_LEMON );
                         ImGui::SameLine();
-                        TextFocused( "Mean time (this):", TimeToString( m_compare.average[0] ) );
+                        TextFocused( "Mean time (this):", TimeToString( dist[0]->average ) );
                         ImGui::SameLine();
                         ImGui::Spacing();
                         ImGui::SameLine();
                         TextColoredUnformatted( ImVec4( 0xDD/511.f, 0xDD/511.f, 0x22/511.f, 1.f ), ICON_FA_LEMON );
                         ImGui::SameLine();
-                        TextFocused( "Median time (this):", TimeToString( m_compare.median[0] ) );
-                        if( sorted[0].size() > 1 )
+                        TextFocused( "Median time (this):", TimeToString( dist[0]->median ) );
+                        if( dist[0]->sorted.size() > 1 )
                         {
-                            const auto sz = sorted[0].size();
-                            const auto avg = m_compare.average[0];
+                            const auto sz = dist[0]->sorted.size();
+                            const auto avg = dist[0]->average;
                             const auto ss = sumSq0 - 2. * total0 * avg + avg * avg * sz;
                             const auto sd = sqrt( ss / ( sz - 1 ) );
 
@@ -1034,17 +1338,17 @@ void View::DrawCompare()
 
                         TextColoredUnformatted( ImVec4( 0xDD/511.f, 0x22/511.f, 0x22/511.f, 1.f ), ICON_FA_GEM );
                         ImGui::SameLine();
-                        TextFocused( "Mean time (ext.):", TimeToString( m_compare.average[1] ) );
+                        TextFocused( "Mean time (ext.):", TimeToString( dist[1]->average ) );
                         ImGui::SameLine();
                         ImGui::Spacing();
                         ImGui::SameLine();
                         TextColoredUnformatted( ImVec4( 0xDD/511.f, 0x22/511.f, 0x22/511.f, 1.f ), ICON_FA_GEM );
                         ImGui::SameLine();
-                        TextFocused( "Median time (ext.):", TimeToString( m_compare.median[1] ) );
-                        if( sorted[1].size() > 1 )
+                        TextFocused( "Median time (ext.):", TimeToString( dist[1]->median ) );
+                        if( dist[1]->sorted.size() > 1 )
                         {
-                            const auto sz = sorted[1].size();
-                            const auto avg = m_compare.average[1];
+                            const auto sz = dist[1]->sorted.size();
+                            const auto avg = dist[1]->average;
                             const auto ss = sumSq1 - 2. * total1 * avg + avg * avg * sz;
                             const auto sd = sqrt( ss / ( sz - 1 ) );
 
@@ -1057,8 +1361,8 @@ void View::DrawCompare()
                             TooltipIfHovered( "Standard deviation" );
                         }
                         ImGui::Indent();
-                        PrintSpeedupOrSlowdown( m_compare.average[0], m_compare.average[1], "Mean time" );
-                        PrintSpeedupOrSlowdown( m_compare.median[0], m_compare.median[1], "Median time" );
+                        PrintSpeedupOrSlowdown( dist[0]->average, dist[1]->average, "Mean time" );
+                        PrintSpeedupOrSlowdown( dist[0]->median, dist[1]->median, "Median time" );
                         ImGui::Unindent();
 
                         ImGui::PushStyleColor( ImGuiCol_Text, ImVec4( 0xDD/511.f, 0xDD/511.f, 0x22/511.f, 1.f ) );
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <numeric>
 
 #include "imgui.h"
@@ -60,7 +61,7 @@ uint64_t View::GetSelectionTarget( const Worker::ZoneThreadData& ev, FindZone::G
     case FindZone::GroupBy::Parent:
     {
         const auto parent = GetZoneParent( *ev.Zone(), m_worker.DecompressThread( ev.Thread() ) );
-        return parent ? uint64_t( parent->SrcLoc() ) : 0;
+        return parent ? uint64_t( uint32_t( m_worker.GetZoneSrcLoc( *parent ) ) ) : 0;
     }
     case FindZone::GroupBy::NoGrouping:
         return 0;
@@ -70,6 +71,571 @@ uint64_t View::GetSelectionTarget( const Worker::ZoneThreadData& ev, FindZone::G
     }
 }
 
+// Every FindZoneSumStep-th prefix sum of a sorted duration vector is kept, so that the time
+// spent in a histogram bin can be calculated without walking over all the values in it.
+enum { FindZoneSumStep = 256 };
+
+static void CalcFindZoneSums( const Vector<int64_t>& vec, Vector<int64_t>& sums )
+{
+    const auto sz = vec.size() / FindZoneSumStep + 1;
+    sums.reserve_and_use( sz );
+    int64_t sum = 0;
+    auto ptr = vec.data();
+    sums[0] = 0;
+    for( size_t i=1; i<sz; i++ )
+    {
+        for( int j=0; j<FindZoneSumStep; j++ ) sum += *ptr++;
+        sums[i] = sum;
+    }
+}
+
+static int64_t GetFindZonePrefixSum( const Vector<int64_t>& vec, const Vector<int64_t>& sums, size_t idx )
+{
+    if( idx == 0 ) return 0;
+    const auto block = idx / FindZoneSumStep;
+    int64_t sum = sums[block];
+    for( size_t i=block*FindZoneSumStep; i<idx; i++ ) sum += vec[i];
+    return sum;
+}
+
+static int64_t GetFindZoneSum( const Vector<int64_t>& vec, const Vector<int64_t>& sums, const int64_t* begin, const int64_t* end )
+{
+    return GetFindZonePrefixSum( vec, sums, end - vec.data() ) - GetFindZonePrefixSum( vec, sums, begin - vec.data() );
+}
+
+static void SortFindZoneChunk( Vector<int64_t>& chunk )
+{
+#ifdef NO_PARALLEL_SORT
+    pdqsort_branchless( chunk.begin(), chunk.end() );
+#else
+    std::sort( std::execution::par_unseq, chunk.begin(), chunk.end() );
+#endif
+}
+
+static void MergeFindZoneChunk( const Vector<int64_t>& vec, const Vector<int64_t>& chunk, Vector<int64_t>& out )
+{
+    out.reserve_and_use( vec.size() + chunk.size() );
+    std::merge( vec.begin(), vec.end(), chunk.begin(), chunk.end(), out.begin() );
+}
+
+// A live capture job is only shown as busy when it falls behind by more zones than this.
+enum { FindZoneLiveBacklog = 64 * 1024 };
+
+static void GetFindZoneCtxSwitch( Worker& worker, unordered_flat_map<uint64_t, const ContextSwitch*>& ctxSwitch )
+{
+    // Context switch lookups go through a cache in the worker, so they need the worker data lock.
+    ctxSwitch.clear();
+    for( auto& td : worker.GetThreadData() )
+    {
+        auto ctx = worker.GetContextSwitchData( td->id );
+        if( ctx ) ctxSwitch.emplace( td->id, ctx );
+    }
+}
+
+// Runs the Find Zone job. With a live capture the job keeps running and every pass picks up
+// the zones which arrived since the previous one.
+void View::FindZoneJob( bool isStatic )
+{
+    auto& fz = m_findZone;
+    if( isStatic )
+    {
+        FindZoneProcess( fz.jobParams, nullptr );
+        FindZoneBins();
+        return;
+    }
+
+    auto params = fz.jobParams;
+    for(;;)
+    {
+        std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+        if( !fz.job.Lock( lock ) ) return;
+        auto& zoneData = m_worker.GetZonesForSourceLocation( params.srcloc );
+        auto& zones = zoneData.zones;
+        if( fz.jobSize != zones.size() )
+        {
+            zones.ensure_sorted();
+            params.zones = zones.data();
+            params.zsz = zones.size();
+            params.tmin = params.selfTime ? zoneData.selfMin : zoneData.min;
+            params.tmax = params.selfTime ? zoneData.selfMax : zoneData.max;
+            if( params.runningTime ) GetFindZoneCtxSwitch( m_worker, params.ctxSwitch );
+            FindZoneProcess( params, &lock );
+        }
+        if( lock.owns_lock() ) lock.unlock();
+        if( fz.job.IsStopping() ) return;
+        FindZoneBins();
+        if( !fz.job.Wait( 50 ) ) return;
+    }
+}
+
+// Fills the Find Zone results for the zones that were not processed yet. The results are
+// published in increasingly large chunks under jobLock, so that the UI thread can draw a
+// progressively refined histogram. With a live capture the caller passes in the worker data
+// lock, which is only held while the zones are read.
+void View::FindZoneProcess( const FindZone::JobParams& params, std::unique_lock<std::mutex>* dataLock )
+{
+    auto& fz = m_findZone;
+    auto zones = params.zones;
+    const auto zsz = params.zsz;
+
+    // The UI thread holds the locks while it draws and may wait for this job to stop.
+    auto lock = [&fz] {
+        return fz.job.Lock( fz.jobLock );
+    };
+    auto unlock = [&fz] {
+        fz.jobLock.unlock();
+    };
+    auto stop = [&fz] {
+        return fz.job.IsStopping();
+    };
+    auto release = [dataLock] {
+        if( dataLock ) dataLock->unlock();
+    };
+    // The zones vector may be reallocated while the data lock is released. Zones are only ever
+    // appended, so the indices stay valid.
+    auto acquire = [this, &fz, &params, &zones, dataLock] {
+        if( !dataLock ) return true;
+        if( !fz.job.Lock( *dataLock ) ) return false;
+        zones = m_worker.GetZonesForSourceLocation( params.srcloc ).zones.data();
+        return true;
+    };
+    auto yield = [&] {
+        if( !dataLock ) return true;
+        release();
+        return acquire();
+    };
+    auto inRange = [&params] ( const ZoneEvent& zone ) {
+        return !params.rangeActive || ( zone.Start() >= params.rangeMin && zone.End() <= params.rangeMax );
+    };
+    auto getTime = [this, &params] ( const Worker::ZoneThreadData& ev, int64_t& t ) {
+        const auto& zone = *ev.Zone();
+        if( params.runningTime )
+        {
+            auto it = params.ctxSwitch.find( m_worker.DecompressThread( ev.Thread() ) );
+            if( it == params.ctxSwitch.end() ) return false;
+            uint64_t cnt;
+            return GetZoneRunningTime( it->second, zone, t, cnt );
+        }
+        t = zone.End() - zone.Start();
+        if( params.selfTime ) t -= GetZoneChildTimeFast( zone );
+        return true;
+    };
+
+    // The zones are sorted by start time, so with a range limit only the ones starting inside of
+    // it have to be visited. skip() moves an index past the zones which start outside of it.
+    size_t rangeBegin = 0;
+    size_t rangeEnd = zsz;
+    if( params.rangeActive )
+    {
+        rangeBegin = std::lower_bound( zones, zones + zsz, params.rangeMin, [] ( const auto& l, const auto& r ) { return l.Zone()->Start() < r; } ) - zones;
+        rangeEnd = std::upper_bound( zones + rangeBegin, zones + zsz, params.rangeMax, [] ( const auto& l, const auto& r ) { return l < r.Zone()->Start(); } ) - zones;
+    }
+    auto skip = [rangeBegin, rangeEnd] ( size_t i, size_t end ) {
+        return std::min( i < rangeBegin ? rangeBegin : ( i < rangeEnd ? i : end ), end );
+    };
+
+    // Chunks grow with the amount of data already processed, which keeps the cost of merging
+    // them into the sorted results linear in the total.
+    constexpr size_t MinChunk = 1024 * 1024;
+    constexpr size_t StopCheck = 64 * 1024;
+    bool complete = true;
+
+    if( fz.sortedNum != zsz )
+    {
+        int64_t total = fz.total;
+        int64_t tmin = fz.tmin;
+        int64_t tmax = fz.tmax;
+        if( !params.runningTime )
+        {
+            tmin = params.tmin;
+            tmax = params.tmax;
+        }
+
+        size_t i = fz.sortedNum;
+        Vector<int64_t> chunk, merged, sums;
+        while( complete && i < zsz )
+        {
+            i = skip( i, zsz );
+            const auto chunkEnd = std::min( std::min( zsz, i + std::max( MinChunk, i ) ), std::max( i, rangeEnd ) );
+            chunk.clear();
+            chunk.reserve( chunkEnd - i );
+            for( ; i<chunkEnd; i++ )
+            {
+                if( ( i % StopCheck ) == 0 && ( stop() || !yield() ) ) return;
+                auto& ev = zones[i];
+                if( !inRange( *ev.Zone() ) ) continue;
+                int64_t t;
+                if( !getTime( ev, t ) )
+                {
+                    complete = false;
+                    break;
+                }
+                chunk.push_back_no_space_check( t );
+                total += t;
+                if( params.runningTime )
+                {
+                    if( t < tmin ) tmin = t;
+                    if( t > tmax ) tmax = t;
+                }
+            }
+            release();
+            SortFindZoneChunk( chunk );
+            MergeFindZoneChunk( fz.sorted, chunk, merged );
+            CalcFindZoneSums( merged, sums );
+            if( stop() || !lock() ) return;
+            fz.sorted.swap( merged );
+            fz.sortedSums.swap( sums );
+            fz.sortedNum = i;
+            const auto vsz = fz.sorted.size();
+            if( vsz != 0 )
+            {
+                fz.average = float( total ) / vsz;
+                fz.median = fz.sorted[vsz/2];
+                fz.total = total;
+                fz.tmin = tmin;
+                fz.tmax = tmax;
+            }
+            fz.binsDirty = true;
+            unlock();
+            FindZoneBins();
+            if( !acquire() ) return;
+        }
+    }
+
+    if( fz.processed != fz.sortedNum )
+    {
+        struct LocalGroup
+        {
+            Vector<short_ptr<ZoneEvent>> zones;
+            Vector<uint16_t> zonesTids;
+            int64_t time = 0;
+        };
+
+        const auto procEnd = fz.sortedNum;
+        size_t i = fz.processed;
+        while( i < procEnd )
+        {
+            i = skip( i, procEnd );
+            const auto chunkEnd = std::min( std::min( procEnd, i + MinChunk ), std::max( i, rangeEnd ) );
+            unordered_flat_map<uint64_t, uint32_t> groupMap;
+            std::vector<std::pair<uint64_t, LocalGroup>> groups;
+            constexpr uint64_t invalidGid = std::numeric_limits<uint64_t>::max() - 1;
+            uint64_t lastGid = invalidGid;
+            LocalGroup* group = nullptr;
+            for( ; i<chunkEnd; i++ )
+            {
+                if( ( i % StopCheck ) == 0 && ( stop() || !yield() ) ) return;
+                auto& ev = zones[i];
+                if( !inRange( *ev.Zone() ) ) continue;
+                if( params.textFilter.IsActive() )
+                {
+                    bool keep = false;
+                    if( m_worker.HasZoneExtra( *ev.Zone() ) && m_worker.GetZoneExtra( *ev.Zone() ).text.Active() )
+                    {
+                        auto text = m_worker.GetString( m_worker.GetZoneExtra( *ev.Zone() ).text );
+                        keep = params.textFilter.PassFilter( text );
+                    }
+                    if( !keep )
+                    {
+                        // Only this job writes to the set while it runs; the UI thread stops it before clearing.
+                        m_filteredZones.insert( &ev );
+                        continue;
+                    }
+                }
+                int64_t timespan;
+                if( !getTime( ev, timespan ) )
+                {
+                    complete = false;
+                    break;
+                }
+                if( params.highlightActive && ( timespan < params.hmin || timespan > params.hmax ) ) continue;
+
+                const auto gid = GetSelectionTarget( ev, params.groupBy );
+                if( lastGid != gid )
+                {
+                    lastGid = gid;
+                    auto it = groupMap.find( gid );
+                    if( it == groupMap.end() )
+                    {
+                        it = groupMap.emplace( gid, uint32_t( groups.size() ) ).first;
+                        groups.emplace_back( gid, LocalGroup {} );
+                    }
+                    group = &groups[it->second].second;
+                }
+                group->time += timespan;
+                group->zones.push_back( ev.Zone() );
+                if( params.samples ) group->zonesTids.push_back( ev.Thread() );
+            }
+            release();
+            if( !lock() ) return;
+            for( auto& v : groups )
+            {
+                auto it = fz.groups.find( v.first );
+                if( it == fz.groups.end() ) it = fz.groups.emplace( v.first, FindZone::Group { fz.groupId++ } ).first;
+                auto& dst = it->second;
+                dst.time += v.second.time;
+                dst.zones.insert( dst.zones.end(), v.second.zones.begin(), v.second.zones.end() );
+                dst.zonesTids.insert( dst.zonesTids.end(), v.second.zonesTids.begin(), v.second.zonesTids.end() );
+            }
+            fz.processed = i;
+            if( params.samples && !groups.empty() ) fz.samples.scheduleUpdate = true;
+            unlock();
+            if( !acquire() ) return;
+            if( !complete ) break;
+        }
+    }
+
+    if( params.selGroup != FindZone::Unselected && fz.selSortNum != fz.sortedNum )
+    {
+        int64_t total = fz.selTotal;
+        auto act = fz.selSortActive;
+        const auto selEnd = fz.sortedNum;
+        size_t i = fz.selSortNum;
+        Vector<int64_t> chunk, merged, sums;
+        while( i < selEnd )
+        {
+            i = skip( i, selEnd );
+            const auto chunkEnd = std::min( std::min( selEnd, i + std::max( MinChunk, i ) ), std::max( i, rangeEnd ) );
+            chunk.clear();
+            for( ; i<chunkEnd; i++ )
+            {
+                if( ( i % StopCheck ) == 0 && ( stop() || !yield() ) ) return;
+                auto& ev = zones[i];
+                if( !inRange( *ev.Zone() ) ) continue;
+                if( m_filteredZones.contains( &ev ) ) continue;
+                if( params.selGroup != GetSelectionTarget( ev, params.groupBy ) ) continue;
+                int64_t t;
+                if( !getTime( ev, t ) ) continue;
+                chunk.push_back( t );
+                act++;
+                total += t;
+            }
+            release();
+            SortFindZoneChunk( chunk );
+            MergeFindZoneChunk( fz.selSort, chunk, merged );
+            CalcFindZoneSums( merged, sums );
+            if( stop() || !lock() ) return;
+            fz.selSort.swap( merged );
+            fz.selSortSums.swap( sums );
+            fz.selSortNum = i;
+            if( act != 0 )
+            {
+                fz.selAverage = float( total ) / act;
+                fz.selMedian = fz.selSort[act/2];
+                fz.selTotal = total;
+                fz.selSortActive = act;
+            }
+            fz.binsDirty = true;
+            unlock();
+            FindZoneBins();
+            if( !acquire() ) return;
+        }
+    }
+
+    if( complete )
+    {
+        if( !lock() ) return;
+        fz.jobSize = zsz;
+        unlock();
+    }
+}
+
+// Bins the histogram with the parameters last requested by the UI thread. Only the job writes
+// the sorted results while it runs, so they can be read here without holding jobLock.
+void View::FindZoneBins()
+{
+    auto& fz = m_findZone;
+    if( !fz.job.Lock( fz.jobLock ) ) return;
+    const auto p = fz.binParams;
+    const bool dirty = fz.binsDirty || fz.binCache.params != p;
+    fz.jobLock.unlock();
+    if( !dirty ) return;
+
+    const auto numBins = p.numBins;
+    int64_t tmin = fz.tmin;
+    int64_t tmax = fz.tmax;
+    int64_t total = fz.total;
+    const auto& sorted = fz.sorted;
+    const auto& sortedSums = fz.sortedSums;
+
+    std::unique_ptr<int64_t[]> bins, binTime, selBin;
+    int64_t selectionTime = 0;
+    const bool valid = numBins > 1 && tmin != std::numeric_limits<int64_t>::max() && !sorted.empty() && tmax - tmin > 0;
+    if( valid )
+    {
+        const auto s = p.hmin;
+        const auto e = p.hmax;
+
+        auto sortedBegin = sorted.begin();
+        auto sortedEnd = sorted.end();
+        while( sortedBegin != sortedEnd && *sortedBegin == 0 ) ++sortedBegin;
+
+        if( p.trim )
+        {
+            if( p.logTime )
+            {
+                const auto tMinLog = log10( tmin );
+                const auto zmax = ( log10( tmax ) - tMinLog ) / numBins;
+                int64_t i;
+                for( i=0; i<numBins; i++ )
+                {
+                    const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( i+1 ) * zmax ) );
+                    auto nit = std::lower_bound( sortedBegin, sortedEnd, nextBinVal );
+                    const auto distance = std::distance( sortedBegin, nit );
+                    if( distance >= p.minBinVal ) break;
+                    sortedBegin = nit;
+                }
+                for( int64_t j=numBins-1; j>i; j-- )
+                {
+                    const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( j-1 ) * zmax ) );
+                    auto nit = std::lower_bound( sortedBegin, sortedEnd, nextBinVal );
+                    const auto distance = std::distance( nit, sortedEnd );
+                    if( distance >= p.minBinVal ) break;
+                    sortedEnd = nit;
+                }
+            }
+            else
+            {
+                const auto zmax = tmax - tmin;
+                int64_t i;
+                for( i=0; i<numBins; i++ )
+                {
+                    const auto nextBinVal = tmin + ( i+1 ) * zmax / numBins;
+                    auto nit = std::lower_bound( sortedBegin, sortedEnd, nextBinVal );
+                    const auto distance = std::distance( sortedBegin, nit );
+                    if( distance >= p.minBinVal ) break;
+                    sortedBegin = nit;
+                }
+                for( int64_t j=numBins-1; j>i; j-- )
+                {
+                    const auto nextBinVal = tmin + ( j-1 ) * zmax / numBins;
+                    auto nit = std::lower_bound( sortedBegin, sortedEnd, nextBinVal );
+                    const auto distance = std::distance( nit, sortedEnd );
+                    if( distance >= p.minBinVal ) break;
+                    sortedEnd = nit;
+                }
+            }
+
+            if( sortedBegin != sorted.end() )
+            {
+                tmin = *sortedBegin;
+                tmax = *(sortedEnd-1);
+                total = GetFindZoneSum( sorted, sortedSums, sortedBegin, sortedEnd );
+            }
+        }
+
+        bins = std::make_unique<int64_t[]>( numBins );
+        binTime = std::make_unique<int64_t[]>( numBins );
+        selBin = std::make_unique<int64_t[]>( numBins );
+
+        const auto& selSort = fz.selSort;
+        if( p.logTime )
+        {
+            const auto tMinLog = log10( tmin );
+            const auto zmax = ( log10( tmax ) - tMinLog ) / numBins;
+            {
+                auto zit = sortedBegin;
+                for( int64_t i=0; i<numBins; i++ )
+                {
+                    const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( i+1 ) * zmax ) );
+                    auto nit = std::lower_bound( zit, sortedEnd, nextBinVal );
+                    const auto distance = std::distance( zit, nit );
+                    const auto timeSum = GetFindZoneSum( sorted, sortedSums, zit, nit );
+                    bins[i] = distance;
+                    binTime[i] = timeSum;
+                    if( p.highlightActive )
+                    {
+                        auto end = nit == zit ? zit : nit-1;
+                        if( *zit >= s && *end <= e ) selectionTime += timeSum;
+                    }
+                    zit = nit;
+                }
+                const auto timeSum = GetFindZoneSum( sorted, sortedSums, zit, sortedEnd );
+                bins[numBins-1] += std::distance( zit, sortedEnd );
+                binTime[numBins-1] += timeSum;
+                if( p.highlightActive && *zit >= s && *(sortedEnd-1) <= e ) selectionTime += timeSum;
+            }
+
+            if( p.selActive )
+            {
+                auto zit = selSort.begin();
+                while( zit != selSort.end() && *zit == 0 ) ++zit;
+                for( int64_t i=0; i<numBins; i++ )
+                {
+                    const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( i+1 ) * zmax ) );
+                    auto nit = std::lower_bound( zit, selSort.end(), nextBinVal );
+                    if( p.cumulateTime )
+                    {
+                        selBin[i] = GetFindZoneSum( selSort, fz.selSortSums, zit, nit );
+                    }
+                    else
+                    {
+                        selBin[i] = std::distance( zit, nit );
+                    }
+                    zit = nit;
+                }
+            }
+        }
+        else
+        {
+            const auto zmax = tmax - tmin;
+            auto zit = sortedBegin;
+            for( int64_t i=0; i<numBins; i++ )
+            {
+                const auto nextBinVal = tmin + ( i+1 ) * zmax / numBins;
+                auto nit = std::lower_bound( zit, sortedEnd, nextBinVal );
+                const auto distance = std::distance( zit, nit );
+                const auto timeSum = GetFindZoneSum( sorted, sortedSums, zit, nit );
+                bins[i] = distance;
+                binTime[i] = timeSum;
+                if( p.highlightActive )
+                {
+                    auto end = nit == zit ? zit : nit-1;
+                    if( *zit >= s && *end <= e ) selectionTime += timeSum;
+                }
+                zit = nit;
+            }
+            const auto timeSum = GetFindZoneSum( sorted, sortedSums, zit, sortedEnd );
+            bins[numBins-1] += std::distance( zit, sortedEnd );
+            binTime[numBins-1] += timeSum;
+            if( p.highlightActive && *zit >= s && *(sortedEnd-1) <= e ) selectionTime += timeSum;
+
+            if( p.selActive )
+            {
+                auto zit = selSort.begin();
+                while( zit != selSort.end() && *zit == 0 ) ++zit;
+                for( int64_t i=0; i<numBins; i++ )
+                {
+                    const auto nextBinVal = tmin + ( i+1 ) * zmax / numBins;
+                    auto nit = std::lower_bound( zit, selSort.end(), nextBinVal );
+                    if( p.cumulateTime )
+                    {
+                        selBin[i] = GetFindZoneSum( selSort, fz.selSortSums, zit, nit );
+                    }
+                    else
+                    {
+                        selBin[i] = std::distance( zit, nit );
+                    }
+                    zit = nit;
+                }
+            }
+        }
+    }
+
+    if( !fz.job.Lock( fz.jobLock ) ) return;
+    fz.bins.swap( bins );
+    fz.binTime.swap( binTime );
+    fz.selBin.swap( selBin );
+    fz.selTime = selectionTime;
+    fz.binCache.params = p;
+    fz.binCache.valid = valid;
+    fz.binCache.tmin = tmin;
+    fz.binCache.tmax = tmax;
+    fz.binCache.total = total;
+    fz.binsDirty = false;
+    fz.jobLock.unlock();
+}
+
 void View::DrawZoneList( int id, const Vector<short_ptr<ZoneEvent>>& zones )
 {
     const auto zsz = zones.size();
@@ -397,6 +963,62 @@ void View::DrawFindZone()
         auto& zoneData = m_worker.GetZonesForSourceLocation( m_findZone.match[m_findZone.selMatch] );
         auto& zones = zoneData.zones;
         zones.ensure_sorted();
+
+        if( m_findZone.jobDone.load( std::memory_order_acquire ) ) m_findZone.StopJob();
+        const bool isStatic = m_worker.IsDataStatic();
+        const bool rebin = m_findZone.binsDirty || m_findZone.binCache.params != m_findZone.binParams;
+        if( !m_findZone.job.IsStarted() && ( !isStatic || m_findZone.jobSize != zones.size() || rebin ) )
+        {
+            auto& params = m_findZone.jobParams;
+            params.srcloc = m_findZone.match[m_findZone.selMatch];
+            params.zones = zones.data();
+            params.zsz = zones.size();
+            params.tmin = m_findZone.selfTime ? zoneData.selfMin : zoneData.min;
+            params.tmax = m_findZone.selfTime ? zoneData.selfMax : zoneData.max;
+            params.rangeActive = m_findZone.range.active;
+            params.rangeMin = rangeMin;
+            params.rangeMax = rangeMax;
+            params.selfTime = m_findZone.selfTime;
+            params.runningTime = m_findZone.runningTime;
+            params.samples = m_findZone.samples.enabled;
+            params.groupBy = m_findZone.groupBy;
+            params.highlightActive = m_findZone.highlight.active;
+            params.hmin = std::min( m_findZone.highlight.start, m_findZone.highlight.end );
+            params.hmax = std::max( m_findZone.highlight.start, m_findZone.highlight.end );
+            params.selGroup = m_findZone.selGroup;
+            memcpy( params.textFilter.InputBuf, m_userTextFilter.InputBuf, sizeof( params.textFilter.InputBuf ) );
+            params.textFilter.Build();
+            params.ctxSwitch.clear();
+            if( params.runningTime ) GetFindZoneCtxSwitch( m_worker, params.ctxSwitch );
+
+            if( isStatic )
+            {
+                m_findZone.job.Start( [this] {
+                    FindZoneJob( true );
+                    m_findZone.jobDone.store( true, std::memory_order_release );
+                } );
+            }
+            else
+            {
+                m_findZone.job.Start( [this] { FindZoneJob( false ); } );
+            }
+        }
+        std::lock_guard lock( m_findZone.jobLock );
+
+        // The job of a live capture never finishes, it only counts as busy when it falls behind.
+        const auto zsz = zones.size();
+        if( m_findZone.job.IsStarted() && m_findZone.jobSize + ( isStatic ? 0 : FindZoneLiveBacklog ) < zsz )
+        {
+            const auto done = m_findZone.sortedNum + m_findZone.processed + ( m_findZone.selGroup != m_findZone.Unselected ? m_findZone.selSortNum : zsz );
+            ImGui::TextUnformatted( "Processing zones" );
+            ImGui::SameLine();
+            char buf[64];
+            PrintStringPercent( buf, 100.f * done / ( zsz * 3 ) );
+            TextDisabledUnformatted( buf );
+            ImGui::SameLine();
+            DrawWaitingDots( s_time );
+        }
+
         if( ImGui::TreeNodeEx( "Histogram", ImGuiTreeNodeFlags_DefaultOpen ) )
         {
             const auto ty = ImGui::GetTextLineHeight();
@@ -404,261 +1026,6 @@ void View::DrawFindZone()
             int64_t tmin = m_findZone.tmin;
             int64_t tmax = m_findZone.tmax;
             int64_t total = m_findZone.total;
-            const auto zsz = zones.size();
-            if( m_findZone.sortedNum != zsz )
-            {
-                auto& vec = m_findZone.sorted;
-                const auto vszorig = vec.size();
-                vec.reserve( zsz );
-                size_t i;
-                if( m_findZone.runningTime )
-                {
-                    if( m_findZone.range.active )
-                    {
-                        for( i=m_findZone.sortedNum; i<zsz; i++ )
-                        {
-                            auto& zone = *zones[i].Zone();
-                            const auto end = zone.End();
-                            if( end > rangeMax || zone.Start() < rangeMin ) continue;
-                            const auto ctx = m_worker.GetContextSwitchData( m_worker.DecompressThread( zones[i].Thread() ) );
-                            if( !ctx ) break;
-                            int64_t t;
-                            uint64_t cnt;
-                            if( !GetZoneRunningTime( ctx, zone, t, cnt ) ) break;
-                            vec.push_back_no_space_check( t );
-                            total += t;
-                            if( t < tmin ) tmin = t;
-                            else if( t > tmax ) tmax = t;
-                        }
-                    }
-                    else
-                    {
-                        for( i=m_findZone.sortedNum; i<zsz; i++ )
-                        {
-                            auto& zone = *zones[i].Zone();
-                            const auto ctx = m_worker.GetContextSwitchData( m_worker.DecompressThread( zones[i].Thread() ) );
-                            if( !ctx ) break;
-                            int64_t t;
-                            uint64_t cnt;
-                            if( !GetZoneRunningTime( ctx, zone, t, cnt ) ) break;
-                            vec.push_back_no_space_check( t );
-                            total += t;
-                            if( t < tmin ) tmin = t;
-                            else if( t > tmax ) tmax = t;
-                        }
-                    }
-                }
-                else if( m_findZone.selfTime )
-                {
-                    tmin = zoneData.selfMin;
-                    tmax = zoneData.selfMax;
-                    if( m_findZone.range.active )
-                    {
-                        for( i=m_findZone.sortedNum; i<zsz; i++ )
-                        {
-                            auto& zone = *zones[i].Zone();
-                            const auto end = zone.End();
-                            const auto start = zone.Start();
-                            if( end > rangeMax || start < rangeMin ) continue;
-                            const auto t = end - start - GetZoneChildTimeFast( zone );
-                            vec.push_back_no_space_check( t );
-                            total += t;
-                        }
-                    }
-                    else
-                    {
-                        for( i=m_findZone.sortedNum; i<zsz; i++ )
-                        {
-                            auto& zone = *zones[i].Zone();
-                            const auto end = zone.End();
-                            const auto t = end - zone.Start() - GetZoneChildTimeFast( zone );
-                            vec.push_back_no_space_check( t );
-                            total += t;
-                        }
-                    }
-                }
-                else
-                {
-                    tmin = zoneData.min;
-                    tmax = zoneData.max;
-                    if( m_findZone.range.active )
-                    {
-                        for( i=m_findZone.sortedNum; i<zsz; i++ )
-                        {
-                            auto& zone = *zones[i].Zone();
-                            const auto end = zone.End();
-                            const auto start = zone.Start();
-                            if( end > rangeMax || start < rangeMin ) continue;
-                            const auto t = end - start;
-                            vec.push_back_no_space_check( t );
-                            total += t;
-                        }
-                    }
-                    else
-                    {
-                        for( i=m_findZone.sortedNum; i<zsz; i++ )
-                        {
-                            auto& zone = *zones[i].Zone();
-                            const auto end = zone.End();
-                            const auto t = end - zone.Start();
-                            vec.push_back_no_space_check( t );
-                            total += t;
-                        }
-                    }
-                }
-                auto mid = vec.begin() + vszorig;
-#ifdef NO_PARALLEL_SORT
-                pdqsort_branchless( mid, vec.end() );
-#else
-                std::sort( std::execution::par_unseq, mid, vec.end() );
-#endif
-                std::inplace_merge( vec.begin(), mid, vec.end() );
-
-                const auto vsz = vec.size();
-                if( vsz != 0 )
-                {
-                    m_findZone.average = float( total ) / vsz;
-                    m_findZone.median = vec[vsz/2];
-                    m_findZone.total = total;
-                    m_findZone.sortedNum = i;
-                    m_findZone.tmin = tmin;
-                    m_findZone.tmax = tmax;
-                }
-            }
-
-            if( m_findZone.selGroup != m_findZone.Unselected )
-            {
-                if( m_findZone.selSortNum != m_findZone.sortedNum )
-                {
-                    const auto selGroup = m_findZone.selGroup;
-                    const auto groupBy = m_findZone.groupBy;
-
-                    auto& vec = m_findZone.selSort;
-                    vec.reserve( zsz );
-                    auto act = m_findZone.selSortActive;
-                    int64_t total = m_findZone.selTotal;
-                    if( m_findZone.runningTime )
-                    {
-                        if( m_findZone.range.active )
-                        {
-                            for( size_t i=m_findZone.selSortNum; i<m_findZone.sortedNum; i++ )
-                            {
-                                auto& ev = zones[i];
-                                if( ev.Zone()->End() > rangeMax || ev.Zone()->Start() < rangeMin ) continue;
-                                if( m_filteredZones.contains( &ev ) ) continue;
-                                if( selGroup == GetSelectionTarget( ev, groupBy ) )
-                                {
-                                    const auto ctx = m_worker.GetContextSwitchData( m_worker.DecompressThread( zones[i].Thread() ) );
-                                    int64_t t;
-                                    uint64_t cnt;
-                                    GetZoneRunningTime( ctx, *ev.Zone(), t, cnt );
-                                    vec.push_back_no_space_check( t );
-                                    act++;
-                                    total += t;
-                                }
-                            }
-                        }
-                        else
-                        {
-                            for( size_t i=m_findZone.selSortNum; i<m_findZone.sortedNum; i++ )
-                            {
-                                auto& ev = zones[i];
-                                if( m_filteredZones.contains( &ev ) ) continue;
-                                if( selGroup == GetSelectionTarget( ev, groupBy ) )
-                                {
-                                    const auto ctx = m_worker.GetContextSwitchData( m_worker.DecompressThread( zones[i].Thread() ) );
-                                    int64_t t;
-                                    uint64_t cnt;
-                                    GetZoneRunningTime( ctx, *ev.Zone(), t, cnt );
-                                    vec.push_back_no_space_check( t );
-                                    act++;
-                                    total += t;
-                                }
-                            }
-                        }
-                    }
-                    else if( m_findZone.selfTime )
-                    {
-                        if( m_findZone.range.active )
-                        {
-                            for( size_t i=m_findZone.selSortNum; i<m_findZone.sortedNum; i++ )
-                            {
-                                auto& ev = zones[i];
-                                if( ev.Zone()->End() > rangeMax || ev.Zone()->Start() < rangeMin ) continue;
-                                if( m_filteredZones.contains( &ev ) ) continue;
-                                if( selGroup == GetSelectionTarget( ev, groupBy ) )
-                                {
-                                    const auto t = ev.Zone()->End() - ev.Zone()->Start() - GetZoneChildTimeFast( *ev.Zone() );
-                                    vec.push_back_no_space_check( t );
-                                    act++;
-                                    total += t;
-                                }
-                            }
-                        }
-                        else
-                        {
-                            for( size_t i=m_findZone.selSortNum; i<m_findZone.sortedNum; i++ )
-                            {
-                                auto& ev = zones[i];
-                                if( m_filteredZones.contains( &ev ) ) continue;
-                                if( selGroup == GetSelectionTarget( ev, groupBy ) )
-                                {
-                                    const auto t = ev.Zone()->End() - ev.Zone()->Start() - GetZoneChildTimeFast( *ev.Zone() );
-                                    vec.push_back_no_space_check( t );
-                                    act++;
-                                    total += t;
-                                }
-                            }
-                        }
-                    }
-                    else
-                    {
-                        if( m_findZone.range.active )
-                        {
-                            for( size_t i=m_findZone.selSortNum; i<m_findZone.sortedNum; i++ )
-                            {
-                                auto& ev = zones[i];
-                                if( ev.Zone()->End() > rangeMax || ev.Zone()->Start() < rangeMin ) continue;
-                                if( m_filteredZones.contains( &ev ) ) continue;
-                                if( selGroup == GetSelectionTarget( ev, groupBy ) )
-                                {
-                                    const auto t = ev.Zone()->End() - ev.Zone()->Start();
-                                    vec.push_back_no_space_check( t );
-                                    act++;
-                                    total += t;
-                                }
-                            }
-                        }
-                        else
-                        {
-                            for( size_t i=m_findZone.selSortNum; i<m_findZone.sortedNum; i++ )
-                            {
-                                auto& ev = zones[i];
-                                if( m_filteredZones.contains( &ev ) ) continue;
-                                if( selGroup == GetSelectionTarget( ev, groupBy ) )
-                                {
-                                    const auto t = ev.Zone()->End() - ev.Zone()->Start();
-                                    vec.push_back_no_space_check( t );
-                                    act++;
-                                    total += t;
-                                }
-                            }
-                        }
-                    }
-                    if( !vec.empty() )
-                    {
-                        auto mid = vec.begin() + m_findZone.selSortActive;
-                        pdqsort_branchless( mid, vec.end() );
-                        std::inplace_merge( vec.begin(), mid, vec.end() );
-
-                        m_findZone.selAverage = float( total ) / act;
-                        m_findZone.selMedian = vec[act/2];
-                        m_findZone.selTotal = total;
-                        m_findZone.selSortNum = m_findZone.sortedNum;
-                        m_findZone.selSortActive = act;
-                    }
-                }
-            }
 
             if( tmin != std::numeric_limits<int64_t>::max() && !m_findZone.sorted.empty() )
             {
@@ -674,10 +1041,7 @@ void View::DrawFindZone()
 
                 SmallCheckbox( "Log values", &m_findZone.logVal );
                 ImGui::SameLine();
-                if( SmallCheckbox( "Log time", &m_findZone.logTime ) )
-                {
-                    m_findZone.binCache.numBins = -1;
-                }
+                SmallCheckbox( "Log time", &m_findZone.logTime );
                 ImGui::SameLine();
                 SmallCheckbox( "Cumulate time", &m_findZone.cumulateTime );
                 ImGui::SameLine();
@@ -702,203 +1066,37 @@ void View::DrawFindZone()
                     }
                 }
 
-                const auto cumulateTime = m_findZone.cumulateTime;
-
                 if( tmax - tmin > 0 )
                 {
                     const auto w = ImGui::GetContentRegionAvail().x;
 
-                    const auto numBins = int64_t( w - 4 );
-                    if( numBins > 1 )
+                    FindZone::BinParams binParams;
+                    binParams.numBins = int64_t( w - 4 );
+                    binParams.logTime = m_findZone.logTime;
+                    binParams.cumulateTime = m_findZone.cumulateTime;
+                    binParams.trim = m_findZone.minBinVal > 1 || m_findZone.range.active;
+                    binParams.highlightActive = m_findZone.highlight.active;
+                    binParams.selActive = m_findZone.selGroup != m_findZone.Unselected;
+                    binParams.minBinVal = m_findZone.minBinVal;
+                    binParams.hmin = std::min( m_findZone.highlight.start, m_findZone.highlight.end );
+                    binParams.hmax = std::max( m_findZone.highlight.start, m_findZone.highlight.end );
+                    m_findZone.binParams = binParams;
+
+                    // The histogram is drawn with the parameters of the last bins published by the job.
+                    const auto& binCache = m_findZone.binCache;
+                    if( binParams.numBins > 1 && binCache.valid )
                     {
-                        const auto s = std::min( m_findZone.highlight.start, m_findZone.highlight.end );
-                        const auto e = std::max( m_findZone.highlight.start, m_findZone.highlight.end );
-
-                        const auto& sorted = m_findZone.sorted;
-
-                        auto sortedBegin = sorted.begin();
-                        auto sortedEnd = sorted.end();
-                        while( sortedBegin != sortedEnd && *sortedBegin == 0 ) ++sortedBegin;
-
-                        if( m_findZone.minBinVal > 1 || m_findZone.range.active )
-                        {
-                            if( m_findZone.logTime )
-                            {
-                                const auto tMinLog = log10( tmin );
-                                const auto zmax = ( log10( tmax ) - tMinLog ) / numBins;
-                                int64_t i;
-                                for( i=0; i<numBins; i++ )
-                                {
-                                    const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( i+1 ) * zmax ) );
-                                    auto nit = std::lower_bound( sortedBegin, sortedEnd, nextBinVal );
-                                    const auto distance = std::distance( sortedBegin, nit );
-                                    if( distance >= m_findZone.minBinVal ) break;
-                                    sortedBegin = nit;
-                                }
-                                for( int64_t j=numBins-1; j>i; j-- )
-                                {
-                                    const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( j-1 ) * zmax ) );
-                                    auto nit = std::lower_bound( sortedBegin, sortedEnd, nextBinVal );
-                                    const auto distance = std::distance( nit, sortedEnd );
-                                    if( distance >= m_findZone.minBinVal ) break;
-                                    sortedEnd = nit;
-                                }
-                            }
-                            else
-                            {
-                                const auto zmax = tmax - tmin;
-                                int64_t i;
-                                for( i=0; i<numBins; i++ )
-                                {
-                                    const auto nextBinVal = tmin + ( i+1 ) * zmax / numBins;
-                                    auto nit = std::lower_bound( sortedBegin, sortedEnd, nextBinVal );
-                                    const auto distance = std::distance( sortedBegin, nit );
-                                    if( distance >= m_findZone.minBinVal ) break;
-                                    sortedBegin = nit;
-                                }
-                                for( int64_t j=numBins-1; j>i; j-- )
-                                {
-                                    const auto nextBinVal = tmin + ( j-1 ) * zmax / numBins;
-                                    auto nit = std::lower_bound( sortedBegin, sortedEnd, nextBinVal );
-                                    const auto distance = std::distance( nit, sortedEnd );
-                                    if( distance >= m_findZone.minBinVal ) break;
-                                    sortedEnd = nit;
-                                }
-                            }
-
-                            if( sortedBegin != sorted.end() )
-                            {
-                                tmin = *sortedBegin;
-                                tmax = *(sortedEnd-1);
-                                total = 0;
-                                for( auto ptr = sortedBegin; ptr != sortedEnd; ptr++ ) total += *ptr;
-                            }
-                        }
-
-                        if( numBins > m_findZone.numBins )
-                        {
-                            m_findZone.numBins = numBins;
-                            m_findZone.bins = std::make_unique<int64_t[]>( numBins );
-                            m_findZone.binTime = std::make_unique<int64_t[]>( numBins );
-                            m_findZone.selBin = std::make_unique<int64_t[]>( numBins );
-                            m_findZone.binCache.numBins = -1;
-                        }
+                        const auto numBins = binCache.params.numBins;
+                        const auto logTime = binCache.params.logTime;
+                        const auto cumulateTime = binCache.params.cumulateTime;
+                        tmin = binCache.tmin;
+                        tmax = binCache.tmax;
+                        total = binCache.total;
 
                         const auto& bins = m_findZone.bins;
                         const auto& binTime = m_findZone.binTime;
                         const auto& selBin = m_findZone.selBin;
 
-                        const auto distBegin = std::distance( sorted.begin(), sortedBegin );
-                        const auto distEnd = std::distance( sorted.begin(), sortedEnd );
-                        if( m_findZone.binCache.numBins != numBins ||
-                            m_findZone.binCache.distBegin != distBegin ||
-                            m_findZone.binCache.distEnd != distEnd )
-                        {
-                            m_findZone.binCache.numBins = numBins;
-                            m_findZone.binCache.distBegin = distBegin;
-                            m_findZone.binCache.distEnd = distEnd;
-
-                            memset( bins.get(), 0, sizeof( int64_t ) * numBins );
-                            memset( binTime.get(), 0, sizeof( int64_t ) * numBins );
-                            memset( selBin.get(), 0, sizeof( int64_t ) * numBins );
-
-                            int64_t selectionTime = 0;
-
-                            if( m_findZone.logTime )
-                            {
-                                const auto tMinLog = log10( tmin );
-                                const auto zmax = ( log10( tmax ) - tMinLog ) / numBins;
-                                {
-                                    auto zit = sortedBegin;
-                                    for( int64_t i=0; i<numBins; i++ )
-                                    {
-                                        const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( i+1 ) * zmax ) );
-                                        auto nit = std::lower_bound( zit, sortedEnd, nextBinVal );
-                                        const auto distance = std::distance( zit, nit );
-                                        const auto timeSum = std::accumulate( zit, nit, int64_t( 0 ) );
-                                        bins[i] = distance;
-                                        binTime[i] = timeSum;
-                                        if( m_findZone.highlight.active )
-                                        {
-                                            auto end = nit == zit ? zit : nit-1;
-                                            if( *zit >= s && *end <= e ) selectionTime += timeSum;
-                                        }
-                                        zit = nit;
-                                    }
-                                    const auto timeSum = std::accumulate( zit, sortedEnd, int64_t( 0 ) );
-                                    bins[numBins-1] += std::distance( zit, sortedEnd );
-                                    binTime[numBins-1] += timeSum;
-                                    if( m_findZone.highlight.active && *zit >= s && *(sortedEnd-1) <= e ) selectionTime += timeSum;
-                                }
-
-                                if( m_findZone.selGroup != m_findZone.Unselected )
-                                {
-                                    auto zit = m_findZone.selSort.begin();
-                                    while( zit != m_findZone.selSort.end() && *zit == 0 ) ++zit;
-                                    for( int64_t i=0; i<numBins; i++ )
-                                    {
-                                        const auto nextBinVal = int64_t( pow( 10.0, tMinLog + ( i+1 ) * zmax ) );
-                                        auto nit = std::lower_bound( zit, m_findZone.selSort.end(), nextBinVal );
-                                        if( cumulateTime )
-                                        {
-                                            selBin[i] = std::accumulate( zit, nit, int64_t( 0 ) );
-                                        }
-                                        else
-                                        {
-                                            selBin[i] = std::distance( zit, nit );
-                                        }
-                                        zit = nit;
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                const auto zmax = tmax - tmin;
-                                auto zit = sortedBegin;
-                                for( int64_t i=0; i<numBins; i++ )
-                                {
-                                    const auto nextBinVal = tmin + ( i+1 ) * zmax / numBins;
-                                    auto nit = std::lower_bound( zit, sortedEnd, nextBinVal );
-                                    const auto distance = std::distance( zit, nit );
-                                    const auto timeSum = std::accumulate( zit, nit, int64_t( 0 ) );
-                                    bins[i] = distance;
-                                    binTime[i] = timeSum;
-                                    if( m_findZone.highlight.active )
-                                    {
-                                        auto end = nit == zit ? zit : nit-1;
-                                        if( *zit >= s && *end <= e ) selectionTime += timeSum;
-                                    }
-                                    zit = nit;
-                                }
-                                const auto timeSum = std::accumulate( zit, sortedEnd, int64_t( 0 ) );
-                                bins[numBins-1] += std::distance( zit, sortedEnd );
-                                binTime[numBins-1] += timeSum;
-                                if( m_findZone.highlight.active && *zit >= s && *(sortedEnd-1) <= e ) selectionTime += timeSum;
-
-                                if( m_findZone.selGroup != m_findZone.Unselected )
-                                {
-                                    auto zit = m_findZone.selSort.begin();
-                                    while( zit != m_findZone.selSort.end() && *zit == 0 ) ++zit;
-                                    for( int64_t i=0; i<numBins; i++ )
-                                    {
-                                        const auto nextBinVal = tmin + ( i+1 ) * zmax / numBins;
-                                        auto nit = std::lower_bound( zit, m_findZone.selSort.end(), nextBinVal );
-                                        if( cumulateTime )
-                                        {
-                                            selBin[i] = std::accumulate( zit, nit, int64_t( 0 ) );
-                                        }
-                                        else
-                                        {
-                                            selBin[i] = std::distance( zit, nit );
-                                        }
-                                        zit = nit;
-                                    }
-                                }
-                            }
-
-                            m_findZone.selTime = selectionTime;
-                        }
-
                         int maxBin = 0;
                         int64_t maxVal;
                         if( cumulateTime )
@@ -941,7 +1139,7 @@ void View::DrawFindZone()
                         ImGui::SameLine();
                         {
                             int64_t t0, t1;
-                            if( m_findZone.logTime )
+                            if( logTime )
                             {
                                 const auto ltmin = log10( tmin );
                                 const auto ltmax = log10( tmax );
@@ -1100,7 +1298,7 @@ void View::DrawFindZone()
 
                         const auto ty05 = round( ty * 0.5f );
                         const auto ty025 = round( ty * 0.25f );
-                        if( m_findZone.logTime )
+                        if( logTime )
                         {
                             const auto ltmin = log10( tmin );
                             const auto ltmax = log10( tmax );
@@ -1185,7 +1383,7 @@ void View::DrawFindZone()
                         }
 
                         float ta, tm, tga, tgm;
-                        if( m_findZone.logTime )
+                        if( logTime )
                         {
                             const auto ltmin = log10( tmin );
                             const auto ltmax = log10( tmax );
@@ -1233,9 +1431,9 @@ void View::DrawFindZone()
                             auto& io = ImGui::GetIO();
                             DrawLine( draw, ImVec2( io.MousePos.x + 0.5f, dpos.y ), ImVec2( io.MousePos.x + 0.5f, dpos.y+Height-2 ), 0x33FFFFFF );
 
-                            const auto bin = int64_t( io.MousePos.x - wpos.x - 2 );
+                            const auto bin = std::min<int64_t>( int64_t( io.MousePos.x - wpos.x - 2 ), numBins - 1 );
                             int64_t t0, t1;
-                            if( m_findZone.logTime )
+                            if( logTime )
                             {
                                 t0 = int64_t( pow( 10, ltmin + double( bin ) / numBins * ( ltmax - ltmin ) ) );
 
@@ -1319,7 +1517,7 @@ void View::DrawFindZone()
                             const auto e = std::max( m_findZone.highlight.start, m_findZone.highlight.end );
 
                             float t0, t1;
-                            if( m_findZone.logTime )
+                            if( logTime )
                             {
                                 const auto ltmin = log10( tmin );
                                 const auto ltmax = log10( tmax );
@@ -1339,12 +1537,12 @@ void View::DrawFindZone()
                             draw->PopClipRect();
                         }
 
-                        if( ( m_zoneHover && m_findZone.match[m_findZone.selMatch] == m_zoneHover->SrcLoc() ) ||
-                            ( m_zoneHover2 && m_findZone.match[m_findZone.selMatch] == m_zoneHover2->SrcLoc() ) )
+                        if( ( m_zoneHover && m_findZone.match[m_findZone.selMatch] == m_worker.GetZoneSrcLoc( *m_zoneHover ) ) ||
+                            ( m_zoneHover2 && m_findZone.match[m_findZone.selMatch] == m_worker.GetZoneSrcLoc( *m_zoneHover2 ) ) )
                         {
                             const auto zoneTime = m_zoneHover ? ( m_worker.GetZoneEnd( *m_zoneHover ) - m_zoneHover->Start() ) : ( m_worker.GetZoneEnd( *m_zoneHover2 ) - m_zoneHover2->Start() );
                             float zonePos;
-                            if( m_findZone.logTime )
+                            if( logTime )
                             {
                                 const auto ltmin = log10( tmin );
                                 const auto ltmax = log10( tmax );
@@ -1384,8 +1582,8 @@ void View::DrawFindZone()
         ImGui::Separator();
         if( filterChanged )
         {
-            m_filteredZones.clear();
             m_findZone.ResetGroups();
+            m_filteredZones.clear();
         }
 
         ImGui::TextUnformatted( "Found zones:" );
@@ -1435,147 +1633,7 @@ void View::DrawFindZone()
         ImGui::SameLine();
         DrawHelpMarker( "Mean time per call" );
 
-        const auto hmin = std::min( m_findZone.highlight.start, m_findZone.highlight.end );
-        const auto hmax = std::max( m_findZone.highlight.start, m_findZone.highlight.end );
         const auto groupBy = m_findZone.groupBy;
-        const auto highlightActive = m_findZone.highlight.active;
-        const auto limitRange = m_findZone.range.active;
-        FindZone::Group* group = nullptr;
-        constexpr uint64_t invalidGid = std::numeric_limits<uint64_t>::max() - 1;
-        uint64_t lastGid = invalidGid;
-        auto zptr = zones.data() + m_findZone.processed;
-        const auto zend = zones.data() + zones.size();
-        while( zptr < zend )
-        {
-            auto& ev = *zptr;
-            const auto end = ev.Zone()->End();
-            const auto start = ev.Zone()->Start();
-            if( limitRange && ( start < rangeMin || end > rangeMax ) )
-            {
-                zptr++;
-                continue;
-            }
-
-            if( m_userTextFilter.IsActive() )
-            {
-                bool keep = false;
-                if ( m_worker.HasZoneExtra( *ev.Zone() ) && m_worker.GetZoneExtra( *ev.Zone() ).text.Active() )
-                {
-                    auto text = m_worker.GetString( m_worker.GetZoneExtra( *ev.Zone() ).text );
-                    if( m_userTextFilter.PassFilter( text ) )
-                    {
-                        keep = true;
-                    }
-                }
-                if( !keep )
-                {
-                    m_filteredZones.insert( &ev );
-                    zptr++;
-                    continue;
-                }
-            }
-
-            auto timespan = end - start;
-            assert( timespan != 0 );
-            if( m_findZone.selfTime )
-            {
-                timespan -= GetZoneChildTimeFast( *ev.Zone() );
-            }
-            else if( m_findZone.runningTime )
-            {
-                const auto ctx = m_worker.GetContextSwitchData( m_worker.DecompressThread( ev.Thread() ) );
-                if( !ctx ) break;
-                int64_t t;
-                uint64_t cnt;
-                if( !GetZoneRunningTime( ctx, *ev.Zone(), t, cnt ) ) break;
-                timespan = t;
-            }
-
-            if( highlightActive )
-            {
-                if( timespan < hmin || timespan > hmax )
-                {
-                    zptr++;
-                    continue;
-                }
-            }
-
-            zptr++;
-            uint64_t gid = 0;
-            switch( groupBy )
-            {
-            case FindZone::GroupBy::Thread:
-                gid = ev.Thread();
-                break;
-            case FindZone::GroupBy::UserText:
-            {
-                const auto& zone = *ev.Zone();
-                if( !m_worker.HasZoneExtra( zone ) )
-                {
-                    gid = std::numeric_limits<uint64_t>::max();
-                }
-                else
-                {
-                    const auto& extra = m_worker.GetZoneExtra( zone );
-                    gid = extra.text.Active() ? extra.text.Idx() : std::numeric_limits<uint64_t>::max();
-                }
-                break;
-            }
-            case FindZone::GroupBy::ZoneName:
-            {
-                const auto& zone = *ev.Zone();
-                if( !m_worker.HasZoneExtra( zone ) )
-                {
-                    gid = std::numeric_limits<uint64_t>::max();
-                }
-                else
-                {
-                    const auto& extra = m_worker.GetZoneExtra( zone );
-                    gid = extra.name.Active() ? extra.name.Idx() : std::numeric_limits<uint64_t>::max();
-                }
-                break;
-            }
-            case FindZone::GroupBy::Callstack:
-                gid = m_worker.GetZoneExtra( *ev.Zone() ).callstack.Val();
-                break;
-            case FindZone::GroupBy::Parent:
-            {
-                const auto parent = GetZoneParent( *ev.Zone(), m_worker.DecompressThread( ev.Thread() ) );
-                if( parent ) gid = uint64_t( uint16_t( parent->SrcLoc() ) );
-                break;
-            }
-            case FindZone::GroupBy::NoGrouping:
-                break;
-            default:
-                assert( false );
-                break;
-            }
-            if( lastGid != gid )
-            {
-                lastGid = gid;
-                auto it = m_findZone.groups.find( gid );
-                if( it == m_findZone.groups.end() )
-                {
-                    it = m_findZone.groups.emplace( gid, FindZone::Group { m_findZone.groupId++ } ).first;
-                    it->second.zones.reserve( 1024 );
-                    if( m_findZone.samples.enabled )
-                        it->second.zonesTids.reserve( 1024 );
-                }
-                group = &it->second;
-            }
-            group->time += timespan;
-            group->zones.push_back_non_empty( ev.Zone() );
-            if( m_findZone.samples.enabled )
-                group->zonesTids.push_back_non_empty( ev.Thread() );
-        }
-        m_findZone.processed = zptr - zones.data();
-
-        const bool groupsUpdated = lastGid != invalidGid;
-        if( m_findZone.samples.enabled && groupsUpdated )
-        {
-            m_findZone.samples.scheduleUpdate = true;
-        }
-
 
         Vector<decltype( m_findZone.groups )::iterator> groups;
         groups.reserve_and_use( m_findZone.groups.size() );
@@ -1604,7 +1662,7 @@ void View::DrawFindZone()
             break;
         }
 
-        int16_t changeZone = 0;
+        int32_t changeZone = 0;
 
         if( groupBy == FindZone::GroupBy::Callstack )
         {
@@ -1784,7 +1842,7 @@ void View::DrawFindZone()
                     }
                     else
                     {
-                        auto& srcloc = m_worker.GetSourceLocation( int16_t( v->first ) );
+                        auto& srcloc = m_worker.GetSourceLocation( int32_t( v->first ) );
                         hdrString = m_worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function );
                         SmallColorBox( GetSrcLocColor( srcloc, 0 ) );
                     }
@@ -1807,7 +1865,7 @@ void View::DrawFindZone()
                 }
                 if( m_findZone.groupBy == FindZone::GroupBy::Parent && ImGui::IsItemClicked( 2 ) )
                 {
-                    changeZone = int16_t( v->first );
+                    changeZone = int32_t( v->first );
                 }
                 ImGui::PopID();
                 if( isFiber )
@@ -0,0 +1,530 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "imgui.h"
+
+#include "TracyColor.hpp"
+#include "TracyImGui.hpp"
+#include "TracyPrint.hpp"
+#include "TracyView.hpp"
+#include "../server/TracyZoneTree.hpp"
+
+namespace tracy
+{
+
+extern double s_time;
+
+enum { FlameGraphUnknownFrame = 0xFFFFFFFF };
+
+// Maximum number of zones or samples processed in one step of the flame graph job. During
+// live capture the worker data lock is held for the whole step.
+enum { FlameGraphStepBudget = 1024 * 1024 };
+
+// Number of samples counted by one task with saved traces.
+enum { FlameGraphSampleBlock = 64 * 1024 };
+
+namespace
+{
+
+class FlameGraphBuilder
+{
+public:
+    FlameGraphBuilder( const Worker& worker, int64_t t0, int64_t t1, int64_t fallbackEnd )
+        : m_worker( worker )
+        , m_t0( t0 )
+        , m_t1( t1 )
+        , m_fallbackEnd( fallbackEnd )
+    {
+        m_items.push_back( FlameGraphItem { 0, 0, 0, 0, 0 } );
+    }
+
+    // The graph with the time of the zones which were not left yet added.
+    std::vector<FlameGraphItem> Items() const
+    {
+        auto items = m_items;
+        for( auto& v : m_entered ) items[v.first].time += v.second;
+        return items;
+    }
+
+    // Returns true if the thread has no more data to process at this point. Each zone uses one
+    // unit of the budget. Processing stops when the budget runs out, also in the middle of a subtree.
+    // During live capture zones which haven't ended yet are entered, so that their finished
+    // children show up.
+    bool ProcessZones( const ThreadData& td, size_t& budget )
+    {
+        auto it = m_walkers.find( td.id );
+        if( it == m_walkers.end() ) it = m_walkers.emplace( td.id, ZoneTreeWalker( m_t0, m_t1, m_fallbackEnd >= 0 ? ZoneTreeWalker::Open::Ended : ZoneTreeWalker::Open::Enter ) ).first;
+        return it->second.Walk( m_worker, td.timeline, 0, budget, *this );
+    }
+
+    // Zones are added to their nodes when they are left. Until then their time is counted
+    // provisionally, up to lastTime if they haven't ended yet. Returns true if any of them did not.
+    bool CollectEntered( int64_t lastTime )
+    {
+        bool open = false;
+        m_entered.clear();
+        for( auto& td : m_worker.GetThreadData() )
+        {
+            auto it = m_walkers.find( td->id );
+            if( it == m_walkers.end() ) continue;
+            it->second.ForEachEntered( m_worker, td->timeline, [&] ( const ZoneEvent& zone, int depth, uint32_t node ) {
+                if( !zone.IsEndValid() ) open = true;
+                const auto time = ZoneTime( zone, zone.IsEndValid() ? zone.End() : lastTime );
+                m_entered.emplace_back( node, time );
+                if( depth == 0 ) m_entered.emplace_back( 0, time );
+            } );
+        }
+        return open;
+    }
+
+    bool ProcessSamples( const ThreadData& td, size_t& budget )
+    {
+        auto& cursor = m_cursors[td.id];
+        if( cursor.done ) return true;
+        const auto& samples = td.samples;
+        if( cursor.pos == std::numeric_limits<size_t>::max() )
+        {
+            auto it = std::lower_bound( samples.begin(), samples.end(), m_t0, [] ( const auto& l, const auto& r ) { return l.time.Val() < r; } );
+            cursor.pos = std::distance( samples.begin(), it );
+        }
+
+        m_counts.clear();
+        const auto size = samples.size();
+        auto pos = cursor.pos;
+        while( pos < size && budget > 0 )
+        {
+            const auto& sample = samples[pos];
+            if( sample.time.Val() > m_t1 )
+            {
+                cursor.done = true;
+                break;
+            }
+            m_counts[sample.callstack.Val()]++;
+            pos++;
+            budget--;
+        }
+        cursor.pos = pos;
+        AddCounts();
+        return cursor.done || pos == size;
+    }
+
+    // Counts the samples of all threads in blocks on the task dispatch. Only for saved traces, as
+    // the samples are read without the data lock.
+    template<typename F>
+    void ProcessSamples( TaskDispatch& dispatch, F&& isStopping )
+    {
+        struct Block
+        {
+            const Vector<SampleData>* samples;
+            size_t begin, end;
+            unordered_flat_map<uint32_t, uint32_t> counts;
+        };
+
+        std::vector<Block> blocks;
+        for( auto& td : m_worker.GetThreadData() )
+        {
+            const auto& samples = td->samples;
+            const auto begin = std::distance( samples.begin(), std::lower_bound( samples.begin(), samples.end(), m_t0, [] ( const auto& l, const auto& r ) { return l.time.Val() < r; } ) );
+            const auto end = std::distance( samples.begin(), std::upper_bound( samples.begin(), samples.end(), m_t1, [] ( const auto& l, const auto& r ) { return l < r.time.Val(); } ) );
+            for( size_t i=begin; i<size_t( end ); i+=FlameGraphSampleBlock )
+            {
+                blocks.emplace_back( Block { &samples, i, std::min<size_t>( end, i + FlameGraphSampleBlock ) } );
+            }
+        }
+
+        TaskGroup tasks( dispatch );
+        for( auto& block : blocks )
+        {
+            tasks.Queue( [&block, &isStopping] {
+                if( isStopping() ) return;
+                auto& samples = *block.samples;
+                for( size_t i=block.begin; i<block.end; i++ ) block.counts[samples[i].callstack.Val()]++;
+            } );
+        }
+        tasks.Sync();
+
+        m_counts.clear();
+        for( auto& block : blocks )
+        {
+            for( auto& v : block.counts ) m_counts[v.first] += v.second;
+        }
+        AddCounts();
+    }
+
+    // Zone tree visitor. The time of each zone is added to its node once all of its children were
+    // visited, and the time of top level zones also to the root.
+    uint32_t Enter( const ZoneEvent& zone, int, uint32_t parent )
+    {
+        return GetNode( parent, uint32_t( m_worker.GetZoneSrcLoc( zone ) ) );
+    }
+
+    void Leave( const ZoneEvent& zone, int depth, uint32_t node )
+    {
+        const auto time = ZoneTime( zone, zone.IsEndValid() ? zone.End() : m_fallbackEnd );
+        m_items[node].time += time;
+        if( depth == 0 ) m_items[0].time += time;
+    }
+
+private:
+    struct SampleCursor
+    {
+        size_t pos = std::numeric_limits<size_t>::max();
+        bool done = false;
+    };
+
+    int64_t ZoneTime( const ZoneEvent& zone, int64_t end ) const
+    {
+        return std::max<int64_t>( 0, std::min( end, m_t1 ) - std::max( zone.Start(), m_t0 ) );
+    }
+
+    void AddCounts()
+    {
+        for( auto& v : m_counts )
+        {
+            auto node = GetCallstackNode( v.first );
+            while( node != 0 )
+            {
+                m_items[node].time += v.second;
+                node = m_items[node].parent;
+            }
+            m_items[0].time += v.second;
+        }
+    }
+
+    uint32_t GetCallstackNode( uint32_t callstack )
+    {
+        auto it = m_callstackNodes.find( callstack );
+        if( it != m_callstackNodes.end() ) return it->second;
+
+        // Frames which are not yet resolved may be known later during live capture.
+        bool cacheable = true;
+        uint32_t node = 0;
+        const auto& cs = m_worker.GetCallstack( callstack );
+        for( int i=int( cs.size() )-1; i>=0; i-- )
+        {
+            const auto frameData = m_worker.GetCallstackFrame( cs[i] );
+            if( !frameData )
+            {
+                node = GetNode( node, FlameGraphUnknownFrame );
+                cacheable = false;
+            }
+            else
+            {
+                for( int j=int( frameData->size )-1; j>=0; j-- )
+                {
+                    node = GetNode( node, frameData->data[j].name.Idx() );
+                }
+            }
+        }
+        if( cacheable ) m_callstackNodes.emplace( callstack, node );
+        return node;
+    }
+
+    uint32_t GetNode( uint32_t parent, uint32_t key )
+    {
+        const auto id = ( uint64_t( parent ) << 32 ) | key;
+        auto it = m_nodes.find( id );
+        if( it != m_nodes.end() ) return it->second;
+
+        const auto idx = uint32_t( m_items.size() );
+        m_items.push_back( FlameGraphItem { key, parent, 0, m_items[parent].child, 0 } );
+        m_items[parent].child = idx;
+        m_nodes.emplace( id, idx );
+        return idx;
+    }
+
+    const Worker& m_worker;
+    int64_t m_t0, m_t1;
+    int64_t m_fallbackEnd;
+
+    std::vector<FlameGraphItem> m_items;
+    unordered_flat_map<uint64_t, uint32_t> m_nodes;
+    unordered_flat_map<uint64_t, ZoneTreeWalker> m_walkers;
+    unordered_flat_map<uint64_t, SampleCursor> m_cursors;
+    unordered_flat_map<uint32_t, uint32_t> m_callstackNodes;
+    unordered_flat_map<uint32_t, uint32_t> m_counts;
+    std::vector<std::pair<uint32_t, int64_t>> m_entered;
+};
+
+}
+
+void View::FlameGraphJob( int mode, RangeSlim range, bool isStatic, TaskDispatch* dispatch )
+{
+    const auto t0 = range.active ? range.min : std::numeric_limits<int64_t>::min();
+    const auto t1 = range.active ? range.max : std::numeric_limits<int64_t>::max();
+
+    // Zones which never ended in a saved trace are counted up to the last event of the trace,
+    // instead of being left out of the graph together with all their children.
+    FlameGraphBuilder builder( m_worker, t0, t1, isStatic ? m_worker.GetLastTime() : -1 );
+
+    auto& job = m_flameGraph.job;
+    if( dispatch )
+    {
+        builder.ProcessSamples( *dispatch, [&job] { return job.IsStopping(); } );
+        if( job.IsStopping() ) return;
+        std::lock_guard<std::mutex> lock( m_flameGraph.lock );
+        m_flameGraph.items = builder.Items();
+        m_flameGraph.complete = true;
+        return;
+    }
+
+    auto lastPublish = std::chrono::steady_clock::now();
+    bool dirty = true;
+    for(;;)
+    {
+        bool caughtUp = true;
+        bool open = false;
+        size_t budget = FlameGraphStepBudget;
+        {
+            std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+            if( !isStatic && !job.Lock( lock ) ) return;
+            for( auto& td : m_worker.GetThreadData() )
+            {
+                if( job.IsStopping() ) return;
+                if( mode == m_flameGraph.Zones )
+                {
+                    if( !builder.ProcessZones( *td, budget ) ) caughtUp = false;
+                }
+                else
+                {
+                    if( !builder.ProcessSamples( *td, budget ) ) caughtUp = false;
+                }
+            }
+            if( mode == m_flameGraph.Zones ) open = builder.CollectEntered( m_worker.GetLastTime() );
+        }
+
+        // Copying the tree is not free, so intermediate results are published only periodically.
+        // Zones which haven't ended yet grow with each step.
+        const bool progress = budget != FlameGraphStepBudget;
+        if( progress || open ) dirty = true;
+        const auto now = std::chrono::steady_clock::now();
+        if( caughtUp || ( dirty && now - lastPublish > std::chrono::milliseconds( 100 ) ) )
+        {
+            std::lock_guard<std::mutex> lock( m_flameGraph.lock );
+            if( dirty ) m_flameGraph.items = builder.Items();
+            m_flameGraph.complete = caughtUp;
+            dirty = false;
+            lastPublish = now;
+        }
+        if( isStatic && caughtUp ) return;
+        if( !progress && !job.Wait( 100 ) ) return;
+    }
+}
+
+void View::DrawFlameGraphItem( uint32_t idx, int depth, double pos, double pxscale, const ImVec2& wpos, float w, int& maxDepth )
+{
+    const auto& items = m_flameGraph.items;
+    const auto& item = items[idx];
+    const auto ty = ImGui::GetTextLineHeight();
+    const auto rowHeight = ty + round( GetScale() * 2 );
+    const auto width = item.time * pxscale;
+    if( depth > maxDepth ) maxDepth = depth;
+
+    const char* name;
+    uint32_t color;
+    const SourceLocation* srcloc = nullptr;
+    if( idx == 0 )
+    {
+        name = "Total";
+        color = 0xFF888888;
+    }
+    else if( m_flameGraph.jobMode == m_flameGraph.Zones )
+    {
+        srcloc = &m_worker.GetSourceLocation( int32_t( item.key ) );
+        name = m_worker.GetZoneName( *srcloc );
+        color = GetSrcLocColor( *srcloc, depth );
+    }
+    else if( item.key == FlameGraphUnknownFrame )
+    {
+        name = "[unknown]";
+        color = 0xFF666666;
+    }
+    else
+    {
+        name = m_worker.GetString( StringIdx( item.key ) );
+        color = GetHsvColor( item.key, depth );
+    }
+
+    auto draw = ImGui::GetWindowDrawList();
+    const auto p0 = wpos + ImVec2( float( pos ), depth * rowHeight );
+    const auto p1 = p0 + ImVec2( std::max( 1.f, float( width ) - 1 ), ty );
+    const bool hover = ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect( p0, p1 );
+    draw->AddRectFilled( p0, p1, hover ? HighlightColor( color ) : color );
+    draw->AddRect( p0, p1, DarkenColor( color ) );
+
+    const auto tsz = ImGui::CalcTextSize( name );
+    if( width > ty )
+    {
+        draw->PushClipRect( p0, p1, true );
+        const auto tx = tsz.x < width ? ( width - tsz.x ) / 2 : 2 * GetScale();
+        DrawTextContrast( draw, p0 + ImVec2( float( tx ), 0 ), 0xFFFFFFFF, name );
+        draw->PopClipRect();
+    }
+
+    if( hover )
+    {
+        int64_t childTime = 0;
+        for( auto c = item.child; c != 0; c = items[c].sibling ) childTime += items[c].time;
+
+        ImGui::BeginTooltip();
+        ImGui::TextUnformatted( name );
+        if( srcloc )
+        {
+            ImGui::SameLine();
+            ImGui::TextDisabled( "%s:%i", m_worker.GetString( srcloc->file ), srcloc->line );
+        }
+        ImGui::Separator();
+        const auto total = items[0].time;
+        if( m_flameGraph.jobMode == m_flameGraph.Zones )
+        {
+            TextFocused( "Time:", TimeToString( item.time ) );
+            ImGui::SameLine();
+            ImGui::TextDisabled( "(%.2f%%)", 100. * item.time / total );
+            TextFocused( "Self time:", TimeToString( item.time - childTime ) );
+            ImGui::SameLine();
+            ImGui::TextDisabled( "(%.2f%%)", 100. * ( item.time - childTime ) / total );
+        }
+        else
+        {
+            TextFocused( "Samples:", RealToString( item.time ) );
+            ImGui::SameLine();
+            ImGui::TextDisabled( "(%.2f%%)", 100. * item.time / total );
+            TextFocused( "Self samples:", RealToString( item.time - childTime ) );
+            ImGui::SameLine();
+            ImGui::TextDisabled( "(%.2f%%)", 100. * ( item.time - childTime ) / total );
+        }
+        ImGui::EndTooltip();
+
+        if( ImGui::IsMouseClicked( 0 ) ) m_flameGraph.zoom = idx;
+        if( ImGui::IsMouseClicked( 1 ) ) m_flameGraph.zoom = items[m_flameGraph.zoom].parent;
+    }
+
+    Vector<uint32_t> children;
+    for( auto c = item.child; c != 0; c = items[c].sibling )
+    {
+        if( items[c].time * pxscale >= 1 ) children.push_back( c );
+    }
+    std::sort( children.begin(), children.end(), [&items] ( const auto& l, const auto& r ) { return items[l].time > items[r].time; } );
+    for( auto c : children )
+    {
+        DrawFlameGraphItem( c, depth+1, pos, pxscale, wpos, w, maxDepth );
+        pos += items[c].time * pxscale;
+    }
+}
+
+void View::DrawFlameGraph()
+{
+    const auto scale = GetScale();
+    ImGui::SetNextWindowSize( ImVec2( 1400 * scale, 800 * scale ), ImGuiCond_FirstUseEver );
+    ImGui::Begin( "Flame graph", &m_flameGraph.show );
+    if( ImGui::GetCurrentWindowRead()->SkipItems ) { ImGui::End(); return; }
+
+    if( m_worker.GetCallstackSampleCount() > 0 )
+    {
+        ImGui::TextUnformatted( "Source:" );
+        ImGui::SameLine();
+        ImGui::RadioButton( "Zones", &m_flameGraph.mode, m_flameGraph.Zones );
+        ImGui::SameLine();
+        ImGui::RadioButton( "Samples", &m_flameGraph.mode, m_flameGraph.Samples );
+        ImGui::SameLine();
+        ImGui::Spacing();
+        ImGui::SameLine();
+    }
+    else
+    {
+        m_flameGraph.mode = m_flameGraph.Zones;
+    }
+    if( ImGui::Checkbox( "Limit range", &m_flameGraph.range.active ) )
+    {
+        if( m_flameGraph.range.active && m_flameGraph.range.min == 0 && m_flameGraph.range.max == 0 )
+        {
+            m_flameGraph.range.min = m_vd.zvStart;
+            m_flameGraph.range.max = m_vd.zvEnd;
+        }
+    }
+    if( m_flameGraph.range.active )
+    {
+        ImGui::SameLine();
+        TextColoredUnformatted( 0xFF00FFFF, ICON_FA_TRIANGLE_EXCLAMATION );
+        ImGui::SameLine();
+        ToggleButton( ICON_FA_RULER " Limits", m_showRanges );
+    }
+
+    // The job has to be stopped before the tree lock is taken, as it may be waiting for it.
+    if( m_flameGraph.jobMode >= 0 && ( m_flameGraph.jobMode != m_flameGraph.mode || m_flameGraph.jobRange != m_flameGraph.range ) )
+    {
+        m_flameGraph.job.Stop();
+        m_flameGraph.jobMode = -1;
+        m_flameGraph.items.clear();
+        m_flameGraph.complete = false;
+        m_flameGraph.zoom = 0;
+    }
+    const bool isStatic = m_worker.IsDataStatic();
+    if( m_flameGraph.jobMode < 0 && ( !isStatic || m_worker.IsBackgroundDone() ) )
+    {
+        m_flameGraph.jobMode = m_flameGraph.mode;
+        m_flameGraph.jobRange = m_flameGraph.range;
+        // Samples of saved traces are counted in parallel. The pool is created here, as the
+        // UI thread owns it.
+        auto dispatch = isStatic && m_flameGraph.jobMode == m_flameGraph.Samples ? &GetTaskDispatch() : nullptr;
+        m_flameGraph.job.Start( [this, mode = m_flameGraph.jobMode, range = m_flameGraph.jobRange, isStatic, dispatch] { FlameGraphJob( mode, range, isStatic, dispatch ); } );
+    }
+
+    std::lock_guard<std::mutex> lock( m_flameGraph.lock );
+    const auto& items = m_flameGraph.items;
+    if( items.empty() || items[0].time == 0 )
+    {
+        ImGui::Separator();
+        if( m_flameGraph.complete )
+        {
+            ImGui::TextUnformatted( m_flameGraph.jobMode == m_flameGraph.Zones ? "No zones to display." : "No samples to display." );
+        }
+        else
+        {
+            ImGui::TextUnformatted( "Processing data" );
+            ImGui::SameLine();
+            DrawWaitingDots( s_time );
+        }
+        ImGui::End();
+        return;
+    }
+
+    if( m_flameGraph.zoom >= items.size() ) m_flameGraph.zoom = 0;
+
+    if( m_flameGraph.jobMode == m_flameGraph.Zones )
+    {
+        TextFocused( "Total time:", TimeToString( items[0].time ) );
+    }
+    else
+    {
+        TextFocused( "Total samples:", RealToString( items[0].time ) );
+    }
+    ImGui::SameLine();
+    TextFocused( "Nodes:", RealToString( items.size() ) );
+    if( !m_flameGraph.complete )
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled( "Processing" );
+        ImGui::SameLine();
+        DrawWaitingDots( s_time );
+    }
+    if( m_flameGraph.zoom != 0 )
+    {
+        ImGui::SameLine();
+        if( ImGui::SmallButton( ICON_FA_MAGNIFYING_GLASS_MINUS " Reset zoom" ) ) m_flameGraph.zoom = 0;
+    }
+    ImGui::Separator();
+
+    ImGui::BeginChild( "##flameGraph" );
+    const auto wpos = ImGui::GetCursorScreenPos();
+    const auto w = ImGui::GetContentRegionAvail().x;
+    const auto zoom = m_flameGraph.zoom;
+    int maxDepth = 0;
+    DrawFlameGraphItem( zoom, 0, 0, w / items[zoom].time, wpos, w, maxDepth );
+    ImGui::Dummy( ImVec2( w, ( maxDepth + 1 ) * ( ImGui::GetTextLineHeight() + round( scale * 2 ) ) ) );
+    ImGui::EndChild();
+    ImGui::End();
+}
+
+}
@@ -60,6 +60,37 @@ unordered_flat_map<uint32_t, View::MemPathData> View::GetCallstackPaths( const M
 
     const bool hide_inactive = memRange == MemRange::Active;
 
+    if( memRange == MemRange::Active )
+    {
+        // Live allocations are known without going through all events.
+        auto add = [&pathSum] ( const MemEvent& ev ) {
+            if( ev.CsAlloc() == 0 ) return;
+            auto it = pathSum.find( ev.CsAlloc() );
+            if( it == pathSum.end() )
+            {
+                pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
+            }
+            else
+            {
+                it->second.cnt++;
+                it->second.mem += ev.Size();
+            }
+        };
+        if( m_memInfo.range.active )
+        {
+            auto it = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.min, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
+            auto end = std::lower_bound( it, mem.data.end(), m_memInfo.range.max, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
+            std::vector<uint32_t> live;
+            GetMemIndex( m_memInfo.pool ).GetLive( mem, it - mem.data.begin(), end - mem.data.begin(), m_memInfo.range.max, live );
+            for( auto idx : live ) add( mem.data[idx] );
+        }
+        else
+        {
+            for( auto& v : mem.active ) add( mem.data[v.second] );
+        }
+        return pathSum;
+    }
+
     if( m_memInfo.range.active )
     {
         auto it = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.min, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
@@ -512,7 +543,29 @@ void View::DrawFrameTreeLevel( const unordered_flat_map<uint64_t, MemCallstackFr
                 TextFocused( "Allocations size:", MemSizeToString( v.alloc ) );
                 TextFocused( "Allocations count:", RealToString( v.count ) );
                 TextFocused( "Mean allocation size:", MemSizeToString( v.alloc / v.count ) );
-                ImGui::SameLine();
+                if( m_memAnalysis.valid && m_memAnalysis.pool == m_memInfo.pool )
+                {
+                    MemHistogram hist = {};
+                    for( auto& cs : v.callstacks )
+                    {
+                        auto it = m_memAnalysis.callstacks.find( cs );
+                        if( it == m_memAnalysis.callstacks.end() ) continue;
+                        for( int i=0; i<MemHistogram::Buckets; i++ )
+                        {
+                            hist.lifetime[i] += it->second.lifetime[i];
+                            hist.size[i] += it->second.size[i];
+                        }
+                        hist.active += it->second.active;
+                    }
+                    const auto width = 300 * GetScale();
+                    ImGui::Separator();
+                    TextDisabledUnformatted( "Lifetime" );
+                    ImGui::SameLine();
+                    TextFocused( "Never freed:", RealToString( hist.active ) );
+                    DrawMemHistogram( hist.lifetime, true, width, false );
+                    TextDisabledUnformatted( "Size" );
+                    DrawMemHistogram( hist.size, false, width, false );
+                }
                 ImGui::EndTooltip();
             }
 
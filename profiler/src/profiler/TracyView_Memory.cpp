@@ -1,7 +1,9 @@
+#include <chrono>
 #include <inttypes.h>
 
 #include "TracyImGui.hpp"
 #include "TracyMouse.hpp"
+#include "TracyPopcnt.hpp"
 #include "TracyPrint.hpp"
 #include "TracyView.hpp"
 
@@ -107,54 +109,76 @@ static tracy_force_inline void FillPages( unordered_flat_map<uint64_t, MemoryPag
 
 std::vector<MemoryPage> View::GetMemoryPages() const
 {
+    static_assert( int( MemIndex::ChunkBits ) == int( ChunkBits ), "Memory index footprint granularity differs from memory map" );
+
     std::vector<MemoryPage> ret;
 
     static unordered_flat_map<uint64_t, MemoryPage> memmap;
 
     const auto& mem = m_worker.GetMemoryNamed( m_memInfo.pool );
+    const auto& index = GetMemIndex( m_memInfo.pool );
     const auto memlow = mem.low;
 
-    if( m_memInfo.range.active )
+    // Allocations freed long enough ago all have the same color, which is painted over the whole
+    // address space ever used by the pool. Only allocations live at the reference time, or freed
+    // shortly before it, have to be drawn individually.
+    for( auto& page : index.GetFootprint() )
     {
-        auto it = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.min, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
-        if( it != mem.data.end() )
+        const auto& bits = page.second;
+        const auto base = page.first * MemIndex::PageChunks;
+        size_t b = 0;
+        while( b < MemIndex::PageChunks )
         {
-            auto end = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.max, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
-            while( it != end )
+            if( ( bits[b / 64] & ( uint64_t( 1 ) << ( b % 64 ) ) ) == 0 )
             {
-                auto& alloc = *it++;
-
-                const auto a0 = alloc.Ptr() - memlow;
-                const auto a1 = a0 + alloc.Size();
-                int8_t val = alloc.TimeFree() < 0 ?
-                    int8_t( std::max( int64_t( 1 ), 127 - ( ( m_memInfo.range.max - alloc.TimeAlloc() ) >> 24 ) ) ) :
-                    ( alloc.TimeFree() > m_memInfo.range.max ?
-                        int8_t( std::max( int64_t( 1 ), 127 - ( ( m_memInfo.range.max - alloc.TimeAlloc() ) >> 24 ) ) ) :
-                        int8_t( -std::max( int64_t( 1 ), 127 - ( ( m_memInfo.range.max - alloc.TimeFree() ) >> 24 ) ) ) );
-
-                const auto c0 = a0 >> ChunkBits;
-                const auto c1 = a1 >> ChunkBits;
-
-                FillPages( memmap, c0, c1, val );
+                b++;
+                continue;
             }
+            const auto b0 = b;
+            do { b++; } while( b < MemIndex::PageChunks && ( bits[b / 64] & ( uint64_t( 1 ) << ( b % 64 ) ) ) != 0 );
+
+            const auto p0 = std::max( ( base + b0 ) << ChunkBits, memlow ) - memlow;
+            const auto p1 = ( ( base + b ) << ChunkBits ) - 1 - memlow;
+            FillPages( memmap, p0 >> ChunkBits, p1 >> ChunkBits, -1 );
         }
     }
+
+    int64_t time;
+    size_t first, last;
+    if( m_memInfo.range.active )
+    {
+        time = m_memInfo.range.max;
+        first = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.min, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } ) - mem.data.begin();
+        last = std::lower_bound( mem.data.begin() + first, mem.data.end(), m_memInfo.range.max, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } ) - mem.data.begin();
+    }
     else
     {
-        const auto lastTime = m_worker.GetLastTime();
-        for( auto& alloc : mem.data )
-        {
-            const auto a0 = alloc.Ptr() - memlow;
-            const auto a1 = a0 + alloc.Size();
-            const int8_t val = alloc.TimeFree() < 0 ?
-                int8_t( std::max( int64_t( 1 ), 127 - ( ( lastTime - std::min( lastTime, alloc.TimeAlloc() ) ) >> 24 ) ) ) :
-                int8_t( -std::max( int64_t( 1 ), 127 - ( ( lastTime - std::min( lastTime, alloc.TimeFree() ) ) >> 24 ) ) );
+        time = m_worker.GetLastTime();
+        first = 0;
+        last = mem.data.size();
+    }
 
-            const auto c0 = a0 >> ChunkBits;
-            const auto c1 = a1 >> ChunkBits;
+    std::vector<uint32_t> events;
+    index.GetLive( mem, first, last, time, events );
+    index.GetFreed( mem, first, last, time - ( int64_t( 126 ) << 24 ), time, events );
+    pdqsort_branchless( events.begin(), events.end() );
+    events.erase( std::unique( events.begin(), events.end() ), events.end() );
 
-            FillPages( memmap, c0, c1, val );
-        }
+    for( auto idx : events )
+    {
+        auto& alloc = mem.data[idx];
+
+        const auto a0 = alloc.Ptr() - memlow;
+        const auto a1 = a0 + alloc.Size();
+        const auto tf = alloc.TimeFree();
+        const int8_t val = tf < 0 || tf > time ?
+            int8_t( std::max( int64_t( 1 ), 127 - ( ( time - std::min( time, alloc.TimeAlloc() ) ) >> 24 ) ) ) :
+            int8_t( -std::max( int64_t( 1 ), 127 - ( ( time - tf ) >> 24 ) ) );
+
+        const auto c0 = a0 >> ChunkBits;
+        const auto c1 = a1 >> ChunkBits;
+
+        FillPages( memmap, c0, c1, val );
     }
 
     std::vector<unordered_flat_map<uint64_t, MemoryPage>::const_iterator> itmap;
@@ -168,6 +192,374 @@ std::vector<MemoryPage> View::GetMemoryPages() const
     return ret;
 }
 
+static tracy_force_inline int MemHistogramBucket( uint64_t val )
+{
+    if( val == 0 ) return 0;
+    return std::min( int( MemHistogram::Buckets - 1 ), int( 64 - TracyLzcnt( val ) ) );
+}
+
+static void MergeMemHistogram( MemHistogram& dst, const MemHistogram& src )
+{
+    for( int i=0; i<MemHistogram::Buckets; i++ )
+    {
+        dst.lifetime[i] += src.lifetime[i];
+        dst.size[i] += src.size[i];
+    }
+    dst.active += src.active;
+}
+
+static void CalcMemHistograms( const MemData& mem, size_t i0, size_t i1, unordered_flat_map<uint32_t, MemHistogram>& out )
+{
+    for( size_t i=i0; i<i1; i++ )
+    {
+        auto& ev = mem.data[i];
+        auto it = out.find( ev.CsAlloc() );
+        if( it == out.end() ) it = out.emplace( ev.CsAlloc(), MemHistogram {} ).first;
+        auto& hist = it->second;
+        hist.size[MemHistogramBucket( ev.Size() )]++;
+        if( ev.TimeFree() < 0 )
+        {
+            hist.active++;
+        }
+        else
+        {
+            hist.lifetime[MemHistogramBucket( ev.TimeFree() - ev.TimeAlloc() )]++;
+        }
+    }
+}
+
+static void CalcMemFragmentation( const MemData& mem, const MemIndex& index, int64_t time, MemFragmentation& out )
+{
+    const auto last = std::upper_bound( mem.data.begin(), mem.data.end(), time, [] ( const auto& l, const auto& r ) { return l < r.TimeAlloc(); } ) - mem.data.begin();
+    std::vector<uint32_t> live;
+    index.GetLive( mem, 0, last, time, live );
+
+    uint64_t usage = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> pages;
+    pages.reserve( live.size() );
+    for( auto idx : live )
+    {
+        auto& ev = mem.data[idx];
+        if( ev.Size() == 0 ) continue;
+        usage += ev.Size();
+        pages.emplace_back( ev.Ptr() >> 12, ( ev.Ptr() + ev.Size() - 1 ) >> 12 );
+    }
+    pdqsort_branchless( pages.begin(), pages.end() );
+
+    uint64_t num = 0;
+    if( !pages.empty() )
+    {
+        auto cur = pages[0];
+        for( auto& v : pages )
+        {
+            if( v.first > cur.second )
+            {
+                num += cur.second - cur.first + 1;
+                cur = v;
+            }
+            else if( v.second > cur.second )
+            {
+                cur.second = v.second;
+            }
+        }
+        num += cur.second - cur.first + 1;
+    }
+
+    out = MemFragmentation { time, usage, num };
+}
+
+void View::UpdateMemoryAnalysis( const MemData& mem )
+{
+    auto& ma = m_memAnalysis;
+    const bool sameInput = ma.pool == m_memInfo.pool && ma.range == m_memInfo.range;
+
+    auto finish = [&ma] {
+        ma.callstacks.clear();
+        ma.total = MemHistogram {};
+        for( auto& block : ma.blocks )
+        {
+            for( auto& v : block )
+            {
+                auto it = ma.callstacks.find( v.first );
+                if( it == ma.callstacks.end() ) it = ma.callstacks.emplace( v.first, MemHistogram {} ).first;
+                MergeMemHistogram( it->second, v.second );
+                MergeMemHistogram( ma.total, v.second );
+            }
+        }
+        ma.blocks.clear();
+        ma.valid = true;
+    };
+
+    if( ma.active )
+    {
+        if( !sameInput )
+        {
+            m_memAnalysisTasks->Cancel();
+            m_memAnalysisTasks->Sync();
+            ma.active = false;
+            ma.valid = false;
+        }
+        else if( ma.done.load( std::memory_order_acquire ) == ma.jobs )
+        {
+            m_memAnalysisTasks->Sync();
+            ma.active = false;
+            finish();
+        }
+        if( ma.active ) return;
+    }
+
+    const bool isStatic = m_worker.IsDataStatic();
+    if( ma.valid && sameInput && !ma.refresh && ( !isStatic || ma.events == mem.data.size() ) ) return;
+    // Fragmentation sampling relies on the live allocation index.
+    const auto& index = GetMemIndex( m_memInfo.pool );
+    if( index.IsEmpty() && !mem.data.empty() ) return;
+
+    ma.refresh = false;
+    ma.valid = false;
+    ma.pool = m_memInfo.pool;
+    ma.range = m_memInfo.range;
+    ma.events = mem.data.size();
+
+    size_t first = 0;
+    size_t last = mem.data.size();
+    int64_t t0 = 0;
+    int64_t t1 = 0;
+    if( m_memInfo.range.active )
+    {
+        first = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.min, [] ( const auto& l, const auto& r ) { return l.TimeAlloc() < r; } ) - mem.data.begin();
+        last = std::lower_bound( mem.data.begin() + first, mem.data.end(), m_memInfo.range.max, [] ( const auto& l, const auto& r ) { return l.TimeAlloc() < r; } ) - mem.data.begin();
+        t0 = m_memInfo.range.min;
+        t1 = m_memInfo.range.max;
+    }
+    else if( !mem.data.empty() )
+    {
+        t0 = mem.data.front().TimeAlloc();
+        t1 = m_worker.GetLastTime();
+    }
+
+    const auto blocks = ( last - first + ma.BlockSize - 1 ) / ma.BlockSize;
+    ma.blocks.clear();
+    ma.blocks.resize( blocks );
+    ma.fragmentation.resize( mem.data.empty() ? 0 : ma.Samples );
+    for( size_t i=0; i<ma.fragmentation.size(); i++ )
+    {
+        ma.fragmentation[i].time = t0 + int64_t( double( t1 - t0 ) * i / ( ma.Samples - 1 ) );
+    }
+
+    if( !isStatic )
+    {
+        // Frees of a live capture update events in place, so a consistent snapshot can only be
+        // taken while the data lock is held. The analysis is refreshed on request.
+        for( size_t i=0; i<blocks; i++ )
+        {
+            CalcMemHistograms( mem, first + i * ma.BlockSize, std::min<size_t>( last, first + ( i+1 ) * ma.BlockSize ), ma.blocks[i] );
+        }
+        for( auto& v : ma.fragmentation ) CalcMemFragmentation( mem, index, v.time, v );
+        finish();
+        return;
+    }
+
+    if( !m_memAnalysisTasks ) m_memAnalysisTasks = std::make_unique<TaskGroup>( GetTaskDispatch() );
+    ma.active = true;
+    ma.jobs = blocks + ( ma.fragmentation.size() + ma.SamplesPerTask - 1 ) / ma.SamplesPerTask;
+    ma.done.store( 0, std::memory_order_relaxed );
+
+    for( size_t i=0; i<blocks; i++ )
+    {
+        m_memAnalysisTasks->Queue( [this, &mem, i, i0 = first + i * ma.BlockSize, i1 = std::min<size_t>( last, first + ( i+1 ) * ma.BlockSize )] {
+            if( !m_memAnalysisTasks->IsCancelled() ) CalcMemHistograms( mem, i0, i1, m_memAnalysis.blocks[i] );
+            m_memAnalysis.done.fetch_add( 1, std::memory_order_release );
+        } );
+    }
+    for( size_t i=0; i<ma.fragmentation.size(); i+=ma.SamplesPerTask )
+    {
+        m_memAnalysisTasks->Queue( [this, &mem, &index, i] {
+            auto& frag = m_memAnalysis.fragmentation;
+            const auto end = std::min<size_t>( frag.size(), i + m_memAnalysis.SamplesPerTask );
+            for( size_t j=i; j<end; j++ )
+            {
+                if( m_memAnalysisTasks->IsCancelled() ) break;
+                CalcMemFragmentation( mem, index, frag[j].time, frag[j] );
+            }
+            m_memAnalysis.done.fetch_add( 1, std::memory_order_release );
+        } );
+    }
+}
+
+void View::DrawMemHistogram( const uint64_t* data, bool time, float width, bool tooltip )
+{
+    int b0 = 0;
+    int b1 = MemHistogram::Buckets - 1;
+    while( b0 < b1 && data[b0] == 0 ) b0++;
+    while( b1 > b0 && data[b1] == 0 ) b1--;
+    uint64_t maxVal = 1;
+    for( int i=b0; i<=b1; i++ ) maxVal = std::max( maxVal, data[i] );
+
+    auto bucketLabel = [time] ( int bucket ) {
+        const auto val = bucket == 0 ? 0 : int64_t( 1 ) << ( bucket - 1 );
+        return time ? TimeToString( val ) : MemSizeToString( val );
+    };
+
+    const auto scale = GetScale();
+    const auto h = 60 * scale;
+    const auto num = b1 - b0 + 1;
+    const auto bw = std::max( 1.f, width / num );
+    auto draw = ImGui::GetWindowDrawList();
+    const auto wpos = ImGui::GetCursorScreenPos();
+    draw->AddRectFilled( wpos, wpos + ImVec2( width, h ), 0x22FFFFFF );
+    for( int i=0; i<num; i++ )
+    {
+        const auto val = data[b0 + i];
+        if( val == 0 ) continue;
+        const auto bh = std::max( 1.f, float( h * val / maxVal ) );
+        draw->AddRectFilled( wpos + ImVec2( i * bw + 1, h - bh ), wpos + ImVec2( ( i+1 ) * bw - 1, h ), 0xFF22DDDD );
+    }
+    ImGui::Dummy( ImVec2( width, h ) );
+    if( tooltip && ImGui::IsItemHovered() )
+    {
+        const auto bucket = b0 + std::clamp( int( ( ImGui::GetIO().MousePos.x - wpos.x ) / bw ), 0, num - 1 );
+        ImGui::BeginTooltip();
+        if( bucket == MemHistogram::Buckets - 1 )
+        {
+            TextFocused( "Range:", bucketLabel( bucket ) );
+            ImGui::SameLine();
+            ImGui::TextUnformatted( "and more" );
+        }
+        else
+        {
+            TextDisabledUnformatted( "Range:" );
+            ImGui::SameLine();
+            ImGui::Text( "%s - ", bucketLabel( bucket ) );
+            ImGui::SameLine( 0, 0 );
+            ImGui::TextUnformatted( bucketLabel( bucket + 1 ) );
+        }
+        TextFocused( "Count:", RealToString( data[bucket] ) );
+        ImGui::EndTooltip();
+    }
+    TextDisabledUnformatted( bucketLabel( b0 ) );
+    const auto last = b1 == MemHistogram::Buckets - 1 ? bucketLabel( b1 ) : bucketLabel( b1 + 1 );
+    ImGui::SameLine( std::max( 0.f, width - ImGui::CalcTextSize( last ).x ) );
+    TextDisabledUnformatted( last );
+}
+
+void View::DrawMemoryAnalysis( const MemData& mem )
+{
+    UpdateMemoryAnalysis( mem );
+
+    auto& ma = m_memAnalysis;
+    if( !m_worker.IsDataStatic() )
+    {
+        if( ImGui::SmallButton( "Recalculate" ) ) ma.refresh = true;
+        ImGui::SameLine();
+        DrawHelpMarker( "The analysis of live captures is only updated on request." );
+    }
+    if( ma.active )
+    {
+        ImGui::TextUnformatted( "Calculating..." );
+        ImGui::SameLine();
+        ImGui::TextDisabled( "(%.0f%%)", 100.f * ma.done.load( std::memory_order_relaxed ) / ma.jobs );
+        return;
+    }
+    if( !ma.valid )
+    {
+        TextDisabledUnformatted( "Waiting for memory index..." );
+        return;
+    }
+
+    const auto width = std::min( ImGui::GetContentRegionAvail().x, 800 * GetScale() );
+
+    TextDisabledUnformatted( "Allocation lifetime" );
+    ImGui::SameLine();
+    ImGui::Spacing();
+    ImGui::SameLine();
+    TextFocused( "Never freed:", RealToString( ma.total.active ) );
+    DrawMemHistogram( ma.total.lifetime, true, width, true );
+    ImGui::Spacing();
+    TextDisabledUnformatted( "Allocation size" );
+    DrawMemHistogram( ma.total.size, false, width, true );
+
+    ImGui::Spacing();
+    TextDisabledUnformatted( "Fragmentation" );
+    ImGui::SameLine();
+    DrawHelpMarker( "Part of the 4 KB pages touched by live allocations which is not used by them. Click to center timeline at the sample time." );
+    if( ma.fragmentation.size() < 2 ) return;
+
+    const auto h = 80 * GetScale();
+    auto draw = ImGui::GetWindowDrawList();
+    const auto wpos = ImGui::GetCursorScreenPos();
+    const auto step = width / ( ma.fragmentation.size() - 1 );
+    draw->AddRectFilled( wpos, wpos + ImVec2( width, h ), 0x22FFFFFF );
+    auto fragmentation = [] ( const MemFragmentation& v ) { return v.pages == 0 ? 0. : 1. - double( v.usage ) / ( v.pages * 4096 ); };
+    for( size_t i=1; i<ma.fragmentation.size(); i++ )
+    {
+        const auto y0 = h * ( 1 - fragmentation( ma.fragmentation[i-1] ) );
+        const auto y1 = h * ( 1 - fragmentation( ma.fragmentation[i] ) );
+        DrawLine( draw, wpos + ImVec2( ( i-1 ) * step, y0 ), wpos + ImVec2( i * step, y1 ), 0xFF22DDDD );
+    }
+    ImGui::Dummy( ImVec2( width, h ) );
+    if( ImGui::IsItemHovered() )
+    {
+        const auto idx = std::clamp<int>( int( ( ImGui::GetIO().MousePos.x - wpos.x ) / step + 0.5f ), 0, int( ma.fragmentation.size() - 1 ) );
+        auto& v = ma.fragmentation[idx];
+        draw->AddLine( wpos + ImVec2( idx * step, 0 ), wpos + ImVec2( idx * step, h ), 0x88FFFFFF );
+        ImGui::BeginTooltip();
+        TextFocused( "Time:", TimeToStringExact( v.time ) );
+        TextFocused( "Memory usage:", MemSizeToString( v.usage ) );
+        TextFocused( "Touched pages:", MemSizeToString( v.pages * 4096 ) );
+        TextDisabledUnformatted( "Fragmentation:" );
+        ImGui::SameLine();
+        ImGui::Text( "%.2f%%", fragmentation( v ) * 100 );
+        ImGui::EndTooltip();
+        if( ImGui::IsItemClicked() ) CenterAtTime( v.time );
+    }
+}
+
+const MemIndex& View::GetMemIndex( uint64_t pool ) const
+{
+    auto it = m_memIndex.pools.find( pool );
+    return it != m_memIndex.pools.end() ? *it->second : m_memIndex.empty;
+}
+
+void View::MemIndexJob( bool isStatic )
+{
+    auto& job = m_memIndex.job;
+
+    if( isStatic )
+    {
+        // Frees are put in time order by the worker, after the trace is loaded.
+        while( !IsBackgroundDone() )
+        {
+            if( !job.Wait( 10 ) ) return;
+        }
+        for( auto& v : m_worker.GetMemNameMap() )
+        {
+            if( job.IsStopping() ) return;
+            auto index = std::make_unique<MemIndex>();
+            index->Update( *v.second );
+
+            std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+            if( !job.Lock( lock ) ) return;
+            m_memIndex.pools.emplace( v.first, std::move( index ) );
+        }
+        return;
+    }
+
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+            if( !job.Lock( lock ) ) return;
+            for( auto& v : m_worker.GetMemNameMap() )
+            {
+                auto it = m_memIndex.pools.find( v.first );
+                if( it == m_memIndex.pools.end() ) it = m_memIndex.pools.emplace( v.first, std::make_unique<MemIndex>() ).first;
+                it->second->Update( *v.second );
+            }
+        }
+        if( !job.Wait( 100 ) ) return;
+    }
+}
+
 void View::DrawMemory()
 {
     const auto scale = GetScale();
@@ -175,6 +567,11 @@ void View::DrawMemory()
     ImGui::Begin( "Memory", &m_memInfo.show, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse );
     if( ImGui::GetCurrentWindowRead()->SkipItems ) { ImGui::End(); return; }
 
+    if( !m_memIndex.job.IsStarted() )
+    {
+        m_memIndex.job.Start( [this, isStatic = m_worker.IsDataStatic()] { MemIndexJob( isStatic ); } );
+    }
+
     auto& memNameMap = m_worker.GetMemNameMap();
     if( memNameMap.size() > 1 )
     {
@@ -328,19 +725,13 @@ void View::DrawMemory()
         if( m_memInfo.range.active )
         {
             auto it = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
-            if( it != mem.data.end() )
+            auto end = std::lower_bound( it, mem.data.end(), m_memInfo.range.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
+            std::vector<uint32_t> live;
+            GetMemIndex( m_memInfo.pool ).GetLive( mem, it - mem.data.begin(), end - mem.data.begin(), m_memInfo.range.max, live );
+            for( auto idx : live )
             {
-                auto end = std::lower_bound( it, mem.data.end(), m_memInfo.range.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
-                while( it != end )
-                {
-                    const auto tf = it->TimeFree();
-                    if( tf < 0 || tf >= m_memInfo.range.max )
-                    {
-                        items.emplace_back( it );
-                        total += it->Size();
-                    }
-                    ++it;
-                }
+                items.emplace_back( mem.data.data() + idx );
+                total += mem.data[idx].Size();
             }
         }
         else
@@ -426,6 +817,15 @@ void View::DrawMemory()
         ImGui::TreePop();
     }
 
+    ImGui::Separator();
+    if( ImGui::TreeNode( ICON_FA_CHART_COLUMN " Lifetime and fragmentation" ) )
+    {
+        ImGui::SameLine();
+        DrawHelpMarker( "Statistics of allocations made in the selected range. Lifetime and size distributions of call stacks are shown in the call stack tree tooltips." );
+        DrawMemoryAnalysis( mem );
+        ImGui::TreePop();
+    }
+
     ImGui::PushID( m_memInfo.pool );
     ImGui::Separator();
     if( ImGui::TreeNode( ICON_FA_TREE " Bottom-up call stack tree" ) )
@@ -594,7 +994,7 @@ void View::DrawMemoryAllocWindow()
         {
             ImGui::Separator();
             sep = true;
-            const auto& srcloc = m_worker.GetSourceLocation( zoneAlloc->SrcLoc() );
+            const auto& srcloc = m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( *zoneAlloc ) );
             const auto txt = srcloc.name.active ? m_worker.GetString( srcloc.name ) : m_worker.GetString( srcloc.function );
             ImGui::PushID( idx++ );
             TextFocused( "Zone alloc:", txt );
@@ -621,7 +1021,7 @@ void View::DrawMemoryAllocWindow()
             if( zoneFree )
             {
                 if( !sep ) ImGui::Separator();
-                const auto& srcloc = m_worker.GetSourceLocation( zoneFree->SrcLoc() );
+                const auto& srcloc = m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( *zoneFree ) );
                 const auto txt = srcloc.name.active ? m_worker.GetString( srcloc.name ) : m_worker.GetString( srcloc.function );
                 TextFocused( "Zone free:", txt );
                 auto hover = ImGui::IsItemHovered();
@@ -809,7 +1209,7 @@ void View::ListMemData( std::vector<const MemEvent*>& vec, const std::function<v
                 }
                 else
                 {
-                    const auto& srcloc = m_worker.GetSourceLocation( zone->SrcLoc() );
+                    const auto& srcloc = m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( *zone ) );
                     const auto txt = srcloc.name.active ? m_worker.GetString( srcloc.name ) : m_worker.GetString( srcloc.function );
                     ImGui::PushID( idx++ );
                     auto sel = ImGui::Selectable( txt, m_zoneInfoWindow == zone );
@@ -843,7 +1243,7 @@ void View::ListMemData( std::vector<const MemEvent*>& vec, const std::function<v
                     }
                     else
                     {
-                        const auto& srcloc = m_worker.GetSourceLocation( zoneFree->SrcLoc() );
+                        const auto& srcloc = m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( *zoneFree ) );
                         const auto txt = srcloc.name.active ? m_worker.GetString( srcloc.name ) : m_worker.GetString( srcloc.function );
                         ImGui::PushID( idx++ );
                         bool sel;
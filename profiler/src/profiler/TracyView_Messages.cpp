@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
 #include "TracyImGui.hpp"
+#include "TracyMouse.hpp"
 #include "TracyPrint.hpp"
 #include "TracyTexture.hpp"
 #include "TracyView.hpp"
@@ -6,6 +11,8 @@
 namespace tracy
 {
 
+extern double s_time;
+
 void View::DrawMessages()
 {
     const auto& msgs = m_worker.GetMessages();
@@ -22,6 +29,12 @@ void View::DrawMessages()
         return;
     }
 
+    if( !m_textIndex.job.IsStarted() )
+    {
+        m_textIndex.isStatic = m_worker.IsDataStatic();
+        m_textIndex.job.Start( [this, isStatic = m_textIndex.isStatic] { TextIndexJob( isStatic ); } );
+    }
+
     size_t tsz = 0;
     for( const auto& t : m_threadOrder ) if( !t->messages.empty() ) tsz++;
 
@@ -33,6 +46,25 @@ void View::DrawMessages()
         filterChanged = true;
     }
     ImGui::SameLine();
+    if( ImGui::Checkbox( "Regex", &m_messageRegex ) ) filterChanged = true;
+    if( filterChanged && m_messageRegex )
+    {
+        try
+        {
+            m_messageRe = std::regex( m_messageFilter.InputBuf, std::regex::ECMAScript | std::regex::icase );
+            m_messageRegexValid = true;
+        }
+        catch( const std::regex_error& )
+        {
+            m_messageRegexValid = false;
+        }
+    }
+    if( m_messageRegex && !m_messageRegexValid )
+    {
+        ImGui::SameLine();
+        TextColoredUnformatted( ImVec4( 1.f, 0.3f, 0.3f, 1.f ), ICON_FA_TRIANGLE_EXCLAMATION " Invalid regex" );
+    }
+    ImGui::SameLine();
     ImGui::Spacing();
     ImGui::SameLine();
     TextFocused( "Total message count:", RealToString( msgs.size() ) );
@@ -104,28 +136,38 @@ void View::DrawMessages()
         ImGui::TreePop();
     }
 
+    const bool filterActive = m_messageRegex ? m_messageFilter.InputBuf[0] != '\0' : m_messageFilter.IsActive();
     const bool msgsChanged = msgs.size() != m_prevMessages;
     if( filterChanged || threadsChanged )
     {
         bool showCallstack = false;
         m_msgList.reserve( msgs.size() );
         m_msgList.clear();
-        if( m_messageFilter.IsActive() )
+        if( filterActive )
         {
-            for( size_t i=0; i<msgs.size(); i++ )
-            {
+            auto test = [&] ( size_t i ) {
                 const auto& v = msgs[i];
                 const auto tid = m_worker.DecompressThread( v->thread );
                 if( VisibleMsgThread( tid ) )
                 {
                     const auto text = m_worker.GetString( msgs[i]->ref );
-                    if( m_messageFilter.PassFilter( text ) )
+                    if( PassMessageFilter( text ) )
                     {
                         if( !showCallstack && msgs[i]->callstack.Val() != 0 ) showCallstack = true;
                         m_msgList.push_back_no_space_check( uint32_t( i ) );
                     }
                 }
+            };
+
+            // Only blocks of indexed messages which may pass the filter have to be checked.
+            std::vector<uint32_t> blocks;
+            const auto indexed = GetMessageFilterCandidates( blocks );
+            for( auto b : blocks )
+            {
+                const auto end = std::min<size_t>( ( size_t( b ) + 1 ) << TextIndex::BlockBits, indexed );
+                for( size_t i=size_t( b ) << TextIndex::BlockBits; i<end; i++ ) test( i );
             }
+            for( size_t i=indexed; i<msgs.size(); i++ ) test( i );
         }
         else
         {
@@ -149,7 +191,7 @@ void View::DrawMessages()
         assert( m_prevMessages < msgs.size() );
         bool showCallstack = m_messagesShowCallstack;
         m_msgList.reserve( msgs.size() );
-        if( m_messageFilter.IsActive() )
+        if( filterActive )
         {
             for( size_t i=m_prevMessages; i<msgs.size(); i++ )
             {
@@ -158,7 +200,7 @@ void View::DrawMessages()
                 if( VisibleMsgThread( tid ) )
                 {
                     const auto text = m_worker.GetString( msgs[i]->ref );
-                    if( m_messageFilter.PassFilter( text ) )
+                    if( PassMessageFilter( text ) )
                     {
                         if( !showCallstack && msgs[i]->callstack.Val() != 0 ) showCallstack = true;
                         m_msgList.push_back_no_space_check( uint32_t( i ) );
@@ -228,6 +270,261 @@ void View::DrawMessages()
     ImGui::End();
 }
 
+bool View::PassMessageFilter( const char* text ) const
+{
+    if( !m_messageRegex ) return m_messageFilter.PassFilter( text );
+    return m_messageRegexValid && std::regex_search( text, m_messageRe );
+}
+
+size_t View::GetMessageFilterCandidates( std::vector<uint32_t>& blocks ) const
+{
+    auto& index = m_textIndex.messages;
+    if( !index ) return 0;
+
+    if( m_messageRegex )
+    {
+        if( !m_messageRegexValid ) return index->Size();
+        std::vector<std::string> literals;
+        TextIndex::GetRegexLiterals( m_messageFilter.InputBuf, literals );
+        return index->Find( literals, blocks ) ? index->Size() : 0;
+    }
+
+    // Messages have to contain one of the filter words, unless there are only exclusions.
+    bool positive = false;
+    std::vector<std::string> word( 1 );
+    std::vector<uint32_t> found, merged;
+    for( auto& f : m_messageFilter.Filters )
+    {
+        if( f.empty() || f.b[0] == '-' ) continue;
+        positive = true;
+        word[0].assign( f.b, f.e );
+        if( !index->Find( word, found ) ) return 0;
+        merged.clear();
+        std::set_union( blocks.begin(), blocks.end(), found.begin(), found.end(), std::back_inserter( merged ) );
+        blocks.swap( merged );
+    }
+    return positive ? index->Size() : 0;
+}
+
+void View::TextIndexJob( bool isStatic )
+{
+    auto& job = m_textIndex.job;
+
+    if( isStatic )
+    {
+        auto& msgs = m_worker.GetMessages();
+        auto messages = std::make_unique<TextIndex>();
+        for( size_t i=0; i<msgs.size(); i++ )
+        {
+            if( ( i & 0xFFFF ) == 0 && job.IsStopping() ) return;
+            messages->Add( m_worker.GetString( msgs[i]->ref ) );
+        }
+        {
+            std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+            if( !job.Lock( lock ) ) return;
+            m_textIndex.messages = std::move( messages );
+        }
+
+        auto zones = std::make_unique<TextIndex>();
+        std::vector<const ZoneEvent*> zoneList;
+        size_t visited = 0;
+        for( auto& td : m_worker.GetThreadData() )
+        {
+            // A single thread may have hundreds of millions of zones, so the walk itself has to be stoppable.
+            const auto done = m_worker.QueryThreadZones( *td, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), [&] ( const ZoneEvent& zone, int ) {
+                if( ( visited++ & 0xFFFF ) == 0 && job.IsStopping() ) return false;
+                if( !m_worker.HasZoneExtra( zone ) ) return true;
+                auto& extra = m_worker.GetZoneExtra( zone );
+                if( !extra.text.Active() ) return true;
+                zoneList.emplace_back( &zone );
+                zones->Add( m_worker.GetString( extra.text ) );
+                return true;
+            } );
+            if( !done || job.IsStopping() ) return;
+        }
+        std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+        if( !job.Lock( lock ) ) return;
+        m_textIndex.zones = std::move( zones );
+        m_textIndex.zoneList = std::move( zoneList );
+        return;
+    }
+
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+            if( !job.Lock( lock ) ) return;
+            if( !m_textIndex.messages ) m_textIndex.messages = std::make_unique<TextIndex>();
+            auto& index = *m_textIndex.messages;
+            auto& msgs = m_worker.GetMessages();
+            // Limit the work done while the UI is blocked.
+            const auto end = std::min<size_t>( msgs.size(), index.Size() + 256 * 1024 );
+            for( size_t i=index.Size(); i<end; i++ ) index.Add( m_worker.GetString( msgs[i]->ref ) );
+        }
+        if( !job.Wait( 100 ) ) return;
+    }
+}
+
+void View::FindZoneText()
+{
+    m_zoneText.result.clear();
+    m_zoneText.invalid = false;
+    if( m_zoneText.pattern[0] == '\0' ) return;
+
+    std::regex re;
+    std::vector<std::string> literals;
+    if( m_zoneText.regex )
+    {
+        try
+        {
+            re = std::regex( m_zoneText.pattern, std::regex::ECMAScript | std::regex::icase );
+        }
+        catch( const std::regex_error& )
+        {
+            m_zoneText.invalid = true;
+            return;
+        }
+        TextIndex::GetRegexLiterals( m_zoneText.pattern, literals );
+    }
+    else
+    {
+        literals.emplace_back( m_zoneText.pattern );
+    }
+
+    auto test = [this, &re] ( const ZoneEvent* zone ) {
+        const auto text = m_worker.GetString( m_worker.GetZoneExtra( *zone ).text );
+        if( m_zoneText.regex ? std::regex_search( text, re ) : ImStristr( text, nullptr, m_zoneText.pattern, nullptr ) != nullptr )
+        {
+            m_zoneText.result.emplace_back( zone );
+        }
+    };
+
+    auto& list = m_textIndex.zoneList;
+    std::vector<uint32_t> blocks;
+    if( m_textIndex.zones->Find( literals, blocks ) )
+    {
+        for( auto b : blocks )
+        {
+            const auto end = std::min<size_t>( ( size_t( b ) + 1 ) << TextIndex::BlockBits, list.size() );
+            for( size_t i=size_t( b ) << TextIndex::BlockBits; i<end; i++ ) test( list[i] );
+        }
+    }
+    else
+    {
+        for( auto& v : list ) test( v );
+    }
+    pdqsort_branchless( m_zoneText.result.begin(), m_zoneText.result.end(), []( const auto& l, const auto& r ) { return l->Start() < r->Start(); } );
+}
+
+void View::DrawZoneTextSearch()
+{
+    const auto scale = GetScale();
+    ImGui::SetNextWindowSize( ImVec2( 1000 * scale, 500 * scale ), ImGuiCond_FirstUseEver );
+    ImGui::Begin( "Zone text", &m_zoneText.show, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse );
+    if( ImGui::GetCurrentWindowRead()->SkipItems ) { ImGui::End(); return; }
+
+    if( !m_textIndex.job.IsStarted() )
+    {
+        m_textIndex.isStatic = m_worker.IsDataStatic();
+        m_textIndex.job.Start( [this, isStatic = m_textIndex.isStatic] { TextIndexJob( isStatic ); } );
+    }
+    if( !m_textIndex.isStatic )
+    {
+        ImGui::TextWrapped( "Zone text can be searched in saved traces." );
+        ImGui::End();
+        return;
+    }
+    if( !m_textIndex.zones )
+    {
+        ImGui::TextUnformatted( "Indexing zone text" );
+        ImGui::SameLine();
+        DrawWaitingDots( s_time );
+        ImGui::End();
+        return;
+    }
+
+    ImGui::PushItemWidth( -0.01f );
+    bool findClicked = ImGui::InputTextWithHint( "###zoneText", "Enter text to search for", m_zoneText.pattern, 1024, ImGuiInputTextFlags_EnterReturnsTrue );
+    ImGui::PopItemWidth();
+
+    findClicked |= ImGui::Button( ICON_FA_MAGNIFYING_GLASS " Find" );
+    ImGui::SameLine();
+    if( ImGui::Button( ICON_FA_BAN " Clear" ) )
+    {
+        m_zoneText.pattern[0] = '\0';
+        m_zoneText.result.clear();
+        m_zoneText.invalid = false;
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox( "Regex", &m_zoneText.regex );
+    ImGui::SameLine();
+    DrawHelpMarker( "Search is case insensitive." );
+    if( findClicked ) FindZoneText();
+
+    TextFocused( "Zones with text:", RealToString( m_textIndex.zoneList.size() ) );
+    ImGui::SameLine();
+    ImGui::Spacing();
+    ImGui::SameLine();
+    TextFocused( "Found zones:", RealToString( m_zoneText.result.size() ) );
+    if( m_zoneText.invalid )
+    {
+        ImGui::SameLine();
+        TextColoredUnformatted( ImVec4( 1.f, 0.3f, 0.3f, 1.f ), ICON_FA_TRIANGLE_EXCLAMATION " Invalid regex" );
+    }
+
+    ImGui::Separator();
+    ImGui::BeginChild( "##zoneText" );
+    if( ImGui::BeginTable( "##zoneText", 4, ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Hideable ) )
+    {
+        ImGui::TableSetupScrollFreeze( 0, 1 );
+        ImGui::TableSetupColumn( "Time", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize );
+        ImGui::TableSetupColumn( "Thread" );
+        ImGui::TableSetupColumn( "Zone" );
+        ImGui::TableSetupColumn( "Text", ImGuiTableColumnFlags_WidthStretch );
+        ImGui::TableHeadersRow();
+
+        ImGuiListClipper clipper;
+        clipper.Begin( m_zoneText.result.size() );
+        while( clipper.Step() )
+        {
+            for( auto i=clipper.DisplayStart; i<clipper.DisplayEnd; i++ )
+            {
+                auto ev = m_zoneText.result[i];
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::PushID( ev );
+                if( ImGui::Selectable( TimeToStringExact( ev->Start() ), m_zoneInfoWindow == ev, ImGuiSelectableFlags_SpanAllColumns ) )
+                {
+                    ShowZoneInfo( *ev );
+                }
+                if( ImGui::IsItemHovered() )
+                {
+                    m_zoneHighlight = ev;
+                    if( IsMouseClicked( 2 ) )
+                    {
+                        ZoomToZone( *ev );
+                    }
+                    ZoneTooltip( *ev );
+                    m_zoneHover2 = ev;
+                }
+                ImGui::PopID();
+                ImGui::TableNextColumn();
+                const auto tid = GetZoneThread( *ev );
+                SmallColorBox( GetThreadColor( tid, 0 ) );
+                ImGui::SameLine();
+                ImGui::TextUnformatted( m_worker.GetThreadName( tid ) );
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( m_worker.GetZoneName( *ev ) );
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( m_worker.GetString( m_worker.GetZoneExtra( *ev ).text ) );
+            }
+        }
+        ImGui::EndTable();
+    }
+    ImGui::EndChild();
+    ImGui::End();
+}
+
 void View::DrawMessageLine( const MessageData& msg, bool hasCallstack, int& idx )
 {
     ImGui::TableNextRow();
@@ -244,7 +244,16 @@ void View::DrawNotificationArea()
     if( m_saveThreadState.load( std::memory_order_relaxed ) == SaveThreadState::Saving )
     {
         ImGui::SameLine();
-        ImGui::TextUnformatted( ICON_FA_FLOPPY_DISK " Saving trace..." );
+        auto& progress = m_worker.GetSaveProgress();
+        const auto total = progress.total.load( std::memory_order_relaxed );
+        if( total == 0 )
+        {
+            ImGui::TextUnformatted( ICON_FA_FLOPPY_DISK " Saving trace..." );
+        }
+        else
+        {
+            ImGui::Text( ICON_FA_FLOPPY_DISK " Saving trace... %i%%", int( progress.progress.load( std::memory_order_relaxed ) * 100 / total ) );
+        }
         m_notificationTime = 0;
     }
     else if( m_notificationTime > 0 )
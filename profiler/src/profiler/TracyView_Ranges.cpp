@@ -17,6 +17,8 @@ void View::DrawRanges()
     DrawRangeEntry( m_waitStackRange, ICON_FA_HOURGLASS_HALF " Wait stacks", 0x44EEB588, "RangeWaitStackCopyFrom", 2 );
     ImGui::Separator();
     DrawRangeEntry( m_memInfo.range, ICON_FA_MEMORY " Memory", 0x4488EEE3, "RangeMemoryCopyFrom", 3 );
+    ImGui::Separator();
+    DrawRangeEntry( m_flameGraph.range, ICON_FA_FIRE_FLAME_CURVED " Flame graph", 0x443388EE, "RangeFlameGraphCopyFrom", 4 );
     ImGui::End();
 }
 
@@ -86,6 +88,11 @@ void View::DrawRangeEntry( Range& range, const char* label, uint32_t color, cons
             ImGui::SameLine();
             if( SmallButtonDisablable( ICON_FA_MEMORY " Copy from memory", m_memInfo.range.min == 0 && m_memInfo.range.max == 0 ) ) range = m_memInfo.range;
         }
+        if( id != 4 )
+        {
+            ImGui::SameLine();
+            if( SmallButtonDisablable( ICON_FA_FIRE_FLAME_CURVED " Copy from flame graph", m_flameGraph.range.min == 0 && m_flameGraph.range.max == 0 ) ) range = m_flameGraph.range;
+        }
     }
 }
 
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <sstream>
 
 #include "TracyFilesystem.hpp"
@@ -12,7 +13,7 @@ extern double s_time;
 
 struct SrcLocZonesSlim
 {
-    int16_t srcloc;
+    int32_t srcloc;
     uint16_t numThreads;
     size_t numZones;
     int64_t total;
@@ -33,6 +34,352 @@ void View::AccumulationModeComboBox()
     m_statAccumulationMode = static_cast<AccumulationMode>( accumulationMode );
 }
 
+#ifndef TRACY_NO_STATISTICS
+// Calculates the statistics of zones fully contained in the range. If the cache holds results
+// for another range, only the zones crossing the moved range edges are visited.
+void View::CalcStatisticsCache( int32_t srcloc, const RangeSlim& range, AccumulationMode accumulationMode, StatisticsCache& cache )
+{
+    auto& slz = m_worker.GetZonesForSourceLocation( srcloc );
+    const auto min = range.min;
+    const auto max = range.max;
+
+    auto getTime = [&] ( const Worker::ZoneThreadData& v, int64_t& time ) {
+        auto& z = *v.Zone();
+        time = z.End() - z.Start();
+        switch( accumulationMode )
+        {
+        case AccumulationMode::SelfOnly:
+            time -= GetZoneChildTimeFast( z );
+            return true;
+        case AccumulationMode::AllChildren:
+            return true;
+        case AccumulationMode::NonReentrantChildren:
+            return !IsZoneReentry( z, m_worker.DecompressThread( v.Thread() ) );
+        default:
+            assert( false );
+            return false;
+        }
+    };
+    auto inRange = [] ( const ZoneEvent& z, int64_t min, int64_t max ) {
+        return z.Start() >= min && z.End() <= max;
+    };
+    auto update = [&cache] ( uint16_t thread, int64_t time, bool add ) {
+        if( add )
+        {
+            cache.count++;
+            cache.total += time;
+            cache.threads[thread]++;
+        }
+        else
+        {
+            cache.count--;
+            cache.total -= time;
+            auto it = cache.threads.find( thread );
+            if( --it->second == 0 ) cache.threads.erase( it );
+        }
+    };
+
+    const auto omin = cache.range.min;
+    const auto omax = cache.range.max;
+    const auto e0 = std::min( omin, min );
+    const auto e1 = std::max( omin, min );
+    const auto e2 = std::min( omax, max );
+    const auto e3 = std::max( omax, max );
+    if( cache.range.active && cache.accumulationMode == accumulationMode && cache.sourceCount == slz.zones.size() && ( e1 - e0 ) + ( e3 - e2 ) < max - min )
+    {
+        // Only zones which start between the old and new minimum, or end between the old and
+        // new maximum, may have entered or left the range.
+        auto& zones = slz.zones;
+        const auto s0 = std::lower_bound( zones.begin(), zones.end(), e0, [] ( const auto& l, const auto& r ) { return l.Zone()->Start() < r; } );
+        const auto s1 = std::lower_bound( s0, zones.end(), e1, [] ( const auto& l, const auto& r ) { return l.Zone()->Start() < r; } );
+        auto edge = [&] ( const Worker::ZoneThreadData& v ) {
+            auto& z = *v.Zone();
+            const auto in0 = inRange( z, omin, omax );
+            const auto in1 = inRange( z, min, max );
+            if( in0 == in1 ) return;
+            int64_t time;
+            if( getTime( v, time ) ) update( v.Thread(), time, in1 );
+        };
+        for( auto it = s0; it != s1; ++it ) edge( *it );
+        m_worker.QueryZones( srcloc, e2, e3, [&] ( const Worker::ZoneThreadData& v ) {
+            if( &v < s0 || &v >= s1 ) edge( v );
+        } );
+    }
+    else
+    {
+        cache.count = 0;
+        cache.total = 0;
+        cache.threads.clear();
+        m_worker.QueryZones( srcloc, min, max, [&] ( const Worker::ZoneThreadData& v ) {
+            int64_t time;
+            if( inRange( *v.Zone(), min, max ) && getTime( v, time ) ) update( v.Thread(), time, true );
+        } );
+    }
+
+    cache.range = range;
+    cache.accumulationMode = accumulationMode;
+    cache.sourceCount = slz.zones.size();
+    cache.threadNum = (uint16_t)cache.threads.size();
+}
+
+void View::UpdateStatisticsCache()
+{
+    const RangeSlim range { m_statRange.min, m_statRange.max, m_statRange.active };
+    const auto accumulationMode = m_statAccumulationMode;
+
+    if( m_statJob.active )
+    {
+        if( m_statJob.range.min != range.min || m_statJob.range.max != range.max || m_statJob.accumulationMode != accumulationMode )
+        {
+            m_statTasks->Cancel();
+            m_statTasks->Sync();
+            m_statJob.active = false;
+        }
+        else if( m_statJob.done.load( std::memory_order_acquire ) == m_statJob.srcloc.size() )
+        {
+            m_statTasks->Sync();
+            for( size_t i=0; i<m_statJob.srcloc.size(); i++ )
+            {
+                m_statCache[m_statJob.srcloc[i]] = std::move( m_statJob.result[i] );
+            }
+            m_statJob.active = false;
+        }
+        if( m_statJob.active ) return;
+    }
+
+    auto& slz = m_worker.GetSourceLocationZones();
+    const auto st = range.max - range.min;
+    m_statJob.srcloc.clear();
+    for( auto it = slz.begin(); it != slz.end(); ++it )
+    {
+        if( it->second.total == 0 || it->second.min > st ) continue;
+        auto cit = m_statCache.find( it->first );
+        if( cit != m_statCache.end() && cit->second.range == m_statRange && cit->second.accumulationMode == accumulationMode && cit->second.sourceCount == it->second.zones.size() ) continue;
+        m_statJob.srcloc.push_back( it->first );
+    }
+    if( m_statJob.srcloc.empty() ) return;
+
+    const auto jobs = m_statJob.srcloc.size();
+    m_statJob.result.clear();
+    m_statJob.result.resize( jobs );
+    size_t zonesTotal = 0;
+    for( size_t i=0; i<jobs; i++ )
+    {
+        const auto srcloc = m_statJob.srcloc[i];
+        auto cit = m_statCache.find( srcloc );
+        if( cit != m_statCache.end() ) m_statJob.result[i] = cit->second;
+        zonesTotal += slz.find( srcloc )->second.zones.size();
+    }
+
+    const auto workers = std::max<int>( 1, std::thread::hardware_concurrency() - 1 );
+    if( !m_statTasks ) m_statTasks = std::make_unique<TaskGroup>( GetTaskDispatch() );
+    m_statJob.active = true;
+    m_statJob.range = range;
+    m_statJob.accumulationMode = accumulationMode;
+    m_statJob.done.store( 0, std::memory_order_relaxed );
+
+    // Batches of source locations have similar zone counts, to spread the work evenly. Each
+    // task brings the time index of its own source locations up to date. Zone lists of a live
+    // capture grow whenever the data lock is released, so there the tasks take the lock and
+    // give it back periodically, for the UI and the worker to proceed.
+    const bool isStatic = m_worker.IsDataStatic();
+    const auto batchSize = std::max<size_t>( 64 * 1024, zonesTotal / ( workers * 8 ) );
+    size_t i = 0;
+    while( i < jobs )
+    {
+        const auto begin = i;
+        size_t batch = 0;
+        while( i < jobs && batch < batchSize ) batch += slz.find( m_statJob.srcloc[i++] )->second.zones.size();
+        m_statTasks->Queue( [this, begin, end = i, range, accumulationMode, isStatic] {
+            std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+            auto locked = std::chrono::steady_clock::now();
+            for( size_t j=begin; j<end; j++ )
+            {
+                if( m_statTasks->IsCancelled() ) return;
+                if( !isStatic && !lock.owns_lock() )
+                {
+                    if( !m_statTasks->Lock( lock ) ) return;
+                    locked = std::chrono::steady_clock::now();
+                }
+                const auto srcloc = m_statJob.srcloc[j];
+                m_worker.PrepareQueryZones( srcloc );
+                CalcStatisticsCache( srcloc, range, accumulationMode, m_statJob.result[j] );
+                if( lock.owns_lock() && std::chrono::steady_clock::now() - locked > std::chrono::milliseconds( 5 ) ) lock.unlock();
+            }
+            m_statJob.done.fetch_add( end - begin, std::memory_order_release );
+        } );
+    }
+}
+
+bool View::IsSampleThreadHidden( uint64_t tid ) const
+{
+    return std::binary_search( m_statHiddenThreads.begin(), m_statHiddenThreads.end(), tid );
+}
+
+// Attributes the samples of a call stack the same way as the global symbol statistics of the worker.
+// Returns false if some of the call stack frames are not resolved yet.
+bool View::CountSampleCallstack( uint32_t callstack, uint32_t count, SymCounters& out ) const
+{
+    const auto& cs = m_worker.GetCallstack( callstack );
+    const auto cssz = cs.size();
+    for( uint16_t i=0; i<cssz; i++ )
+    {
+        if( !m_worker.GetCallstackFrame( cs[i] ) ) return false;
+    }
+
+    const auto fexcl = m_worker.GetCallstackFrame( cs[0] );
+    out.Add( fexcl->data[0].symAddr, 0, count );
+    for( uint8_t f=1; f<fexcl->size; f++ )
+    {
+        out.Add( fexcl->data[f].symAddr, count, 0 );
+    }
+    for( uint16_t c=1; c<cssz; c++ )
+    {
+        const auto fincl = m_worker.GetCallstackFrame( cs[c] );
+        for( uint8_t f=0; f<fincl->size; f++ )
+        {
+            out.Add( fincl->data[f].symAddr, count, 0 );
+        }
+    }
+    return true;
+}
+
+static size_t SampleIndex( const Vector<SampleData>& samples, size_t first, int64_t time )
+{
+    return std::lower_bound( samples.begin() + first, samples.end(), time, [] ( const auto& l, const auto& r ) { return l.time.Val() < r; } ) - samples.begin();
+}
+
+static void CountSamples( const Vector<SampleData>& samples, size_t first, size_t last, unordered_flat_map<uint32_t, uint32_t>& counts )
+{
+    for( size_t i=first; i<last; i++ )
+    {
+        const auto cs = samples[i].callstack.Val();
+        if( cs != 0 ) counts[cs]++;
+    }
+}
+
+void View::UpdateSampleStatistics()
+{
+    auto& ss = m_sampleStat;
+    const bool sameInput = ss.range == m_statRange && ss.hidden == m_statHiddenThreads;
+
+    if( ss.active )
+    {
+        if( !sameInput )
+        {
+            m_sampleStatTasks->Cancel();
+            m_sampleStatTasks->Sync();
+            ss.active = false;
+        }
+        else if( ss.done.load( std::memory_order_acquire ) == ss.jobs )
+        {
+            m_sampleStatTasks->Sync();
+            ss.symbols.Clear();
+            for( auto& block : ss.blocks )
+            {
+                for( auto& v : block.symbols.data ) ss.symbols.Add( v.symAddr, v.incl, v.excl );
+                for( auto& v : block.pending ) ss.pending[v.first] += v.second;
+            }
+            ss.blocks.clear();
+            ss.active = false;
+            ss.valid = true;
+        }
+        if( ss.active ) return;
+    }
+
+    const bool isStatic = m_worker.IsDataStatic();
+    if( ss.valid && sameInput && isStatic ) return;
+    if( !ss.valid || !sameInput )
+    {
+        ss.valid = false;
+        ss.range = m_statRange;
+        ss.hidden = m_statHiddenThreads;
+        ss.symbols.Clear();
+        ss.processed.clear();
+        ss.pending.clear();
+    }
+
+    const auto& range = ss.range;
+    if( ss.valid )
+    {
+        // Samples of a live capture are appended in time order, so once the samples in the range
+        // were counted by the tasks, only the ones which arrived since the last update are
+        // counted here. Call stacks with unresolved frames are kept aside and retried in the
+        // following frames.
+        unordered_flat_map<uint32_t, uint32_t> counts;
+        counts.swap( ss.pending );
+        for( auto td : m_worker.GetThreadData() )
+        {
+            if( td->samples.empty() || IsSampleThreadHidden( td->id ) ) continue;
+            auto it = ss.processed.find( td->id );
+            if( it == ss.processed.end() ) it = ss.processed.emplace( td->id, range.active ? SampleIndex( td->samples, 0, range.min ) : 0 ).first;
+            const auto first = it->second;
+            const auto last = range.active ? SampleIndex( td->samples, first, range.max ) : td->samples.size();
+            CountSamples( td->samples, first, last, counts );
+            it->second = last;
+        }
+        for( auto& v : counts )
+        {
+            if( !CountSampleCallstack( v.first, v.second, ss.symbols ) ) ss.pending.emplace( v.first, v.second );
+        }
+        return;
+    }
+
+    // With a live capture the blocks end at the samples available now, and the ones arriving
+    // later are counted by the updates above.
+    struct Block
+    {
+        const Vector<SampleData>* samples;
+        size_t first, last;
+    };
+    std::vector<Block> blocks;
+    for( auto td : m_worker.GetThreadData() )
+    {
+        if( td->samples.empty() || IsSampleThreadHidden( td->id ) ) continue;
+        const auto first = range.active ? SampleIndex( td->samples, 0, range.min ) : 0;
+        const auto last = range.active ? SampleIndex( td->samples, first, range.max ) : td->samples.size();
+        for( size_t i=first; i<last; i+=ss.BlockSize )
+        {
+            blocks.emplace_back( Block { &td->samples, i, std::min<size_t>( last, i + ss.BlockSize ) } );
+        }
+        if( !isStatic ) ss.processed.emplace( td->id, last );
+    }
+    if( blocks.empty() )
+    {
+        ss.valid = true;
+        return;
+    }
+
+    if( !m_sampleStatTasks ) m_sampleStatTasks = std::make_unique<TaskGroup>( GetTaskDispatch() );
+    ss.active = true;
+    ss.jobs = blocks.size();
+    ss.done.store( 0, std::memory_order_relaxed );
+    ss.blocks.clear();
+    ss.blocks.resize( blocks.size() );
+
+    // The samples vectors of a live capture may be reallocated while the data lock is not held,
+    // so there the tasks take it for the time of their block.
+    for( size_t i=0; i<blocks.size(); i++ )
+    {
+        m_sampleStatTasks->Queue( [this, i, block = blocks[i], isStatic] {
+            std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+            if( !m_sampleStatTasks->IsCancelled() && ( isStatic || m_sampleStatTasks->Lock( lock ) ) )
+            {
+                auto& out = m_sampleStat.blocks[i];
+                unordered_flat_map<uint32_t, uint32_t> counts;
+                CountSamples( *block.samples, block.first, block.last, counts );
+                for( auto& v : counts )
+                {
+                    if( m_sampleStatTasks->IsCancelled() ) break;
+                    if( !CountSampleCallstack( v.first, v.second, out.symbols ) && !isStatic ) out.pending.emplace( v.first, v.second );
+                }
+            }
+            m_sampleStat.done.fetch_add( 1, std::memory_order_release );
+        } );
+    }
+}
+#endif
+
 void View::DrawStatistics()
 {
     const auto scale = GetScale();
@@ -109,111 +456,24 @@ void View::DrawStatistics()
         uint32_t slzcnt = 0;
         if( m_statRange.active )
         {
-            const auto min = m_statRange.min;
-            const auto max = m_statRange.max;
-            const auto st = max - min;
+            UpdateStatisticsCache();
+
+            // Results for a previous range are shown until the ones for the current range are ready.
+            const auto st = m_statRange.max - m_statRange.min;
             for( auto it = slz.begin(); it != slz.end(); ++it )
             {
                 if( it->second.total != 0 && it->second.min <= st )
                 {
-                    if( !filterActive )
-                    {
-                        auto cit = m_statCache.find( it->first );
-                        if( cit != m_statCache.end() && cit->second.range == m_statRange && cit->second.accumulationMode == m_statAccumulationMode && cit->second.sourceCount == it->second.zones.size() )
-                        {
-                            if( cit->second.count != 0 )
-                            {
-                                slzcnt++;
-                                srcloc.push_back_no_space_check( SrcLocZonesSlim { it->first, cit->second.threadNum, cit->second.count, cit->second.total } );
-                            }
-                        }
-                        else
-                        {
-                            unordered_flat_set<uint16_t> threads;
-                            size_t cnt = 0;
-                            int64_t total = 0;
-                            for( auto& v : it->second.zones )
-                            {
-                                auto& z = *v.Zone();
-                                const auto start = z.Start();
-                                const auto end = z.End();
-                                if( start >= min && end <= max )
-                                {
-                                    const auto zt = end - start;
-                                    if( m_statAccumulationMode == AccumulationMode::SelfOnly )
-                                    {
-                                        total += zt - GetZoneChildTimeFast( z );
-                                        cnt++;
-                                        threads.emplace( v.Thread() );
-                                    }
-                                    else if( m_statAccumulationMode == AccumulationMode::AllChildren || !IsZoneReentry( z ) )
-                                    {
-                                        total += zt;
-                                        cnt++;
-                                        threads.emplace( v.Thread() );
-                                    }
-                                }
-                            }
-                            const auto threadNum = (uint16_t)threads.size();
-                            if( cnt != 0 )
-                            {
-                                slzcnt++;
-                                srcloc.push_back_no_space_check( SrcLocZonesSlim { it->first, threadNum, cnt, total } );
-                            }
-                            m_statCache[it->first] = StatisticsCache { RangeSlim { m_statRange.min, m_statRange.max, m_statRange.active }, m_statAccumulationMode, it->second.zones.size(), cnt, total, threadNum };
-                        }
-                    }
-                    else
+                    auto cit = m_statCache.find( it->first );
+                    if( cit == m_statCache.end() || cit->second.accumulationMode != m_statAccumulationMode || cit->second.count == 0 ) continue;
+                    slzcnt++;
+                    if( filterActive )
                     {
-                        slzcnt++;
                         auto& sl = m_worker.GetSourceLocation( it->first );
                         auto name = m_worker.GetString( sl.name.active ? sl.name : sl.function );
-                        if( m_statisticsFilter.PassFilter( name ) )
-                        {
-                            auto cit = m_statCache.find( it->first );
-                            if( cit != m_statCache.end() && cit->second.range == m_statRange && cit->second.accumulationMode == m_statAccumulationMode && cit->second.sourceCount == it->second.zones.size() )
-                            {
-                                if( cit->second.count != 0 )
-                                {
-                                    srcloc.push_back_no_space_check( SrcLocZonesSlim { it->first, cit->second.threadNum, cit->second.count, cit->second.total } );
-                                }
-                            }
-                            else
-                            {
-                                unordered_flat_set<uint16_t> threads;
-                                size_t cnt = 0;
-                                int64_t total = 0;
-                                for( auto& v : it->second.zones )
-                                {
-                                    auto& z = *v.Zone();
-                                    const auto start = z.Start();
-                                    const auto end = z.End();
-                                    if( start >= min && end <= max )
-                                    {
-                                        const auto zt = end - start;
-                                        if( m_statAccumulationMode == AccumulationMode::SelfOnly )
-                                        {
-                                            total += zt - GetZoneChildTimeFast( z );
-                                            cnt++;
-                                            threads.emplace( v.Thread() );
-                                        }
-                                        else if( m_statAccumulationMode == AccumulationMode::AllChildren || !IsZoneReentry( z ) )
-                                        {
-                                            total += zt;
-                                            cnt++;
-                                            threads.emplace( v.Thread() );
-                                        }
-                                    }
-                                }
-                                const auto threadNum = (uint16_t)threads.size();
-                                if( cnt != 0 )
-                                {
-                                    srcloc.push_back_no_space_check( SrcLocZonesSlim { it->first, threadNum, cnt, total } );
-                                }
-                                m_statCache[it->first] = StatisticsCache { RangeSlim { m_statRange.min, m_statRange.max, m_statRange.active }, m_statAccumulationMode, it->second.zones.size(), cnt, total, threadNum };
-                            }
-                        }
+                        if( !m_statisticsFilter.PassFilter( name ) ) continue;
                     }
+                    srcloc.push_back_no_space_check( SrcLocZonesSlim { it->first, cit->second.threadNum, cit->second.count, cit->second.total } );
                 }
             }
         }
@@ -258,6 +518,19 @@ void View::DrawStatistics()
             }
         }
 
+        if( m_statJob.active )
+        {
+            ImGui::TextUnformatted( "Calculating range" );
+            ImGui::SameLine();
+            char buf[64];
+            PrintStringPercent( buf, 100.f * m_statJob.done.load( std::memory_order_relaxed ) / m_statJob.srcloc.size() );
+            TextDisabledUnformatted( buf );
+            ImGui::SameLine();
+            DrawWaitingDots( s_time );
+            ImGui::SameLine();
+            ImGui::Spacing();
+            ImGui::SameLine();
+        }
         TextFocused( "Total zone count:", RealToString( slzcnt ) );
         ImGui::SameLine();
         ImGui::Spacing();
@@ -276,17 +549,7 @@ void View::DrawStatistics()
         ImGui::SameLine();
         ImGui::Spacing();
         ImGui::SameLine();
-        if( m_statRange.active )
-        {
-            ImGui::BeginDisabled();
-            m_statAccumulationMode = AccumulationMode::SelfOnly;
-            AccumulationModeComboBox();
-            ImGui::EndDisabled();
-        }
-        else
-        {
-            AccumulationModeComboBox();
-        }
+        AccumulationModeComboBox();
         ImGui::SameLine();
         ImGui::Spacing();
         ImGui::SameLine();
@@ -311,6 +574,63 @@ void View::DrawStatistics()
         const char* locationTable = "Entry\0Sample\0Smart\0";
         ImGui::SetNextItemWidth( ImGui::CalcTextSize( "Sample" ).x + ImGui::GetTextLineHeight() * 2 );
         ImGui::Combo( "##location", &m_statSampleLocation, locationTable );
+        ImGui::SameLine();
+        ImGui::Spacing();
+        ImGui::SameLine();
+        // Thread limited statistics are calculated from the samples, which may not be fully processed yet.
+        const bool threadsReady = m_worker.AreSymbolSamplesReady();
+        if( !threadsReady )
+        {
+            m_statHiddenThreads.clear();
+            ImGui::BeginDisabled();
+        }
+        char buf[64];
+        if( m_statHiddenThreads.empty() )
+        {
+            snprintf( buf, sizeof( buf ), "%s", ICON_FA_SHUFFLE " All threads" );
+        }
+        else
+        {
+            snprintf( buf, sizeof( buf ), ICON_FA_SHUFFLE " %s threads hidden", RealToString( m_statHiddenThreads.size() ) );
+        }
+        ImGui::SetNextItemWidth( ImGui::CalcTextSize( buf ).x + ImGui::GetTextLineHeight() * 2 );
+        if( ImGui::BeginCombo( "##threads", buf, ImGuiComboFlags_HeightLarge ) )
+        {
+            if( ImGui::SmallButton( "Show all" ) ) m_statHiddenThreads.clear();
+            ImGui::SameLine();
+            if( ImGui::SmallButton( "Hide all" ) )
+            {
+                m_statHiddenThreads.clear();
+                for( auto td : m_worker.GetThreadData() )
+                {
+                    if( !td->samples.empty() ) m_statHiddenThreads.emplace_back( td->id );
+                }
+                std::sort( m_statHiddenThreads.begin(), m_statHiddenThreads.end() );
+            }
+            for( auto td : m_worker.GetThreadData() )
+            {
+                if( td->samples.empty() ) continue;
+                ImGui::PushID( td );
+                bool visible = !IsSampleThreadHidden( td->id );
+                if( SmallCheckbox( m_worker.GetThreadName( td->id ), &visible ) )
+                {
+                    auto it = std::lower_bound( m_statHiddenThreads.begin(), m_statHiddenThreads.end(), td->id );
+                    if( visible )
+                    {
+                        m_statHiddenThreads.erase( it );
+                    }
+                    else
+                    {
+                        m_statHiddenThreads.insert( it, td->id );
+                    }
+                }
+                ImGui::PopID();
+                ImGui::SameLine();
+                ImGui::TextDisabled( "(%s)", RealToString( td->samples.size() ) );
+            }
+            ImGui::EndCombo();
+        }
+        if( !threadsReady ) ImGui::EndDisabled();
     }
     else
     {
@@ -778,72 +1098,66 @@ void View::DrawStatistics()
         const auto& symMap = m_worker.GetSymbolMap();
         const auto& symStat = m_worker.GetSymbolStats();
 
+        // Range or thread limited counts are calculated from the samples, the global counts are maintained by the worker.
+        const bool limited = m_statRange.active || !m_statHiddenThreads.empty();
+        if( limited )
+        {
+            UpdateSampleStatistics();
+            if( !m_sampleStat.valid )
+            {
+                ImGui::TextUnformatted( "Calculating..." );
+                ImGui::SameLine();
+                ImGui::TextDisabled( "(%.0f%%)", m_sampleStat.jobs == 0 ? 0.f : 100.f * m_sampleStat.done.load( std::memory_order_relaxed ) / m_sampleStat.jobs );
+                ImGui::SameLine();
+                DrawWaitingDots( s_time );
+                ImGui::End();
+                return;
+            }
+        }
+        const auto& counters = m_sampleStat.symbols;
+
+        const bool filterActive = m_statisticsFilter.IsActive() || m_statisticsImageFilter.IsActive() || !m_statShowKernel;
+        auto passFilter = [&] ( uint64_t symAddr, const SymbolData& sym ) {
+            const auto name = m_worker.GetString( sym.name );
+            const auto image = m_worker.GetString( sym.imageName );
+            bool pass = ( m_statShowKernel || ( symAddr >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( name ) && m_statisticsImageFilter.PassFilter( image );
+            if( !pass && sym.size.Val() == 0 )
+            {
+                const auto parentAddr = m_worker.GetSymbolForAddress( symAddr );
+                if( parentAddr != 0 )
+                {
+                    auto pit = symMap.find( parentAddr );
+                    if( pit != symMap.end() )
+                    {
+                        const auto parentName = m_worker.GetString( pit->second.name );
+                        pass = ( m_statShowKernel || ( parentAddr >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( parentName ) && m_statisticsImageFilter.PassFilter( image );
+                    }
+                }
+            }
+            return pass;
+        };
+
         Vector<SymList> data;
         if( m_showAllSymbols )
         {
             data.reserve( symMap.size() );
-            if( m_statisticsFilter.IsActive() || m_statisticsImageFilter.IsActive() || !m_statShowKernel )
+            for( auto& v : symMap )
             {
-                for( auto& v : symMap )
+                if( filterActive && !passFilter( v.first, v.second ) ) continue;
+                if( limited )
                 {
-                    const auto name = m_worker.GetString( v.second.name );
-                    const auto image = m_worker.GetString( v.second.imageName );
-                    bool pass = ( m_statShowKernel || ( v.first >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( name ) && m_statisticsImageFilter.PassFilter( image );
-                    if( !pass && v.second.size.Val() == 0 )
+                    auto it = counters.index.find( v.first );
+                    if( it == counters.index.end() )
                     {
-                        const auto parentAddr = m_worker.GetSymbolForAddress( v.first );
-                        if( parentAddr != 0 )
-                        {
-                            auto pit = symMap.find( parentAddr );
-                            if( pit != symMap.end() )
-                            {
-                                const auto parentName = m_worker.GetString( pit->second.name );
-                                pass = ( m_statShowKernel || ( parentAddr >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( parentName ) && m_statisticsImageFilter.PassFilter( image );
-                            }
-                        }
+                        data.push_back_no_space_check( SymList { v.first, 0, 0 } );
                     }
-                    if( pass )
+                    else
                     {
-                        auto it = symStat.find( v.first );
-                        if( it == symStat.end() )
-                        {
-                            data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                        }
-                        else
-                        {
-                            if( m_statRange.active )
-                            {
-                                auto samples = m_worker.GetSamplesForSymbol( v.first );
-                                if( samples )
-                                {
-                                    auto it = std::lower_bound( samples->begin(), samples->end(), m_statRange.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                    if( it != samples->end() )
-                                    {
-                                        auto end = std::lower_bound( it, samples->end(), m_statRange.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                        const auto count = uint32_t( end - it );
-                                        data.push_back_no_space_check( SymList { v.first, 0, count } );
-                                    }
-                                    else
-                                    {
-                                        data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                                    }
-                                }
-                                else
-                                {
-                                    data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                                }
-                            }
-                            else
-                            {
-                                data.push_back_no_space_check( SymList { v.first, it->second.incl, it->second.excl } );
-                            }
-                        }
+                        auto& cnt = counters.data[it->second];
+                        data.push_back_no_space_check( SymList { v.first, cnt.incl, cnt.excl } );
                     }
                 }
-            }
-            else
-            {
-                for( auto& v : symMap )
+                else
                 {
                     auto it = symStat.find( v.first );
                     if( it == symStat.end() )
@@ -852,112 +1166,30 @@ void View::DrawStatistics()
                     }
                     else
                     {
-                        if( m_statRange.active )
-                        {
-                            auto samples = m_worker.GetSamplesForSymbol( v.first );
-                            if( samples )
-                            {
-                                auto it = std::lower_bound( samples->begin(), samples->end(), m_statRange.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                if( it != samples->end() )
-                                {
-                                    auto end = std::lower_bound( it, samples->end(), m_statRange.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                    const auto count = uint32_t( end - it );
-                                    data.push_back_no_space_check( SymList { v.first, 0, count } );
-                                }
-                                else
-                                {
-                                    data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                                }
-                            }
-                            else
-                            {
-                                data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                            }
-                        }
-                        else
-                        {
-                            data.push_back_no_space_check( SymList { v.first, it->second.incl, it->second.excl } );
-                        }
+                        data.push_back_no_space_check( SymList { v.first, it->second.incl, it->second.excl } );
                     }
                 }
             }
         }
         else
         {
-            data.reserve( symStat.size() );
-            if( m_statisticsFilter.IsActive() || m_statisticsImageFilter.IsActive() || !m_statShowKernel )
-            {
-                for( auto& v : symStat )
+            auto add = [&] ( uint64_t symAddr, uint32_t incl, uint32_t excl ) {
+                if( filterActive )
                 {
-                    auto sit = symMap.find( v.first );
-                    if( sit != symMap.end() )
-                    {
-                        const auto name = m_worker.GetString( sit->second.name );
-                        const auto image = m_worker.GetString( sit->second.imageName );
-                        bool pass = ( m_statShowKernel || ( v.first >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( name ) && m_statisticsImageFilter.PassFilter( image );
-                        if( !pass && sit->second.size.Val() == 0 )
-                        {
-                            const auto parentAddr = m_worker.GetSymbolForAddress( v.first );
-                            if( parentAddr != 0 )
-                            {
-                                auto pit = symMap.find( parentAddr );
-                                if( pit != symMap.end() )
-                                {
-                                    const auto parentName = m_worker.GetString( pit->second.name );
-                                    pass = ( m_statShowKernel || ( parentAddr >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( parentName ) && m_statisticsImageFilter.PassFilter( image );
-                                }
-                            }
-                        }
-                        if( pass )
-                        {
-                            if( m_statRange.active )
-                            {
-                                auto samples = m_worker.GetSamplesForSymbol( v.first );
-                                if( samples )
-                                {
-                                    auto it = std::lower_bound( samples->begin(), samples->end(), m_statRange.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                    if( it != samples->end() )
-                                    {
-                                        auto end = std::lower_bound( it, samples->end(), m_statRange.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                        const auto count = uint32_t( end - it );
-                                        data.push_back_no_space_check( SymList { v.first, 0, count } );
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                data.push_back_no_space_check( SymList { v.first, v.second.incl, v.second.excl } );
-                            }
-                        }
-                    }
+                    auto sit = symMap.find( symAddr );
+                    if( sit == symMap.end() || !passFilter( symAddr, sit->second ) ) return;
                 }
+                data.push_back_no_space_check( SymList { symAddr, incl, excl } );
+            };
+            if( limited )
+            {
+                data.reserve( counters.data.size() );
+                for( auto& v : counters.data ) add( v.symAddr, v.incl, v.excl );
             }
             else
             {
-                if( m_statRange.active )
-                {
-                    for( auto& v : symStat )
-                    {
-                        auto samples = m_worker.GetSamplesForSymbol( v.first );
-                        if( samples )
-                        {
-                            auto it = std::lower_bound( samples->begin(), samples->end(), m_statRange.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                            if( it != samples->end() )
-                            {
-                                auto end = std::lower_bound( it, samples->end(), m_statRange.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                const auto count = uint32_t( end - it );
-                                data.push_back_no_space_check( SymList { v.first, 0, count } );
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    for( auto& v : symStat )
-                    {
-                        data.push_back_no_space_check( SymList { v.first, v.second.incl, v.second.excl } );
-                    }
-                }
+                data.reserve( symStat.size() );
+                for( auto& v : symStat ) add( v.first, v.second.incl, v.second.excl );
             }
         }
 
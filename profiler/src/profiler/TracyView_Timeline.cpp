@@ -249,6 +249,7 @@ void View::DrawTimeline()
     m_statRange.StartFrame();
     m_waitStackRange.StartFrame();
     m_memInfo.range.StartFrame();
+    m_flameGraph.range.StartFrame();
     m_yDelta = 0;
     m_nextLockHighlight = { -1 };
 
@@ -278,6 +279,7 @@ void View::DrawTimeline()
         HandleRange( m_statRange, timespan, ImGui::GetCursorScreenPos(), w );
         HandleRange( m_waitStackRange, timespan, ImGui::GetCursorScreenPos(), w );
         HandleRange( m_memInfo.range, timespan, ImGui::GetCursorScreenPos(), w );
+        HandleRange( m_flameGraph.range, timespan, ImGui::GetCursorScreenPos(), w );
         for( auto& v : m_annotations )
         {
             v->range.StartFrame();
@@ -497,6 +499,15 @@ void View::DrawTimeline()
         DrawLine( draw, ImVec2( dpos.x + px1, linepos.y + 0.5f ), ImVec2( dpos.x + px1, linepos.y + lineh + 0.5f ), m_memInfo.range.hiMax ? 0x9988EEE3 : 0x3388EEE3, m_memInfo.range.hiMax ? 2 : 1 );
     }
 
+    if( m_flameGraph.range.active && ( m_flameGraph.show || m_showRanges ) )
+    {
+        const auto px0 = ( m_flameGraph.range.min - m_vd.zvStart ) * pxns;
+        const auto px1 = std::max( px0 + std::max( 1.0, pxns * 0.5 ), ( m_flameGraph.range.max - m_vd.zvStart ) * pxns );
+        DrawStripedRect( draw, wpos, px0, linepos.y, px1, linepos.y + lineh, 10 * scale, 0x223388EE, true, true );
+        DrawLine( draw, ImVec2( dpos.x + px0, linepos.y + 0.5f ), ImVec2( dpos.x + px0, linepos.y + lineh + 0.5f ), m_flameGraph.range.hiMin ? 0x993388EE : 0x333388EE, m_flameGraph.range.hiMin ? 2 : 1 );
+        DrawLine( draw, ImVec2( dpos.x + px1, linepos.y + 0.5f ), ImVec2( dpos.x + px1, linepos.y + lineh + 0.5f ), m_flameGraph.range.hiMax ? 0x993388EE : 0x333388EE, m_flameGraph.range.hiMax ? 2 : 1 );
+    }
+
     if( m_setRangePopup.active || m_setRangePopupOpen )
     {
         const auto s = std::min( m_setRangePopup.min, m_setRangePopup.max );
@@ -43,7 +43,7 @@ uint32_t View::GetSrcLocColor( const SourceLocation& srcloc, int depth )
 
 uint32_t View::GetZoneColor( const ZoneEvent& ev, uint64_t thread, int depth )
 {
-    const auto sl = ev.SrcLoc();
+    const auto sl = m_worker.GetZoneSrcLoc( ev );
     const auto& srcloc = m_worker.GetSourceLocation( sl );
     if( !m_vd.forceColors )
     {
@@ -79,7 +79,7 @@ uint32_t View::GetZoneColor( const GpuEvent& ev )
 View::ZoneColorData View::GetZoneColorData( const ZoneEvent& ev, uint64_t thread, int depth )
 {
     ZoneColorData ret;
-    const auto& srcloc = ev.SrcLoc();
+    const auto srcloc = m_worker.GetZoneSrcLoc( ev );
     if( m_zoneInfoWindow == &ev )
     {
         ret.color = GetZoneColor( ev, thread, depth );
@@ -169,31 +169,13 @@ const ZoneEvent* View::FindZoneAtTime( uint64_t thread, int64_t time ) const
     }
     if( !td ) return nullptr;
 
-    const Vector<short_ptr<ZoneEvent>>* timeline = &td->timeline;
-    if( timeline->empty() ) return nullptr;
+    // Zones containing the time are visited from the outermost one inwards.
     const ZoneEvent* ret = nullptr;
-    for(;;)
-    {
-        if( timeline->is_magic() )
-        {
-            auto vec = (Vector<ZoneEvent>*)timeline;
-            auto it = std::upper_bound( vec->begin(), vec->end(), time, [] ( const auto& l, const auto& r ) { return l < r.Start(); } );
-            if( it != vec->begin() ) --it;
-            if( it->Start() > time || ( it->IsEndValid() && it->End() < time ) ) return ret;
-            ret = it;
-            if( !it->HasChildren() ) return ret;
-            timeline = &m_worker.GetZoneChildren( it->Child() );
-        }
-        else
-        {
-            auto it = std::upper_bound( timeline->begin(), timeline->end(), time, [] ( const auto& l, const auto& r ) { return l < r->Start(); } );
-            if( it != timeline->begin() ) --it;
-            if( (*it)->Start() > time || ( (*it)->IsEndValid() && (*it)->End() < time ) ) return ret;
-            ret = *it;
-            if( !(*it)->HasChildren() ) return ret;
-            timeline = &m_worker.GetZoneChildren( (*it)->Child() );
-        }
-    }
+    m_worker.QueryThreadZones( *td, time, time, [&ret] ( const ZoneEvent& zone, int ) {
+        ret = &zone;
+        return true;
+    } );
+    return ret;
 }
 
 const ZoneEvent* View::GetZoneChild( const ZoneEvent& zone, int64_t time ) const
@@ -217,12 +199,31 @@ const ZoneEvent* View::GetZoneChild( const ZoneEvent& zone, int64_t time ) const
     }
 }
 
+bool View::GetZoneAncestors( const ThreadData& thread, const ZoneEvent& zone, std::vector<const ZoneEvent*>& ancestors ) const
+{
+    // The walk is depth first, so the last zone visited on each level above the searched one
+    // is its ancestor.
+    bool found = false;
+    ancestors.clear();
+    m_worker.QueryThreadZones( thread, zone.Start(), zone.Start(), [&] ( const ZoneEvent& z, int depth ) {
+        ancestors.resize( depth );
+        if( &z == &zone )
+        {
+            found = true;
+            return false;
+        }
+        ancestors.push_back( &z );
+        return true;
+    } );
+    return found;
+}
+
 const ZoneEvent* View::GetZoneParent( const ZoneEvent& zone ) const
 {
 #ifndef TRACY_NO_STATISTICS
     if( m_worker.AreSourceLocationZonesReady() )
     {
-        auto& slz = m_worker.GetZonesForSourceLocation( zone.SrcLoc() );
+        auto& slz = m_worker.GetZonesForSourceLocation( m_worker.GetZoneSrcLoc( zone ) );
         if( !slz.zones.empty() && slz.zones.is_sorted() )
         {
             auto it = std::lower_bound( slz.zones.begin(), slz.zones.end(), zone.Start(), [] ( const auto& lhs, const auto& rhs ) { return lhs.Zone()->Start() < rhs; } );
@@ -234,70 +235,29 @@ const ZoneEvent* View::GetZoneParent( const ZoneEvent& zone ) const
     }
 #endif
 
+    std::vector<const ZoneEvent*> ancestors;
     for( const auto& thread : m_worker.GetThreadData() )
     {
-        const ZoneEvent* parent = nullptr;
-        const Vector<short_ptr<ZoneEvent>>* timeline = &thread->timeline;
-        if( timeline->empty() ) continue;
-        for(;;)
-        {
-            if( timeline->is_magic() )
-            {
-                auto vec = (Vector<ZoneEvent>*)timeline;
-                auto it = std::upper_bound( vec->begin(), vec->end(), zone.Start(), [] ( const auto& l, const auto& r ) { return l < r.Start(); } );
-                if( it != vec->begin() ) --it;
-                if( zone.IsEndValid() && it->Start() > zone.End() ) break;
-                if( it == &zone ) return parent;
-                if( !it->HasChildren() ) break;
-                parent = it;
-                timeline = &m_worker.GetZoneChildren( parent->Child() );
-            }
-            else
-            {
-                auto it = std::upper_bound( timeline->begin(), timeline->end(), zone.Start(), [] ( const auto& l, const auto& r ) { return l < r->Start(); } );
-                if( it != timeline->begin() ) --it;
-                if( zone.IsEndValid() && (*it)->Start() > zone.End() ) break;
-                if( *it == &zone ) return parent;
-                if( !(*it)->HasChildren() ) break;
-                parent = *it;
-                timeline = &m_worker.GetZoneChildren( parent->Child() );
-            }
-        }
+        if( GetZoneAncestors( *thread, zone, ancestors ) ) return ancestors.empty() ? nullptr : ancestors.back();
     }
     return nullptr;
 }
 
 const ZoneEvent* View::GetZoneParent( const ZoneEvent& zone, uint64_t tid ) const
 {
-    const auto thread = m_worker.GetThreadData( tid );
-    const ZoneEvent* parent = nullptr;
-    const Vector<short_ptr<ZoneEvent>>* timeline = &thread->timeline;
-    if( timeline->empty() ) return nullptr;
-    for(;;)
+    std::vector<const ZoneEvent*> ancestors;
+    if( !GetZoneAncestors( *m_worker.GetThreadData( tid ), zone, ancestors ) || ancestors.empty() ) return nullptr;
+    return ancestors.back();
+}
+
+static bool IsZoneReentry( const Worker& worker, const ZoneEvent& zone, const std::vector<const ZoneEvent*>& ancestors )
+{
+    const auto srcloc = worker.GetZoneSrcLoc( zone );
+    for( auto& v : ancestors )
     {
-        if( timeline->is_magic() )
-        {
-            auto vec = (Vector<ZoneEvent>*)timeline;
-            auto it = std::upper_bound( vec->begin(), vec->end(), zone.Start(), [] ( const auto& l, const auto& r ) { return l < r.Start(); } );
-            if( it != vec->begin() ) --it;
-            if( zone.IsEndValid() && it->Start() > zone.End() ) break;
-            if( it == &zone ) return parent;
-            if( !it->HasChildren() ) break;
-            parent = it;
-            timeline = &m_worker.GetZoneChildren( parent->Child() );
-        }
-        else
-        {
-            auto it = std::upper_bound( timeline->begin(), timeline->end(), zone.Start(), [] ( const auto& l, const auto& r ) { return l < r->Start(); } );
-            if( it != timeline->begin() ) --it;
-            if( zone.IsEndValid() && (*it)->Start() > zone.End() ) break;
-            if( *it == &zone ) return parent;
-            if( !(*it)->HasChildren() ) break;
-            parent = *it;
-            timeline = &m_worker.GetZoneChildren( parent->Child() );
-        }
+        if( worker.GetZoneSrcLoc( *v ) == srcloc ) return true;
     }
-    return nullptr;
+    return false;
 }
 
 bool View::IsZoneReentry( const ZoneEvent& zone ) const
@@ -305,7 +265,7 @@ bool View::IsZoneReentry( const ZoneEvent& zone ) const
 #ifndef TRACY_NO_STATISTICS
     if( m_worker.AreSourceLocationZonesReady() )
     {
-        auto& slz = m_worker.GetZonesForSourceLocation( zone.SrcLoc() );
+        auto& slz = m_worker.GetZonesForSourceLocation( m_worker.GetZoneSrcLoc( zone ) );
         if( !slz.zones.empty() && slz.zones.is_sorted() )
         {
             auto it = std::lower_bound( slz.zones.begin(), slz.zones.end(), zone.Start(), [] ( const auto& lhs, const auto& rhs ) { return lhs.Zone()->Start() < rhs; } );
@@ -317,74 +277,19 @@ bool View::IsZoneReentry( const ZoneEvent& zone ) const
     }
 #endif
 
+    std::vector<const ZoneEvent*> ancestors;
     for( const auto& thread : m_worker.GetThreadData() )
     {
-        const ZoneEvent* parent = nullptr;
-        const Vector<short_ptr<ZoneEvent>>* timeline = &thread->timeline;
-        if( timeline->empty() ) continue;
-        for(;;)
-        {
-            if( timeline->is_magic() )
-            {
-                auto vec = (Vector<ZoneEvent>*)timeline;
-                auto it = std::upper_bound( vec->begin(), vec->end(), zone.Start(), [] ( const auto& l, const auto& r ) { return l < r.Start(); } );
-                if( it != vec->begin() ) --it;
-                if( zone.IsEndValid() && it->Start() > zone.End() ) break;
-                if( it == &zone ) return false;
-                if( !it->HasChildren() ) break;
-                parent = it;
-                if (parent->SrcLoc() == zone.SrcLoc() ) return true;
-                timeline = &m_worker.GetZoneChildren( parent->Child() );
-            }
-            else
-            {
-                auto it = std::upper_bound( timeline->begin(), timeline->end(), zone.Start(), [] ( const auto& l, const auto& r ) { return l < r->Start(); } );
-                if( it != timeline->begin() ) --it;
-                if( zone.IsEndValid() && (*it)->Start() > zone.End() ) break;
-                if( *it == &zone ) return false;
-                if( !(*it)->HasChildren() ) break;
-                parent = *it;
-                if (parent->SrcLoc() == zone.SrcLoc() ) return true;
-                timeline = &m_worker.GetZoneChildren( parent->Child() );
-            }
-        }
+        if( GetZoneAncestors( *thread, zone, ancestors ) ) return tracy::IsZoneReentry( m_worker, zone, ancestors );
     }
     return false;
 }
 
 bool View::IsZoneReentry( const ZoneEvent& zone, uint64_t tid ) const
 {
-    const auto thread = m_worker.GetThreadData( tid );
-    const ZoneEvent* parent = nullptr;
-    const Vector<short_ptr<ZoneEvent>>* timeline = &thread->timeline;
-    if( timeline->empty() ) return false;
-    for(;;)
-    {
-        if( timeline->is_magic() )
-        {
-            auto vec = (Vector<ZoneEvent>*)timeline;
-            auto it = std::upper_bound( vec->begin(), vec->end(), zone.Start(), [] ( const auto& l, const auto& r ) { return l < r.Start(); } );
-            if( it != vec->begin() ) --it;
-            if( zone.IsEndValid() && it->Start() > zone.End() ) break;
-            if( it == &zone ) return false;
-            if( !it->HasChildren() ) break;
-            parent = it;
-            if (parent->SrcLoc() == zone.SrcLoc() ) return true;
-            timeline = &m_worker.GetZoneChildren( parent->Child() );
-        }
-        else
-        {
-            auto it = std::upper_bound( timeline->begin(), timeline->end(), zone.Start(), [] ( const auto& l, const auto& r ) { return l < r->Start(); } );
-            if( it != timeline->begin() ) --it;
-            if( zone.IsEndValid() && (*it)->Start() > zone.End() ) break;
-            if( *it == &zone ) return false;
-            if( !(*it)->HasChildren() ) break;
-            parent = *it;
-            if (parent->SrcLoc() == zone.SrcLoc() ) return true;
-            timeline = &m_worker.GetZoneChildren( parent->Child() );
-        }
-    }
-    return false;
+    std::vector<const ZoneEvent*> ancestors;
+    if( !GetZoneAncestors( *m_worker.GetThreadData( tid ), zone, ancestors ) ) return false;
+    return tracy::IsZoneReentry( m_worker, zone, ancestors );
 }
 
 const GpuEvent* View::GetZoneParent( const GpuEvent& zone ) const
@@ -430,7 +335,7 @@ const ThreadData* View::GetZoneThreadData( const ZoneEvent& zone ) const
 #ifndef TRACY_NO_STATISTICS
     if( m_worker.AreSourceLocationZonesReady() )
     {
-        auto& slz = m_worker.GetZonesForSourceLocation( zone.SrcLoc() );
+        auto& slz = m_worker.GetZonesForSourceLocation( m_worker.GetZoneSrcLoc( zone ) );
         if( !slz.zones.empty() && slz.zones.is_sorted() )
         {
             auto it = std::lower_bound( slz.zones.begin(), slz.zones.end(), zone.Start(), [] ( const auto& lhs, const auto& rhs ) { return lhs.Zone()->Start() < rhs; } );
@@ -444,30 +349,12 @@ const ThreadData* View::GetZoneThreadData( const ZoneEvent& zone ) const
 
     for( const auto& thread : m_worker.GetThreadData() )
     {
-        const Vector<short_ptr<ZoneEvent>>* timeline = &thread->timeline;
-        if( timeline->empty() ) continue;
-        for(;;)
-        {
-            if( timeline->is_magic() )
-            {
-                auto vec = (Vector<ZoneEvent>*)timeline;
-                auto it = std::upper_bound( vec->begin(), vec->end(), zone.Start(), [] ( const auto& l, const auto& r ) { return l < r.Start(); } );
-                if( it != vec->begin() ) --it;
-                if( zone.IsEndValid() && it->Start() > zone.End() ) break;
-                if( it == &zone ) return thread;
-                if( !it->HasChildren() ) break;
-                timeline = &m_worker.GetZoneChildren( it->Child() );
-            }
-            else
-            {
-                auto it = std::upper_bound( timeline->begin(), timeline->end(), zone.Start(), [] ( const auto& l, const auto& r ) { return l < r->Start(); } );
-                if( it != timeline->begin() ) --it;
-                if( zone.IsEndValid() && (*it)->Start() > zone.End() ) break;
-                if( *it == &zone ) return thread;
-                if( !(*it)->HasChildren() ) break;
-                timeline = &m_worker.GetZoneChildren( (*it)->Child() );
-            }
-        }
+        bool found = false;
+        m_worker.QueryThreadZones( *thread, zone.Start(), zone.Start(), [&] ( const ZoneEvent& z, int ) {
+            found = &z == &zone;
+            return !found;
+        } );
+        if( found ) return thread;
     }
     return nullptr;
 }
@@ -26,7 +26,7 @@ inline uint32_t GetZoneCallstack<GpuEvent>( const GpuEvent& ev, const Worker& wo
     return ev.callstack.Val();
 }
 
-void View::CalcZoneTimeData( unordered_flat_map<int16_t, ZoneTimeData>& data, int64_t& ztime, const ZoneEvent& zone )
+void View::CalcZoneTimeData( unordered_flat_map<int32_t, ZoneTimeData>& data, int64_t& ztime, const ZoneEvent& zone )
 {
     assert( zone.HasChildren() );
     const auto& children = m_worker.GetZoneChildren( zone.Child() );
@@ -41,7 +41,7 @@ void View::CalcZoneTimeData( unordered_flat_map<int16_t, ZoneTimeData>& data, in
 }
 
 template<typename Adapter, typename V>
-void View::CalcZoneTimeDataImpl( const V& children, unordered_flat_map<int16_t, ZoneTimeData>& data, int64_t& ztime )
+void View::CalcZoneTimeDataImpl( const V& children, unordered_flat_map<int32_t, ZoneTimeData>& data, int64_t& ztime )
 {
     Adapter a;
     if( m_timeDist.exclusiveTime )
@@ -56,7 +56,7 @@ void View::CalcZoneTimeDataImpl( const V& children, unordered_flat_map<int16_t,
     }
     for( auto& child : children )
     {
-        const auto srcloc = a(child).SrcLoc();
+        const auto srcloc = m_worker.GetZoneSrcLoc( a(child) );
         const auto t = m_worker.GetZoneEnd( a(child) ) - a(child).Start();
         auto it = data.find( srcloc );
         if( it == data.end() )
@@ -72,7 +72,7 @@ void View::CalcZoneTimeDataImpl( const V& children, unordered_flat_map<int16_t,
     }
 }
 
-void View::CalcZoneTimeData( const ContextSwitch* ctx, unordered_flat_map<int16_t, ZoneTimeData>& data, int64_t& ztime, const ZoneEvent& zone )
+void View::CalcZoneTimeData( const ContextSwitch* ctx, unordered_flat_map<int32_t, ZoneTimeData>& data, int64_t& ztime, const ZoneEvent& zone )
 {
     assert( zone.HasChildren() );
     const auto& children = m_worker.GetZoneChildren( zone.Child() );
@@ -87,7 +87,7 @@ void View::CalcZoneTimeData( const ContextSwitch* ctx, unordered_flat_map<int16_
 }
 
 template<typename Adapter, typename V>
-void View::CalcZoneTimeDataImpl( const V& children, const ContextSwitch* ctx, unordered_flat_map<int16_t, ZoneTimeData>& data, int64_t& ztime )
+void View::CalcZoneTimeDataImpl( const V& children, const ContextSwitch* ctx, unordered_flat_map<int32_t, ZoneTimeData>& data, int64_t& ztime )
 {
     Adapter a;
     if( m_timeDist.exclusiveTime )
@@ -105,7 +105,7 @@ void View::CalcZoneTimeDataImpl( const V& children, const ContextSwitch* ctx, un
     }
     for( auto& child : children )
     {
-        const auto srcloc = a(child).SrcLoc();
+        const auto srcloc = m_worker.GetZoneSrcLoc( a(child) );
         int64_t t;
         uint64_t cnt;
         const auto res = GetZoneRunningTime( ctx, a(child), t, cnt );
@@ -291,7 +291,7 @@ void View::DrawZoneInfoWindow()
 {
     auto& ev = *m_zoneInfoWindow;
 
-    const auto& srcloc = m_worker.GetSourceLocation( ev.SrcLoc() );
+    const auto& srcloc = m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( ev ) );
 
     const auto scale = GetScale();
     ImGui::SetNextWindowSize( ImVec2( 500 * scale, 600 * scale ), ImGuiCond_FirstUseEver );
@@ -315,7 +315,7 @@ void View::DrawZoneInfoWindow()
 #ifndef TRACY_NO_STATISTICS
         if( m_worker.AreSourceLocationZonesReady() )
         {
-            const auto sl = ev.SrcLoc();
+            const auto sl = m_worker.GetZoneSrcLoc( ev );
             const auto& slz = m_worker.GetZonesForSourceLocation( sl );
             if( !slz.zones.empty() )
             {
@@ -424,7 +424,7 @@ void View::DrawZoneInfoWindow()
             ImGui::SameLine();
             if( ClipboardButton( 1 ) ) ImGui::SetClipboardText( m_worker.GetString( srcloc.function ) );
         }
-        SmallColorBox( GetSrcLocColor( m_worker.GetSourceLocation( ev.SrcLoc() ), 0 ) );
+        SmallColorBox( GetSrcLocColor( m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( ev ) ), 0 ) );
         ImGui::SameLine();
         TextDisabledUnformatted( "Location:" );
         ImGui::SameLine();
@@ -460,7 +460,7 @@ void View::DrawZoneInfoWindow()
 #ifndef TRACY_NO_STATISTICS
         if( m_worker.AreSourceLocationZonesReady() )
         {
-            auto& zoneData = m_worker.GetZonesForSourceLocation( ev.SrcLoc() );
+            auto& zoneData = m_worker.GetZonesForSourceLocation( m_worker.GetZoneSrcLoc( ev ) );
             if( zoneData.total > 0 )
             {
                 ImGui::SameLine();
@@ -931,7 +931,7 @@ void View::DrawZoneInfoWindow()
         DrawZoneTrace<const ZoneEvent*>( &ev, zoneTrace, m_worker, m_zoneinfoBuzzAnim, *this, m_showUnknownFrames, [&idx, this] ( const ZoneEvent* v, int& fidx ) {
             ImGui::TextDisabled( "%i.", fidx++ );
             ImGui::SameLine();
-            const auto& srcloc = m_worker.GetSourceLocation( v->SrcLoc() );
+            const auto& srcloc = m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( *v ) );
             SmallColorBox( GetSrcLocColor( srcloc, 0 ) );
             ImGui::SameLine();
             const auto txt = m_worker.GetZoneName( *v, srcloc );
@@ -1023,21 +1023,21 @@ void View::DrawZoneInfoWindow()
                         }
                         else
                         {
-                            auto it = m_timeDist.data.emplace( ev.SrcLoc(), ZoneTimeData{ time, 1 } ).first;
+                            auto it = m_timeDist.data.emplace( m_worker.GetZoneSrcLoc( ev ), ZoneTimeData{ time, 1 } ).first;
                             CalcZoneTimeData( ctx, m_timeDist.data, it->second.time, ev );
                         }
                         m_timeDist.fztime = 100.f / time;
                     }
                     else
                     {
-                        auto it = m_timeDist.data.emplace( ev.SrcLoc(), ZoneTimeData{ ztime, 1 } ).first;
+                        auto it = m_timeDist.data.emplace( m_worker.GetZoneSrcLoc( ev ), ZoneTimeData{ ztime, 1 } ).first;
                         CalcZoneTimeData( m_timeDist.data, it->second.time, ev );
                         m_timeDist.fztime = 100.f / ztime;
                     }
                 }
                 if( !m_timeDist.data.empty() )
                 {
-                    std::vector<unordered_flat_map<int16_t, ZoneTimeData>::const_iterator> vec;
+                    std::vector<unordered_flat_map<int32_t, ZoneTimeData>::const_iterator> vec;
                     vec.reserve( m_timeDist.data.size() );
                     for( auto it = m_timeDist.data.cbegin(); it != m_timeDist.data.cend(); ++it ) vec.emplace_back( it );
                     if( ImGui::BeginTable( "##timedist", 3, ImGuiTableFlags_Sortable | ImGuiTableFlags_BordersInnerV ) )
@@ -1138,19 +1138,19 @@ void View::DrawZoneInfoChildren( const V& children, int64_t ztime )
     {
         struct ChildGroup
         {
-            int16_t srcloc;
+            int32_t srcloc;
             uint64_t t;
             Vector<uint32_t> v;
         };
         uint64_t ctime = 0;
-        unordered_flat_map<int16_t, ChildGroup> cmap;
+        unordered_flat_map<int32_t, ChildGroup> cmap;
         cmap.reserve( 128 );
         for( size_t i=0; i<children.size(); i++ )
         {
             const auto& child = a(children[i]);
             const auto cend = m_worker.GetZoneEnd( child );
             const auto ct = cend - child.Start();
-            const auto srcloc = child.SrcLoc();
+            const auto srcloc = m_worker.GetZoneSrcLoc( child );
             ctime += ct;
 
             auto it = cmap.find( srcloc );
@@ -1326,7 +1326,7 @@ void View::DrawZoneInfoChildren( const V& children, int64_t ztime )
                 auto& cev = a(children[cti[i]]);
                 const auto txt = m_worker.GetZoneName( cev );
                 bool b = false;
-                SmallColorBox( GetSrcLocColor( m_worker.GetSourceLocation( cev.SrcLoc() ), 0 ) );
+                SmallColorBox( GetSrcLocColor( m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( cev ) ), 0 ) );
                 ImGui::SameLine();
                 ImGui::PushID( (int)i );
                 if( ImGui::Selectable( txt, &b, ImGuiSelectableFlags_SpanAllColumns ) )
@@ -1826,7 +1826,7 @@ void View::ShowZoneInfo( const GpuEvent& ev, uint64_t thread )
 void View::ZoneTooltip( const ZoneEvent& ev )
 {
     const auto tid = GetZoneThread( ev );
-    auto& srcloc = m_worker.GetSourceLocation( ev.SrcLoc() );
+    auto& srcloc = m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( ev ) );
     const auto end = m_worker.GetZoneEnd( ev );
     const auto ztime = end - ev.Start();
     const auto selftime = GetZoneSelfTime( ev );
@@ -1860,7 +1860,7 @@ void View::ZoneTooltip( const ZoneEvent& ev )
 #ifndef TRACY_NO_STATISTICS
     if( m_worker.AreSourceLocationZonesReady() )
     {
-        auto& zoneData = m_worker.GetZonesForSourceLocation( ev.SrcLoc() );
+        auto& zoneData = m_worker.GetZonesForSourceLocation( m_worker.GetZoneSrcLoc( ev ) );
         if( zoneData.total > 0 )
         {
             ImGui::SameLine();
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <inttypes.h>
 
 #include "TracyColor.hpp"
@@ -23,7 +24,7 @@ static tracy_force_inline uint32_t MixGhostColor( uint32_t c0, uint32_t c1 )
         ( ( ( ( ( c0 & 0x000000FF )       ) + 3 * ( ( c1 & 0x000000FF )       ) ) >> 2 )       );
 }
 
-void View::DrawThread( const TimelineContext& ctx, const ThreadData& thread, const std::vector<TimelineDraw>& draw, const std::vector<ContextSwitchDraw>& ctxDraw, const std::vector<SamplesDraw>& samplesDraw, const std::vector<std::unique_ptr<LockDraw>>& lockDraw, int& offset, int depth, bool _hasCtxSwitches, bool _hasSamples )
+void View::DrawThread( const TimelineContext& ctx, const ThreadData& thread, const std::vector<TimelineDraw>& draw, const std::vector<ContextSwitchDraw>& ctxDraw, const std::vector<SamplesDraw>& samplesDraw, const std::vector<std::unique_ptr<LockDraw>>& lockDraw, const std::vector<ZoneLodDraw>& lodDraw, int& offset, int depth, bool _hasCtxSwitches, bool _hasSamples )
 {
     const auto& wpos = ctx.wpos;
     const auto ty = ctx.ty;
@@ -56,8 +57,10 @@ void View::DrawThread( const TimelineContext& ctx, const ThreadData& thread, con
     }
 
     const auto yPos = wpos.y + offset;
-    if( !draw.empty() && yPos <= yMax && yPos + ostep * depth >= yMin )
+    if( ( !draw.empty() || !lodDraw.empty() ) && yPos <= yMax && yPos + ostep * depth >= yMin )
     {
+        // Large zones are drawn over the summary.
+        if( !lodDraw.empty() ) DrawZoneLodList( ctx, lodDraw, offset, thread.id );
         DrawZoneList( ctx, draw, offset, thread.id );
     }
     offset += ostep * depth;
@@ -198,6 +201,124 @@ void View::DrawThreadOverlays( const ThreadData& thread, const ImVec2& ul, const
     }
 }
 
+void View::DrawZoneLodList( const TimelineContext& ctx, const std::vector<ZoneLodDraw>& drawList, int _offset, uint64_t tid )
+{
+    auto draw = ImGui::GetWindowDrawList();
+    const auto w = ctx.w;
+    const auto& wpos = ctx.wpos;
+    const auto ty = ctx.ty;
+    const auto ostep = ty + 1;
+    const auto yMin = ctx.yMin;
+    const auto yMax = ctx.yMax;
+    const auto pxns = ctx.pxns;
+    const auto hover = ctx.hover;
+    const auto vStart = ctx.vStart;
+
+    for( auto& v : drawList )
+    {
+        const auto offset = _offset + ostep * v.depth;
+        const auto yPos = wpos.y + offset;
+        if( yPos > yMax || yPos + ostep < yMin ) continue;
+
+        const auto color = m_vd.dynamicColors == 2 ? 0xFF666666 : GetThreadColor( tid, v.depth );
+        const auto start = v.start.Val();
+        const auto end = v.end.Val();
+        const auto px0 = std::max( ( start - vStart ) * pxns, -10.0 );
+        const auto px1 = std::min( std::max( ( end - vStart ) * pxns, px0 + MinVisSize ), double( w + 10 ) );
+        draw->AddRectFilled( wpos + ImVec2( px0, offset ), wpos + ImVec2( px1, offset + ty ), color );
+        DrawZigZag( draw, wpos + ImVec2( 0, offset + ty/2 ), px0, px1, ty/4, DarkenColor( color ) );
+        if( hover && ImGui::IsMouseHoveringRect( wpos + ImVec2( px0, offset ), wpos + ImVec2( px1, offset + ty + 1 ) ) )
+        {
+            if( IsMouseClickReleased( 1 ) ) m_setRangePopup = RangeSlim { start, end, true };
+            ImGui::BeginTooltip();
+            ImGui::TextUnformatted( "Zones too small to display" );
+            ImGui::Separator();
+            if( v.depth == 0 )
+            {
+                const auto& srcloc = m_worker.GetSourceLocation( v.srcloc );
+                TextFocused( "Zone count:", RealToString( v.num ) );
+                TextFocused( "Mostly:", m_worker.GetZoneName( srcloc ) );
+            }
+            TextFocused( "Time span:", TimeToString( end - start ) );
+            ImGui::EndTooltip();
+
+            if( IsMouseClicked( 2 ) && end - start > 0 )
+            {
+                ZoomToRange( start, end );
+            }
+        }
+    }
+}
+
+void View::ZoneLodJob( bool isStatic )
+{
+    // Unfinished zones in a saved trace will never end, so they are cut at the end of the trace.
+    ZoneLodBuilder builder( m_worker, isStatic ? m_worker.GetLastTime() : -1 );
+    auto& job = m_zoneLod.job;
+
+    if( isStatic )
+    {
+        for( auto& td : m_worker.GetThreadData() )
+        {
+            if( td->count < ZoneLodBuilder::MinZones || td->timeline.empty() ) continue;
+            auto lod = builder.Create( *td );
+            for(;;)
+            {
+                if( job.IsStopping() ) return;
+                size_t budget = 1024 * 1024;
+                if( builder.Process( *lod, *td, budget ) ) break;
+            }
+            lod->Update();
+
+            std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+            if( !job.Lock( lock ) ) return;
+            m_zoneLod.threads.emplace( td->id, std::move( lod ) );
+        }
+        return;
+    }
+
+    // New data is processed in bounded steps, as the data lock blocks the capture.
+    size_t first = 0;
+    for(;;)
+    {
+        bool progress = false;
+        {
+            std::unique_lock<std::mutex> lock( m_worker.GetDataLock(), std::defer_lock );
+            if( !job.Lock( lock ) ) return;
+            // Threads are visited round robin, so that a busy thread can't starve the others.
+            const auto& threads = m_worker.GetThreadData();
+            size_t budget = 256 * 1024;
+            for( size_t i=0; i<threads.size(); i++ )
+            {
+                auto td = threads[( first + i ) % threads.size()];
+                if( td->count < ZoneLodBuilder::MinZones || td->timeline.empty() ) continue;
+                auto it = m_zoneLod.threads.find( td->id );
+                if( it == m_zoneLod.threads.end() ) it = m_zoneLod.threads.emplace( td->id, builder.Create( *td ) ).first;
+                const auto prev = budget;
+                builder.Process( *it->second, *td, budget );
+                if( budget != prev )
+                {
+                    it->second->Update();
+                    progress = true;
+                }
+                if( budget == 0 )
+                {
+                    first = ( first + i + 1 ) % threads.size();
+                    break;
+                }
+            }
+        }
+        if( !progress )
+        {
+            if( !job.Wait( 100 ) ) return;
+        }
+        else if( job.IsStopping() )
+        {
+            return;
+        }
+    }
+}
+
 void View::DrawZoneList( const TimelineContext& ctx, const std::vector<TimelineDraw>& drawList, int _offset, uint64_t tid )
 {
     auto draw = ImGui::GetWindowDrawList();
@@ -257,8 +378,8 @@ void View::DrawZoneList( const TimelineContext& ctx, const std::vector<TimelineD
                     {
                         if( ImGui::GetIO().KeyCtrl )
                         {
-                            auto& srcloc = m_worker.GetSourceLocation( ev.SrcLoc() );
-                            m_findZone.ShowZone( ev.SrcLoc(), m_worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function ) );
+                            auto& srcloc = m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( ev ) );
+                            m_findZone.ShowZone( m_worker.GetZoneSrcLoc( ev ), m_worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function ) );
                         }
                         else
                         {
@@ -266,7 +387,7 @@ void View::DrawZoneList( const TimelineContext& ctx, const std::vector<TimelineD
                         }
                     }
 
-                    m_zoneSrcLocHighlight = ev.SrcLoc();
+                    m_zoneSrcLocHighlight = m_worker.GetZoneSrcLoc( ev );
                     m_zoneHover = &ev;
                 }
             }
@@ -353,8 +474,8 @@ void View::DrawZoneList( const TimelineContext& ctx, const std::vector<TimelineD
                 {
                     if( ImGui::GetIO().KeyCtrl )
                     {
-                        auto& srcloc = m_worker.GetSourceLocation( ev.SrcLoc() );
-                        m_findZone.ShowZone( ev.SrcLoc(), m_worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function ) );
+                        auto& srcloc = m_worker.GetSourceLocation( m_worker.GetZoneSrcLoc( ev ) );
+                        m_findZone.ShowZone( m_worker.GetZoneSrcLoc( ev ), m_worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function ) );
                     }
                     else
                     {
@@ -362,7 +483,7 @@ void View::DrawZoneList( const TimelineContext& ctx, const std::vector<TimelineD
                     }
                 }
 
-                m_zoneSrcLocHighlight = ev.SrcLoc();
+                m_zoneSrcLocHighlight = m_worker.GetZoneSrcLoc( ev );
                 m_zoneHover = &ev;
             }
             break;
@@ -0,0 +1,223 @@
+#include <algorithm>
+
+#include "TracyZoneLod.hpp"
+#include "../server/TracyWorker.hpp"
+
+namespace tracy
+{
+
+ZoneLod::ZoneLod( int64_t start, int64_t end )
+    : m_base( start )
+    , m_shift( MinShift )
+    , m_end( start )
+    , m_dirtyMin( std::numeric_limits<size_t>::max() )
+    , m_dirtyMax( 0 )
+{
+    assert( end >= start );
+    while( ( ( end - start ) >> m_shift ) >= MaxBuckets ) m_shift++;
+    m_levels.emplace_back();
+}
+
+ZoneLod::Bucket ZoneLod::Merge( const Bucket& a, const Bucket& b )
+{
+    if( a.depth == 0 ) return b;
+    if( b.depth == 0 ) return a;
+
+    Bucket ret;
+    ret.depth = std::max( a.depth, b.depth );
+    ret.num = uint32_t( std::min<uint64_t>( uint64_t( a.num ) + b.num, std::numeric_limits<uint32_t>::max() ) );
+    if( a.srcloc == b.srcloc )
+    {
+        ret.srcloc = a.srcloc;
+        ret.time = a.time + b.time;
+    }
+    else if( a.time >= b.time )
+    {
+        ret.srcloc = a.srcloc;
+        ret.time = a.time;
+    }
+    else
+    {
+        ret.srcloc = b.srcloc;
+        ret.time = b.time;
+    }
+    return ret;
+}
+
+void ZoneLod::Add( const ZoneEvent& zone, int64_t start, int64_t end, int depth, int32_t srcloc )
+{
+    assert( start >= m_base );
+    assert( end >= start );
+    while( ( ( end - m_base ) >> m_shift ) >= MaxBuckets ) Coarsen();
+
+    const auto i0 = size_t( ( start - m_base ) >> m_shift );
+    const auto i1 = size_t( ( end - m_base ) >> m_shift );
+    auto& level = m_levels[0];
+    if( level.size() <= i1 ) level.resize( i1 + 1, Bucket {} );
+
+    level[i0].num++;
+    for( size_t i=i0; i<=i1; i++ )
+    {
+        auto& b = level[i];
+        if( b.depth <= depth ) b.depth = uint16_t( depth + 1 );
+    }
+    if( depth == 0 )
+    {
+        // A single counter heavy hitter estimate is good enough to pick the color of a bucket.
+        for( size_t i=i0; i<=i1; i++ )
+        {
+            auto& b = level[i];
+            const auto bs = m_base + ( int64_t( i ) << m_shift );
+            const auto be = bs + ( int64_t( 1 ) << m_shift );
+            const auto t = float( std::min( end, be ) - std::max( start, bs ) );
+            if( b.time == 0 || b.srcloc == srcloc )
+            {
+                b.srcloc = srcloc;
+                b.time += t;
+            }
+            else if( t > b.time )
+            {
+                b.srcloc = srcloc;
+                b.time = t;
+            }
+        }
+    }
+
+    if( i1 - i0 + 1 >= LargeZoneBuckets )
+    {
+        if( m_large.size() <= size_t( depth ) ) m_large.resize( depth + 1 );
+        m_large[depth].emplace_back( &zone );
+    }
+
+    m_dirtyMin = std::min( m_dirtyMin, i0 );
+    m_dirtyMax = std::max( m_dirtyMax, i1 );
+}
+
+void ZoneLod::Update()
+{
+    if( m_dirtyMin > m_dirtyMax ) return;
+
+    auto d0 = m_dirtyMin;
+    auto d1 = m_dirtyMax;
+    size_t l = 1;
+    while( m_levels[l-1].size() > TopBuckets )
+    {
+        if( l == m_levels.size() )
+        {
+            m_levels.emplace_back();
+            d0 = 0;
+            d1 = m_levels[l-1].size() - 1;
+        }
+        const auto& src = m_levels[l-1];
+        auto& dst = m_levels[l];
+        dst.resize( ( src.size() + 1 ) / 2, Bucket {} );
+        d0 /= 2;
+        d1 /= 2;
+        for( size_t i=d0; i<=d1; i++ )
+        {
+            const auto c = i * 2;
+            dst[i] = c+1 < src.size() ? Merge( src[c], src[c+1] ) : src[c];
+        }
+        l++;
+    }
+
+    m_dirtyMin = std::numeric_limits<size_t>::max();
+    m_dirtyMax = 0;
+}
+
+void ZoneLod::Coarsen()
+{
+    Update();
+    if( m_levels.size() == 1 )
+    {
+        const auto& src = m_levels[0];
+        std::vector<Bucket> dst( ( src.size() + 1 ) / 2 );
+        for( size_t i=0; i<dst.size(); i++ )
+        {
+            const auto c = i * 2;
+            dst[i] = c+1 < src.size() ? Merge( src[c], src[c+1] ) : src[c];
+        }
+        m_levels.emplace_back( std::move( dst ) );
+    }
+    m_levels.erase( m_levels.begin() );
+    m_shift++;
+
+    const auto minSize = int64_t( LargeZoneBuckets ) << m_shift;
+    for( auto& v : m_large )
+    {
+        v.erase( std::remove_if( v.begin(), v.end(), [minSize] ( const auto& z ) { return z->IsEndValid() && z->End() - z->Start() < minSize; } ), v.end() );
+    }
+}
+
+int ZoneLod::FindLevel( int64_t size ) const
+{
+    if( GetBucketSize( 0 ) > size ) return -1;
+    int level = 0;
+    while( level+1 < (int)m_levels.size() && GetBucketSize( level+1 ) <= size ) level++;
+    return level;
+}
+
+
+ZoneLodBuilder::ZoneLodBuilder( const Worker& worker, int64_t fallbackEnd )
+    : m_worker( worker )
+    , m_fallbackEnd( fallbackEnd )
+{
+}
+
+std::unique_ptr<ZoneLod> ZoneLodBuilder::Create( const ThreadData& td ) const
+{
+    assert( !td.timeline.empty() );
+    int64_t start, end;
+    if( td.timeline.is_magic() )
+    {
+        auto& vec = *(const Vector<ZoneEvent>*)&td.timeline;
+        start = vec.front().Start();
+        end = vec.back().IsEndValid() ? vec.back().End() : vec.back().Start();
+    }
+    else
+    {
+        start = td.timeline.front()->Start();
+        end = td.timeline.back()->IsEndValid() ? td.timeline.back()->End() : td.timeline.back()->Start();
+    }
+    if( m_fallbackEnd >= 0 ) end = std::max( end, m_fallbackEnd );
+    return std::make_unique<ZoneLod>( start, end );
+}
+
+namespace
+{
+
+struct ZoneLodVisitor
+{
+    const Worker& worker;
+    ZoneLod& lod;
+    int64_t fallbackEnd;
+
+    uint32_t Enter( const ZoneEvent& zone, int depth, uint32_t )
+    {
+        const auto start = zone.Start();
+        const auto end = std::max( start, zone.IsEndValid() ? zone.End() : fallbackEnd );
+        lod.Add( zone, start, end, depth, worker.GetZoneSrcLoc( zone ) );
+        return 0;
+    }
+
+    // The summary is never revisited, so its end only moves past a top level zone once the
+    // whole subtree was added.
+    void Leave( const ZoneEvent& zone, int depth, uint32_t )
+    {
+        if( depth == 0 ) lod.SetEnd( zone.IsEndValid() ? zone.End() : fallbackEnd );
+    }
+};
+
+}
+
+bool ZoneLodBuilder::Process( ZoneLod& lod, const ThreadData& td, size_t& budget )
+{
+    auto it = m_walkers.find( td.id );
+    if( it == m_walkers.end() )
+    {
+        it = m_walkers.emplace( td.id, ZoneTreeWalker( std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), m_fallbackEnd >= 0 ? ZoneTreeWalker::Open::Ended : ZoneTreeWalker::Open::Wait ) ).first;
+    }
+    return it->second.Walk( m_worker, td.timeline, 0, budget, ZoneLodVisitor { m_worker, lod, m_fallbackEnd } );
+}
+
+}
@@ -0,0 +1,97 @@
+#ifndef __TRACYZONELOD_HPP__
+#define __TRACYZONELOD_HPP__
+
+#include <assert.h>
+#include <limits>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include "../server/TracyEvent.hpp"
+#include "../server/TracyShortPtr.hpp"
+#include "../server/TracyZoneTree.hpp"
+#include "../server/tracy_robin_hood.h"
+
+namespace tracy
+{
+
+// Multi-resolution summary of a thread's zones, used to draw the timeline when zoomed out
+// far enough that individual zones are no longer visible. Level 0 buckets have a size of
+// 2^shift ns and each following level halves the bucket count. The finest level is coarsened
+// as the trace grows, to keep the memory use bounded.
+class ZoneLod
+{
+public:
+    enum { MaxBuckets = 8 * 1024 };
+    enum { TopBuckets = 64 };
+    // Finer buckets would only be used at zoom levels where drawing zones directly is cheap.
+    enum { MinShift = 16 };
+    // Zones spanning at least this many level 0 buckets are remembered, so that they can be
+    // drawn individually on top of the summary.
+    enum { LargeZoneBuckets = 8 };
+
+    struct Bucket
+    {
+        int32_t srcloc;     // dominant top level zone
+        uint32_t num;       // number of zones starting in the bucket
+        float time;         // dominant zone weight
+        uint16_t depth;     // number of occupied zone levels, 0 if empty
+    };
+
+    ZoneLod( int64_t start, int64_t end );
+
+    void Add( const ZoneEvent& zone, int64_t start, int64_t end, int depth, int32_t srcloc );
+    void Update();
+
+    // Finds the coarsest level with buckets not larger than the given size, or -1 if there is none.
+    int FindLevel( int64_t size ) const;
+
+    int64_t GetBase() const { return m_base; }
+    int64_t GetBucketSize( int level ) const { return int64_t( 1 ) << ( m_shift + level ); }
+    const std::vector<Bucket>& GetLevel( int level ) const { return m_levels[level]; }
+
+    // All zones ending before this time are included.
+    int64_t GetEnd() const { return m_end; }
+    void SetEnd( int64_t end ) { m_end = end; }
+
+    size_t GetLargeDepth() const { return m_large.size(); }
+    const std::vector<short_ptr<ZoneEvent>>& GetLargeZones( int depth ) const { return m_large[depth]; }
+
+    static Bucket Merge( const Bucket& a, const Bucket& b );
+
+private:
+    void Coarsen();
+
+    int64_t m_base;
+    int m_shift;
+    int64_t m_end;
+    size_t m_dirtyMin, m_dirtyMax;
+    std::vector<std::vector<Bucket>> m_levels;
+    std::vector<std::vector<short_ptr<ZoneEvent>>> m_large;
+};
+
+// Feeds finished zones of threads into their summaries. During live capture this has to
+// be called with the worker data lock held.
+class ZoneLodBuilder
+{
+public:
+    // Threads with fewer zones are fast enough to draw directly.
+    enum { MinZones = 64 * 1024 };
+
+    ZoneLodBuilder( const Worker& worker, int64_t fallbackEnd );
+
+    std::unique_ptr<ZoneLod> Create( const ThreadData& td ) const;
+
+    // Returns true if all zones available at this point were processed. Each zone uses one unit
+    // of the budget. Processing stops when the budget runs out, also in the middle of a subtree.
+    bool Process( ZoneLod& lod, const ThreadData& td, size_t& budget );
+
+private:
+    const Worker& m_worker;
+    int64_t m_fallbackEnd;
+    unordered_flat_map<uint64_t, ZoneTreeWalker> m_walkers;
+};
+
+}
+
+#endif
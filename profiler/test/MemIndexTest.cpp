@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "../../server/test/TracyTest.hpp"
+#include "../src/profiler/TracyMemIndex.hpp"
+
+namespace tracy
+{
+
+static void BruteLive( const MemData& mem, size_t first, size_t last, int64_t time, std::vector<uint32_t>& out )
+{
+    out.clear();
+    for( size_t i=first; i<last; i++ )
+    {
+        const auto tf = mem.data[i].TimeFree();
+        if( tf < 0 || tf >= time ) out.emplace_back( uint32_t( i ) );
+    }
+}
+
+static void BruteFreed( const MemData& mem, size_t first, size_t last, int64_t t0, int64_t t1, std::vector<uint32_t>& out )
+{
+    out.clear();
+    for( size_t i=first; i<last; i++ )
+    {
+        const auto tf = mem.data[i].TimeFree();
+        if( tf >= 0 && tf >= t0 && tf <= t1 ) out.emplace_back( uint32_t( i ) );
+    }
+}
+
+static bool FootprintHas( const MemIndex& index, uint64_t addr )
+{
+    const auto chunk = addr >> MemIndex::ChunkBits;
+    auto& fp = index.GetFootprint();
+    auto it = fp.find( chunk / MemIndex::PageChunks );
+    if( it == fp.end() ) return false;
+    const auto bit = chunk % MemIndex::PageChunks;
+    return ( it->second[bit / 64] >> ( bit % 64 ) ) & 1;
+}
+
+// The index is updated while allocations and frees are appended, as during a live capture, and
+// queries are compared against a linear scan, also over events not yet covered by the index.
+static void TestQueries()
+{
+    MemData mem;
+    MemIndex index;
+    TRACY_CHECK( index.IsEmpty() );
+
+    uint32_t seed = 7;
+    const auto rnd = [&seed] { seed = seed * 1664525 + 1013904223; return seed >> 8; };
+    std::vector<uint32_t> live;
+    std::vector<uint32_t> a, b;
+    int64_t time = 0;
+    for( int step=0; step<20000; step++ )
+    {
+        time += 1 + rnd() % 10;
+        if( live.empty() || rnd() % 3 != 0 )
+        {
+            MemEvent ev = {};
+            ev.SetPtr( 0x10000 + uint64_t( rnd() % 4096 ) * 4096 );
+            ev.SetSize( 1 + rnd() % 10000 );
+            ev.SetTimeThreadAlloc( time, 0 );
+            ev.SetTimeThreadFree( -1, 0 );
+            live.emplace_back( uint32_t( mem.data.size() ) );
+            mem.data.push_back( ev );
+        }
+        else
+        {
+            const auto pos = rnd() % live.size();
+            const auto idx = live[pos];
+            live[pos] = live.back();
+            live.pop_back();
+            mem.data[idx].SetTimeFree( time );
+            mem.frees.push_back( idx );
+        }
+
+        if( rnd() % 100 == 0 )
+        {
+            index.Update( mem );
+            TRACY_CHECK( !index.IsEmpty() );
+        }
+        if( rnd() % 50 == 0 )
+        {
+            const auto size = mem.data.size();
+            const auto first = rnd() % size;
+            const auto last = first + rnd() % ( size - first + 1 );
+            const auto t = int64_t( rnd() % uint32_t( time + 1 ) );
+
+            a.clear();
+            index.GetLive( mem, first, last, t, a );
+            BruteLive( mem, first, last, t, b );
+            std::sort( a.begin(), a.end() );
+            TRACY_CHECK( a == b );
+
+            const auto t1 = t + rnd() % 1000;
+            a.clear();
+            index.GetFreed( mem, first, last, t, t1, a );
+            BruteFreed( mem, first, last, t, t1, b );
+            std::sort( a.begin(), a.end() );
+            TRACY_CHECK( a == b );
+        }
+    }
+
+    index.Update( mem );
+    for( auto& ev : mem.data )
+    {
+        TRACY_CHECK( FootprintHas( index, ev.Ptr() ) );
+        TRACY_CHECK( FootprintHas( index, ev.Ptr() + ev.Size() ) );
+    }
+    TRACY_CHECK( !FootprintHas( index, 0 ) );
+}
+
+}
+
+TRACY_TEST_MAIN( tracy::TestQueries )
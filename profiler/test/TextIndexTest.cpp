@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <ctype.h>
+#include <regex>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../../server/test/TracyTest.hpp"
+#include "../src/profiler/TracyTextIndex.hpp"
+
+namespace tracy
+{
+
+static bool ContainsNoCase( const std::string& str, const std::string& sub )
+{
+    return std::search( str.begin(), str.end(), sub.begin(), sub.end(), [] ( char l, char r ) { return tolower( (unsigned char)l ) == tolower( (unsigned char)r ); } ) != str.end();
+}
+
+static std::vector<std::string> Literals( const char* re )
+{
+    std::vector<std::string> out;
+    TextIndex::GetRegexLiterals( re, out );
+    return out;
+}
+
+static void TestFind()
+{
+    std::vector<std::string> texts;
+    uint32_t seed = 1;
+    const auto rnd = [&seed] { seed = seed * 1664525 + 1013904223; return seed >> 8; };
+    static const char* words[] = { "Frame", "render", "physics", "update", "Load", "texture", "shader", "mesh", "a", "xy" };
+    for( int i=0; i<5000; i++ )
+    {
+        std::string text;
+        const auto cnt = rnd() % 5;
+        for( uint32_t j=0; j<cnt; j++ )
+        {
+            if( j != 0 ) text += ' ';
+            text += words[rnd() % 10];
+            if( rnd() % 3 == 0 ) text += std::to_string( rnd() % 1000 );
+        }
+        texts.emplace_back( std::move( text ) );
+    }
+    TextIndex index;
+    for( auto& v : texts ) index.Add( v.c_str() );
+    TRACY_CHECK( index.Size() == texts.size() );
+
+    const std::vector<std::vector<std::string>> queries = { { "render" }, { "RENDER" }, { "der tex" }, { "physics", "mesh" }, { "Load42" }, { "update", "xy 1" }, { "missing" } };
+    std::vector<uint32_t> blocks;
+    for( auto& q : queries )
+    {
+        TRACY_CHECK( index.Find( q, blocks ) );
+        TRACY_CHECK( std::is_sorted( blocks.begin(), blocks.end() ) );
+        for( size_t i=0; i<texts.size(); i++ )
+        {
+            bool match = true;
+            for( auto& s : q ) match = match && ContainsNoCase( texts[i], s );
+            if( match ) TRACY_CHECK( std::binary_search( blocks.begin(), blocks.end(), uint32_t( i >> TextIndex::BlockBits ) ) );
+        }
+    }
+    TRACY_CHECK( index.Find( { "missing" }, blocks ) && blocks.empty() );
+
+    // Strings shorter than a trigram can't narrow down the search.
+    TRACY_CHECK( !index.Find( { "xy" }, blocks ) );
+    TRACY_CHECK( !index.Find( {}, blocks ) );
+}
+
+static void TestRegexLiterals()
+{
+    TRACY_CHECK( Literals( "render" ) == std::vector<std::string>( { "render" } ) );
+    TRACY_CHECK( Literals( "load.*texture" ) == std::vector<std::string>( { "load", "texture" } ) );
+    TRACY_CHECK( Literals( "abcd*" ) == std::vector<std::string>( { "abc" } ) );
+    TRACY_CHECK( Literals( "abc+def" ) == std::vector<std::string>( { "abc", "def" } ) );
+    TRACY_CHECK( Literals( "[a-z]+_update\\d+" ) == std::vector<std::string>( { "_update" } ) );
+    TRACY_CHECK( Literals( "frame (begin|end) mark" ) == std::vector<std::string>( { "frame ", " mark" } ) );
+    TRACY_CHECK( Literals( "a\\.b\\(c" ) == std::vector<std::string>( { "a.b(c" } ) );
+    TRACY_CHECK( Literals( "render|physics" ).empty() );
+    TRACY_CHECK( Literals( "x{2,3}yz" ).empty() );
+
+    // Operands of character code escapes aren't literals.
+    TRACY_CHECK( Literals( "\\x41bc" ).empty() );
+    TRACY_CHECK( Literals( "foo\\x41bar" ) == std::vector<std::string>( { "foo", "bar" } ) );
+    TRACY_CHECK( Literals( "abc\\u0041def" ) == std::vector<std::string>( { "abc", "def" } ) );
+    TRACY_CHECK( Literals( "\\u00e9cole" ) == std::vector<std::string>( { "cole" } ) );
+    TRACY_CHECK( Literals( "\\cJabc" ) == std::vector<std::string>( { "abc" } ) );
+    TRACY_CHECK( Literals( "(ab)\\12xyz" ) == std::vector<std::string>( { "xyz" } ) );
+}
+
+// Any text matched by the expression has to contain all of its literals.
+static void TestRegexMatches()
+{
+    static const char* texts[] = { "Abc", "xAbc", "foo Abar", "abcAdef", "line\nabc", "render 123 mesh", "frame end mark", "ab12xyz" };
+    static const char* res[] = { "\\x41bc", "foo\\x41bar", "abc\\u0041def", "\\cJabc", "\\d+ mesh", "frame (begin|end) mark", "ab\\d\\dxyz" };
+    for( auto re : res )
+    {
+        const std::regex regex( re, std::regex::ECMAScript | std::regex::icase );
+        const auto literals = Literals( re );
+        for( auto text : texts )
+        {
+            if( !std::regex_search( text, regex ) ) continue;
+            for( auto& v : literals )
+            {
+                if( !ContainsNoCase( text, v ) )
+                {
+                    fprintf( stderr, "'%s' matches '%s', but doesn't contain '%s'\n", text, re, v.c_str() );
+                    TRACY_CHECK( false );
+                }
+            }
+        }
+    }
+}
+
+}
+
+TRACY_TEST_MAIN( tracy::TestFind, tracy::TestRegexLiterals, tracy::TestRegexMatches )
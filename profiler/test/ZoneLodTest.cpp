@@ -0,0 +1,159 @@
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../server/test/TracyTest.hpp"
+#include "../../server/TracyWorker.hpp"
+#include "../src/profiler/TracyZoneLod.hpp"
+
+namespace tracy
+{
+
+// Top level zones, each with a subtree of nested and sibling zones.
+static std::unique_ptr<Worker> MakeWorker( int topLevel, int children )
+{
+    std::vector<Worker::ImportEventTimeline> events;
+    uint64_t t = 1000;
+    const auto begin = [&] ( const char* name ) { events.emplace_back( Worker::ImportEventTimeline { 1, t, name, "", false, "test.cpp", 1 } ); t += 100; };
+    const auto end = [&] { events.emplace_back( Worker::ImportEventTimeline { 1, t, "", "", true, "", 0 } ); t += 100; };
+    for( int i=0; i<topLevel; i++ )
+    {
+        begin( i % 2 == 0 ? "Even" : "Odd" );
+        for( int j=0; j<children; j++ )
+        {
+            begin( "Child" );
+            begin( "Leaf" );
+            end();
+            end();
+        }
+        end();
+        t += i * 1000000;
+    }
+    return std::make_unique<Worker>( "test", "test", events, std::vector<Worker::ImportEventMessages>(), std::vector<Worker::ImportEventPlots>(), std::unordered_map<uint64_t, std::string>() );
+}
+
+static bool Equal( const ZoneLod::Bucket& a, const ZoneLod::Bucket& b )
+{
+    return a.srcloc == b.srcloc && a.num == b.num && a.time == b.time && a.depth == b.depth;
+}
+
+static uint64_t CountZones( const ZoneLod& lod )
+{
+    uint64_t cnt = 0;
+    for( auto& v : lod.GetLevel( 0 ) ) cnt += v.num;
+    return cnt;
+}
+
+static void TestMerge()
+{
+    const ZoneLod::Bucket empty = {};
+    const ZoneLod::Bucket a = { 1, 2, 10.f, 1 };
+    const ZoneLod::Bucket b = { 2, 3, 20.f, 3 };
+    TRACY_CHECK( Equal( ZoneLod::Merge( empty, a ), a ) );
+    TRACY_CHECK( Equal( ZoneLod::Merge( a, empty ), a ) );
+    const auto ab = ZoneLod::Merge( a, b );
+    TRACY_CHECK( ab.srcloc == 2 && ab.num == 5 && ab.time == 20.f && ab.depth == 3 );
+    const auto aa = ZoneLod::Merge( a, a );
+    TRACY_CHECK( aa.srcloc == 1 && aa.num == 4 && aa.time == 20.f && aa.depth == 1 );
+}
+
+static void TestUpdate()
+{
+    ZoneLod lod( 0, 1000000000 );
+    const ZoneEvent zone = {};
+    const auto bs = lod.GetBucketSize( 0 );
+    for( int i=0; i<1000; i++ ) lod.Add( zone, i * bs, i * bs + bs / 2, i % 3, i % 2 );
+    lod.Update();
+
+    // Each level halves the bucket count of the previous one, down to the top level.
+    TRACY_CHECK( lod.GetLevel( 0 ).size() == 1000 );
+    int level = 1;
+    for( ;; level++ )
+    {
+        auto& prev = lod.GetLevel( level-1 );
+        if( prev.size() <= ZoneLod::TopBuckets ) break;
+        auto& cur = lod.GetLevel( level );
+        TRACY_CHECK( cur.size() == ( prev.size() + 1 ) / 2 );
+        for( size_t i=0; i<cur.size(); i++ )
+        {
+            const auto merged = 2*i+1 < prev.size() ? ZoneLod::Merge( prev[2*i], prev[2*i+1] ) : prev[2*i];
+            TRACY_CHECK( Equal( cur[i], merged ) );
+        }
+    }
+    TRACY_CHECK( lod.FindLevel( bs - 1 ) == -1 );
+    TRACY_CHECK( lod.FindLevel( bs ) == 0 );
+    TRACY_CHECK( lod.FindLevel( bs * 4 ) == 2 );
+    TRACY_CHECK( lod.FindLevel( bs << 20 ) == level - 1 );
+
+    // Updates after adding more zones only touch the dirty range, with the same result.
+    lod.Add( zone, 10 * bs, 12 * bs, 5, 7 );
+    lod.Update();
+    TRACY_CHECK( lod.GetLevel( 1 )[5].depth == 6 && lod.GetLevel( 1 )[6].depth == 6 );
+    TRACY_CHECK( lod.GetLevel( 2 )[2].depth == 6 && lod.GetLevel( 2 )[3].depth == 6 );
+}
+
+static void TestCoarsen()
+{
+    ZoneLod lod( 0, 0 );
+    const ZoneEvent zone = {};
+    const auto bs = lod.GetBucketSize( 0 );
+    for( int i=0; i<ZoneLod::MaxBuckets; i++ ) lod.Add( zone, i * bs, i * bs, 0, 0 );
+    TRACY_CHECK( lod.GetBucketSize( 0 ) == bs );
+    lod.Add( zone, ZoneLod::MaxBuckets * bs, ZoneLod::MaxBuckets * bs, 0, 0 );
+    TRACY_CHECK( lod.GetBucketSize( 0 ) == bs * 2 );
+    TRACY_CHECK( lod.GetLevel( 0 ).size() <= ZoneLod::MaxBuckets );
+    TRACY_CHECK( CountZones( lod ) == ZoneLod::MaxBuckets + 1 );
+}
+
+// Processing in small steps has to give the same summary as processing everything at once,
+// with the budget also bounding the work within a single large subtree.
+static void TestBudget()
+{
+    auto worker = MakeWorker( 20, 500 );
+    auto& td = *worker->GetThreadData()[0];
+    const uint64_t total = 20 * ( 1 + 500 * 2 );
+
+    ZoneLodBuilder full( *worker, worker->GetLastTime() );
+    auto ref = full.Create( td );
+    size_t budget = std::numeric_limits<size_t>::max();
+    TRACY_CHECK( full.Process( *ref, td, budget ) );
+    ref->Update();
+    TRACY_CHECK( CountZones( *ref ) == total );
+    TRACY_CHECK( ref->GetEnd() == td.timeline.back()->End() );
+
+    ZoneLodBuilder step( *worker, worker->GetLastTime() );
+    auto lod = step.Create( td );
+    uint64_t added = 0;
+    int calls = 0;
+    for(;;)
+    {
+        budget = 7;
+        const auto done = step.Process( *lod, td, budget );
+        added += 7 - budget;
+        calls++;
+        TRACY_CHECK( CountZones( *lod ) == added );
+        if( done ) break;
+        TRACY_CHECK( budget == 0 );
+        TRACY_CHECK( lod->GetEnd() <= ref->GetEnd() );
+    }
+    lod->Update();
+    TRACY_CHECK( added == total );
+    TRACY_CHECK( calls == int( ( total + 6 ) / 7 ) );
+    TRACY_CHECK( lod->GetEnd() == ref->GetEnd() );
+    TRACY_CHECK( lod->GetBucketSize( 0 ) == ref->GetBucketSize( 0 ) );
+    const auto levels = ref->FindLevel( ref->GetBucketSize( 0 ) << 20 ) + 1;
+    TRACY_CHECK( levels > 1 && lod->FindLevel( lod->GetBucketSize( 0 ) << 20 ) + 1 == levels );
+    for( int l=0; l<levels; l++ )
+    {
+        auto& a = lod->GetLevel( l );
+        auto& b = ref->GetLevel( l );
+        TRACY_CHECK( a.size() == b.size() );
+        for( size_t i=0; i<std::min( a.size(), b.size() ); i++ ) TRACY_CHECK( Equal( a[i], b[i] ) );
+    }
+    TRACY_CHECK( lod->GetLargeDepth() == ref->GetLargeDepth() );
+}
+
+}
+
+TRACY_TEST_MAIN( tracy::TestMerge, tracy::TestUpdate, tracy::TestCoarsen, tracy::TestBudget )
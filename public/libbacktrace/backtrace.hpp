@@ -181,6 +181,19 @@ extern int backtrace_syminfo (struct backtrace_state *state, uintptr_t addr,
 			      backtrace_error_callback error_callback,
 			      void *data);
 
+/* Load the symbol table and debug info of the ELF image FILENAME into
+   STATE, which must have been created with backtrace_create_state and
+   not used yet.  Unlike the other routines, the image does not have to
+   be loaded into the current program: addresses passed to
+   backtrace_pcinfo and backtrace_syminfo are then offsets from the
+   image load address.  FILENAME must point to a permanent buffer.
+   Returns 1 on success, 0 on error.  */
+
+extern int backtrace_initialize_image (struct backtrace_state *state,
+				       const char *filename,
+				       backtrace_error_callback error_callback,
+				       void *data);
+
 }
 
 #endif
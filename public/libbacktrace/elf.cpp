@@ -7594,4 +7594,40 @@ backtrace_initialize (struct backtrace_state *state, const char *filename,
   return 1;
 }
 
+/* Initialize the backtrace data for a single ELF image that is not
+   mapped into the current process, as used by offline symbol
+   resolution.  The image is added at base address zero, so program
+   counters are offsets from the image load address, and the shared
+   objects of the current process are not consulted.  Returns 1 on
+   success, 0 on failure.  */
+
+int
+backtrace_initialize_image (struct backtrace_state *state,
+			    const char *filename,
+			    backtrace_error_callback error_callback,
+			    void *data)
+{
+  int descriptor;
+  int does_not_exist;
+  int found_sym;
+  int found_dwarf;
+  fileline elf_fileline_fn = elf_nodebug;
+
+  descriptor = backtrace_open (filename, error_callback, data,
+			       &does_not_exist);
+  if (descriptor < 0)
+    return 0;
+
+  if (!elf_add (state, filename, descriptor, NULL, 0, 0, NULL,
+		error_callback, data, &elf_fileline_fn, &found_sym,
+		&found_dwarf, NULL, 0, 0, NULL, 0))
+    return 0;
+
+  state->syminfo_fn = found_sym ? elf_syminfo : elf_nosyms;
+  state->fileline_fn = elf_fileline_fn;
+  state->request_known_address_ranges_refresh_fn = NULL;
+
+  return 1;
+}
+
 }
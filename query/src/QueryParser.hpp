@@ -0,0 +1,666 @@
+#ifndef __QUERYPARSER_HPP__
+#define __QUERYPARSER_HPP__
+
+#include <ctype.h>
+#include <math.h>
+#include <memory>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+static bool EqualNoCase( const char* l, const char* r, size_t len )
+{
+    for( size_t i=0; i<len; i++ )
+    {
+        if( tolower( (unsigned char)l[i] ) != tolower( (unsigned char)r[i] ) ) return false;
+        if( l[i] == '\0' ) return true;
+    }
+    return true;
+}
+
+static bool EqualNoCase( const std::string& l, const char* r )
+{
+    return l.size() == strlen( r ) && EqualNoCase( l.c_str(), r, l.size() );
+}
+
+struct QueryError
+{
+    std::string msg;
+    size_t pos;
+};
+
+enum class Source
+{
+    Zones,
+    Frames,
+    Plots,
+    Messages,
+    Memory
+};
+
+enum class Field
+{
+    Name,
+    File,
+    Line,
+    Thread,
+    Tid,
+    Start,
+    End,
+    Duration,
+    Self,
+    Text,
+    Set,
+    Index,
+    Plot,
+    Time,
+    Value,
+    Pool,
+    Address,
+    Size,
+    Alloc,
+    Free,
+    Lifetime
+};
+
+struct FieldDef
+{
+    const char* name;
+    Field field;
+};
+
+static const FieldDef ZoneFields[] = { { "name", Field::Name }, { "file", Field::File }, { "line", Field::Line }, { "thread", Field::Thread }, { "tid", Field::Tid }, { "start", Field::Start }, { "end", Field::End }, { "duration", Field::Duration }, { "self", Field::Self }, { "text", Field::Text } };
+static const FieldDef FrameFields[] = { { "set", Field::Set }, { "index", Field::Index }, { "start", Field::Start }, { "end", Field::End }, { "duration", Field::Duration } };
+static const FieldDef PlotFields[] = { { "plot", Field::Plot }, { "time", Field::Time }, { "value", Field::Value } };
+static const FieldDef MessageFields[] = { { "time", Field::Time }, { "thread", Field::Thread }, { "tid", Field::Tid }, { "text", Field::Text } };
+static const FieldDef MemoryFields[] = { { "pool", Field::Pool }, { "address", Field::Address }, { "size", Field::Size }, { "alloc", Field::Alloc }, { "free", Field::Free }, { "lifetime", Field::Lifetime }, { "thread", Field::Thread }, { "tid", Field::Tid } };
+
+struct SourceDef
+{
+    const char* name;
+    Source source;
+    const FieldDef* fields;
+    size_t numFields;
+};
+
+#define SOURCE( name, source, fields ) { name, source, fields, sizeof( fields ) / sizeof( *fields ) }
+static const SourceDef Sources[] = {
+    SOURCE( "zones", Source::Zones, ZoneFields ),
+    SOURCE( "frames", Source::Frames, FrameFields ),
+    SOURCE( "plots", Source::Plots, PlotFields ),
+    SOURCE( "messages", Source::Messages, MessageFields ),
+    SOURCE( "memory", Source::Memory, MemoryFields )
+};
+#undef SOURCE
+
+static const SourceDef& GetSourceDef( Source source )
+{
+    return Sources[(int)source];
+}
+
+struct Value
+{
+    enum class Type : uint8_t
+    {
+        Null,
+        Int,
+        Float,
+        String
+    };
+
+    Type type = Type::Null;
+    union
+    {
+        int64_t i;
+        double f;
+        const char* s;
+    };
+
+    Value() : i( 0 ) {}
+    static Value Int( int64_t v ) { Value r; r.type = Type::Int; r.i = v; return r; }
+    static Value Float( double v ) { Value r; r.type = Type::Float; r.f = v; return r; }
+    static Value String( const char* v ) { Value r; r.type = Type::String; r.s = v; return r; }
+
+    bool IsNumber() const { return type == Type::Int || type == Type::Float; }
+    double AsFloat() const { return type == Type::Int ? double( i ) : f; }
+};
+
+enum class Aggregate
+{
+    Count,
+    Sum,
+    Min,
+    Max,
+    Avg,
+    Std,
+    Percentile
+};
+
+struct Expr
+{
+    enum class Op
+    {
+        Literal,
+        Field,
+        Aggregate,
+        GroupKey,
+        Neg,
+        Not,
+        And,
+        Or,
+        Eq,
+        Ne,
+        Lt,
+        Le,
+        Gt,
+        Ge,
+        Contains,
+        Add,
+        Sub,
+        Mul,
+        Div
+    };
+
+    Op op;
+    Value value;
+    std::string str;
+    Field field;
+    Aggregate agg;
+    double percentile;
+    int aggIdx;
+    std::unique_ptr<Expr> lhs, rhs;
+    std::string text;
+    size_t pos;
+};
+
+struct SelectItem
+{
+    std::unique_ptr<Expr> expr;
+    std::string name;
+};
+
+struct Query
+{
+    std::string text;
+    Source source;
+    std::unique_ptr<Expr> where;
+    std::unique_ptr<Query> during;
+    std::vector<std::unique_ptr<Expr>> groupBy;
+    std::vector<SelectItem> select;
+    std::vector<Expr*> aggregates;
+    std::string orderBy;
+    bool orderDesc = false;
+    int64_t limit = -1;
+
+    bool IsAggregate() const { return !groupBy.empty() || !aggregates.empty(); }
+};
+
+class Parser
+{
+    enum class Token
+    {
+        End,
+        Ident,
+        Number,
+        String,
+        Symbol
+    };
+
+public:
+    Parser( const char* text ) : m_text( text ), m_pos( 0 ) { Next(); }
+
+    std::unique_ptr<Query> ParseQuery()
+    {
+        auto query = std::make_unique<Query>();
+        const auto start = m_tokPos;
+        if( m_tok != Token::Ident ) Error( "expected a data source" );
+        bool found = false;
+        for( auto& v : Sources )
+        {
+            if( m_tokText == v.name )
+            {
+                query->source = v.source;
+                found = true;
+                break;
+            }
+        }
+        if( !found ) Error( "unknown data source '" + m_tokText + "'" );
+        m_source = query->source;
+        Next();
+
+        if( Keyword( "where" ) ) query->where = ParseExpr();
+        if( Keyword( "during" ) )
+        {
+            Expect( "(" );
+            const auto source = m_source;
+            const auto pos = m_tokPos;
+            query->during = ParseQuery();
+            if( query->during->IsAggregate() || !query->during->select.empty() ) Error( "subquery can't select or aggregate", pos );
+            m_source = source;
+            Expect( ")" );
+        }
+        if( Keyword( "group" ) )
+        {
+            ExpectKeyword( "by" );
+            do
+            {
+                query->groupBy.emplace_back( ParseExpr() );
+                if( ContainsAggregate( *query->groupBy.back() ) ) Error( "can't group by an aggregate" );
+            }
+            while( Symbol( "," ) );
+        }
+        if( Keyword( "select" ) )
+        {
+            do
+            {
+                SelectItem item;
+                item.expr = ParseExpr( &query->aggregates );
+                if( Keyword( "as" ) )
+                {
+                    if( m_tok != Token::Ident ) Error( "expected a column name" );
+                    item.name = m_tokText;
+                    Next();
+                }
+                else
+                {
+                    item.name = item.expr->text;
+                }
+                query->select.emplace_back( std::move( item ) );
+            }
+            while( Symbol( "," ) );
+        }
+        if( query->IsAggregate() )
+        {
+            for( auto& v : query->select ) BindGroupKeys( *v.expr, *query );
+        }
+        if( Keyword( "order" ) )
+        {
+            ExpectKeyword( "by" );
+            query->orderBy = ParseColumnName();
+            query->orderDesc = Keyword( "desc" );
+            if( !query->orderDesc ) Keyword( "asc" );
+        }
+        if( Keyword( "limit" ) )
+        {
+            if( m_tok != Token::Number || m_tokValue.type != Value::Type::Int || m_tokValue.i < 0 ) Error( "expected a row count" );
+            query->limit = m_tokValue.i;
+            Next();
+        }
+        query->text = Trim( std::string( m_text + start, m_text + m_tokPos ) );
+        return query;
+    }
+
+    void ExpectEnd()
+    {
+        if( m_tok != Token::End ) Error( "unexpected '" + m_tokText + "'" );
+    }
+
+private:
+    [[noreturn]] void Error( const std::string& msg, size_t pos = std::string::npos ) const
+    {
+        throw QueryError { msg, pos == std::string::npos ? m_tokPos : pos };
+    }
+
+    static std::string Trim( std::string str )
+    {
+        while( !str.empty() && isspace( (unsigned char)str.back() ) ) str.pop_back();
+        return str;
+    }
+
+    void Next()
+    {
+        while( isspace( (unsigned char)m_text[m_pos] ) ) m_pos++;
+        m_tokPos = m_pos;
+        const auto c = m_text[m_pos];
+        if( c == '\0' )
+        {
+            m_tok = Token::End;
+            m_tokText.clear();
+        }
+        else if( isalpha( (unsigned char)c ) || c == '_' )
+        {
+            while( isalnum( (unsigned char)m_text[m_pos] ) || m_text[m_pos] == '_' ) m_pos++;
+            m_tok = Token::Ident;
+            m_tokText.assign( m_text + m_tokPos, m_pos - m_tokPos );
+        }
+        else if( isdigit( (unsigned char)c ) || ( c == '.' && isdigit( (unsigned char)m_text[m_pos+1] ) ) )
+        {
+            char* end;
+            const auto f = strtod( m_text + m_pos, &end );
+            bool isFloat = false;
+            for( auto p = m_text + m_pos; p < end; p++ ) if( *p == '.' || *p == 'e' || *p == 'E' ) isFloat = true;
+            m_pos = end - m_text;
+            auto unitEnd = m_pos;
+            while( isalpha( (unsigned char)m_text[unitEnd] ) ) unitEnd++;
+            const std::string unit( m_text + m_pos, unitEnd - m_pos );
+            double mul = 1;
+            if( unit.empty() || unit == "ns" ) mul = 1;
+            else if( unit == "us" ) mul = 1e3;
+            else if( unit == "ms" ) mul = 1e6;
+            else if( unit == "s" ) mul = 1e9;
+            else if( unit == "kb" || unit == "KB" ) mul = 1024.;
+            else if( unit == "mb" || unit == "MB" ) mul = 1024. * 1024;
+            else if( unit == "gb" || unit == "GB" ) mul = 1024. * 1024 * 1024;
+            else Error( "unknown unit '" + unit + "'", m_pos );
+            m_pos = unitEnd;
+            const auto v = f * mul;
+            if( !isFloat || v == floor( v ) ) m_tokValue = Value::Int( int64_t( v ) );
+            else m_tokValue = Value::Float( v );
+            m_tok = Token::Number;
+            m_tokText.assign( m_text + m_tokPos, m_pos - m_tokPos );
+        }
+        else if( c == '"' || c == '\'' )
+        {
+            m_pos++;
+            m_tokText.clear();
+            while( m_text[m_pos] != c )
+            {
+                if( m_text[m_pos] == '\0' ) Error( "unterminated string" );
+                if( m_text[m_pos] == '\\' && m_text[m_pos+1] != '\0' ) m_pos++;
+                m_tokText.push_back( m_text[m_pos++] );
+            }
+            m_pos++;
+            m_tok = Token::String;
+        }
+        else
+        {
+            static const char* symbols[] = { "<=", ">=", "!=", "==", "(", ")", ",", "=", "<", ">", "~", "+", "-", "*", "/" };
+            for( auto& v : symbols )
+            {
+                const auto len = strlen( v );
+                if( strncmp( m_text + m_pos, v, len ) == 0 )
+                {
+                    m_pos += len;
+                    m_tok = Token::Symbol;
+                    m_tokText = v;
+                    return;
+                }
+            }
+            Error( std::string( "unexpected character '" ) + c + "'" );
+        }
+    }
+
+    bool Keyword( const char* kw )
+    {
+        if( m_tok != Token::Ident || !EqualNoCase( m_tokText, kw ) ) return false;
+        Next();
+        return true;
+    }
+
+    void ExpectKeyword( const char* kw )
+    {
+        if( !Keyword( kw ) ) Error( std::string( "expected '" ) + kw + "'" );
+    }
+
+    bool Symbol( const char* sym )
+    {
+        if( m_tok != Token::Symbol || m_tokText != sym ) return false;
+        Next();
+        return true;
+    }
+
+    void Expect( const char* sym )
+    {
+        if( !Symbol( sym ) ) Error( std::string( "expected '" ) + sym + "'" );
+    }
+
+    // Column names are matched against the output columns, so they're taken verbatim.
+    std::string ParseColumnName()
+    {
+        if( m_tok == Token::String )
+        {
+            auto name = m_tokText;
+            Next();
+            return name;
+        }
+        const auto start = m_tokPos;
+        int depth = 0;
+        while( m_tok != Token::End )
+        {
+            if( m_tok == Token::Symbol && m_tokText == "(" ) depth++;
+            else if( m_tok == Token::Symbol && m_tokText == ")" && --depth < 0 ) break;
+            else if( depth == 0 && m_tok == Token::Ident && ( EqualNoCase( m_tokText, "asc" ) || EqualNoCase( m_tokText, "desc" ) || EqualNoCase( m_tokText, "limit" ) ) ) break;
+            Next();
+        }
+        if( m_tokPos == start ) Error( "expected a column name" );
+        return Trim( std::string( m_text + start, m_text + m_tokPos ) );
+    }
+
+    static bool ContainsAggregate( const Expr& expr )
+    {
+        if( expr.op == Expr::Op::Aggregate ) return true;
+        return ( expr.lhs && ContainsAggregate( *expr.lhs ) ) || ( expr.rhs && ContainsAggregate( *expr.rhs ) );
+    }
+
+    // An aggregate query produces one row per group, so outside of aggregates fields can only be
+    // used through the group expressions. These are evaluated from the group key, which follows
+    // the aggregate values.
+    void BindGroupKeys( Expr& expr, const Query& query ) const
+    {
+        if( expr.op == Expr::Op::Aggregate ) return;
+        for( size_t i=0; i<query.groupBy.size(); i++ )
+        {
+            if( expr.text == query.groupBy[i]->text )
+            {
+                expr.op = Expr::Op::GroupKey;
+                expr.aggIdx = int( query.aggregates.size() + i );
+                expr.lhs.reset();
+                expr.rhs.reset();
+                return;
+            }
+        }
+        if( expr.op == Expr::Op::Field ) Error( "field '" + expr.text + "' must be grouped by or aggregated", expr.pos );
+        if( expr.lhs ) BindGroupKeys( *expr.lhs, query );
+        if( expr.rhs ) BindGroupKeys( *expr.rhs, query );
+    }
+
+    std::unique_ptr<Expr> Make( Expr::Op op, size_t start, std::unique_ptr<Expr> lhs = nullptr, std::unique_ptr<Expr> rhs = nullptr )
+    {
+        auto expr = std::make_unique<Expr>();
+        expr->op = op;
+        expr->lhs = std::move( lhs );
+        expr->rhs = std::move( rhs );
+        expr->text = Trim( std::string( m_text + start, m_text + m_tokPos ) );
+        expr->pos = start;
+        return expr;
+    }
+
+    // Aggregates are only allowed if there's a list to register them in.
+    std::unique_ptr<Expr> ParseExpr( std::vector<Expr*>* aggregates = nullptr )
+    {
+        m_aggregates = aggregates;
+        return ParseOr();
+    }
+
+    std::unique_ptr<Expr> ParseOr()
+    {
+        const auto start = m_tokPos;
+        auto lhs = ParseAnd();
+        while( Keyword( "or" ) )
+        {
+            auto rhs = ParseAnd();
+            lhs = Make( Expr::Op::Or, start, std::move( lhs ), std::move( rhs ) );
+        }
+        return lhs;
+    }
+
+    std::unique_ptr<Expr> ParseAnd()
+    {
+        const auto start = m_tokPos;
+        auto lhs = ParseNot();
+        while( Keyword( "and" ) )
+        {
+            auto rhs = ParseNot();
+            lhs = Make( Expr::Op::And, start, std::move( lhs ), std::move( rhs ) );
+        }
+        return lhs;
+    }
+
+    std::unique_ptr<Expr> ParseNot()
+    {
+        const auto start = m_tokPos;
+        if( Keyword( "not" ) ) return Make( Expr::Op::Not, start, ParseNot() );
+        return ParseCompare();
+    }
+
+    std::unique_ptr<Expr> ParseCompare()
+    {
+        static const std::pair<const char*, Expr::Op> ops[] = {
+            { "=", Expr::Op::Eq }, { "==", Expr::Op::Eq }, { "!=", Expr::Op::Ne }, { "<", Expr::Op::Lt }, { "<=", Expr::Op::Le },
+            { ">", Expr::Op::Gt }, { ">=", Expr::Op::Ge }, { "~", Expr::Op::Contains }
+        };
+        const auto start = m_tokPos;
+        auto lhs = ParseAdd();
+        for( auto& v : ops )
+        {
+            if( Symbol( v.first ) )
+            {
+                auto rhs = ParseAdd();
+                return Make( v.second, start, std::move( lhs ), std::move( rhs ) );
+            }
+        }
+        return lhs;
+    }
+
+    std::unique_ptr<Expr> ParseAdd()
+    {
+        const auto start = m_tokPos;
+        auto lhs = ParseMul();
+        for(;;)
+        {
+            Expr::Op op;
+            if( Symbol( "+" ) ) op = Expr::Op::Add;
+            else if( Symbol( "-" ) ) op = Expr::Op::Sub;
+            else return lhs;
+            auto rhs = ParseMul();
+            lhs = Make( op, start, std::move( lhs ), std::move( rhs ) );
+        }
+    }
+
+    std::unique_ptr<Expr> ParseMul()
+    {
+        const auto start = m_tokPos;
+        auto lhs = ParseUnary();
+        for(;;)
+        {
+            Expr::Op op;
+            if( Symbol( "*" ) ) op = Expr::Op::Mul;
+            else if( Symbol( "/" ) ) op = Expr::Op::Div;
+            else return lhs;
+            auto rhs = ParseUnary();
+            lhs = Make( op, start, std::move( lhs ), std::move( rhs ) );
+        }
+    }
+
+    std::unique_ptr<Expr> ParseUnary()
+    {
+        const auto start = m_tokPos;
+        if( Symbol( "-" ) ) return Make( Expr::Op::Neg, start, ParseUnary() );
+        return ParsePrimary();
+    }
+
+    std::unique_ptr<Expr> ParsePrimary()
+    {
+        const auto start = m_tokPos;
+        if( m_tok == Token::Number )
+        {
+            auto value = m_tokValue;
+            Next();
+            auto expr = Make( Expr::Op::Literal, start );
+            expr->value = value;
+            return expr;
+        }
+        if( m_tok == Token::String )
+        {
+            auto str = m_tokText;
+            Next();
+            auto expr = Make( Expr::Op::Literal, start );
+            expr->str = std::move( str );
+            return expr;
+        }
+        if( Symbol( "(" ) )
+        {
+            auto expr = ParseOr();
+            Expect( ")" );
+            expr->text = Trim( std::string( m_text + start, m_text + m_tokPos ) );
+            return expr;
+        }
+        if( m_tok != Token::Ident ) Error( m_tok == Token::End ? "unexpected end of query" : "unexpected '" + m_tokText + "'" );
+
+        const auto name = m_tokText;
+        Next();
+        if( Symbol( "(" ) ) return ParseAggregate( name, start );
+
+        auto& def = GetSourceDef( m_source );
+        for( size_t i=0; i<def.numFields; i++ )
+        {
+            if( name == def.fields[i].name )
+            {
+                auto expr = Make( Expr::Op::Field, start );
+                expr->field = def.fields[i].field;
+                return expr;
+            }
+        }
+        Error( "unknown field '" + name + "' in " + def.name, start );
+    }
+
+    std::unique_ptr<Expr> ParseAggregate( const std::string& name, size_t start )
+    {
+        static const std::pair<const char*, Aggregate> aggs[] = {
+            { "count", Aggregate::Count }, { "sum", Aggregate::Sum }, { "min", Aggregate::Min }, { "max", Aggregate::Max },
+            { "avg", Aggregate::Avg }, { "std", Aggregate::Std }, { "p50", Aggregate::Percentile }, { "p90", Aggregate::Percentile },
+            { "p99", Aggregate::Percentile }, { "percentile", Aggregate::Percentile }
+        };
+        const Aggregate* agg = nullptr;
+        for( auto& v : aggs ) if( name == v.first ) agg = &v.second;
+        if( !agg ) Error( "unknown function '" + name + "'", start );
+        if( !m_aggregates ) Error( "aggregates are only allowed in select", start );
+
+        auto aggregates = m_aggregates;
+        std::unique_ptr<Expr> arg;
+        double percentile = 0;
+        if( *agg != Aggregate::Count )
+        {
+            m_aggregates = nullptr;
+            arg = ParseOr();
+            if( name == "percentile" )
+            {
+                Expect( "," );
+                if( m_tok != Token::Number ) Error( "expected a percentile" );
+                percentile = m_tokValue.AsFloat();
+                if( percentile > 1 ) percentile /= 100;
+                if( percentile < 0 || percentile > 1 ) Error( "percentile out of range" );
+                Next();
+            }
+            else if( *agg == Aggregate::Percentile )
+            {
+                percentile = atoi( name.c_str() + 1 ) / 100.;
+            }
+            m_aggregates = aggregates;
+        }
+        Expect( ")" );
+
+        auto expr = Make( Expr::Op::Aggregate, start, std::move( arg ) );
+        expr->agg = *agg;
+        expr->percentile = percentile;
+        expr->aggIdx = (int)aggregates->size();
+        aggregates->push_back( expr.get() );
+        return expr;
+    }
+
+    const char* m_text;
+    size_t m_pos;
+
+    Token m_tok;
+    size_t m_tokPos;
+    std::string m_tokText;
+    Value m_tokValue;
+
+    Source m_source;
+    std::vector<Expr*>* m_aggregates = nullptr;
+};
+
+#endif
@@ -0,0 +1,1009 @@
+#ifdef _WIN32
+#  include <windows.h>
+#endif
+
+#include <algorithm>
+#include <ctype.h>
+#include <chrono>
+#include <inttypes.h>
+#include <math.h>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../../server/TracyFileRead.hpp"
+#include "../../server/TracyTaskDispatch.hpp"
+#include "../../server/TracyWorker.hpp"
+#include "../../getopt/getopt.h"
+
+#include "QueryParser.hpp"
+
+void Usage()
+{
+    printf( "Usage: query [options] input.tracy query [query...]\n\n" );
+    printf( "  -o output: write the JSON result to a file instead of stdout\n\n" );
+    printf( "Query syntax:\n" );
+    printf( "  source [where expr] [during (subquery)] [group by expr, ...]\n" );
+    printf( "         [select expr [as name], ...] [order by name [asc|desc]] [limit n]\n\n" );
+    printf( "Sources and their fields:\n" );
+    printf( "  zones:    name, file, line, thread, tid, start, end, duration, self, text\n" );
+    printf( "  frames:   set, index, start, end, duration\n" );
+    printf( "  plots:    plot, time, value\n" );
+    printf( "  messages: time, thread, tid, text\n" );
+    printf( "  memory:   pool, address, size, alloc, free, lifetime, thread, tid\n\n" );
+    printf( "Aggregates: count(), sum(x), min(x), max(x), avg(x), std(x), p50(x), p90(x), p99(x),\n" );
+    printf( "            percentile(x, q)\n" );
+    printf( "Operators:  or, and, not, = != < <= > >=, ~ (case-insensitive substring), + - * /\n" );
+    printf( "Literals:   numbers with optional ns/us/ms/s or kb/mb/gb suffix, \"strings\"\n\n" );
+    printf( "Example:\n" );
+    printf( "  query trace.tracy 'zones where name = \"Update\" during (frames during (zones where\n" );
+    printf( "      name = \"Physics\" and duration > 5ms)) group by thread select count(), p99(duration)'\n" );
+
+    exit( 1 );
+}
+
+// Zone name, file and line are known for all zones of a source location, without looking at
+// the zones themselves.
+static bool IsSrcLocField( Field field )
+{
+    return field == Field::Name || field == Field::File || field == Field::Line;
+}
+
+static bool IsTrue( const Value& v )
+{
+    switch( v.type )
+    {
+    case Value::Type::Int: return v.i != 0;
+    case Value::Type::Float: return v.f != 0;
+    case Value::Type::String: return *v.s != '\0';
+    default: return false;
+    }
+}
+
+static bool IsFalse( const Value& v )
+{
+    return v.type != Value::Type::Null && !IsTrue( v );
+}
+
+// A row of any source. Rows with a null pointer only have the source location known, and are
+// used to decide if the source location can be skipped as a whole.
+struct Row
+{
+    const void* ptr;
+    size_t idx;
+    int32_t srcloc;
+    uint16_t thread;
+};
+
+class Evaluator
+{
+public:
+    Evaluator( const tracy::Worker& worker ) : m_worker( worker )
+    {
+        for( auto& fd : worker.GetFrames() )
+        {
+            if( fd->name == 0 )
+            {
+                m_names.emplace( fd, "Frames" );
+            }
+            else if( fd->name >> 63 != 0 )
+            {
+                char buf[64];
+                snprintf( buf, sizeof( buf ), "[%" PRIu32 "] Vsync", uint32_t( fd->name ) );
+                m_names.emplace( fd, buf );
+            }
+            else
+            {
+                m_names.emplace( fd, worker.GetString( fd->name ) );
+            }
+        }
+        for( auto& plot : worker.GetPlots() )
+        {
+            switch( plot->type )
+            {
+            case tracy::PlotType::Memory: m_names.emplace( plot, plot->name == 0 ? "Memory usage" : worker.GetString( plot->name ) ); break;
+            case tracy::PlotType::SysTime: m_names.emplace( plot, "CPU usage" ); break;
+            default: m_names.emplace( plot, worker.GetString( plot->name ) ); break;
+            }
+        }
+        for( auto& v : worker.GetMemNameMap() )
+        {
+            m_names.emplace( v.second, v.first == 0 ? "Default allocator" : worker.GetString( v.first ) );
+        }
+    }
+
+    Value GetField( Source source, const Row& row, Field field ) const
+    {
+        if( source == Source::Zones && ( !row.ptr || IsSrcLocField( field ) ) )
+        {
+            if( !IsSrcLocField( field ) ) return Value();
+            auto& srcloc = m_worker.GetSourceLocation( row.srcloc );
+            switch( field )
+            {
+            case Field::Name: return Value::String( m_worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function ) );
+            case Field::File: return Value::String( m_worker.GetString( srcloc.file ) );
+            case Field::Line: return Value::Int( srcloc.line );
+            default: assert( false ); return Value();
+            }
+        }
+
+        switch( source )
+        {
+        case Source::Zones:
+        {
+            auto& zone = *(const tracy::ZoneEvent*)row.ptr;
+            switch( field )
+            {
+            case Field::Thread: return Value::String( m_worker.GetThreadName( m_worker.DecompressThread( row.thread ) ) );
+            case Field::Tid: return Value::Int( int64_t( m_worker.DecompressThread( row.thread ) ) );
+            case Field::Start: return Value::Int( zone.Start() );
+            case Field::End: return Value::Int( zone.End() );
+            case Field::Duration: return Value::Int( zone.End() - zone.Start() );
+            case Field::Self: return Value::Int( zone.End() - zone.Start() - GetChildTime( zone ) );
+            case Field::Text:
+                if( m_worker.HasZoneExtra( zone ) )
+                {
+                    auto& extra = m_worker.GetZoneExtra( zone );
+                    if( extra.text.Active() ) return Value::String( m_worker.GetString( extra.text ) );
+                }
+                return Value::String( "" );
+            default: break;
+            }
+            break;
+        }
+        case Source::Frames:
+        {
+            auto& fd = *(const tracy::FrameData*)row.ptr;
+            switch( field )
+            {
+            case Field::Set: return Value::String( GetName( &fd ) );
+            case Field::Index: return Value::Int( int64_t( row.idx ) );
+            case Field::Start: return Value::Int( m_worker.GetFrameBegin( fd, row.idx ) );
+            case Field::End: return Value::Int( m_worker.GetFrameEnd( fd, row.idx ) );
+            case Field::Duration: return Value::Int( m_worker.GetFrameEnd( fd, row.idx ) - m_worker.GetFrameBegin( fd, row.idx ) );
+            default: break;
+            }
+            break;
+        }
+        case Source::Plots:
+        {
+            auto& plot = *(const tracy::PlotData*)row.ptr;
+            switch( field )
+            {
+            case Field::Plot: return Value::String( GetName( &plot ) );
+            case Field::Time: return Value::Int( plot.data[row.idx].time.Val() );
+            case Field::Value: return Value::Float( plot.data[row.idx].val );
+            default: break;
+            }
+            break;
+        }
+        case Source::Messages:
+        {
+            auto& msg = *(const tracy::MessageData*)row.ptr;
+            switch( field )
+            {
+            case Field::Time: return Value::Int( msg.time );
+            case Field::Thread: return Value::String( m_worker.GetThreadName( m_worker.DecompressThread( msg.thread ) ) );
+            case Field::Tid: return Value::Int( int64_t( m_worker.DecompressThread( msg.thread ) ) );
+            case Field::Text: return Value::String( m_worker.GetString( msg.ref ) );
+            default: break;
+            }
+            break;
+        }
+        case Source::Memory:
+        {
+            auto& mem = *(const tracy::MemData*)row.ptr;
+            auto& ev = mem.data[row.idx];
+            switch( field )
+            {
+            case Field::Pool: return Value::String( GetName( &mem ) );
+            case Field::Address: return Value::Int( int64_t( ev.Ptr() ) );
+            case Field::Size: return Value::Int( int64_t( ev.Size() ) );
+            case Field::Alloc: return Value::Int( ev.TimeAlloc() );
+            case Field::Free: return ev.TimeFree() < 0 ? Value() : Value::Int( ev.TimeFree() );
+            case Field::Lifetime: return Value::Int( ( ev.TimeFree() < 0 ? m_worker.GetLastTime() : ev.TimeFree() ) - ev.TimeAlloc() );
+            case Field::Thread: return Value::String( m_worker.GetThreadName( m_worker.DecompressThread( ev.ThreadAlloc() ) ) );
+            case Field::Tid: return Value::Int( int64_t( m_worker.DecompressThread( ev.ThreadAlloc() ) ) );
+            default: break;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        assert( false );
+        return Value();
+    }
+
+    // Time span of a row, used to match rows against subquery results.
+    std::pair<int64_t, int64_t> GetTimeSpan( Source source, const Row& row ) const
+    {
+        switch( source )
+        {
+        case Source::Zones:
+        {
+            auto& zone = *(const tracy::ZoneEvent*)row.ptr;
+            return { zone.Start(), zone.End() };
+        }
+        case Source::Frames:
+        {
+            auto& fd = *(const tracy::FrameData*)row.ptr;
+            return { m_worker.GetFrameBegin( fd, row.idx ), m_worker.GetFrameEnd( fd, row.idx ) };
+        }
+        case Source::Plots:
+        {
+            const auto t = ((const tracy::PlotData*)row.ptr)->data[row.idx].time.Val();
+            return { t, t };
+        }
+        case Source::Messages:
+        {
+            const auto t = ((const tracy::MessageData*)row.ptr)->time;
+            return { t, t };
+        }
+        case Source::Memory:
+        {
+            auto& ev = ((const tracy::MemData*)row.ptr)->data[row.idx];
+            return { ev.TimeAlloc(), ev.TimeFree() < 0 ? m_worker.GetLastTime() : ev.TimeFree() };
+        }
+        default:
+            assert( false );
+            return { 0, 0 };
+        }
+    }
+
+    // Aggregate and group key expressions evaluate to the given finished aggregate values, which
+    // are followed by the group key. Comparisons and logic follow SQL rules, where unknown (null)
+    // values propagate.
+    Value Eval( const Expr& expr, Source source, const Row& row, const Value* aggregates = nullptr ) const
+    {
+        switch( expr.op )
+        {
+        case Expr::Op::Literal:
+            return expr.value.type == Value::Type::Null ? Value::String( expr.str.c_str() ) : expr.value;
+        case Expr::Op::Field:
+            return GetField( source, row, expr.field );
+        case Expr::Op::Aggregate:
+        case Expr::Op::GroupKey:
+            assert( aggregates );
+            return aggregates[expr.aggIdx];
+        case Expr::Op::Neg:
+        {
+            const auto v = Eval( *expr.lhs, source, row, aggregates );
+            if( v.type == Value::Type::Int ) return Value::Int( -v.i );
+            if( v.type == Value::Type::Float ) return Value::Float( -v.f );
+            return Value();
+        }
+        case Expr::Op::Not:
+        {
+            const auto v = Eval( *expr.lhs, source, row, aggregates );
+            if( v.type == Value::Type::Null ) return v;
+            return Value::Int( !IsTrue( v ) );
+        }
+        case Expr::Op::And:
+        {
+            const auto l = Eval( *expr.lhs, source, row, aggregates );
+            if( IsFalse( l ) ) return Value::Int( 0 );
+            const auto r = Eval( *expr.rhs, source, row, aggregates );
+            if( IsFalse( r ) ) return Value::Int( 0 );
+            if( l.type == Value::Type::Null || r.type == Value::Type::Null ) return Value();
+            return Value::Int( 1 );
+        }
+        case Expr::Op::Or:
+        {
+            const auto l = Eval( *expr.lhs, source, row, aggregates );
+            if( IsTrue( l ) ) return Value::Int( 1 );
+            const auto r = Eval( *expr.rhs, source, row, aggregates );
+            if( IsTrue( r ) ) return Value::Int( 1 );
+            if( l.type == Value::Type::Null || r.type == Value::Type::Null ) return Value();
+            return Value::Int( 0 );
+        }
+        case Expr::Op::Contains:
+        {
+            const auto l = Eval( *expr.lhs, source, row, aggregates );
+            const auto r = Eval( *expr.rhs, source, row, aggregates );
+            if( l.type != Value::Type::String || r.type != Value::Type::String ) return Value();
+            return Value::Int( ContainsNoCase( l.s, r.s ) );
+        }
+        case Expr::Op::Eq:
+        case Expr::Op::Ne:
+        case Expr::Op::Lt:
+        case Expr::Op::Le:
+        case Expr::Op::Gt:
+        case Expr::Op::Ge:
+        {
+            const auto l = Eval( *expr.lhs, source, row, aggregates );
+            const auto r = Eval( *expr.rhs, source, row, aggregates );
+            int cmp;
+            if( !Compare( l, r, cmp ) ) return Value();
+            switch( expr.op )
+            {
+            case Expr::Op::Eq: return Value::Int( cmp == 0 );
+            case Expr::Op::Ne: return Value::Int( cmp != 0 );
+            case Expr::Op::Lt: return Value::Int( cmp < 0 );
+            case Expr::Op::Le: return Value::Int( cmp <= 0 );
+            case Expr::Op::Gt: return Value::Int( cmp > 0 );
+            default: return Value::Int( cmp >= 0 );
+            }
+        }
+        case Expr::Op::Add:
+        case Expr::Op::Sub:
+        case Expr::Op::Mul:
+        case Expr::Op::Div:
+        {
+            const auto l = Eval( *expr.lhs, source, row, aggregates );
+            const auto r = Eval( *expr.rhs, source, row, aggregates );
+            if( !l.IsNumber() || !r.IsNumber() ) return Value();
+            if( l.type == Value::Type::Int && r.type == Value::Type::Int )
+            {
+                switch( expr.op )
+                {
+                case Expr::Op::Add: return Value::Int( l.i + r.i );
+                case Expr::Op::Sub: return Value::Int( l.i - r.i );
+                case Expr::Op::Mul: return Value::Int( l.i * r.i );
+                default: return r.i == 0 ? Value() : Value::Float( double( l.i ) / r.i );
+                }
+            }
+            const auto lf = l.AsFloat();
+            const auto rf = r.AsFloat();
+            switch( expr.op )
+            {
+            case Expr::Op::Add: return Value::Float( lf + rf );
+            case Expr::Op::Sub: return Value::Float( lf - rf );
+            case Expr::Op::Mul: return Value::Float( lf * rf );
+            default: return rf == 0 ? Value() : Value::Float( lf / rf );
+            }
+        }
+        default:
+            assert( false );
+            return Value();
+        }
+    }
+
+    // Null values are ordered before everything else.
+    static bool Compare( const Value& l, const Value& r, int& cmp )
+    {
+        if( l.IsNumber() && r.IsNumber() )
+        {
+            if( l.type == Value::Type::Int && r.type == Value::Type::Int ) cmp = l.i < r.i ? -1 : ( l.i > r.i ? 1 : 0 );
+            else cmp = l.AsFloat() < r.AsFloat() ? -1 : ( l.AsFloat() > r.AsFloat() ? 1 : 0 );
+            return true;
+        }
+        if( l.type == Value::Type::String && r.type == Value::Type::String )
+        {
+            cmp = strcmp( l.s, r.s );
+            return true;
+        }
+        return false;
+    }
+
+    const char* GetName( const void* ptr ) const
+    {
+        auto it = m_names.find( ptr );
+        assert( it != m_names.end() );
+        return it->second.c_str();
+    }
+
+private:
+    int64_t GetChildTime( const tracy::ZoneEvent& zone ) const
+    {
+        int64_t time = 0;
+        if( zone.HasChildren() )
+        {
+            auto& children = m_worker.GetZoneChildren( zone.Child() );
+            if( children.is_magic() )
+            {
+                auto& vec = *(tracy::Vector<tracy::ZoneEvent>*)&children;
+                for( auto& v : vec ) if( v.IsEndValid() ) time += v.End() - v.Start();
+            }
+            else
+            {
+                for( auto& v : children ) if( v->IsEndValid() ) time += v->End() - v->Start();
+            }
+        }
+        return time;
+    }
+
+    static bool ContainsNoCase( const char* str, const char* sub )
+    {
+        const auto len = strlen( sub );
+        for( ; *str; str++ )
+        {
+            if( EqualNoCase( str, sub, len ) ) return true;
+        }
+        return len == 0;
+    }
+
+    const tracy::Worker& m_worker;
+    std::unordered_map<const void*, std::string> m_names;
+};
+
+struct AggState
+{
+    int64_t count = 0;
+    int64_t num = 0;
+    double sum = 0;
+    double sumSq = 0;
+    Value min, max;
+    bool isInt = true;
+    std::vector<double> values;
+
+    void Add( const Value& v, bool keepValues )
+    {
+        if( v.type == Value::Type::Null ) return;
+        count++;
+        int cmp;
+        if( min.type == Value::Type::Null || ( Evaluator::Compare( v, min, cmp ) && cmp < 0 ) ) min = v;
+        if( max.type == Value::Type::Null || ( Evaluator::Compare( v, max, cmp ) && cmp > 0 ) ) max = v;
+        if( !v.IsNumber() ) return;
+        const auto f = v.AsFloat();
+        num++;
+        sum += f;
+        sumSq += f * f;
+        if( v.type != Value::Type::Int ) isInt = false;
+        if( keepValues ) values.push_back( f );
+    }
+
+    void Merge( AggState& other )
+    {
+        count += other.count;
+        num += other.num;
+        sum += other.sum;
+        sumSq += other.sumSq;
+        isInt = isInt && other.isInt;
+        int cmp;
+        if( other.min.type != Value::Type::Null && ( min.type == Value::Type::Null || ( Evaluator::Compare( other.min, min, cmp ) && cmp < 0 ) ) ) min = other.min;
+        if( other.max.type != Value::Type::Null && ( max.type == Value::Type::Null || ( Evaluator::Compare( other.max, max, cmp ) && cmp > 0 ) ) ) max = other.max;
+        values.insert( values.end(), other.values.begin(), other.values.end() );
+        std::vector<double>().swap( other.values );
+    }
+
+    // Aggregates other than count, min and max only consider numeric values.
+    Value Finish( const Expr& expr, int64_t rows )
+    {
+        const auto number = [this] ( double v ) { return isInt ? Value::Int( int64_t( v ) ) : Value::Float( v ); };
+        switch( expr.agg )
+        {
+        case Aggregate::Count: return Value::Int( expr.lhs ? count : rows );
+        case Aggregate::Sum: return num == 0 ? Value() : number( sum );
+        case Aggregate::Min: return min;
+        case Aggregate::Max: return max;
+        case Aggregate::Avg: return num == 0 ? Value() : Value::Float( sum / num );
+        case Aggregate::Std:
+        {
+            if( num < 2 ) return Value();
+            const auto avg = sum / num;
+            return Value::Float( sqrt( std::max( 0., ( sumSq - avg * avg * num ) / ( num - 1 ) ) ) );
+        }
+        case Aggregate::Percentile:
+        {
+            // Nearest-rank percentile, using a selection instead of a full sort.
+            if( values.empty() ) return Value();
+            const auto rank = std::max<size_t>( 1, size_t( ceil( expr.percentile * values.size() ) ) );
+            const auto nth = values.begin() + std::min( rank, values.size() ) - 1;
+            std::nth_element( values.begin(), nth, values.end() );
+            return number( *nth );
+        }
+        default:
+            assert( false );
+            return Value();
+        }
+    }
+};
+
+struct Group
+{
+    std::vector<Value> keys;
+    int64_t rows = 0;
+    std::vector<AggState> aggs;
+};
+
+using GroupMap = std::unordered_map<std::string, Group>;
+using Table = std::vector<std::vector<Value>>;
+
+// Results of a single unit of work, merged serially in unit order.
+struct UnitResult
+{
+    GroupMap groups;
+    Table rows;
+    std::vector<std::pair<int64_t, int64_t>> spans;
+};
+
+struct Unit
+{
+    Source source;
+    const void* ptr;
+    int32_t srcloc;
+    size_t begin;
+    size_t end;
+};
+
+// The source location zone list type is private to the worker.
+using SrcLocZoneList = std::decay_t<decltype( std::declval<const tracy::Worker&>().GetSourceLocationZones().begin()->second.zones )>;
+
+enum { UnitRows = 64 * 1024 };
+
+class Executor
+{
+public:
+    Executor( const tracy::Worker& worker, tracy::TaskDispatch& td ) : m_worker( worker ), m_eval( worker ), m_td( td ) {}
+
+    struct Result
+    {
+        std::vector<std::string> columns;
+        Table rows;
+    };
+
+    Result Run( Query& query )
+    {
+        Scan( query, false );
+
+        Result result;
+        if( !query.IsAggregate() )
+        {
+            if( query.select.empty() )
+            {
+                auto& def = GetSourceDef( query.source );
+                for( size_t i=0; i<def.numFields; i++ ) result.columns.emplace_back( def.fields[i].name );
+            }
+            else
+            {
+                for( auto& v : query.select ) result.columns.emplace_back( v.name );
+            }
+            for( auto& v : m_results )
+            {
+                result.rows.insert( result.rows.end(), std::make_move_iterator( v.rows.begin() ), std::make_move_iterator( v.rows.end() ) );
+            }
+        }
+        else
+        {
+            GroupMap groups;
+            for( auto& unit : m_results )
+            {
+                for( auto& v : unit.groups )
+                {
+                    auto it = groups.find( v.first );
+                    if( it == groups.end() )
+                    {
+                        groups.emplace( v.first, std::move( v.second ) );
+                    }
+                    else
+                    {
+                        it->second.rows += v.second.rows;
+                        for( size_t i=0; i<it->second.aggs.size(); i++ ) it->second.aggs[i].Merge( v.second.aggs[i] );
+                    }
+                }
+                GroupMap().swap( unit.groups );
+            }
+            // An aggregate query without groups still produces a single row.
+            if( groups.empty() && query.groupBy.empty() ) groups.emplace( std::string(), Group { {}, 0, std::vector<AggState>( query.aggregates.size() ) } );
+
+            // Select items which are group expressions are taken from the group key. Group
+            // expressions which aren't selected are listed first.
+            std::vector<int> selectKey( query.select.size(), -1 );
+            std::vector<bool> keySelected( query.groupBy.size(), false );
+            for( size_t i=0; i<query.select.size(); i++ )
+            {
+                for( size_t j=0; j<query.groupBy.size(); j++ )
+                {
+                    if( query.select[i].expr->text == query.groupBy[j]->text )
+                    {
+                        selectKey[i] = int( j );
+                        keySelected[j] = true;
+                        break;
+                    }
+                }
+            }
+            for( size_t j=0; j<query.groupBy.size(); j++ )
+            {
+                if( !keySelected[j] ) result.columns.emplace_back( query.groupBy[j]->text );
+            }
+            for( auto& v : query.select ) result.columns.emplace_back( v.name );
+
+            // The parser makes sure that outside of aggregates the select items only use the group
+            // key, so the row itself is never accessed.
+            const Row empty = {};
+            const auto numAggs = query.aggregates.size();
+            std::vector<Value> aggValues( numAggs + query.groupBy.size() );
+            for( auto& v : groups )
+            {
+                auto& group = v.second;
+                for( size_t i=0; i<numAggs; i++ ) aggValues[i] = group.aggs[i].Finish( *query.aggregates[i], group.rows );
+                std::copy( group.keys.begin(), group.keys.end(), aggValues.begin() + numAggs );
+                std::vector<Value> row;
+                for( size_t j=0; j<query.groupBy.size(); j++ )
+                {
+                    if( !keySelected[j] ) row.emplace_back( group.keys[j] );
+                }
+                for( size_t i=0; i<query.select.size(); i++ )
+                {
+                    if( selectKey[i] >= 0 ) row.emplace_back( group.keys[selectKey[i]] );
+                    else row.emplace_back( m_eval.Eval( *query.select[i].expr, query.source, empty, aggValues.data() ) );
+                }
+                result.rows.emplace_back( std::move( row ) );
+            }
+            if( query.orderBy.empty() )
+            {
+                // Group order would otherwise depend on hashing.
+                std::sort( result.rows.begin(), result.rows.end(), [] ( const auto& l, const auto& r ) {
+                    for( size_t i=0; i<l.size(); i++ )
+                    {
+                        const auto c = CompareForSort( l[i], r[i] );
+                        if( c != 0 ) return c < 0;
+                    }
+                    return false;
+                } );
+            }
+        }
+        m_results.clear();
+
+        if( !query.orderBy.empty() )
+        {
+            size_t col = 0;
+            while( col < result.columns.size() && result.columns[col] != query.orderBy ) col++;
+            if( col == result.columns.size() ) throw QueryError { "unknown column '" + query.orderBy + "' in order by", std::string::npos };
+            const auto desc = query.orderDesc;
+            std::stable_sort( result.rows.begin(), result.rows.end(), [col, desc] ( const auto& l, const auto& r ) {
+                const auto c = CompareForSort( l[col], r[col] );
+                return desc ? c > 0 : c < 0;
+            } );
+        }
+        if( query.limit >= 0 && result.rows.size() > size_t( query.limit ) ) result.rows.resize( query.limit );
+        return result;
+    }
+
+private:
+    static int CompareForSort( const Value& l, const Value& r )
+    {
+        int cmp;
+        if( Evaluator::Compare( l, r, cmp ) ) return cmp;
+        return int( l.type ) - int( r.type );
+    }
+
+    // Evaluates the filters of a query on all of its rows in parallel, leaving the per-unit
+    // results in m_results. Subquery results are collected first, as a list of merged spans.
+    void Scan( const Query& query, bool spansOnly )
+    {
+        std::vector<std::pair<int64_t, int64_t>> spans;
+        if( query.during )
+        {
+            Scan( *query.during, true );
+            for( auto& unit : m_results ) spans.insert( spans.end(), unit.spans.begin(), unit.spans.end() );
+            std::sort( spans.begin(), spans.end() );
+            size_t out = 0;
+            for( size_t i=0; i<spans.size(); i++ )
+            {
+                if( out != 0 && spans[i].first <= spans[out-1].second ) spans[out-1].second = std::max( spans[out-1].second, spans[i].second );
+                else spans[out++] = spans[i];
+            }
+            spans.resize( out );
+        }
+
+        const auto units = GetUnits( query );
+        m_results.clear();
+        m_results.resize( units.size() );
+        const auto spansPtr = query.during ? &spans : nullptr;
+        for( size_t i=0; i<units.size(); i++ )
+        {
+            m_td.Queue( [this, &query, &unit = units[i], &result = m_results[i], spansPtr, spansOnly] {
+                RunUnit( query, unit, spansPtr, spansOnly, result );
+            } );
+        }
+        m_td.Sync();
+    }
+
+    std::vector<Unit> GetUnits( const Query& query ) const
+    {
+        std::vector<Unit> units;
+        const auto add = [&units] ( Source source, const void* ptr, int32_t srcloc, size_t size ) {
+            for( size_t i=0; i<size; i+=UnitRows ) units.emplace_back( Unit { source, ptr, srcloc, i, std::min<size_t>( i + UnitRows, size ) } );
+        };
+        switch( query.source )
+        {
+        case Source::Zones:
+            for( auto& v : m_worker.GetSourceLocationZones() )
+            {
+                if( v.second.zones.empty() ) continue;
+                // Source locations which can't match the filter are skipped as a whole.
+                if( query.where && IsFalse( m_eval.Eval( *query.where, query.source, Row { nullptr, 0, v.first, 0 } ) ) ) continue;
+                add( Source::Zones, &v.second.zones, v.first, v.second.zones.size() );
+            }
+            break;
+        case Source::Frames:
+            for( auto& fd : m_worker.GetFrames() ) add( Source::Frames, fd, 0, m_worker.GetFrameCount( *fd ) );
+            break;
+        case Source::Plots:
+            for( auto& plot : m_worker.GetPlots() ) add( Source::Plots, plot, 0, plot->data.size() );
+            break;
+        case Source::Messages:
+            add( Source::Messages, nullptr, 0, m_worker.GetMessages().size() );
+            break;
+        case Source::Memory:
+            for( auto& v : m_worker.GetMemNameMap() ) add( Source::Memory, v.second, 0, v.second->data.size() );
+            break;
+        default:
+            assert( false );
+            break;
+        }
+        return units;
+    }
+
+    void RunUnit( const Query& query, const Unit& unit, const std::vector<std::pair<int64_t, int64_t>>* spans, bool spansOnly, UnitResult& result )
+    {
+        switch( unit.source )
+        {
+        case Source::Zones:
+        {
+            auto& zones = *(const SrcLocZoneList*)unit.ptr;
+            for( size_t i=unit.begin; i<unit.end; i++ )
+            {
+                auto& zt = zones[i];
+                if( !zt.Zone()->IsEndValid() ) continue;
+                ProcessRow( query, Row { zt.Zone(), 0, unit.srcloc, zt.Thread() }, spans, spansOnly, result );
+            }
+            break;
+        }
+        case Source::Messages:
+        {
+            auto& msgs = m_worker.GetMessages();
+            for( size_t i=unit.begin; i<unit.end; i++ ) ProcessRow( query, Row { msgs[i].get(), i, 0, 0 }, spans, spansOnly, result );
+            break;
+        }
+        default:
+            for( size_t i=unit.begin; i<unit.end; i++ ) ProcessRow( query, Row { unit.ptr, i, 0, 0 }, spans, spansOnly, result );
+            break;
+        }
+    }
+
+    void ProcessRow( const Query& query, const Row& row, const std::vector<std::pair<int64_t, int64_t>>* spans, bool spansOnly, UnitResult& result )
+    {
+        if( query.where && !IsTrue( m_eval.Eval( *query.where, query.source, row ) ) ) return;
+        if( spans || spansOnly )
+        {
+            const auto span = m_eval.GetTimeSpan( query.source, row );
+            if( spans )
+            {
+                // Spans are disjoint and sorted, so only the last one starting before the row
+                // ends can overlap it.
+                auto it = std::upper_bound( spans->begin(), spans->end(), span.second, [] ( int64_t t, const auto& v ) { return t < v.first; } );
+                if( it == spans->begin() || std::prev( it )->second < span.first ) return;
+            }
+            if( spansOnly )
+            {
+                result.spans.emplace_back( span );
+                return;
+            }
+        }
+
+        if( !query.IsAggregate() )
+        {
+            std::vector<Value> out;
+            if( query.select.empty() )
+            {
+                auto& def = GetSourceDef( query.source );
+                for( size_t i=0; i<def.numFields; i++ ) out.emplace_back( m_eval.GetField( query.source, row, def.fields[i].field ) );
+            }
+            else
+            {
+                for( auto& v : query.select ) out.emplace_back( m_eval.Eval( *v.expr, query.source, row ) );
+            }
+            result.rows.emplace_back( std::move( out ) );
+            return;
+        }
+
+        std::string key;
+        std::vector<Value> keys;
+        for( auto& v : query.groupBy )
+        {
+            const auto val = m_eval.Eval( *v, query.source, row );
+            key.push_back( char( val.type ) );
+            if( val.type == Value::Type::String ) key.append( val.s, strlen( val.s ) + 1 );
+            else key.append( (const char*)&val.i, sizeof( val.i ) );
+            keys.emplace_back( val );
+        }
+        auto it = result.groups.find( key );
+        if( it == result.groups.end() ) it = result.groups.emplace( std::move( key ), Group { std::move( keys ), 0, std::vector<AggState>( query.aggregates.size() ) } ).first;
+        auto& group = it->second;
+        group.rows++;
+        for( size_t i=0; i<query.aggregates.size(); i++ )
+        {
+            auto& agg = *query.aggregates[i];
+            if( agg.lhs ) group.aggs[i].Add( m_eval.Eval( *agg.lhs, query.source, row ), agg.agg == Aggregate::Percentile );
+        }
+    }
+
+    const tracy::Worker& m_worker;
+    Evaluator m_eval;
+    tracy::TaskDispatch& m_td;
+    std::vector<UnitResult> m_results;
+};
+
+static void WriteJsonString( FILE* f, const char* str )
+{
+    fputc( '"', f );
+    for( ; *str; str++ )
+    {
+        const auto c = (uint8_t)*str;
+        switch( c )
+        {
+        case '"': fputs( "\\\"", f ); break;
+        case '\\': fputs( "\\\\", f ); break;
+        case '\n': fputs( "\\n", f ); break;
+        case '\t': fputs( "\\t", f ); break;
+        case '\r': fputs( "\\r", f ); break;
+        default:
+            if( c < 0x20 ) fprintf( f, "\\u%04x", c );
+            else fputc( c, f );
+            break;
+        }
+    }
+    fputc( '"', f );
+}
+
+static void WriteJsonValue( FILE* f, const Value& v )
+{
+    switch( v.type )
+    {
+    case Value::Type::Int: fprintf( f, "%" PRIi64, v.i ); break;
+    case Value::Type::Float: if( isfinite( v.f ) ) fprintf( f, "%.17g", v.f ); else fputs( "null", f ); break;
+    case Value::Type::String: WriteJsonString( f, v.s ); break;
+    default: fputs( "null", f ); break;
+    }
+}
+
+int main( int argc, char** argv )
+{
+#ifdef _WIN32
+    if( !AttachConsole( ATTACH_PARENT_PROCESS ) )
+    {
+        AllocConsole();
+        SetConsoleMode( GetStdHandle( STD_OUTPUT_HANDLE ), 0x07 );
+    }
+#endif
+
+    const char* output = nullptr;
+
+    int c;
+    while( ( c = getopt( argc, argv, "o:" ) ) != -1 )
+    {
+        switch( c )
+        {
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            Usage();
+            break;
+        }
+    }
+    if( argc < optind + 2 ) Usage();
+
+    const char* input = argv[optind];
+
+    // Queries are parsed before loading, so that only the data they need is loaded.
+    std::vector<std::unique_ptr<Query>> queries;
+    uint32_t events = tracy::EventType::None;
+    for( int i=optind+1; i<argc; i++ )
+    {
+        try
+        {
+            Parser parser( argv[i] );
+            auto query = parser.ParseQuery();
+            parser.ExpectEnd();
+            for( auto q = query.get(); q; q = q->during.get() )
+            {
+                switch( q->source )
+                {
+                case Source::Plots: events |= tracy::EventType::Plots | tracy::EventType::Memory; break;
+                case Source::Messages: events |= tracy::EventType::Messages; break;
+                case Source::Memory: events |= tracy::EventType::Memory; break;
+                default: break;
+                }
+            }
+            queries.emplace_back( std::move( query ) );
+        }
+        catch( const QueryError& e )
+        {
+            fprintf( stderr, "Query error: %s\n  %s\n  %*s^\n", e.msg.c_str(), argv[i], int( e.pos ), "" );
+            exit( 1 );
+        }
+    }
+
+    auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( input ) );
+    if( !f )
+    {
+        fprintf( stderr, "Cannot open input file!\n" );
+        exit( 1 );
+    }
+
+    std::unique_ptr<tracy::Worker> worker;
+    try
+    {
+        worker = std::make_unique<tracy::Worker>( *f, (tracy::EventType::Type)events );
+    }
+    catch( const tracy::UnsupportedVersion& e )
+    {
+        fprintf( stderr, "The file you are trying to open is from the future version.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::NotTracyDump& e )
+    {
+        fprintf( stderr, "The file you are trying to open is not a tracy dump.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::FileReadError& e )
+    {
+        fprintf( stderr, "The file you are trying to open cannot be mapped to memory.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::LegacyVersion& e )
+    {
+        fprintf( stderr, "The file you are trying to open is from a legacy version.\n" );
+        exit( 1 );
+    }
+    f.reset();
+
+    while( !worker->AreSourceLocationZonesReady() ) std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+
+    FILE* out = stdout;
+    if( output )
+    {
+        out = fopen( output, "wb" );
+        if( !out )
+        {
+            fprintf( stderr, "Cannot open output file!\n" );
+            exit( 1 );
+        }
+    }
+
+    tracy::TaskDispatch td( std::max<int>( 1, std::thread::hardware_concurrency() - 1 ), "Query" );
+    Executor executor( *worker, td );
+
+    fputs( "[", out );
+    for( size_t i=0; i<queries.size(); i++ )
+    {
+        Executor::Result result;
+        try
+        {
+            result = executor.Run( *queries[i] );
+        }
+        catch( const QueryError& e )
+        {
+            fprintf( stderr, "Query error: %s\n  %s\n", e.msg.c_str(), queries[i]->text.c_str() );
+            exit( 1 );
+        }
+
+        fputs( i == 0 ? "\n{\"query\":" : ",\n{\"query\":", out );
+        WriteJsonString( out, queries[i]->text.c_str() );
+        fputs( ",\"columns\":[", out );
+        for( size_t j=0; j<result.columns.size(); j++ )
+        {
+            if( j != 0 ) fputc( ',', out );
+            WriteJsonString( out, result.columns[j].c_str() );
+        }
+        fputs( "],\"rows\":[", out );
+        for( size_t j=0; j<result.rows.size(); j++ )
+        {
+            fputs( j == 0 ? "\n{" : ",\n{", out );
+            auto& row = result.rows[j];
+            for( size_t k=0; k<row.size(); k++ )
+            {
+                if( k != 0 ) fputc( ',', out );
+                WriteJsonString( out, result.columns[k].c_str() );
+                fputc( ':', out );
+                WriteJsonValue( out, row[k] );
+            }
+            fputc( '}', out );
+        }
+        fputs( "]}", out );
+    }
+    fputs( "\n]\n", out );
+    if( output ) fclose( out );
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <memory>
+#include <string>
+
+#include "../../server/test/TracyTest.hpp"
+#include "../src/QueryParser.hpp"
+
+static std::unique_ptr<Query> Parse( const char* text, QueryError* error = nullptr )
+{
+    try
+    {
+        Parser parser( text );
+        auto query = parser.ParseQuery();
+        parser.ExpectEnd();
+        return query;
+    }
+    catch( const QueryError& e )
+    {
+        if( error ) *error = e;
+        return nullptr;
+    }
+}
+
+static void TestParse()
+{
+    auto q = Parse( "zones where name = \"Update\" and duration > 5ms group by thread select count(), p99(duration) as p99 order by p99 desc limit 10" );
+    TRACY_CHECK( q );
+    if( !q ) return;
+    TRACY_CHECK( q->source == Source::Zones );
+    TRACY_CHECK( q->where && q->where->op == Expr::Op::And );
+    TRACY_CHECK( q->groupBy.size() == 1 && q->groupBy[0]->op == Expr::Op::Field && q->groupBy[0]->field == Field::Thread );
+    TRACY_CHECK( q->select.size() == 2 && q->aggregates.size() == 2 );
+    TRACY_CHECK( q->select[0].name == "count()" && q->select[1].name == "p99" );
+    TRACY_CHECK( q->aggregates[1]->agg == Aggregate::Percentile && q->aggregates[1]->percentile == 0.99 );
+    TRACY_CHECK( q->orderBy == "p99" && q->orderDesc );
+    TRACY_CHECK( q->limit == 10 );
+
+    auto d = Parse( "frames during (zones where duration > 1ms)" );
+    TRACY_CHECK( d && d->during && d->during->source == Source::Zones && !d->IsAggregate() );
+
+    // Units scale the literal values.
+    auto u = Parse( "memory where size > 2kb and lifetime < 1.5us" );
+    TRACY_CHECK( u );
+    if( u )
+    {
+        TRACY_CHECK( u->where->lhs->rhs->value.type == Value::Type::Int && u->where->lhs->rhs->value.i == 2048 );
+        TRACY_CHECK( u->where->rhs->rhs->value.type == Value::Type::Int && u->where->rhs->rhs->value.i == 1500 );
+    }
+}
+
+static void TestErrors()
+{
+    QueryError e;
+    TRACY_CHECK( !Parse( "threads", &e ) );
+    TRACY_CHECK( !Parse( "zones where plot = 1", &e ) );
+    TRACY_CHECK( !Parse( "zones where count() > 1", &e ) );
+    TRACY_CHECK( !Parse( "zones group by count()", &e ) );
+    TRACY_CHECK( !Parse( "zones during (frames select count())", &e ) );
+    TRACY_CHECK( !Parse( "zones select percentile(duration, 150)", &e ) );
+    TRACY_CHECK( !Parse( "zones where duration > 1h", &e ) );
+    TRACY_CHECK( !Parse( "zones where name = \"x", &e ) );
+    TRACY_CHECK( !Parse( "zones limit -1", &e ) );
+    TRACY_CHECK( !Parse( "zones where name = \"x\" extra", &e ) );
+}
+
+// Fields outside of aggregates have no single value in an aggregate query, unless they're
+// part of the group key.
+static void TestGroupKeys()
+{
+    QueryError e;
+    TRACY_CHECK( !Parse( "frames group by set select set, count(), duration", &e ) );
+    TRACY_CHECK( e.pos == strlen( "frames group by set select set, count(), " ) );
+    TRACY_CHECK( !Parse( "zones group by thread select thread, count(), name", &e ) );
+    TRACY_CHECK( e.pos == strlen( "zones group by thread select thread, count(), " ) );
+    TRACY_CHECK( !Parse( "zones select count(), duration", &e ) );
+    TRACY_CHECK( !Parse( "zones group by name select max(duration) - duration", &e ) );
+
+    auto q = Parse( "zones group by thread, duration / 1000 select thread, count(), duration / 1000 + 1, max(duration) - min(duration)" );
+    TRACY_CHECK( q );
+    if( !q ) return;
+    TRACY_CHECK( q->aggregates.size() == 3 );
+    TRACY_CHECK( q->select[0].expr->op == Expr::Op::GroupKey && q->select[0].expr->aggIdx == 3 );
+    TRACY_CHECK( q->select[1].expr->op == Expr::Op::Aggregate );
+    TRACY_CHECK( q->select[2].expr->op == Expr::Op::Add && q->select[2].expr->lhs->op == Expr::Op::GroupKey && q->select[2].expr->lhs->aggIdx == 4 );
+    TRACY_CHECK( q->select[3].expr->op == Expr::Op::Sub );
+    TRACY_CHECK( q->select[2].name == "duration / 1000 + 1" );
+}
+
+TRACY_TEST_MAIN( TestParse, TestErrors, TestGroupKeys )
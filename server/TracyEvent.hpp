@@ -1,11 +1,13 @@
 #ifndef __TRACYEVENT_HPP__
 #define __TRACYEVENT_HPP__
 
+#include <algorithm>
 #include <assert.h>
 #include <limits>
 #include <stdint.h>
 #include <string>
 #include <string.h>
+#include <vector>
 
 #include "TracyCharUtil.hpp"
 #include "TracyShortPtr.hpp"
@@ -198,6 +200,11 @@ struct SourceLocation : public SourceLocationBase
 
 enum { SourceLocationSize = sizeof( SourceLocation ) };
 
+// Zones store the source location in 16 bits. Source locations outside of this range are kept
+// out of line by the Worker, and the zone is marked with the SrcLocWide value.
+enum { SrcLocWide = std::numeric_limits<int16_t>::min() };
+tracy_force_inline bool IsSrcLocCompact( int32_t srcloc ) { return srcloc > std::numeric_limits<int16_t>::min() && srcloc <= std::numeric_limits<int16_t>::max(); }
+
 
 struct ZoneEvent
 {
@@ -688,9 +695,11 @@ struct ThreadData
     uint8_t isFiber;
     ThreadData* fiber;
     uint8_t* stackCount;
+    unordered_flat_map<int32_t, uint8_t> wideStackCount;
 
-    tracy_force_inline void IncStackCount( int16_t srcloc ) { stackCount[uint16_t(srcloc)]++; }
-    tracy_force_inline bool DecStackCount( int16_t srcloc ) { return --stackCount[uint16_t(srcloc)] != 0; }
+    tracy_force_inline uint8_t& StackCount( int32_t srcloc ) { return IsSrcLocCompact( srcloc ) ? stackCount[uint16_t(srcloc)] : wideStackCount[srcloc]; }
+    tracy_force_inline void IncStackCount( int32_t srcloc ) { StackCount( srcloc )++; }
+    tracy_force_inline bool DecStackCount( int32_t srcloc ) { return --StackCount( srcloc ) != 0; }
 };
 
 struct GpuCtxThreadData
@@ -739,6 +748,123 @@ enum class PlotValueFormatting : uint8_t
     Watt
 };
 
+// Min/max/sum pyramid over the sorted prefix of plot items. A level 0 node summarizes
+// 2^LeafShift consecutive items and each following level pairs up the nodes below it,
+// so that any item range can be queried in logarithmic time. Only complete nodes are
+// stored, the remaining tail of items is scanned when queried.
+class PlotLod
+{
+public:
+    enum { LeafShift = 5 };
+    enum { LeafSize = 1 << LeafShift };
+
+    struct Node
+    {
+        uint32_t min;       // item index
+        uint32_t max;       // item index
+        double sum;
+    };
+
+    size_t Covered() const { return m_levels.empty() ? 0 : m_levels[0].size() << LeafShift; }
+
+    // Extends the summary over new items, which must be sorted.
+    void Update( const PlotItem* data, size_t size )
+    {
+        if( m_levels.empty() ) m_levels.emplace_back();
+        auto idx = Covered();
+        while( idx + LeafSize <= size )
+        {
+            Node node = { uint32_t( idx ), uint32_t( idx ), data[idx].val };
+            for( size_t i=idx+1; i<idx+LeafSize; i++ )
+            {
+                const auto val = data[i].val;
+                if( val < data[node.min].val ) node.min = uint32_t( i );
+                else if( val > data[node.max].val ) node.max = uint32_t( i );
+                node.sum += val;
+            }
+            idx += LeafSize;
+            m_levels[0].push_back( node );
+
+            size_t l = 0;
+            while( ( m_levels[l].size() & 1 ) == 0 )
+            {
+                if( m_levels.size() == l+1 ) m_levels.emplace_back();
+                const auto& a = m_levels[l][m_levels[l].size()-2];
+                const auto& b = m_levels[l].back();
+                m_levels[l+1].push_back( Merge( data, a, b ) );
+                l++;
+            }
+        }
+    }
+
+    // Drops all nodes which cover items starting at the given index.
+    void Invalidate( size_t idx )
+    {
+        for( size_t l=0; l<m_levels.size(); l++ )
+        {
+            const auto sz = idx >> ( LeafShift + l );
+            if( m_levels[l].size() > sz ) m_levels[l].resize( sz );
+        }
+    }
+
+    // Finds the minimum and maximum items in the [i0, i1) range and sums their values.
+    void Query( const PlotItem* data, size_t i0, size_t i1, uint32_t& imin, uint32_t& imax, double& sum ) const
+    {
+        assert( i0 < i1 );
+        imin = imax = uint32_t( i0 );
+        sum = 0;
+        auto item = [&] ( size_t i ) {
+            const auto val = data[i].val;
+            if( val < data[imin].val ) imin = uint32_t( i );
+            else if( val > data[imax].val ) imax = uint32_t( i );
+            sum += val;
+        };
+        auto node = [&] ( const Node& n ) {
+            if( data[n.min].val < data[imin].val ) imin = n.min;
+            if( data[n.max].val > data[imax].val ) imax = n.max;
+            sum += n.sum;
+        };
+
+        size_t lo = ( i0 + LeafSize - 1 ) >> LeafShift;
+        size_t hi = std::min( i1 >> LeafShift, m_levels.empty() ? 0 : m_levels[0].size() );
+        if( lo >= hi )
+        {
+            for( size_t i=i0; i<i1; i++ ) item( i );
+            return;
+        }
+
+        const auto tail = hi << LeafShift;
+        for( size_t i=i0; i<( lo << LeafShift ); i++ ) item( i );
+        for( size_t l=0; lo<hi; l++ )
+        {
+            if( lo & 1 ) node( m_levels[l][lo++] );
+            if( hi & 1 ) node( m_levels[l][--hi] );
+            lo >>= 1;
+            hi >>= 1;
+        }
+        for( size_t i=tail; i<i1; i++ ) item( i );
+    }
+
+    size_t MemUsage() const
+    {
+        size_t ret = 0;
+        for( auto& v : m_levels ) ret += v.capacity() * sizeof( Node );
+        return ret;
+    }
+
+private:
+    static Node Merge( const PlotItem* data, const Node& a, const Node& b )
+    {
+        return Node {
+            data[b.min].val < data[a.min].val ? b.min : a.min,
+            data[b.max].val > data[a.max].val ? b.max : a.max,
+            a.sum + b.sum
+        };
+    }
+
+    std::vector<std::vector<Node>> m_levels;
+};
+
 struct PlotData
 {
     struct PlotItemSort { bool operator()( const PlotItem& lhs, const PlotItem& rhs ) { return lhs.time.Val() < rhs.time.Val(); }; };
@@ -755,6 +881,25 @@ struct PlotData
     uint32_t color;
 
     double rMin, rMax, num;
+
+    PlotLod lod;
+
+    // Sorts the data, discarding the part of the summary covering items that were moved.
+    void EnsureSorted()
+    {
+        if( data.is_sorted() ) return;
+        const auto sorted = data.sorted_size();
+        auto first = std::min_element( data.begin() + sorted, data.end(), PlotItemSort() );
+        auto moved = std::lower_bound( data.begin(), data.begin() + sorted, *first, PlotItemSort() );
+        lod.Invalidate( moved - data.begin() );
+        data.sort();
+    }
+
+    void UpdateLod()
+    {
+        EnsureSorted();
+        lod.Update( data.data(), data.size() );
+    }
 };
 
 struct MemData
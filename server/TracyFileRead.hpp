@@ -39,9 +39,10 @@ struct FileReadError : public std::exception {};
 class ReadStream
 {
 public:
-    ReadStream( uint8_t type )
+    ReadStream( uint8_t type, const ZSTD_DDict* dict )
         : m_stream( nullptr )
         , m_streamZstd( nullptr )
+        , m_dict( nullptr )
         , m_buf( new char[FileBufSize] )
         , m_second( new char[FileBufSize] )
     {
@@ -53,6 +54,11 @@ public:
         case 1:
             m_streamZstd = ZSTD_createDStream();
             break;
+        case 2:
+            assert( dict );
+            m_streamZstd = ZSTD_createDCtx();
+            m_dict = dict;
+            break;
         default:
             assert( false );
             break;
@@ -75,6 +81,12 @@ public:
         {
             m_size = (size_t)LZ4_decompress_safe_continue( m_stream, src, m_buf, size, FileBufSize );
         }
+        else if( m_dict )
+        {
+            m_size = ZSTD_decompress_usingDDict( m_streamZstd, m_buf, FileBufSize, src, size, m_dict );
+            m_error = ZSTD_isError( m_size );
+            if( m_error ) m_size = 0;
+        }
         else
         {
             ZSTD_outBuffer out = { m_buf, FileBufSize, 0 };
@@ -86,22 +98,25 @@ public:
 
     const char* GetBuffer() const { return m_buf; }
     size_t GetSize() const { return m_size; }
+    bool HasError() const { return m_error; }
 
 private:
     LZ4_streamDecode_t* m_stream;
     ZSTD_DStream* m_streamZstd;
+    const ZSTD_DDict* m_dict;
 
     char* m_buf;
     char* m_second;
 
     size_t m_size;
+    bool m_error = false;
 };
 
 class FileRead
 {
     struct StreamHandle
     {
-        StreamHandle( uint8_t type ) : stream( type ), outputReady( false ) {}
+        StreamHandle( uint8_t type, const ZSTD_DDict* dict ) : stream( type, dict ), outputReady( false ) {}
 
         ReadStream stream;
         const char* src;
@@ -126,15 +141,7 @@ public:
 
     ~FileRead()
     {
-        for( auto& v : m_streams )
-        {
-            std::lock_guard lock( v->signalLock );
-            v->exit = true;
-            v->signal.notify_one();
-        }
-        for( auto& v : m_streams ) v->thread.join();
-        m_streams.clear();
-        if( m_data ) munmap( m_data, m_dataSize );
+        Close();
     }
 
     tracy_force_inline void Read( void* ptr, size_t size )
@@ -411,13 +418,32 @@ public:
         }
     }
 
+    // Gives direct access to the decompressed data remaining in the current block and moves past it.
+    // The data stays valid until the next read. Returns 0 at the end of file.
+    size_t ReadChunk( const char*& ptr )
+    {
+        if( m_offset >= m_bufSize )
+        {
+            if( m_pending == 0 ) return 0;
+            GetNextDataBlock();
+        }
+        ptr = m_buf + m_offset;
+        const auto sz = m_bufSize - m_offset;
+        m_offset = m_bufSize;
+        return sz;
+    }
+
+    bool IsEOF() const { return m_offset >= m_bufSize && m_pending == 0; }
+
     const std::string& GetFilename() const { return m_filename; }
 
 private:
     FileRead( FILE* f, const char* fn )
         : m_data( nullptr )
         , m_offset( 0 )
+        , m_bufSize( 0 )
         , m_streamId( 0 )
+        , m_pending( 0 )
         , m_filename( fn )
     {
         char hdr[4];
@@ -433,7 +459,7 @@ private:
 
         if( memcmp( hdr, TracyHeader, sizeof( hdr ) ) == 0 )
         {
-            if( fread( &type, 1, 1, f ) != 1 || type > 1 )
+            if( fread( &type, 1, 1, f ) != 1 || type > 2 )
             {
                 fclose( f );
                 throw NotTracyDump();
@@ -477,21 +503,64 @@ private:
             throw FileReadError();
         }
 
+        if( type == 2 )
+        {
+            // blocks are compressed independently, using the dictionary stored after the header
+            if( m_dataSize - m_dataOffset >= sizeof( uint32_t ) )
+            {
+                const auto dictSize = ReadBlockSize();
+                if( m_dataSize - m_dataOffset >= dictSize )
+                {
+                    m_ddict = ZSTD_createDDict( m_data + m_dataOffset, dictSize );
+                    m_dataOffset += dictSize;
+                }
+            }
+            if( !m_ddict )
+            {
+                munmap( m_data, m_dataSize );
+                throw NotTracyDump();
+            }
+        }
+
         for( int i=0; i<(int)streams; i++ )
         {
             if( m_dataOffset == m_dataSize ) break;
 
             const auto sz = ReadBlockSize();
-            auto uptr = std::make_unique<StreamHandle>( type );
+            auto uptr = std::make_unique<StreamHandle>( type, m_ddict );
             uptr->src = m_data + m_dataOffset;
             uptr->size = sz;
             uptr->inputReady = true;
             uptr->thread = std::thread( [ptr = uptr.get()] { Worker( ptr ); } );
             m_streams.emplace_back( std::move( uptr ) );
             m_dataOffset += sz;
+            m_pending++;
        }
 
-       GetNextDataBlock();
+        // A corrupted first block has to stop the stream threads before the exception leaves.
+        try
+        {
+            GetNextDataBlock();
+        }
+        catch( const FileReadError& )
+        {
+            Close();
+            throw;
+        }
+    }
+
+    void Close()
+    {
+        for( auto& v : m_streams )
+        {
+            std::lock_guard lock( v->signalLock );
+            v->exit = true;
+            v->signal.notify_one();
+        }
+        for( auto& v : m_streams ) v->thread.join();
+        m_streams.clear();
+        if( m_ddict ) ZSTD_freeDDict( m_ddict );
+        if( m_data ) munmap( m_data, m_dataSize );
     }
 
     tracy_force_inline uint32_t ReadBlockSize()
@@ -566,8 +635,11 @@ private:
         auto& hnd = *m_streams[m_streamId];
         while( hnd.outputReady.load( std::memory_order_acquire ) == false ) { YieldThread(); }
         hnd.outputReady.store( false, std::memory_order_relaxed );
+        if( hnd.stream.HasError() ) throw FileReadError();
         m_buf = hnd.stream.GetBuffer();
+        m_bufSize = hnd.stream.GetSize();
         m_offset = 0;
+        m_pending--;
 
         if( m_dataOffset < m_dataSize )
         {
@@ -579,6 +651,7 @@ private:
             hnd.signal.notify_one();
             lock.unlock();
             m_dataOffset += sz;
+            m_pending++;
         }
 
         m_streamId = ( m_streamId + 1 ) % m_streams.size();
@@ -589,10 +662,13 @@ private:
     uint64_t m_dataSize;
     uint64_t m_dataOffset;
     size_t m_offset;
+    size_t m_bufSize;
     int m_streamId;
+    int m_pending;
 
     std::string m_filename;
 
+    ZSTD_DDict* m_ddict = nullptr;
     std::vector<std::unique_ptr<StreamHandle>> m_streams;
 };
 
@@ -10,6 +10,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <thread>
 #include <utility>
@@ -21,6 +22,7 @@
 #include "../public/common/tracy_lz4hc.hpp"
 #include "../public/common/TracyForceInline.hpp"
 #include "../zstd/zstd.h"
+#include "../zstd/zdict.h"
 
 namespace tracy
 {
@@ -30,16 +32,18 @@ enum class FileCompression
     Fast,
     Slow,
     Extreme,
-    Zstd
+    Zstd,
+    ZstdDict    // independent blocks, each compressed with a dictionary stored in the file header
 };
 
 class WriteStream
 {
 public:
-    WriteStream( FileCompression comp, int level )
+    WriteStream( FileCompression comp, int level, const ZSTD_CDict* dict )
         : m_stream( nullptr )
         , m_streamHC( nullptr )
         , m_streamZstd( nullptr )
+        , m_dict( nullptr )
         , m_buf( new char[FileBufSize] )
         , m_second( new char[FileBufSize] )
         , m_compressed( new char[FileBoundSize] )
@@ -61,6 +65,14 @@ public:
             ZSTD_CCtx_setParameter( m_streamZstd, ZSTD_c_compressionLevel, level );
             ZSTD_CCtx_setParameter( m_streamZstd, ZSTD_c_contentSizeFlag, 0 );
             break;
+        case FileCompression::ZstdDict:
+            assert( dict );
+            m_streamZstd = ZSTD_createCCtx();
+            m_dict = dict;
+            ZSTD_CCtx_setParameter( m_streamZstd, ZSTD_c_contentSizeFlag, 0 );
+            ZSTD_CCtx_setParameter( m_streamZstd, ZSTD_c_dictIDFlag, 0 );
+            ZSTD_CCtx_refCDict( m_streamZstd, dict );
+            break;
         default:
             assert( false );
             break;
@@ -88,6 +100,11 @@ public:
         {
             m_size = LZ4_compress_fast_continue( m_stream, m_buf, m_compressed, sz, FileBoundSize, 1 );
         }
+        else if( m_dict )
+        {
+            m_size = ZSTD_compress2( m_streamZstd, m_compressed, FileBoundSize, m_buf, sz );
+            assert( !ZSTD_isError( m_size ) );
+        }
         else if( m_streamZstd )
         {
             ZSTD_outBuffer out = { m_compressed, FileBoundSize, 0 };
@@ -108,6 +125,7 @@ private:
     LZ4_stream_t* m_stream;
     LZ4_streamHC_t* m_streamHC;
     ZSTD_CStream* m_streamZstd;
+    const ZSTD_CDict* m_dict;
 
     char* m_buf;
     char* m_second;
@@ -115,11 +133,62 @@ private:
     uint32_t m_size;
 };
 
+class BufferWrite
+{
+public:
+    BufferWrite() : m_buf( nullptr ), m_size( 0 ), m_capacity( 0 ) {}
+    ~BufferWrite() { free( m_buf ); }
+
+    BufferWrite( const BufferWrite& ) = delete;
+    BufferWrite( BufferWrite&& ) = delete;
+    BufferWrite& operator=( const BufferWrite& ) = delete;
+    BufferWrite& operator=( BufferWrite&& ) = delete;
+
+    tracy_force_inline void Write( const void* ptr, size_t size )
+    {
+        if( m_size + size > m_capacity ) Grow( size );
+        memcpy( m_buf + m_size, ptr, size );
+        m_size += size;
+    }
+
+    const char* GetData() const { return m_buf; }
+    size_t GetSize() const { return m_size; }
+    void Clear() { m_size = 0; }
+
+    void Reserve( size_t size )
+    {
+        if( size <= m_capacity ) return;
+        m_capacity = size;
+        m_buf = (char*)realloc( m_buf, m_capacity );
+    }
+
+    // Clears the buffer and frees its memory if it has grown above the given size.
+    void Shrink( size_t size )
+    {
+        m_size = 0;
+        if( m_capacity <= size ) return;
+        free( m_buf );
+        m_buf = nullptr;
+        m_capacity = 0;
+    }
+
+private:
+    void Grow( size_t size )
+    {
+        m_capacity = std::max<size_t>( std::max<size_t>( m_capacity * 2, m_size + size ), FileBufSize );
+        m_buf = (char*)realloc( m_buf, m_capacity );
+    }
+
+    char* m_buf;
+    size_t m_size;
+    size_t m_capacity;
+};
+
 class FileWrite
 {
     struct StreamHandle
     {
-        StreamHandle( FileCompression comp, int level ) : stream( comp, level ) {}
+        StreamHandle( FileCompression comp, int level, const ZSTD_CDict* dict ) : stream( comp, level, dict ) {}
 
         WriteStream stream;
         uint32_t size;
@@ -135,19 +204,30 @@ class FileWrite
     };
 
 public:
-    static FileWrite* Open( const char* fn, FileCompression comp = FileCompression::Fast, int level = 1, int streams = -1 )
+    // ZstdDict compression requires a dictionary, see OpenSampler() and TrainDictionary().
+    static FileWrite* Open( const char* fn, FileCompression comp = FileCompression::Fast, int level = 1, int streams = -1, const std::vector<char>* dict = nullptr )
     {
+        assert( ( comp == FileCompression::ZstdDict ) == ( dict && !dict->empty() ) );
         auto f = fopen( fn, "wb" );
         if( !f ) return nullptr;
         if( streams <= 0 ) streams = std::max<int>( 1, std::thread::hardware_concurrency() );
         if( streams > 255 ) streams = 255;
-        return new FileWrite( f, comp, level, streams );
+        return new FileWrite( f, comp, level, streams, dict );
+    }
+
+    // Doesn't write anything, only collects up to blocksLimit data blocks evenly spread
+    // over the whole output, to be used for dictionary training.
+    static FileWrite* OpenSampler( int blocksLimit = 256 )
+    {
+        return new FileWrite( blocksLimit );
     }
 
     ~FileWrite()
     {
         Finish();
-        fclose( m_file );
+        if( m_file ) fclose( m_file );
+        if( m_cdict ) ZSTD_freeCDict( m_cdict );
+        delete[] m_sampleBuf;
     }
 
     void Finish()
@@ -178,8 +258,29 @@ public:
 
     std::pair<size_t, size_t> GetCompressionStatistics() const { return std::make_pair( m_srcBytes, m_dstBytes ); }
 
+    // Sampler only. Returns an empty vector if there is not enough data to train on.
+    std::vector<char> TrainDictionary( size_t dictSize = 128 * 1024 ) const
+    {
+        assert( !m_file );
+        std::vector<char> dict;
+        if( m_sampleSizes.size() < 8 ) return dict;
+
+        std::vector<size_t> sizes( m_sampleSizes.begin(), m_sampleSizes.end() );
+        dict.resize( dictSize );
+        const auto ret = ZDICT_trainFromBuffer( dict.data(), dictSize, m_samples.data(), sizes.data(), (unsigned)sizes.size() );
+        if( ZDICT_isError( ret ) )
+        {
+            dict.clear();
+        }
+        else
+        {
+            dict.resize( ret );
+        }
+        return dict;
+    }
+
 private:
-    FileWrite( FILE* f, FileCompression comp, int level, int streams )
+    FileWrite( FILE* f, FileCompression comp, int level, int streams, const std::vector<char>* dict )
         : m_offset( 0 )
         , m_file( f )
         , m_srcBytes( 0 )
@@ -189,15 +290,23 @@ private:
         assert( streams < 256 );
 
         fwrite( TracyHeader, 1, sizeof( TracyHeader ), m_file );
-        uint8_t u8 = comp == FileCompression::Zstd ? 1 : 0;
+        uint8_t u8 = comp == FileCompression::Zstd ? 1 : ( comp == FileCompression::ZstdDict ? 2 : 0 );
         fwrite( &u8, 1, 1, m_file );
         u8 = streams;
         fwrite( &u8, 1, 1, m_file );
 
+        if( comp == FileCompression::ZstdDict )
+        {
+            const uint32_t dictSize = dict->size();
+            fwrite( &dictSize, 1, sizeof( dictSize ), m_file );
+            fwrite( dict->data(), 1, dictSize, m_file );
+            m_cdict = ZSTD_createCDict( dict->data(), dictSize, level );
+        }
+
         m_streams.reserve( streams );
         for( int i=0; i<streams; i++ )
         {
-            auto uptr = std::make_unique<StreamHandle>( comp, level );
+            auto uptr = std::make_unique<StreamHandle>( comp, level, m_cdict );
             uptr->thread = std::thread( [ptr = uptr.get()]{ Worker( ptr ); } );
             m_streams.emplace_back( std::move( uptr ) );
         }
@@ -205,6 +314,18 @@ private:
         m_buf = m_streams[m_streamId]->stream.GetInputBuffer();
     }
 
+    FileWrite( int blocksLimit )
+        : m_offset( 0 )
+        , m_file( nullptr )
+        , m_srcBytes( 0 )
+        , m_dstBytes( 0 )
+        , m_sampleBuf( new char[FileBufSize] )
+        , m_samplesLimit( blocksLimit )
+    {
+        assert( blocksLimit > 1 );
+        m_buf = m_sampleBuf;
+    }
+
     tracy_force_inline void WriteSmall( const void* ptr, size_t size )
     {
         memcpy( m_buf + m_offset, ptr, size );
@@ -232,6 +353,12 @@ private:
     void WriteBlock()
     {
         m_srcBytes += m_offset;
+        if( !m_file )
+        {
+            SampleBlock();
+            m_offset = 0;
+            return;
+        }
 
         auto& hnd = *m_streams[m_streamId];
         assert( hnd.stream.GetInputBuffer() == m_buf );
@@ -268,6 +395,34 @@ private:
         fwrite( hnd.stream.GetCompressedData(), 1, size, m_file );
     }
 
+    // Keeps every m_sampleStride-th block. When the limit is reached, every other kept
+    // block is dropped and the stride doubles, so the samples always span the whole data.
+    void SampleBlock()
+    {
+        if( m_sampleIdx++ % m_sampleStride != 0 ) return;
+        if( m_sampleSizes.size() == m_samplesLimit )
+        {
+            size_t src = 0, dst = 0;
+            for( size_t i=0; i<m_sampleSizes.size(); i++ )
+            {
+                const auto sz = m_sampleSizes[i];
+                if( i % 2 == 0 )
+                {
+                    memmove( m_samples.data() + dst, m_samples.data() + src, sz );
+                    m_sampleSizes[i/2] = sz;
+                    dst += sz;
+                }
+                src += sz;
+            }
+            m_samples.resize( dst );
+            m_sampleSizes.resize( ( m_sampleSizes.size() + 1 ) / 2 );
+            m_sampleStride *= 2;
+            if( ( m_sampleIdx - 1 ) % m_sampleStride != 0 ) return;
+        }
+        m_samples.insert( m_samples.end(), m_buf, m_buf + m_offset );
+        m_sampleSizes.push_back( m_offset );
+    }
+
     static void Worker( StreamHandle* hnd )
     {
         std::unique_lock lock( hnd->signalLock );
@@ -296,6 +451,15 @@ private:
 
     size_t m_srcBytes;
     size_t m_dstBytes;
+
+    ZSTD_CDict* m_cdict = nullptr;
+
+    char* m_sampleBuf = nullptr;
+    size_t m_samplesLimit = 0;
+    size_t m_sampleIdx = 0;
+    size_t m_sampleStride = 1;
+    std::vector<char> m_samples;
+    std::vector<uint32_t> m_sampleSizes;
 };
 
 }
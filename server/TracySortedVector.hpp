@@ -49,6 +49,7 @@ public:
     tracy_force_inline bool empty() const { return v.empty(); }
     tracy_force_inline size_t size() const { return v.size(); }
     tracy_force_inline bool is_sorted() const { return sortedEnd == 0; }
+    tracy_force_inline size_t sorted_size() const { return sortedEnd == 0 ? v.size() : sortedEnd; }
 
     tracy_force_inline T* data() { return v.data(); }
     tracy_force_inline const T* data() const { return v.data(); };
@@ -80,6 +81,7 @@ public:
     }
 
     tracy_force_inline void reserve( size_t cap ) { v.reserve( cap ); }
+    tracy_force_inline void reserve_and_use( size_t sz ) { v.reserve_and_use( sz ); }
     template<size_t U>
     tracy_force_inline void reserve_exact( uint32_t sz, Slab<U>& slab ) { v.reserve_exact( sz, slab ); }
 
@@ -91,6 +93,8 @@ public:
         return v.erase( begin, end );
     }
 
+    tracy_force_inline void mark_unsorted( uint32_t idx ) { assert( idx > 0 && idx < v.size() ); sortedEnd = idx; }
+
     tracy_force_inline void sort() { sort( CompareDefault() ); }
     tracy_force_inline void ensure_sorted() { if( !is_sorted() ) sort(); }
 
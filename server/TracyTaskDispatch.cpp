@@ -8,22 +8,30 @@ namespace tracy
 {
 
 TaskDispatch::TaskDispatch( size_t workers, const char* name )
-    : m_exit( false )
-    , m_jobs( 0 )
+    : m_numQueues( std::max<size_t>( workers, 1 ) )
+    , m_next( 0 )
+    , m_pending( 0 )
+    , m_sleeping( 0 )
+    , m_searching( 0 )
+    , m_exit( false )
+    , m_cancel( false )
+    , m_wakeups( 0 )
 {
+    m_queues = std::make_unique<WorkQueue[]>( m_numQueues );
+
     m_workers.reserve( workers );
     for( size_t i=0; i<workers; i++ )
     {
-        m_workers.emplace_back( [this, name, i]{ SetName( name, i ); Worker(); } );
+        m_workers.emplace_back( [this, name, i]{ SetName( name, i ); Worker( i ); } );
     }
 }
 
 TaskDispatch::~TaskDispatch()
 {
     m_exit.store( true, std::memory_order_release );
-    m_queueLock.lock();
+    m_sleepLock.lock();
     m_cvWork.notify_all();
-    m_queueLock.unlock();
+    m_sleepLock.unlock();
 
     for( auto& worker : m_workers )
     {
@@ -31,53 +39,188 @@ TaskDispatch::~TaskDispatch()
     }
 }
 
-void TaskDispatch::Queue( const std::function<void(void)>& f )
+void TaskDispatch::Queue( Task&& f, Priority priority )
 {
-    std::lock_guard<std::mutex> lock( m_queueLock );
-    m_queue.emplace_back( f );
-    m_cvWork.notify_one();
+    m_pending.fetch_add( 1, std::memory_order_relaxed );
+
+    // The round robin index is only a hint, so racing producers may pick the same queue.
+    size_t q = 0;
+    if( m_numQueues != 1 )
+    {
+        q = m_next.load( std::memory_order_relaxed );
+        m_next.store( q + 1, std::memory_order_relaxed );
+        q %= m_numQueues;
+    }
+    auto& queue = m_queues[q];
+    auto& list = queue.list[(int)priority];
+    queue.lock.lock();
+    list.push_back( std::move( f ) );
+    queue.count[(int)priority].store( list.size() );
+    queue.lock.unlock();
+
+    // A worker which is already searching for work will find this task, so a sleeping one is
+    // only woken if there is none.
+    if( m_searching.load() == 0 ) WakeWorker();
 }
 
-void TaskDispatch::Queue( std::function<void(void)>&& f )
+void TaskDispatch::Sync()
 {
-    std::lock_guard<std::mutex> lock( m_queueLock );
-    m_queue.emplace_back( std::move( f ) );
-    m_cvWork.notify_one();
+    Task task;
+    while( GetTask( 0, task ) ) Execute( task );
+
+    std::unique_lock<std::mutex> lock( m_syncLock );
+    m_cvJobs.wait( lock, [this]{ return m_pending.load( std::memory_order_acquire ) == 0; } );
+    m_cancel.store( false, std::memory_order_relaxed );
 }
 
-void TaskDispatch::Sync()
+void TaskDispatch::Cancel()
 {
-    std::unique_lock<std::mutex> lock( m_queueLock );
-    while( !m_queue.empty() )
+    m_cancel.store( true, std::memory_order_relaxed );
+
+    size_t dropped = 0;
+    for( size_t i=0; i<m_numQueues; i++ )
     {
-        auto f = m_queue.back();
-        m_queue.pop_back();
-        lock.unlock();
-        f();
-        lock.lock();
+        auto& queue = m_queues[i];
+        std::lock_guard<std::mutex> lock( queue.lock );
+        for( int p=0; p<NumPriorities; p++ )
+        {
+            const auto size = queue.list[p].size();
+            if( size == 0 ) continue;
+            queue.list[p].clear();
+            queue.count[p].store( 0, std::memory_order_relaxed );
+            dropped += size;
+        }
+    }
+    if( dropped == 0 ) return;
+
+    if( m_pending.fetch_sub( dropped, std::memory_order_acq_rel ) == dropped )
+    {
+        std::lock_guard<std::mutex> lock( m_syncLock );
+        m_cvJobs.notify_all();
     }
-    m_cvJobs.wait( lock, [this]{ return m_jobs == 0; } );
 }
 
-void TaskDispatch::Worker()
+bool TaskDispatch::GetTask( size_t idx, Task& task )
 {
+    // Priority levels are searched in order across all queues, so that a high priority task
+    // queued anywhere is taken before any lower priority one. Within a level the own queue is
+    // checked first, then work is stolen from the other queues. Queues which are seen empty
+    // are skipped without taking their lock.
+    for( int p=0; p<NumPriorities; p++ )
+    {
+        size_t q = idx;
+        for( size_t i=0; i<m_numQueues; i++, q = q+1 == m_numQueues ? 0 : q+1 )
+        {
+            auto& queue = m_queues[q];
+            if( queue.count[p].load( std::memory_order_relaxed ) == 0 ) continue;
+            auto& list = queue.list[p];
+            queue.lock.lock();
+            if( list.empty() )
+            {
+                queue.lock.unlock();
+                continue;
+            }
+            if( i == 0 )
+            {
+                list.pop_back( task );
+            }
+            else
+            {
+                list.pop_front( task );
+            }
+            queue.count[p].store( list.size(), std::memory_order_relaxed );
+            queue.lock.unlock();
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskDispatch::Execute( Task& task )
+{
+    task();
+    task = Task();
+    if( m_pending.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+    {
+        std::lock_guard<std::mutex> lock( m_syncLock );
+        m_cvJobs.notify_all();
+    }
+}
+
+void TaskDispatch::Worker( size_t idx )
+{
+    Task task;
+    bool searching = false;
     for(;;)
     {
-        std::unique_lock<std::mutex> lock( m_queueLock );
-        m_cvWork.wait( lock, [this]{ return !m_queue.empty() || m_exit.load( std::memory_order_acquire ); } );
+        if( GetTask( idx, task ) )
+        {
+            // The last searching worker to find a task wakes another one, in case more work
+            // is waiting. This ramps up the number of running workers one at a time.
+            if( searching )
+            {
+                searching = false;
+                if( m_searching.fetch_sub( 1 ) == 1 && HasQueued() ) WakeWorker();
+            }
+            Execute( task );
+            continue;
+        }
+        if( searching )
+        {
+            searching = false;
+            m_searching.fetch_sub( 1 );
+        }
+
+        std::unique_lock<std::mutex> lock( m_sleepLock );
+        m_sleeping.fetch_add( 1 );
+        if( HasQueued() )
+        {
+            m_sleeping.fetch_sub( 1, std::memory_order_relaxed );
+            continue;
+        }
+        m_cvWork.wait( lock, [this]{ return m_wakeups != 0 || m_exit.load( std::memory_order_acquire ); } );
         if( m_exit.load( std::memory_order_acquire ) ) return;
-        auto f = m_queue.back();
-        m_queue.pop_back();
-        m_jobs++;
-        lock.unlock();
-        f();
-        lock.lock();
-        m_jobs--;
-        if( m_jobs == 0 && m_queue.empty() ) m_cvJobs.notify_one();
-        lock.unlock();
+        m_wakeups--;
+        searching = true;
     }
 }
 
+void TaskDispatch::WakeWorker()
+{
+    // The woken worker is counted as searching from the moment it is claimed, so that
+    // producers don't wake more workers while it is getting scheduled.
+    if( m_sleeping.load() == 0 ) return;
+    std::lock_guard<std::mutex> lock( m_sleepLock );
+    if( m_sleeping.load( std::memory_order_relaxed ) == 0 ) return;
+    m_sleeping.fetch_sub( 1, std::memory_order_relaxed );
+    m_searching.fetch_add( 1 );
+    m_wakeups++;
+    m_cvWork.notify_one();
+}
+
+bool TaskDispatch::HasQueued() const
+{
+    for( size_t i=0; i<m_numQueues; i++ )
+    {
+        for( auto& v : m_queues[i].count )
+        {
+            if( v.load() != 0 ) return true;
+        }
+    }
+    return false;
+}
+
+void TaskDispatch::TaskRing::Grow()
+{
+    const auto capacity = m_capacity == 0 ? 64 : m_capacity * 2;
+    auto buf = std::make_unique<Task[]>( capacity );
+    for( size_t i=0; i<size(); i++ ) buf[i] = std::move( m_buf[( m_head + i ) & ( m_capacity - 1 )] );
+    m_tail = size();
+    m_head = 0;
+    m_buf = std::move( buf );
+    m_capacity = capacity;
+}
+
 void TaskDispatch::SetName( const char* name, size_t num )
 {
     char tmp[128];
@@ -85,4 +228,63 @@ void TaskDispatch::SetName( const char* name, size_t num )
     SetThreadName( tmp );
 }
 
+TaskGroup::TaskGroup( TaskDispatch& td, TaskDispatch::Priority priority )
+    : m_td( td )
+    , m_priority( priority )
+    , m_generation( 0 )
+    , m_pending( 0 )
+    , m_running( 0 )
+    , m_queued( 0 )
+    , m_cancel( false )
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    Cancel();
+    std::unique_lock<std::mutex> lock( m_lock );
+    m_cv.wait( lock, [this]{ return m_queued == 0; } );
+}
+
+void TaskGroup::Queue( Task&& f, TaskDispatch::Priority priority )
+{
+    m_lock.lock();
+    const auto generation = m_generation;
+    m_pending++;
+    m_queued++;
+    m_lock.unlock();
+    m_td.Queue( [this, generation, f = std::move( f )] () mutable { Run( f, generation ); }, priority );
+}
+
+void TaskGroup::Sync()
+{
+    std::unique_lock<std::mutex> lock( m_lock );
+    m_cv.wait( lock, [this]{ return m_pending == 0; } );
+    m_cancel.store( false, std::memory_order_relaxed );
+}
+
+void TaskGroup::Cancel()
+{
+    std::lock_guard<std::mutex> lock( m_lock );
+    m_cancel.store( true, std::memory_order_relaxed );
+    m_generation++;
+    m_pending = m_running;
+}
+
+void TaskGroup::Run( Task& f, uint64_t generation )
+{
+    std::unique_lock<std::mutex> lock( m_lock );
+    if( generation == m_generation )
+    {
+        m_running++;
+        lock.unlock();
+        f();
+        lock.lock();
+        m_running--;
+        m_pending--;
+    }
+    m_queued--;
+    if( m_pending == 0 || m_queued == 0 ) m_cv.notify_all();
+}
+
 }
@@ -2,39 +2,268 @@
 #define __TRACYTASKDISPATCH_HPP__
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <functional>
+#include <cstddef>
+#include <memory>
 #include <mutex>
+#include <string.h>
+#include <new>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace tracy
 {
 
+// Move-only callable wrapper. Small closures are stored inline, without heap allocation.
+// Trivially copyable closures are moved with a plain copy of the storage.
+class Task
+{
+    enum { BufSize = 48 };
+
+    struct Ops
+    {
+        void (*invoke)( void* );
+        void (*move)( void* dst, void* src );
+        void (*destroy)( void* );
+    };
+
+    template<typename F>
+    static constexpr bool IsInline = sizeof( F ) <= BufSize && alignof( F ) <= alignof( std::max_align_t ) && std::is_nothrow_move_constructible_v<F>;
+
+    template<typename F>
+    static constexpr bool IsTrivial = std::is_trivially_copyable_v<F> && std::is_trivially_destructible_v<F>;
+
+    template<typename F>
+    struct InlineOps
+    {
+        static void Invoke( void* p ) { (*(F*)p)(); }
+        static void Move( void* dst, void* src ) { new( dst ) F( std::move( *(F*)src ) ); ((F*)src)->~F(); }
+        static void Destroy( void* p ) { ((F*)p)->~F(); }
+        static constexpr Ops ops = { Invoke, IsTrivial<F> ? nullptr : Move, IsTrivial<F> ? nullptr : Destroy };
+    };
+
+    template<typename F>
+    struct HeapOps
+    {
+        static void Invoke( void* p ) { (**(F**)p)(); }
+        static void Move( void* dst, void* src ) { *(F**)dst = *(F**)src; }
+        static void Destroy( void* p ) { delete *(F**)p; }
+        static constexpr Ops ops = { Invoke, Move, Destroy };
+    };
+
+public:
+    Task() : m_ops( nullptr ) {}
+
+    template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task( F&& f )
+    {
+        using T = std::decay_t<F>;
+        if constexpr( IsInline<T> )
+        {
+            new( m_buf ) T( std::forward<F>( f ) );
+            m_ops = &InlineOps<T>::ops;
+        }
+        else
+        {
+            *(T**)m_buf = new T( std::forward<F>( f ) );
+            m_ops = &HeapOps<T>::ops;
+        }
+    }
+
+    Task( Task&& other ) noexcept : m_ops( other.m_ops )
+    {
+        if( m_ops )
+        {
+            MoveFrom( other );
+            other.m_ops = nullptr;
+        }
+    }
+
+    Task& operator=( Task&& other ) noexcept
+    {
+        if( this != &other )
+        {
+            Destroy();
+            m_ops = other.m_ops;
+            if( m_ops )
+            {
+                MoveFrom( other );
+                other.m_ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task( const Task& ) = delete;
+    Task& operator=( const Task& ) = delete;
+
+    ~Task() { Destroy(); }
+
+    explicit operator bool() const { return m_ops != nullptr; }
+    void operator()() { m_ops->invoke( m_buf ); }
+
+private:
+    void MoveFrom( Task& other )
+    {
+        if( m_ops->move ) m_ops->move( m_buf, other.m_buf );
+        else memcpy( m_buf, other.m_buf, BufSize );
+    }
+
+    void Destroy()
+    {
+        if( m_ops && m_ops->destroy ) m_ops->destroy( m_buf );
+    }
+
+    alignas( std::max_align_t ) char m_buf[BufSize];
+    const Ops* m_ops;
+};
+
 class TaskDispatch
 {
 public:
+    enum class Priority
+    {
+        High,
+        Normal,
+        Low,
+        NumPriorities
+    };
+
     TaskDispatch( size_t workers, const char* name );
     ~TaskDispatch();
 
-    void Queue( const std::function<void(void)>& f );
-    void Queue( std::function<void(void)>&& f );
+    // Priorities are global: a thread looking for work takes the highest priority task queued
+    // on any of the workers, so lower priority tasks only run when no higher priority task is
+    // waiting. Tasks which are already running are not preempted.
+    void Queue( Task&& f, Priority priority = Priority::Normal );
 
+    // Blocks until all queued tasks are done. The calling thread executes tasks too.
     void Sync();
 
+    // Drops tasks which haven't started yet. Running tasks may poll IsCancelled() to
+    // return early. The cancelled state is cleared by the next Sync().
+    void Cancel();
+    bool IsCancelled() const { return m_cancel.load( std::memory_order_relaxed ); }
+
 private:
-    void Worker();
+    enum { NumPriorities = (int)Priority::NumPriorities };
+
+    // Ring buffer of tasks. The owner takes newest tasks from the back, thieves take oldest
+    // tasks from the front. Consumed slots are reused, so the buffer only grows to the largest
+    // number of tasks waiting at once.
+    class TaskRing
+    {
+    public:
+        bool empty() const { return m_head == m_tail; }
+        size_t size() const { return m_tail - m_head; }
+
+        void push_back( Task&& task )
+        {
+            if( size() == m_capacity ) Grow();
+            m_buf[m_tail++ & ( m_capacity - 1 )] = std::move( task );
+        }
+        void pop_back( Task& task ) { task = std::move( m_buf[--m_tail & ( m_capacity - 1 )] ); }
+        void pop_front( Task& task ) { task = std::move( m_buf[m_head++ & ( m_capacity - 1 )] ); }
+        void clear() { while( !empty() ) m_buf[m_head++ & ( m_capacity - 1 )] = Task(); }
+
+    private:
+        void Grow();
+
+        std::unique_ptr<Task[]> m_buf;
+        size_t m_capacity = 0;
+        size_t m_head = 0;
+        size_t m_tail = 0;
+    };
+
+    // The counts mirror the list sizes. They are written with the lock held, but may be read
+    // without it, so that GetTask() skips empty queues without locking them.
+    struct alignas(64) WorkQueue
+    {
+        std::mutex lock;
+        std::atomic<size_t> count[NumPriorities];
+        TaskRing list[NumPriorities];
+    };
+
+    void Worker( size_t idx );
+    bool GetTask( size_t idx, Task& task );
+    void Execute( Task& task );
     void SetName( const char* name, size_t num );
+    bool HasQueued() const;
+    void WakeWorker();
 
-    std::vector<std::function<void(void)>> m_queue;
-    std::mutex m_queueLock;
-    std::condition_variable m_cvWork, m_cvJobs;
+    std::unique_ptr<WorkQueue[]> m_queues;
+    size_t m_numQueues;
+    std::atomic<size_t> m_next;
+
+    std::atomic<size_t> m_pending;
+    std::atomic<size_t> m_sleeping;
+    std::atomic<size_t> m_searching;
     std::atomic<bool> m_exit;
-    size_t m_jobs;
+    std::atomic<bool> m_cancel;
+
+    std::mutex m_sleepLock;
+    std::condition_variable m_cvWork;
+    size_t m_wakeups;
+    std::mutex m_syncLock;
+    std::condition_variable m_cvJobs;
 
     std::vector<std::thread> m_workers;
 };
 
+// Tasks of one client of a shared TaskDispatch, which can be waited for and cancelled without
+// affecting the tasks of other groups. Cancelled tasks are skipped when they are dequeued, so
+// the group waits for them when it is destroyed and must not outlive the dispatch. The
+// dispatch needs at least one worker, as Sync() doesn't execute tasks.
+class TaskGroup
+{
+public:
+    explicit TaskGroup( TaskDispatch& td, TaskDispatch::Priority priority = TaskDispatch::Priority::Normal );
+    ~TaskGroup();
+
+    void Queue( Task&& f ) { Queue( std::move( f ), m_priority ); }
+    void Queue( Task&& f, TaskDispatch::Priority priority );
+
+    // Blocks until all tasks of the group are done.
+    void Sync();
+
+    // Drops tasks of the group which haven't started yet. Running tasks may poll IsCancelled()
+    // to return early. The cancelled state is cleared by the next Sync().
+    void Cancel();
+    bool IsCancelled() const { return m_cancel.load( std::memory_order_relaxed ); }
+
+    // Takes a lock which another thread may hold for long, such as the worker data lock held by
+    // the UI thread. Returns false, without the lock taken, if the group is cancelled meanwhile.
+    template<typename L>
+    bool Lock( L& lock ) const
+    {
+        while( !lock.try_lock() )
+        {
+            if( IsCancelled() ) return false;
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        }
+        return true;
+    }
+
+private:
+    void Run( Task& f, uint64_t generation );
+
+    TaskDispatch& m_td;
+    TaskDispatch::Priority m_priority;
+
+    // Cancel() starts a new generation, tasks of older generations are not started. Pending
+    // counts the tasks Sync() waits for, queued the ones the dispatch still holds.
+    std::mutex m_lock;
+    std::condition_variable m_cv;
+    uint64_t m_generation;
+    size_t m_pending;
+    size_t m_running;
+    size_t m_queued;
+    std::atomic<bool> m_cancel;
+};
+
 }
 
 #endif
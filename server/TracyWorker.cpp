@@ -37,6 +37,7 @@
 #include "TracySort.hpp"
 #include "TracyTaskDispatch.hpp"
 #include "TracyWorker.hpp"
+#include "TracyZoneTree.hpp"
 
 namespace tracy
 {
@@ -63,6 +64,17 @@ enum { FileHeaderMagic = 5 };
 static const int CurrentVersion = FileVersion( Version::Major, Version::Minor, Version::Patch );
 static const int MinSupportedVersion = FileVersion( 0, 9, 0 );
 
+// Optional trailing section with precomputed statistics. Older readers stop before it.
+static const uint8_t StatisticsCacheHeader[8] { 't', 'r', 's', 't', 'a', 't', 's', 3 };
+
+#ifndef TRACY_NO_STATISTICS
+struct ZoneListRef
+{
+    uint32_t list;
+    uint32_t pos;
+};
+#endif
+
 
 static void UpdateLockCountLockable( LockMap& lockmap, size_t pos )
 {
@@ -213,7 +225,8 @@ static inline void UpdateLockCount( LockMap& lockmap, size_t pos )
     }
 }
 
-static tracy_force_inline void WriteTimeOffset( FileWrite& f, int64_t& refTime, int64_t time )
+template<typename W>
+static tracy_force_inline void WriteTimeOffset( W& f, int64_t& refTime, int64_t time )
 {
     int64_t timeOffset = time - refTime;
     refTime += timeOffset;
@@ -304,7 +317,7 @@ Worker::Worker( const char* addr, uint16_t port, int64_t memoryLimit )
     m_threadNet = std::thread( [this] { SetThreadName( "Tracy Network" ); Network(); } );
 }
 
-Worker::Worker( const char* name, const char* program, const std::vector<ImportEventTimeline>& timeline, const std::vector<ImportEventMessages>& messages, const std::vector<ImportEventPlots>& plots, const std::unordered_map<uint64_t, std::string>& threadNames )
+Worker::Worker( const char* name, const char* program )
     : m_hasData( true )
     , m_delay( 0 )
     , m_resolution( 0 )
@@ -328,113 +341,137 @@ Worker::Worker( const char* name, const char* program, const std::vector<ImportE
     m_data.symbolLocInline.push_back( std::numeric_limits<uint64_t>::max() );
     m_data.memory = m_slab.AllocInit<MemData>();
     m_data.memNameMap.emplace( 0, m_data.memory );
-
     m_data.lastTime = 0;
-    if( !timeline.empty() )
-    {
-        m_data.lastTime = timeline.back().timestamp;
-    }
-    if( !messages.empty() )
-    {
-        if( m_data.lastTime < (int64_t)messages.back().timestamp ) m_data.lastTime = messages.back().timestamp;
-    }
-    if( !plots.empty() )
-    {
-        for( auto& v : plots )
-        {
-            if( m_data.lastTime < v.data.back().first ) m_data.lastTime = v.data.back().first;
-        }
-    }
 
+    // The default frame set has to be the first one, the loader expects it there.
+    m_data.framesBase = m_data.frames.Retrieve( 0, [this] ( uint64_t name ) {
+        auto fd = m_slab.AllocInit<FrameData>();
+        fd->name = name;
+        fd->continuous = 1;
+        return fd;
+    }, [this] ( uint64_t name ) {
+        assert( name == 0 );
+        char tmp[6] = "Frame";
+        HandleFrameName( name, tmp, 5 );
+    } );
+}
+
+Worker::Worker( const char* name, const char* program, const std::vector<ImportEventTimeline>& timeline, const std::vector<ImportEventMessages>& messages, const std::vector<ImportEventPlots>& plots, const std::unordered_map<uint64_t, std::string>& threadNames )
+    : Worker( name, program )
+{
     for( auto& v : timeline )
     {
         if( !v.isEnd )
         {
-            SourceLocation srcloc {{
-                StringRef(),
-                StringRef( StringRef::Idx, StoreString( v.name.c_str(), v.name.size() ).idx ),
-                StringRef( StringRef::Idx, StoreString( v.locFile.c_str(), v.locFile.size() ).idx ),
-                v.locLine,
-                0
-            }};
-            int key;
-            auto it = m_data.sourceLocationPayloadMap.find( &srcloc );
-            if( it == m_data.sourceLocationPayloadMap.end() )
-            {
-                auto slptr = m_slab.Alloc<SourceLocation>();
-                memcpy( slptr, &srcloc, sizeof( srcloc ) );
-                uint32_t idx = m_data.sourceLocationPayload.size();
-                m_data.sourceLocationPayloadMap.emplace( slptr, idx );
-                m_data.sourceLocationPayload.push_back( slptr );
-                key = -int16_t( idx + 1 );
-#ifndef TRACY_NO_STATISTICS
-                auto res = m_data.sourceLocationZones.emplace( key, SourceLocationZones() );
-                m_data.srclocZonesLast.first = key;
-                m_data.srclocZonesLast.second = &res.first->second;
+            const auto srcloc = ImportSourceLocation( StoreString( v.name.c_str(), v.name.size() ).idx, StoreString( v.locFile.c_str(), v.locFile.size() ).idx, v.locLine );
+            StringIdx text;
+            if( !v.text.empty() ) text.SetIdx( StoreString( v.text.c_str(), v.text.size() ).idx );
+            ImportZoneBegin( v.tid, v.timestamp, srcloc, text );
+        }
+        else
+        {
+            ImportZoneEnd( v.tid, v.timestamp );
+        }
+    }
+    ImportMessages( messages );
+    ImportPlots( plots );
+    ImportFinish( threadNames );
+}
 
+int32_t Worker::ImportSourceLocation( uint32_t name, uint32_t file, uint32_t line )
+{
+    SourceLocation srcloc {{
+        StringRef(),
+        StringRef( StringRef::Idx, name ),
+        StringRef( StringRef::Idx, file ),
+        line,
+        0
+    }};
+    auto it = m_data.sourceLocationPayloadMap.find( &srcloc );
+    if( it != m_data.sourceLocationPayloadMap.end() ) return -int32_t( it->second + 1 );
+
+    auto slptr = m_slab.Alloc<SourceLocation>();
+    memcpy( slptr, &srcloc, sizeof( srcloc ) );
+    uint32_t idx = m_data.sourceLocationPayload.size();
+    m_data.sourceLocationPayloadMap.emplace( slptr, idx );
+    m_data.sourceLocationPayload.push_back( slptr );
+    const auto key = -int32_t( idx + 1 );
+#ifndef TRACY_NO_STATISTICS
+    auto res = m_data.sourceLocationZones.emplace( key, SourceLocationZones() );
+    m_data.srclocZonesLast.first = key;
+    m_data.srclocZonesLast.second = &res.first->second;
 #else
-                auto res = m_data.sourceLocationZonesCnt.emplace( key, 0 );
-                m_data.srclocCntLast.first = key;
-                m_data.srclocCntLast.second = &res.first->second;
+    auto res = m_data.sourceLocationZonesCnt.emplace( key, 0 );
+    m_data.srclocCntLast.first = key;
+    m_data.srclocCntLast.second = &res.first->second;
 #endif
-            }
-            else
-            {
-                key = -int16_t( it->second + 1 );
-            }
+    return key;
+}
 
-            auto zone = AllocZoneEvent();
-            zone->SetStartSrcLoc( v.timestamp, key );
-            zone->SetEnd( -1 );
-            zone->SetChild( -1 );
+void Worker::ImportZoneBegin( uint64_t tid, int64_t time, int32_t srcloc, StringIdx text )
+{
+    if( m_data.lastTime < time ) m_data.lastTime = time;
 
-            if( !v.text.empty() )
-            {
-                auto& extra = RequestZoneExtra( *zone );
-                extra.text = StringIdx( StoreString( v.text.c_str(), v.text.size() ).idx );
-            }
+    auto zone = AllocZoneEvent();
+    SetZoneStartSrcLoc( *zone, time, srcloc );
+    zone->SetEnd( -1 );
+    zone->SetChild( -1 );
 
-            if( m_threadCtx != v.tid )
-            {
-                m_threadCtx = v.tid;
-                m_threadCtxData = NoticeThread( v.tid );
-            }
-            NewZone( zone );
-        }
-        else
-        {
-            auto td = NoticeThread( v.tid );
-            if( td->zoneIdStack.empty() ) continue;
-            td->zoneIdStack.pop_back();
-            auto& stack = td->stack;
-            auto zone = stack.back_and_pop();
-            td->DecStackCount( zone->SrcLoc() );
-            zone->SetEnd( v.timestamp );
+    if( text.Active() )
+    {
+        auto& extra = RequestZoneExtra( *zone );
+        extra.text = text;
+    }
+
+    if( m_threadCtx != tid )
+    {
+        m_threadCtx = tid;
+        m_threadCtxData = NoticeThread( tid );
+    }
+    NewZone( zone );
+}
+
+void Worker::ImportZoneEnd( uint64_t tid, int64_t time )
+{
+    if( m_data.lastTime < time ) m_data.lastTime = time;
+
+    auto td = NoticeThread( tid );
+    if( td->zoneIdStack.empty() ) return;
+    td->zoneIdStack.pop_back();
+    auto& stack = td->stack;
+    auto zone = stack.back_and_pop();
+    td->DecStackCount( GetZoneSrcLoc( *zone ) );
+    zone->SetEnd( time );
 
 #ifndef TRACY_NO_STATISTICS
-            ZoneThreadData ztd;
-            ztd.SetZone( zone );
-            ztd.SetThread( CompressThread( v.tid ) );
-            auto slz = GetSourceLocationZones( zone->SrcLoc() );
-            slz->zones.push_back( ztd );
+    ZoneThreadData ztd;
+    ztd.SetZone( zone );
+    ztd.SetThread( CompressThread( tid ) );
+    auto slz = GetSourceLocationZones( GetZoneSrcLoc( *zone ) );
+    slz->zones.push_back( ztd );
 #else
-            CountZoneStatistics( zone );
+    CountZoneStatistics( zone );
 #endif
-        }
-    }
+}
 
+void Worker::ImportMessages( const std::vector<ImportEventMessages>& messages, bool frameMessages )
+{
     std::unordered_map<std::string, uint64_t> frameNames;
 
     for( auto& v : messages )
     {
+        if( m_data.lastTime < (int64_t)v.timestamp ) m_data.lastTime = v.timestamp;
+
         // There is no specific chrome-tracing type for frame events. We use messages that contain the word "frame"
         std::string lower( v.message );
         std::transform( lower.begin(), lower.end(), lower.begin(), []( char c ) { return char( std::tolower( c ) ); } );
-        if( lower.find( "frame" ) != std::string::npos )
+        if( frameMessages && lower.find( "frame" ) != std::string::npos )
         {
             // Reserve 0 as the default FrameSet, since it replaces the name with "Frame" and we want to keep our custom names.
-            auto result = frameNames.emplace( v.message, frameNames.size() + 1 );
-            auto fd = m_data.frames.Retrieve( result.first->second, [&] ( uint64_t name ) {
+            // Only messages which are exactly "Frame" go there.
+            uint64_t frameName = 0;
+            if( v.message != "Frame" ) frameName = frameNames.emplace( v.message, frameNames.size() + 1 ).first->second;
+            auto fd = m_data.frames.Retrieve( frameName, [&] ( uint64_t name ) {
                 auto fd = m_slab.AllocInit<FrameData>();
                 fd->name = name;
                 fd->continuous = 1;
@@ -464,7 +501,38 @@ Worker::Worker( const char* name, const char* program, const std::vector<ImportE
             InsertMessageData( msg );
         }
     }
+}
+
+void Worker::ImportFrames( const std::vector<ImportEventFrames>& frames )
+{
+    for( auto& v : frames )
+    {
+        // Named frame sets are keyed by the stored name, which is unique for each string.
+        uint64_t frameName = 0;
+        if( !v.name.empty() ) frameName = uint64_t( StoreString( v.name.c_str(), v.name.size() ).ptr );
+        auto fd = m_data.frames.Retrieve( frameName, [&] ( uint64_t name ) {
+            auto fd = m_slab.AllocInit<FrameData>();
+            fd->name = name;
+            fd->continuous = v.continuous;
+            return fd;
+        }, [&] ( uint64_t name ) {
+            HandleFrameName( name, v.name.c_str(), v.name.size() );
+        } );
+        assert( fd->frames.empty() || v.frames.empty() || fd->frames.back().start <= v.frames.front().first );
+        fd->continuous = v.continuous;
+
+        fd->frames.reserve( fd->frames.size() + v.frames.size() );
+        for( auto& f : v.frames )
+        {
+            fd->frames.push_back( FrameEvent{ f.first, v.continuous ? -1 : f.second, -1 } );
+            const auto time = v.continuous ? f.first : f.second;
+            if( m_data.lastTime < time ) m_data.lastTime = time;
+        }
+    }
+}
 
+void Worker::ImportPlots( const std::vector<ImportEventPlots>& plots )
+{
     for( auto& v : plots )
     {
         uint64_t nptr = (uint64_t)&v.name;
@@ -500,10 +568,15 @@ Worker::Worker( const char* name, const char* program, const std::vector<ImportE
         plot->min = min;
         plot->max = max;
         plot->sum = sum;
+        plot->lod.Update( plot->data.data(), plot->data.size() );
+        if( m_data.lastTime < v.data.back().first ) m_data.lastTime = v.data.back().first;
 
         m_data.plots.Data().push_back( plot );
     }
+}
 
+void Worker::ImportFinish( const std::unordered_map<uint64_t, std::string>& threadNames )
+{
     for( auto& t : m_threadMap )
     {
         auto name = threadNames.find(t.first);
@@ -537,20 +610,9 @@ Worker::Worker( const char* name, const char* program, const std::vector<ImportE
         }
     }
 
-    // Add a default frame if we didn't have any framesets
-    if( frameNames.empty() )
+    // Add a default frame if we didn't have any frames in the default frameset
+    if( m_data.framesBase->frames.empty() )
     {
-        m_data.framesBase = m_data.frames.Retrieve( 0, [this] ( uint64_t name ) {
-            auto fd = m_slab.AllocInit<FrameData>();
-            fd->name = name;
-            fd->continuous = 1;
-            return fd;
-        }, [this] ( uint64_t name ) {
-            assert( name == 0 );
-            char tmp[6] = "Frame";
-            HandleFrameName( name, tmp, 5 );
-        } );
-
         m_data.framesBase->frames.push_back( FrameEvent{ 0, -1, -1 } );
         m_data.framesBase->frames.push_back( FrameEvent{ 0, -1, -1 } );
     }
@@ -803,7 +865,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
     const auto sle = sz;
 
     f.Read( sz );
-    if( sz > std::numeric_limits<int16_t>::max() )
+    if( sz > std::numeric_limits<int32_t>::max() )
     {
         s_loadProgress.total.store( 0, std::memory_order_relaxed );
         char buf[256];
@@ -817,7 +879,38 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         f.Read( srcloc, sizeof( SourceLocationBase ) );
         srcloc->namehash = 0;
         m_data.sourceLocationPayload[i] = srcloc;
-        m_data.sourceLocationPayloadMap.emplace( srcloc, int16_t( i ) );
+        m_data.sourceLocationPayloadMap.emplace( srcloc, uint32_t( i ) );
+    }
+
+    // Traces which don't fit in the compact source location range carry the wide zone
+    // source locations, and store source location ids in 32 bits.
+    const bool wideSrcLoc = sz > std::numeric_limits<int16_t>::max();
+    auto ReadSrcLocId = [&f, wideSrcLoc] {
+        if( wideSrcLoc )
+        {
+            int32_t id;
+            f.Read( id );
+            return id;
+        }
+        else
+        {
+            int16_t id;
+            f.Read( id );
+            return int32_t( id );
+        }
+    };
+    if( wideSrcLoc )
+    {
+        uint64_t wsz;
+        f.Read( wsz );
+        m_data.zoneWideSrcLoc.reserve( wsz );
+        for( uint64_t i=0; i<wsz; i++ )
+        {
+            uint32_t extra;
+            int32_t srcloc;
+            f.Read2( extra, srcloc );
+            m_data.zoneWideSrcLoc.emplace( extra, srcloc );
+        }
     }
 
 #ifndef TRACY_NO_STATISTICS
@@ -826,9 +919,9 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
     f.Read( sz );
     for( uint64_t i=0; i<sz; i++ )
     {
-        int16_t id;
+        const auto id = ReadSrcLocId();
         uint64_t cnt;
-        f.Read2( id, cnt );
+        f.Read( cnt );
         auto status = m_data.sourceLocationZones.emplace( id, SourceLocationZones() );
         assert( status.second );
         status.first->second.zones.reserve( cnt );
@@ -848,8 +941,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
     f.Read( sz );
     for( uint64_t i=0; i<sz; i++ )
     {
-        int16_t id;
-        f.Read( id );
+        const auto id = ReadSrcLocId();
         f.Skip( sizeof( uint64_t ) );
         m_data.sourceLocationZonesCnt.emplace( id, 0 );
     }
@@ -1116,6 +1208,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                 ptr->time = refTime;
                 ptr++;
             }
+            pd->lod.Update( pd->data.data(), psz );
             m_data.plots.Data().push_back_no_space_check( pd );
         }
     }
@@ -1611,6 +1704,10 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         }
     }
 
+#ifndef TRACY_NO_STATISTICS
+    if( bgTasks && !f.IsEOF() ) ReadStatisticsCache( f );
+#endif
+
     s_loadProgress.total.store( 0, std::memory_order_relaxed );
     m_loadTime = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - loadStart ).count();
 
@@ -1625,7 +1722,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         m_threadBackground = std::thread( [this, eventMask] {
             std::vector<std::thread> jobs;
 
-            if( !m_data.ctxSwitch.empty() && m_data.cpuDataCount != 0 )
+            if( !m_data.ctxUsageReady && !m_data.ctxSwitch.empty() && m_data.cpuDataCount != 0 )
             {
                 jobs.emplace_back( std::thread( [this] { ReconstructContextSwitchUsage(); } ) );
             }
@@ -1635,8 +1732,8 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                 if( mem.second->reconstruct ) jobs.emplace_back( std::thread( [this, mem = mem.second] { ReconstructMemAllocPlot( *mem ); } ) );
             }
 
-            std::function<void(uint8_t*, Vector<short_ptr<ZoneEvent>>&, uint16_t)> ProcessTimeline;
-            ProcessTimeline = [this, &ProcessTimeline] ( uint8_t* countMap, Vector<short_ptr<ZoneEvent>>& _vec, uint16_t thread )
+            std::function<void(ZoneStackCount&, Vector<short_ptr<ZoneEvent>>&, uint16_t)> ProcessTimeline;
+            ProcessTimeline = [this, &ProcessTimeline] ( ZoneStackCount& countMap, Vector<short_ptr<ZoneEvent>>& _vec, uint16_t thread )
             {
                 if( m_shutdown.load( std::memory_order_relaxed ) ) return;
                 assert( _vec.is_magic() );
@@ -1646,24 +1743,33 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                     if( zone.IsEndValid() ) ReconstructZoneStatistics( countMap, zone, thread );
                     if( zone.HasChildren() )
                     {
-                        countMap[uint16_t(zone.SrcLoc())]++;
+                        const auto srcloc = GetZoneSrcLoc( zone );
+                        countMap[srcloc]++;
                         ProcessTimeline( countMap, GetZoneChildrenMutable( zone.Child() ), thread );
-                        countMap[uint16_t(zone.SrcLoc())]--;
+                        countMap[srcloc]--;
                     }
                 }
             };
 
             jobs.emplace_back( std::thread( [this, ProcessTimeline] {
-                for( auto& t : m_data.threads )
+                if( !m_statisticsCached )
                 {
-                    if( m_shutdown.load( std::memory_order_relaxed ) ) return;
-                    if( !t->timeline.empty() )
+                    auto countMap = std::make_unique<ZoneStackCount>();
+                    for( auto& t : m_data.threads )
                     {
-                        uint8_t countMap[64*1024];
-                        // Don't touch thread compression cache in a thread.
-                        ProcessTimeline( countMap, t->timeline, m_data.localThreadCompress.DecompressMustRaw( t->id ) );
+                        if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+                        if( !t->timeline.empty() )
+                        {
+                            // Don't touch thread compression cache in a thread.
+                            ProcessTimeline( *countMap, t->timeline, m_data.localThreadCompress.DecompressMustRaw( t->id ) );
+                        }
                     }
                 }
+                for( auto& v : m_data.sourceLocationZones )
+                {
+                    if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+                    UpdateZoneTimeIndex( v.second );
+                }
                 std::lock_guard<std::mutex> lock( m_data.lock );
                 m_data.sourceLocationZonesReady = true;
             } ) );
@@ -2427,7 +2533,7 @@ bool Worker::IsThreadFiber( uint64_t id )
     return td && ( td->isFiber );
 }
 
-const SourceLocation& Worker::GetSourceLocation( int16_t srcloc ) const
+const SourceLocation& Worker::GetSourceLocation( int32_t srcloc ) const
 {
     if( srcloc < 0 )
     {
@@ -2441,6 +2547,28 @@ const SourceLocation& Worker::GetSourceLocation( int16_t srcloc ) const
     }
 }
 
+int32_t Worker::GetZoneSrcLocWide( const ZoneEvent& zone ) const
+{
+    assert( zone.extra != 0 );
+    auto it = m_data.zoneWideSrcLoc.find( zone.extra );
+    assert( it != m_data.zoneWideSrcLoc.end() );
+    return it->second;
+}
+
+void Worker::SetZoneStartSrcLoc( ZoneEvent& zone, int64_t start, int32_t srcloc )
+{
+    if( IsSrcLocCompact( srcloc ) )
+    {
+        zone.SetStartSrcLoc( start, srcloc );
+    }
+    else
+    {
+        zone.SetStartSrcLoc( start, SrcLocWide );
+        if( zone.extra == 0 ) AllocZoneExtra( zone );
+        m_data.zoneWideSrcLoc[zone.extra] = srcloc;
+    }
+}
+
 std::pair<const char*, const char*> Worker::GetExternalName( uint64_t id ) const
 {
     const auto it = m_data.externalNames.find( id );
@@ -2468,7 +2596,7 @@ const char* Worker::GetZoneName( const SourceLocation& srcloc ) const
 
 const char* Worker::GetZoneName( const ZoneEvent& ev ) const
 {
-    auto& srcloc = GetSourceLocation( ev.SrcLoc() );
+    auto& srcloc = GetSourceLocation( GetZoneSrcLoc( ev ) );
     return GetZoneName( ev, srcloc );
 }
 
@@ -2513,9 +2641,9 @@ static bool strstr_nocase( const char* l, const char* r )
     return strstr( ll, rl ) != nullptr;
 }
 
-std::vector<int16_t> Worker::GetMatchingSourceLocation( const char* query, bool ignoreCase ) const
+std::vector<int32_t> Worker::GetMatchingSourceLocation( const char* query, bool ignoreCase ) const
 {
-    std::vector<int16_t> match;
+    std::vector<int32_t> match;
 
     const auto sz = m_data.sourceLocationExpand.size();
     for( size_t i=1; i<sz; i++ )
@@ -2535,7 +2663,7 @@ std::vector<int16_t> Worker::GetMatchingSourceLocation( const char* query, bool
         }
         if( found )
         {
-            match.push_back( (int16_t)i );
+            match.push_back( (int32_t)i );
         }
     }
 
@@ -2555,7 +2683,7 @@ std::vector<int16_t> Worker::GetMatchingSourceLocation( const char* query, bool
         {
             auto it = m_data.sourceLocationPayloadMap.find( (const SourceLocation*)srcloc );
             assert( it != m_data.sourceLocationPayloadMap.end() );
-            match.push_back( -int16_t( it->second + 1 ) );
+            match.push_back( -int32_t( it->second + 1 ) );
         }
     }
 
@@ -2563,7 +2691,7 @@ std::vector<int16_t> Worker::GetMatchingSourceLocation( const char* query, bool
 }
 
 #ifndef TRACY_NO_STATISTICS
-Worker::SourceLocationZones& Worker::GetZonesForSourceLocation( int16_t srcloc )
+Worker::SourceLocationZones& Worker::GetZonesForSourceLocation( int32_t srcloc )
 {
     assert( AreSourceLocationZonesReady() );
     static SourceLocationZones empty;
@@ -2571,7 +2699,7 @@ Worker::SourceLocationZones& Worker::GetZonesForSourceLocation( int16_t srcloc )
     return it != m_data.sourceLocationZones.end() ? it->second : empty;
 }
 
-const Worker::SourceLocationZones& Worker::GetZonesForSourceLocation( int16_t srcloc ) const
+const Worker::SourceLocationZones& Worker::GetZonesForSourceLocation( int32_t srcloc ) const
 {
     assert( AreSourceLocationZonesReady() );
     static const SourceLocationZones empty;
@@ -2579,6 +2707,49 @@ const Worker::SourceLocationZones& Worker::GetZonesForSourceLocation( int16_t sr
     return it != m_data.sourceLocationZones.end() ? it->second : empty;
 }
 
+void Worker::UpdateZoneTimeIndex( SourceLocationZones& slz )
+{
+    auto& zones = slz.zones;
+    if( !zones.is_sorted() )
+    {
+        const auto indexed = slz.blockEnd.size() * ZoneIndexBlock;
+        if( indexed == 0 )
+        {
+            zones.sort();
+        }
+        else
+        {
+            // Zones added out of order invalidate the index from their sorted position onwards.
+            const auto last = zones[indexed-1].Zone()->Start();
+            auto first = std::numeric_limits<int64_t>::max();
+            for( size_t i=indexed; i<zones.size(); i++ ) first = std::min( first, zones[i].Zone()->Start() );
+            zones.sort();
+            if( first < last )
+            {
+                const auto pos = std::lower_bound( zones.begin(), zones.end(), first, [] ( const auto& l, const auto& r ) { return l.Zone()->Start() < r; } ) - zones.begin();
+                const auto blocks = pos / ZoneIndexBlock;
+                slz.blockEnd.set_size( blocks );
+                slz.superEnd.set_size( blocks / ZoneIndexBlock );
+            }
+        }
+    }
+
+    const auto zsz = zones.size();
+    for( size_t b = slz.blockEnd.size(); ( b+1 ) * ZoneIndexBlock <= zsz; b++ )
+    {
+        auto end = std::numeric_limits<int64_t>::min();
+        for( size_t i=b*ZoneIndexBlock; i<(b+1)*ZoneIndexBlock; i++ ) end = std::max( end, ZoneEndOrMax( *zones[i].Zone() ) );
+        slz.blockEnd.push_back( end );
+    }
+    const auto bsz = slz.blockEnd.size();
+    for( size_t b = slz.superEnd.size(); ( b+1 ) * ZoneIndexBlock <= bsz; b++ )
+    {
+        auto end = std::numeric_limits<int64_t>::min();
+        for( size_t i=b*ZoneIndexBlock; i<(b+1)*ZoneIndexBlock; i++ ) end = std::max( end, slz.blockEnd[i] );
+        slz.superEnd.push_back( end );
+    }
+}
+
 const SymbolStats* Worker::GetSymbolStats( uint64_t symAddr ) const
 {
     assert( AreCallstackSamplesReady() );
@@ -2908,7 +3079,7 @@ bool Worker::IsCallstackRetrieved( uint32_t callstack )
     return true;
 }
 
-bool Worker::IsSourceLocationRetrieved( int16_t srcloc )
+bool Worker::IsSourceLocationRetrieved( int32_t srcloc )
 {
     auto& sl = GetSourceLocation( srcloc );
     auto func = GetString( sl.function );
@@ -3392,7 +3563,7 @@ ThreadData* Worker::GetCurrentThreadData()
 }
 
 #ifndef TRACY_NO_STATISTICS
-Worker::SourceLocationZones* Worker::GetSourceLocationZonesReal( uint16_t srcloc )
+Worker::SourceLocationZones* Worker::GetSourceLocationZonesReal( int32_t srcloc )
 {
     auto it = m_data.sourceLocationZones.find( srcloc );
     assert( it != m_data.sourceLocationZones.end() );
@@ -3413,7 +3584,7 @@ Worker::GpuSourceLocationZones* Worker::GetGpuSourceLocationZonesReal( uint16_t
     return &it->second;
 }
 #else
-uint64_t* Worker::GetSourceLocationZonesCntReal( uint16_t srcloc )
+uint64_t* Worker::GetSourceLocationZonesCntReal( int32_t srcloc )
 {
     auto it = m_data.sourceLocationZonesCnt.find( srcloc );
     assert( it != m_data.sourceLocationZonesCnt.end() );
@@ -3477,7 +3648,7 @@ void Worker::NewZone( ZoneEvent* zone )
 
     auto td = GetCurrentThreadData();
     td->count++;
-    td->IncStackCount( zone->SrcLoc() );
+    td->IncStackCount( GetZoneSrcLoc( *zone ) );
     const auto ssz = td->stack.size();
     if( ssz == 0 )
     {
@@ -3661,19 +3832,19 @@ void Worker::AddSourceLocationPayload( const char* data, size_t sz )
         auto slptr = m_slab.Alloc<SourceLocation>();
         memcpy( slptr, &srcloc, sizeof( srcloc ) );
         uint32_t idx = m_data.sourceLocationPayload.size();
-        if( idx+1 > std::numeric_limits<int16_t>::max() )
+        if( idx+1 > uint32_t( std::numeric_limits<int32_t>::max() ) )
         {
             SourceLocationOverflowFailure();
             return;
         }
         m_data.sourceLocationPayloadMap.emplace( slptr, idx );
-        m_pendingSourceLocationPayload = -int16_t( idx + 1 );
+        m_pendingSourceLocationPayload = -int32_t( idx + 1 );
         m_data.sourceLocationPayload.push_back( slptr );
         if( m_checkedFileStrings.find( srcloc.file ) == m_checkedFileStrings.end() )
         {
             CacheSource( srcloc.file );
         }
-        const auto key = -int16_t( idx + 1 );
+        const auto key = -int32_t( idx + 1 );
 #ifndef TRACY_NO_STATISTICS
         auto res = m_data.sourceLocationZones.emplace( key, SourceLocationZones() );
         m_data.srclocZonesLast.first = key;
@@ -3686,7 +3857,7 @@ void Worker::AddSourceLocationPayload( const char* data, size_t sz )
     }
     else
     {
-        m_pendingSourceLocationPayload = -int16_t( it->second + 1 );
+        m_pendingSourceLocationPayload = -int32_t( it->second + 1 );
     }
 }
 
@@ -4097,6 +4268,8 @@ void Worker::InsertPlot( PlotData* plot, int64_t time, double val )
         plot->sum += val;
         plot->data.push_back( { Int48( time ), val } );
     }
+    // Out of order items are summarized once the plot is sorted.
+    if( plot->data.is_sorted() ) plot->lod.Update( plot->data.data(), plot->data.size() );
 }
 
 void Worker::HandlePlotName( uint64_t name, const char* str, size_t sz )
@@ -4158,7 +4331,7 @@ void Worker::DoPostponedWorkAll()
 
     for( auto& plot : m_data.plots.Data() )
     {
-        if( !plot->data.is_sorted() ) plot->data.sort();
+        plot->UpdateLod();
     }
 }
 
@@ -4730,7 +4903,7 @@ void Worker::ProcessZoneBeginAllocSrcLocImpl( ZoneEvent* zone, const QueueZoneBe
     assert( m_pendingSourceLocationPayload != 0 );
 
     const auto start = TscTime( RefTime( m_refTimeThread, ev.time ) );
-    zone->SetStartSrcLoc( start, m_pendingSourceLocationPayload );
+    SetZoneStartSrcLoc( *zone, start, m_pendingSourceLocationPayload );
     zone->SetEnd( -1 );
     zone->SetChild( -1 );
 
@@ -4816,7 +4989,7 @@ void Worker::ProcessZoneEnd( const QueueZoneEnd& ev )
     assert( !stack.empty() );
     auto zone = stack.back_and_pop();
     assert( zone->End() == -1 );
-    const auto isReentry = td->DecStackCount( zone->SrcLoc() );
+    const auto isReentry = td->DecStackCount( GetZoneSrcLoc( *zone ) );
     const auto timeEnd = TscTime( RefTime( m_refTimeThread, ev.time ) );
     zone->SetEnd( timeEnd );
     assert( timeEnd >= zone->Start() );
@@ -4860,7 +5033,7 @@ void Worker::ProcessZoneEnd( const QueueZoneEnd& ev )
         ztd.SetZone( zone );
         ztd.SetThread( ctid );
 
-        auto slz = GetSourceLocationZones( zone->SrcLoc() );
+        auto slz = GetSourceLocationZones( GetZoneSrcLoc( *zone ) );
         slz->zones.push_back( ztd );
         if( slz->min > timeSpan ) slz->min = timeSpan;
         if( slz->max < timeSpan ) slz->max = timeSpan;
@@ -4906,14 +5079,14 @@ void Worker::ZoneStackFailure( uint64_t thread, const ZoneEvent* ev )
 {
     m_failure = Failure::ZoneStack;
     m_failureData.thread = thread;
-    m_failureData.srcloc = ev->SrcLoc();
+    m_failureData.srcloc = GetZoneSrcLoc( *ev );
 }
 
 void Worker::ZoneDoubleEndFailure( uint64_t thread, const ZoneEvent* ev )
 {
     m_failure = Failure::ZoneDoubleEnd;
     m_failureData.thread = thread;
-    m_failureData.srcloc = ev ? ev->SrcLoc() : 0;
+    m_failureData.srcloc = ev ? GetZoneSrcLoc( *ev ) : 0;
 }
 
 void Worker::ZoneTextFailure( uint64_t thread, const char* text )
@@ -5667,6 +5840,11 @@ void Worker::ProcessGpuZoneBeginImpl( GpuEvent* zone, const QueueGpuZoneBegin& e
 void Worker::ProcessGpuZoneBeginAllocSrcLocImpl( GpuEvent* zone, const QueueGpuZoneBeginLean& ev, bool serial )
 {
     assert( m_pendingSourceLocationPayload != 0 );
+    if( !IsSrcLocCompact( m_pendingSourceLocationPayload ) )
+    {
+        SourceLocationOverflowFailure();
+        return;
+    }
     zone->SetSrcLoc( m_pendingSourceLocationPayload );
     ProcessGpuZoneBeginImplCommon( zone, ev, serial );
     m_pendingSourceLocationPayload = 0;
@@ -6971,11 +7149,16 @@ void Worker::CreateMemAllocPlot( MemData& memdata )
 
 void Worker::ReconstructMemAllocPlot( MemData& mem )
 {
+    const auto cmp = [&mem] ( const auto& lhs, const auto& rhs ) { return mem.data[lhs].TimeFree() < mem.data[rhs].TimeFree(); };
+    // Free order may already be known from the statistics cache.
+    if( !std::is_sorted( mem.frees.begin(), mem.frees.end(), cmp ) )
+    {
 #ifdef NO_PARALLEL_SORT
-    pdqsort_branchless( mem.frees.begin(), mem.frees.end(), [&mem] ( const auto& lhs, const auto& rhs ) { return mem.data[lhs].TimeFree() < mem.data[rhs].TimeFree(); } );
+        pdqsort_branchless( mem.frees.begin(), mem.frees.end(), cmp );
 #else
-    std::sort( std::execution::par_unseq, mem.frees.begin(), mem.frees.end(), [&mem] ( const auto& lhs, const auto& rhs ) { return mem.data[lhs].TimeFree() < mem.data[rhs].TimeFree(); } );
+        std::sort( std::execution::par_unseq, mem.frees.begin(), mem.frees.end(), cmp );
 #endif
+    }
 
     const auto psz = mem.data.size() + mem.frees.size() + 1;
 
@@ -7073,6 +7256,7 @@ void Worker::ReconstructMemAllocPlot( MemData& mem )
     plot->min = 0;
     plot->max = max;
     plot->sum = sum;
+    plot->lod.Update( plot->data.data(), psz );
 
     std::lock_guard<std::mutex> lock( m_data.lock );
     m_data.plots.Data().insert( m_data.plots.Data().begin(), plot );
@@ -7443,13 +7627,14 @@ void Worker::ReadTimelineHaveSize( FileRead& f, GpuEvent* zone, int64_t& refTime
 }
 
 #ifndef TRACY_NO_STATISTICS
-void Worker::ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint16_t thread )
+void Worker::ReconstructZoneStatistics( ZoneStackCount& countMap, ZoneEvent& zone, uint16_t thread )
 {
     assert( zone.IsEndValid() );
     auto timeSpan = zone.End() - zone.Start();
     if( timeSpan > 0 )
     {
-        auto it = m_data.sourceLocationZones.find( zone.SrcLoc() );
+        const auto srcloc = GetZoneSrcLoc( zone );
+        auto it = m_data.sourceLocationZones.find( srcloc );
         assert( it != m_data.sourceLocationZones.end() );
 
         ZoneThreadData ztd;
@@ -7463,7 +7648,7 @@ void Worker::ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint
         slz.total += timeSpan;
         slz.sumSq += double( timeSpan ) * timeSpan;
 
-        if( countMap[uint16_t(zone.SrcLoc())] == 0 )
+        if( countMap[srcloc] == 0 )
         {
             slz.nonReentrantCount++;
             if( slz.nonReentrantMin > timeSpan ) slz.nonReentrantMin = timeSpan;
@@ -7521,10 +7706,101 @@ void Worker::ReconstructZoneStatistics( GpuEvent& zone, uint16_t thread )
         slz.sumSq += double( timeSpan ) * timeSpan;
     }
 }
+
+template<typename R>
+bool Worker::ReadSourceLocationZones( R& Read )
+{
+    struct Range
+    {
+        ZoneThreadData* ptr;
+        ZoneThreadData* end;
+    };
+
+    const auto tsz = m_data.threads.size();
+    std::vector<uint16_t> threadId( tsz );
+    unordered_flat_map<uint16_t, size_t> threadIdx;
+    for( size_t i=0; i<tsz; i++ )
+    {
+        threadId[i] = m_data.localThreadCompress.DecompressMustRaw( m_data.threads[i]->id );
+        threadIdx.emplace( threadId[i], i );
+    }
+
+    for( auto& v : m_data.sourceLocationZones )
+    {
+        for( auto& t : v.second.threadCnt )
+        {
+            if( threadIdx.find( t.first ) == threadIdx.end() ) return false;
+        }
+    }
+
+    // Each thread gets its own slot in every source location list. Slots are filled in
+    // timeline order, i.e. sorted.
+    std::vector<unordered_flat_map<int32_t, Range>> ranges( tsz );
+    for( auto& v : m_data.sourceLocationZones )
+    {
+        auto& slz = v.second;
+        uint64_t cnt = 0;
+        for( auto& t : slz.threadCnt ) cnt += t.second;
+        if( cnt == 0 ) continue;
+        slz.zones.reserve_and_use( cnt );
+        auto ptr = slz.zones.data();
+        for( auto& t : slz.threadCnt )
+        {
+            if( t.second == 0 ) continue;
+            if( ptr != slz.zones.data() && slz.zones.is_sorted() ) slz.zones.mark_unsorted( uint32_t( ptr - slz.zones.data() ) );
+            ranges[threadIdx[t.first]].emplace( v.first, Range { ptr, ptr + t.second } );
+            ptr += t.second;
+        }
+    }
+
+    std::vector<ZoneListRef> refs( 64 * 1024 );
+    for( size_t i=0; i<tsz; i++ )
+    {
+        auto& r = ranges[i];
+        const auto thread = threadId[i];
+        uint64_t sz;
+        Read( &sz, sizeof( sz ) );
+        if( sz != r.size() ) return false;
+        for( uint64_t j=0; j<sz; j++ )
+        {
+            int32_t srcloc;
+            uint64_t cnt;
+            Read( &srcloc, sizeof( srcloc ) );
+            Read( &cnt, sizeof( cnt ) );
+            auto it = r.find( srcloc );
+            if( it == r.end() || cnt == 0 || cnt != uint64_t( it->second.end - it->second.ptr ) ) return false;
+            auto ptr = it->second.ptr;
+            ZoneListRef prev = {};
+            while( cnt > 0 )
+            {
+                const auto num = std::min<uint64_t>( cnt, refs.size() );
+                Read( refs.data(), sizeof( ZoneListRef ) * num );
+                for( uint64_t k=0; k<num; k++ )
+                {
+                    auto ref = refs[k];
+                    ref.list += prev.list;
+                    if( ref.list == prev.list ) ref.pos += prev.pos;
+                    prev = ref;
+                    if( ref.list > m_data.zoneChildren.size() ) return false;
+                    auto& _vec = ref.list == 0 ? m_data.threads[i]->timeline : m_data.zoneChildren[ref.list-1];
+                    if( !_vec.is_magic() || ref.pos >= _vec.size() ) return false;
+                    auto& zone = (*(Vector<ZoneEvent>*)( &_vec ))[ref.pos];
+                    if( !zone.IsEndValid() || zone.End() <= zone.Start() || GetZoneSrcLoc( zone ) != srcloc ) return false;
+                    ptr->SetZone( &zone );
+                    ptr->SetThread( thread );
+                    ptr++;
+                }
+                cnt -= num;
+            }
+            it->second.ptr = ptr;
+        }
+    }
+    return true;
+}
 #else
 void Worker::CountZoneStatistics( ZoneEvent* zone )
 {
-    auto cnt = GetSourceLocationZonesCnt( zone->SrcLoc() );
+    auto cnt = GetSourceLocationZonesCnt( GetZoneSrcLoc( *zone ) );
     (*cnt)++;
 }
 
@@ -7622,6 +7898,175 @@ void Worker::Disconnect()
     m_disconnect = true;
 }
 
+// Serializes parts of the trace on worker threads and appends them to the file in order. Parts
+// are collected until their estimated sizes reach the batch limit, then consecutive parts are
+// grouped into tasks of up to PartBytes(), each writing into its own buffer. Large sections are
+// split into many parts, so that memory use stays bounded and they are still serialized in
+// parallel. Buffers are allocated to the estimated size, and only small ones are kept after
+// their batch is written, so that the limit applies to the memory held during the whole save.
+class PartWriter
+{
+public:
+    enum { BatchBytes = 256 * 1024 * 1024 };
+    enum { KeepBytes = 4 * 1024 * 1024 };
+
+    PartWriter( FileWrite& f, std::atomic<uint64_t>& progress )
+        : m_file( f )
+        , m_progress( progress )
+        , m_jobs( std::max<int>( 1, std::thread::hardware_concurrency() - 1 ) )
+        , m_td( m_jobs, "Save" )
+        , m_bytes( 0 )
+    {
+    }
+
+    size_t PartBytes() const { return BatchBytes / ( m_jobs + 1 ); }
+
+    void Add( size_t bytes, std::function<void(BufferWrite&)>&& write )
+    {
+        m_parts.emplace_back( Part { bytes, std::move( write ), false } );
+        m_bytes += bytes;
+        if( m_bytes >= BatchBytes ) Flush();
+    }
+
+    template<typename T>
+    void AddValue( T val )
+    {
+        Add( sizeof( val ), [val] ( BufferWrite& f ) { f.Write( &val, sizeof( val ) ); } );
+    }
+
+    // Adds the elements of a vector in parts. Times are stored as offsets from the previous
+    // element, so each part continues from the time of the last element of the part before it.
+    template<typename V, typename T, typename F>
+    void AddElements( const V& vec, size_t elemBytes, const T& time, const F& write )
+    {
+        const auto size = size_t( vec.size() );
+        const auto step = std::max<size_t>( 1, PartBytes() / elemBytes );
+        for( size_t i=0; i<size; i+=step )
+        {
+            const auto end = std::min( size, i + step );
+            Add( ( end - i ) * elemBytes, [&vec, i, end, ref = i == 0 ? 0 : time( vec[i-1] ), write] ( BufferWrite& f ) {
+                int64_t refTime = ref;
+                for( size_t j=i; j<end; j++ ) write( f, vec[j], refTime );
+            } );
+        }
+    }
+
+    // The save progress advances once the last part added so far is written.
+    void EndSection()
+    {
+        if( m_parts.empty() )
+        {
+            m_progress.fetch_add( 1, std::memory_order_relaxed );
+        }
+        else
+        {
+            m_parts.back().sectionEnd = true;
+        }
+    }
+
+    void Flush()
+    {
+        size_t tasks = 0;
+        size_t begin = 0;
+        while( begin < m_parts.size() )
+        {
+            auto end = begin + 1;
+            auto bytes = m_parts[begin].bytes;
+            while( end < m_parts.size() && bytes + m_parts[end].bytes <= PartBytes() ) bytes += m_parts[end++].bytes;
+            if( tasks == m_buffers.size() ) m_buffers.emplace_back( std::make_unique<BufferWrite>() );
+            m_td.Queue( [this, &buf = *m_buffers[tasks], begin, end, bytes] {
+                buf.Reserve( bytes );
+                for( size_t i=begin; i<end; i++ ) m_parts[i].write( buf );
+            } );
+            tasks++;
+            begin = end;
+        }
+        m_td.Sync();
+        for( size_t i=0; i<tasks; i++ )
+        {
+            m_file.Write( m_buffers[i]->GetData(), m_buffers[i]->GetSize() );
+            m_buffers[i]->Shrink( KeepBytes );
+        }
+        for( auto& part : m_parts )
+        {
+            if( part.sectionEnd ) m_progress.fetch_add( 1, std::memory_order_relaxed );
+        }
+        m_parts.clear();
+        m_bytes = 0;
+    }
+
+private:
+    struct Part
+    {
+        size_t bytes;
+        std::function<void(BufferWrite&)> write;
+        bool sectionEnd;
+    };
+
+    FileWrite& m_file;
+    std::atomic<uint64_t>& m_progress;
+    size_t m_jobs;
+    TaskDispatch m_td;
+    std::vector<Part> m_parts;
+    std::vector<std::unique_ptr<BufferWrite>> m_buffers;
+    size_t m_bytes;
+};
+
+static void AddPlotData( PartWriter& pw, const PlotData& plot )
+{
+    pw.Add( 64, [&plot] ( BufferWrite& f ) {
+        f.Write( &plot.type, sizeof( plot.type ) );
+        f.Write( &plot.format, sizeof( plot.format ) );
+        f.Write( &plot.showSteps, sizeof( plot.showSteps ) );
+        f.Write( &plot.fill, sizeof( plot.fill ) );
+        f.Write( &plot.color, sizeof( plot.color ) );
+        f.Write( &plot.name, sizeof( plot.name ) );
+        f.Write( &plot.min, sizeof( plot.min ) );
+        f.Write( &plot.max, sizeof( plot.max ) );
+        f.Write( &plot.sum, sizeof( plot.sum ) );
+    } );
+    pw.AddValue( uint64_t( plot.data.size() ) );
+    pw.AddElements( plot.data, sizeof( int64_t ) + sizeof( double ), [] ( const auto& v ) { return v.time.Val(); }, [] ( BufferWrite& f, const auto& v, int64_t& refTime ) {
+        WriteTimeOffset( f, refTime, v.time.Val() );
+        f.Write( &v.val, sizeof( v.val ) );
+    } );
+    pw.EndSection();
+}
+
+static void AddMemData( PartWriter& pw, uint64_t name, const MemData& memdata )
+{
+    pw.AddValue( name );
+    pw.AddValue( uint64_t( memdata.data.size() ) );
+    pw.AddValue( uint64_t( memdata.active.size() ) );
+    pw.AddValue( uint64_t( memdata.frees.size() ) );
+    pw.AddElements( memdata.data, 5 * sizeof( uint64_t ) + 2 * sizeof( Int24 ) + 2 * sizeof( uint16_t ), [] ( const auto& mem ) { return mem.TimeAlloc(); }, [] ( BufferWrite& f, const auto& mem, int64_t& refTime ) {
+        const auto ptr = mem.Ptr();
+        const auto size = mem.Size();
+        const Int24 csAlloc = mem.CsAlloc();
+        f.Write( &ptr, sizeof( ptr ) );
+        f.Write( &size, sizeof( size ) );
+        f.Write( &csAlloc, sizeof( csAlloc ) );
+        f.Write( &mem.csFree, sizeof( mem.csFree ) );
+
+        int64_t timeAlloc = mem.TimeAlloc();
+        uint16_t threadAlloc = mem.ThreadAlloc();
+        int64_t timeFree = mem.TimeFree();
+        uint16_t threadFree = mem.ThreadFree();
+        WriteTimeOffset( f, refTime, timeAlloc );
+        int64_t freeOffset = timeFree < 0 ? timeFree : timeFree - timeAlloc;
+        f.Write( &freeOffset, sizeof( freeOffset ) );
+        f.Write( &threadAlloc, sizeof( threadAlloc ) );
+        f.Write( &threadFree, sizeof( threadFree ) );
+    } );
+    pw.Add( 64, [&memdata] ( BufferWrite& f ) {
+        f.Write( &memdata.high, sizeof( memdata.high ) );
+        f.Write( &memdata.low, sizeof( memdata.low ) );
+        f.Write( &memdata.usage, sizeof( memdata.usage ) );
+        f.Write( &memdata.name, sizeof( memdata.name ) );
+    } );
+    pw.EndSection();
+}
+
 static void WriteHwSampleVec( FileWrite& f, SortedVector<Int48, Int48Sort>& vec )
 {
     uint64_t sz = vec.size();
@@ -7641,6 +8086,15 @@ void Worker::Write( FileWrite& f, bool fiDict )
 {
     DoPostponedWorkAll();
 
+    uint64_t plotCnt = 0;
+    for( auto& plot : m_data.plots.Data() ) { if( plot->type != PlotType::Memory ) plotCnt++; }
+    m_saveProgress.progress.store( 0, std::memory_order_relaxed );
+    m_saveProgress.total.store( m_data.threads.size() + m_data.gpuData.size() + plotCnt + m_data.memNameMap.size() + 1, std::memory_order_relaxed );
+
+    // Per-thread, per-context, per-plot and per-pool blocks don't depend on each other. They are
+    // serialized on worker threads, split into parts where they are large.
+    PartWriter pw( f, m_saveProgress.progress );
+
     f.Write( FileHeader, sizeof( FileHeader ) );
 
     f.Write( &m_delay, sizeof( m_delay ) );
@@ -7786,14 +8240,36 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( v, sizeof( SourceLocationBase ) );
     }
 
+    const bool wideSrcLoc = sz > std::numeric_limits<int16_t>::max();
+    auto WriteSrcLocId = [&f, wideSrcLoc] ( int32_t id ) {
+        if( wideSrcLoc )
+        {
+            f.Write( &id, sizeof( id ) );
+        }
+        else
+        {
+            const int16_t id16 = id;
+            f.Write( &id16, sizeof( id16 ) );
+        }
+    };
+    if( wideSrcLoc )
+    {
+        sz = m_data.zoneWideSrcLoc.size();
+        f.Write( &sz, sizeof( sz ) );
+        for( auto& v : m_data.zoneWideSrcLoc )
+        {
+            f.Write( &v.first, sizeof( v.first ) );
+            f.Write( &v.second, sizeof( v.second ) );
+        }
+    }
+
 #ifndef TRACY_NO_STATISTICS
     sz = m_data.sourceLocationZones.size();
     f.Write( &sz, sizeof( sz ) );
     for( auto& v : m_data.sourceLocationZones )
     {
-        int16_t id = v.first;
         uint64_t cnt = v.second.zones.size();
-        f.Write( &id, sizeof( id ) );
+        WriteSrcLocId( v.first );
         f.Write( &cnt, sizeof( cnt ) );
     }
 
@@ -7811,9 +8287,8 @@ void Worker::Write( FileWrite& f, bool fiDict )
     f.Write( &sz, sizeof( sz ) );
     for( auto& v : m_data.sourceLocationZonesCnt )
     {
-        int16_t id = v.first;
         uint64_t cnt = v.second;
-        f.Write( &id, sizeof( id ) );
+        WriteSrcLocId( v.first );
         f.Write( &cnt, sizeof( cnt ) );
     }
 
@@ -7884,46 +8359,8 @@ void Worker::Write( FileWrite& f, bool fiDict )
     f.Write( &sz, sizeof( sz ) );
     sz = m_data.threads.size();
     f.Write( &sz, sizeof( sz ) );
-    for( auto& thread : m_data.threads )
-    {
-        int64_t refTime = 0;
-        f.Write( &thread->id, sizeof( thread->id ) );
-        f.Write( &thread->count, sizeof( thread->count ) );
-        f.Write( &thread->kernelSampleCnt, sizeof( thread->kernelSampleCnt ) );
-        f.Write( &thread->isFiber, sizeof( thread->isFiber ) );
-        WriteTimeline( f, thread->timeline, refTime );
-        sz = thread->messages.size();
-        f.Write( &sz, sizeof( sz ) );
-        for( auto& v : thread->messages )
-        {
-            auto ptr = uint64_t( (MessageData*)v );
-            f.Write( &ptr, sizeof( ptr ) );
-        }
-        sz = thread->ctxSwitchSamples.size();
-        f.Write( &sz, sizeof( sz ) );
-        refTime = 0;
-        for( auto& v : thread->ctxSwitchSamples )
-        {
-            WriteTimeOffset( f, refTime, v.time.Val() );
-            f.Write( &v.callstack, sizeof( v.callstack ) );
-        }
-        if( m_inconsistentSamples )
-        {
-#ifdef NO_PARALLEL_SORT
-            pdqsort_branchless( thread->samples.begin(), thread->samples.end(), [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs.time.Val(); } );
-#else
-            std::sort( std::execution::par_unseq, thread->samples.begin(), thread->samples.end(), [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs.time.Val(); } );
-#endif
-        }
-        sz = thread->samples.size();
-        f.Write( &sz, sizeof( sz ) );
-        refTime = 0;
-        for( auto& v : thread->samples )
-        {
-            WriteTimeOffset( f, refTime, v.time.Val() );
-            f.Write( &v.callstack, sizeof( v.callstack ) );
-        }
-    }
+    for( auto& thread : m_data.threads ) AddThreadData( pw, *thread );
+    pw.Flush();
 
     sz = 0;
     for( auto& v : m_data.gpuData ) sz += v->count;
@@ -7932,52 +8369,17 @@ void Worker::Write( FileWrite& f, bool fiDict )
     f.Write( &sz, sizeof( sz ) );
     sz = m_data.gpuData.size();
     f.Write( &sz, sizeof( sz ) );
-    for( auto& ctx : m_data.gpuData )
-    {
-        f.Write( &ctx->thread, sizeof( ctx->thread ) );
-        uint8_t calibration = ctx->hasCalibration;
-        f.Write( &calibration, sizeof( calibration ) );
-        f.Write( &ctx->count, sizeof( ctx->count ) );
-        f.Write( &ctx->period, sizeof( ctx->period ) );
-        f.Write( &ctx->type, sizeof( ctx->type ) );
-        f.Write( &ctx->name, sizeof( ctx->name ) );
-        f.Write( &ctx->overflow, sizeof( ctx->overflow ) );
-        sz = ctx->threadData.size();
-        f.Write( &sz, sizeof( sz ) );
-        for( auto& td : ctx->threadData )
-        {
-            int64_t refTime = 0;
-            int64_t refGpuTime = 0;
-            uint64_t tid = td.first;
-            f.Write( &tid, sizeof( tid ) );
-            WriteTimeline( f, td.second.timeline, refTime, refGpuTime );
-        }
-    }
+    for( auto& ctx : m_data.gpuData ) AddGpuData( pw, *ctx );
+    pw.Flush();
 
     sz = m_data.plots.Data().size();
     for( auto& plot : m_data.plots.Data() ) { if( plot->type == PlotType::Memory ) sz--; }
     f.Write( &sz, sizeof( sz ) );
     for( auto& plot : m_data.plots.Data() )
     {
-        if( plot->type == PlotType::Memory ) continue;
-        f.Write( &plot->type, sizeof( plot->type ) );
-        f.Write( &plot->format, sizeof( plot->format ) );
-        f.Write( &plot->showSteps, sizeof( plot->showSteps ) );
-        f.Write( &plot->fill, sizeof( plot->fill ) );
-        f.Write( &plot->color, sizeof( plot->color ) );
-        f.Write( &plot->name, sizeof( plot->name ) );
-        f.Write( &plot->min, sizeof( plot->min ) );
-        f.Write( &plot->max, sizeof( plot->max ) );
-        f.Write( &plot->sum, sizeof( plot->sum ) );
-        int64_t refTime = 0;
-        sz = plot->data.size();
-        f.Write( &sz, sizeof( sz ) );
-        for( auto& v : plot->data )
-        {
-            WriteTimeOffset( f, refTime, v.time.Val() );
-            f.Write( &v.val, sizeof( v.val ) );
-        }
+        if( plot->type != PlotType::Memory ) AddPlotData( pw, *plot );
     }
+    pw.Flush();
 
     sz = m_data.memNameMap.size();
     f.Write( &sz, sizeof( sz ) );
@@ -7987,44 +8389,8 @@ void Worker::Write( FileWrite& f, bool fiDict )
         sz += memory.second->data.size();
     }
     f.Write( &sz, sizeof( sz ) );
-    for( auto& memory : m_data.memNameMap )
-    {
-        uint64_t name = memory.first;
-        f.Write( &name, sizeof( name ) );
-
-        auto& memdata = *memory.second;
-        int64_t refTime = 0;
-        sz = memdata.data.size();
-        f.Write( &sz, sizeof( sz ) );
-        sz = memdata.active.size();
-        f.Write( &sz, sizeof( sz ) );
-        sz = memdata.frees.size();
-        f.Write( &sz, sizeof( sz ) );
-        for( auto& mem : memdata.data )
-        {
-            const auto ptr = mem.Ptr();
-            const auto size = mem.Size();
-            const Int24 csAlloc = mem.CsAlloc();
-            f.Write( &ptr, sizeof( ptr ) );
-            f.Write( &size, sizeof( size ) );
-            f.Write( &csAlloc, sizeof( csAlloc ) );
-            f.Write( &mem.csFree, sizeof( mem.csFree ) );
-
-            int64_t timeAlloc = mem.TimeAlloc();
-            uint16_t threadAlloc = mem.ThreadAlloc();
-            int64_t timeFree = mem.TimeFree();
-            uint16_t threadFree = mem.ThreadFree();
-            WriteTimeOffset( f, refTime, timeAlloc );
-            int64_t freeOffset = timeFree < 0 ? timeFree : timeFree - timeAlloc;
-            f.Write( &freeOffset, sizeof( freeOffset ) );
-            f.Write( &threadAlloc, sizeof( threadAlloc ) );
-            f.Write( &threadFree, sizeof( threadFree ) );
-        }
-        f.Write( &memdata.high, sizeof( memdata.high ) );
-        f.Write( &memdata.low, sizeof( memdata.low ) );
-        f.Write( &memdata.usage, sizeof( memdata.usage ) );
-        f.Write( &memdata.name, sizeof( memdata.name ) );
-    }
+    for( auto& v : m_data.memNameMap ) AddMemData( pw, v.first, *v.second );
+    pw.Flush();
 
     sz = m_data.callstackPayload.size() - 1;
     f.Write( &sz, sizeof( sz ) );
@@ -8244,34 +8610,481 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( &v.second.len, sizeof( v.second.len ) );
         f.Write( v.second.data, v.second.len );
     }
+
+#ifndef TRACY_NO_STATISTICS
+    if( m_data.sourceLocationZonesReady ) WriteStatisticsCache( f );
+#endif
+
+    m_saveProgress.total.store( 0, std::memory_order_relaxed );
+}
+
+#ifndef TRACY_NO_STATISTICS
+void Worker::WriteStatisticsCache( FileWrite& f )
+{
+    XXH3_state_t hash;
+    XXH3_64bits_reset( &hash );
+    auto Write = [&f, &hash] ( const void* ptr, size_t size ) {
+        f.Write( ptr, size );
+        XXH3_64bits_update( &hash, ptr, size );
+    };
+
+    f.Write( StatisticsCacheHeader, sizeof( StatisticsCacheHeader ) );
+
+    uint64_t sz = m_data.threads.size();
+    Write( &m_data.zonesCnt, sizeof( m_data.zonesCnt ) );
+    Write( &m_data.lastTime, sizeof( m_data.lastTime ) );
+    Write( &sz, sizeof( sz ) );
+
+    sz = m_data.sourceLocationZones.size();
+    Write( &sz, sizeof( sz ) );
+    for( auto& v : m_data.sourceLocationZones )
+    {
+        auto& slz = v.second;
+        const int32_t id = v.first;
+        const uint64_t cnt = slz.zones.size();
+        const uint64_t nonReentrantCount = slz.nonReentrantCount;
+        Write( &id, sizeof( id ) );
+        Write( &cnt, sizeof( cnt ) );
+        Write( &slz.min, sizeof( slz.min ) );
+        Write( &slz.max, sizeof( slz.max ) );
+        Write( &slz.total, sizeof( slz.total ) );
+        Write( &slz.sumSq, sizeof( slz.sumSq ) );
+        Write( &slz.selfMin, sizeof( slz.selfMin ) );
+        Write( &slz.selfMax, sizeof( slz.selfMax ) );
+        Write( &slz.selfTotal, sizeof( slz.selfTotal ) );
+        Write( &nonReentrantCount, sizeof( nonReentrantCount ) );
+        Write( &slz.nonReentrantMin, sizeof( slz.nonReentrantMin ) );
+        Write( &slz.nonReentrantMax, sizeof( slz.nonReentrantMax ) );
+        Write( &slz.nonReentrantTotal, sizeof( slz.nonReentrantTotal ) );
+        sz = slz.threadCnt.size();
+        Write( &sz, sizeof( sz ) );
+        for( auto& t : slz.threadCnt )
+        {
+            Write( &t.first, sizeof( t.first ) );
+            Write( &t.second, sizeof( t.second ) );
+        }
+    }
+
+    // Zones are referenced by list and position, in the order the loader assigns children
+    // lists (pre-order, list 0 is the thread timeline), so the per-thread slots of each
+    // source location list can be filled without walking the zone trees. References are
+    // delta encoded against the previous one of the same list, which compresses well.
+    uint32_t childIdx = 0;
+    unordered_flat_map<int32_t, std::vector<ZoneListRef>> refs;
+    std::function<void(const Vector<short_ptr<ZoneEvent>>&, uint32_t)> ProcessTimeline;
+    ProcessTimeline = [this, &refs, &childIdx, &ProcessTimeline] ( const Vector<short_ptr<ZoneEvent>>& vec, uint32_t list )
+    {
+        for( uint32_t i=0; i<vec.size(); i++ )
+        {
+            auto& zone = vec.is_magic() ? (*(const Vector<ZoneEvent>*)( &vec ))[i] : *vec[i];
+            if( zone.IsEndValid() && zone.End() > zone.Start() ) refs[GetZoneSrcLoc( zone )].emplace_back( ZoneListRef { list, i } );
+            if( zone.HasChildren() )
+            {
+                auto& children = GetZoneChildren( zone.Child() );
+                if( !children.empty() ) ProcessTimeline( children, ++childIdx );
+            }
+        }
+    };
+    for( auto& t : m_data.threads )
+    {
+        refs.clear();
+        ProcessTimeline( t->timeline, 0 );
+        sz = refs.size();
+        Write( &sz, sizeof( sz ) );
+        for( auto& v : refs )
+        {
+            const uint64_t cnt = v.second.size();
+            ZoneListRef prev = {};
+            for( auto& ref : v.second )
+            {
+                const auto cur = ref;
+                ref.list -= prev.list;
+                if( ref.list == 0 ) ref.pos -= prev.pos;
+                prev = cur;
+            }
+            Write( &v.first, sizeof( v.first ) );
+            Write( &cnt, sizeof( cnt ) );
+            Write( v.second.data(), sizeof( ZoneListRef ) * cnt );
+        }
+    }
+
+    uint64_t csCnt = 0;
+    for( int i=0; i<m_data.cpuDataCount; i++ ) csCnt += m_data.cpuData[i].cs.size();
+    sz = m_data.ctxUsageReady ? m_data.ctxUsage.size() : 0;
+    Write( &csCnt, sizeof( csCnt ) );
+    Write( &sz, sizeof( sz ) );
+    if( sz != 0 ) Write( m_data.ctxUsage.data(), sizeof( ContextSwitchUsage ) * sz );
+
+    // Plot is assigned only after frees were put in time order.
+    std::vector<std::pair<uint64_t, const MemData*>> mem;
+    for( auto& v : m_data.memNameMap )
+    {
+        auto& memdata = *v.second;
+        if( memdata.plot && !memdata.frees.empty() && std::is_sorted( memdata.frees.begin(), memdata.frees.end(), [&memdata] ( const auto& lhs, const auto& rhs ) { return memdata.data[lhs].TimeFree() < memdata.data[rhs].TimeFree(); } ) )
+        {
+            mem.emplace_back( v.first, &memdata );
+        }
+    }
+    sz = mem.size();
+    Write( &sz, sizeof( sz ) );
+    for( auto& v : mem )
+    {
+        const uint64_t dataSz = v.second->data.size();
+        const uint64_t freesSz = v.second->frees.size();
+        Write( &v.first, sizeof( v.first ) );
+        Write( &dataSz, sizeof( dataSz ) );
+        Write( &freesSz, sizeof( freesSz ) );
+        Write( v.second->frees.data(), sizeof( uint32_t ) * freesSz );
+    }
+
+    const uint64_t digest = XXH3_64bits_digest( &hash );
+    f.Write( &digest, sizeof( digest ) );
 }
 
-void Worker::WriteTimeline( FileWrite& f, const Vector<short_ptr<ZoneEvent>>& vec, int64_t& refTime )
+void Worker::ReadStatisticsCache( FileRead& f )
+{
+    uint8_t hdr[8];
+    f.Read( hdr, sizeof( hdr ) );
+    if( memcmp( hdr, StatisticsCacheHeader, sizeof( hdr ) ) != 0 ) return;
+
+    XXH3_state_t hash;
+    XXH3_64bits_reset( &hash );
+    auto Read = [&f, &hash] ( void* ptr, size_t size ) {
+        f.Read( ptr, size );
+        XXH3_64bits_update( &hash, ptr, size );
+    };
+
+    uint64_t zonesCnt, threadsCnt;
+    int64_t lastTime;
+    Read( &zonesCnt, sizeof( zonesCnt ) );
+    Read( &lastTime, sizeof( lastTime ) );
+    Read( &threadsCnt, sizeof( threadsCnt ) );
+    // Cache belongs to a different trace, e.g. a file spliced by an external tool.
+    if( zonesCnt != m_data.zonesCnt || lastTime != m_data.lastTime || threadsCnt != m_data.threads.size() ) return;
+
+    uint64_t sz;
+    Read( &sz, sizeof( sz ) );
+    if( sz > m_data.sourceLocationZones.size() ) return;
+    bool valid = true;
+    for( uint64_t i=0; i<sz; i++ )
+    {
+        int32_t id;
+        uint64_t cnt, nonReentrantCount, tsz;
+        Read( &id, sizeof( id ) );
+        Read( &cnt, sizeof( cnt ) );
+        auto it = m_data.sourceLocationZones.find( id );
+        if( it == m_data.sourceLocationZones.end() )
+        {
+            valid = false;
+            break;
+        }
+        auto& slz = it->second;
+        Read( &slz.min, sizeof( slz.min ) );
+        Read( &slz.max, sizeof( slz.max ) );
+        Read( &slz.total, sizeof( slz.total ) );
+        Read( &slz.sumSq, sizeof( slz.sumSq ) );
+        Read( &slz.selfMin, sizeof( slz.selfMin ) );
+        Read( &slz.selfMax, sizeof( slz.selfMax ) );
+        Read( &slz.selfTotal, sizeof( slz.selfTotal ) );
+        Read( &nonReentrantCount, sizeof( nonReentrantCount ) );
+        Read( &slz.nonReentrantMin, sizeof( slz.nonReentrantMin ) );
+        Read( &slz.nonReentrantMax, sizeof( slz.nonReentrantMax ) );
+        Read( &slz.nonReentrantTotal, sizeof( slz.nonReentrantTotal ) );
+        slz.nonReentrantCount = nonReentrantCount;
+        Read( &tsz, sizeof( tsz ) );
+        if( tsz > threadsCnt )
+        {
+            valid = false;
+            break;
+        }
+        uint64_t total = 0;
+        for( uint64_t j=0; j<tsz; j++ )
+        {
+            uint16_t thread;
+            uint64_t tcnt;
+            Read( &thread, sizeof( thread ) );
+            Read( &tcnt, sizeof( tcnt ) );
+            slz.threadCnt.emplace( thread, tcnt );
+            total += tcnt;
+        }
+        if( total != cnt ) valid = false;
+    }
+
+    if( valid ) valid = ReadSourceLocationZones( Read );
+
+    uint64_t csCnt = 0, cachedCsCnt;
+    for( int i=0; i<m_data.cpuDataCount; i++ ) csCnt += m_data.cpuData[i].cs.size();
+    if( valid )
+    {
+        Read( &cachedCsCnt, sizeof( cachedCsCnt ) );
+        Read( &sz, sizeof( sz ) );
+        // Each context switch produces at most two usage changes.
+        if( sz > cachedCsCnt * 2 + 1 )
+        {
+            valid = false;
+        }
+        else if( sz != 0 )
+        {
+            m_data.ctxUsage.reserve_and_use( sz );
+            Read( m_data.ctxUsage.data(), sizeof( ContextSwitchUsage ) * sz );
+        }
+    }
+
+    std::vector<std::pair<MemData*, std::vector<uint32_t>>> mem;
+    if( valid )
+    {
+        Read( &sz, sizeof( sz ) );
+        for( uint64_t i=0; i<sz; i++ )
+        {
+            uint64_t name, dataSz, freesSz;
+            Read( &name, sizeof( name ) );
+            Read( &dataSz, sizeof( dataSz ) );
+            Read( &freesSz, sizeof( freesSz ) );
+            if( freesSz > dataSz || dataSz > std::numeric_limits<uint32_t>::max() )
+            {
+                valid = false;
+                break;
+            }
+            std::vector<uint32_t> frees( freesSz );
+            Read( frees.data(), sizeof( uint32_t ) * freesSz );
+            auto it = m_data.memNameMap.find( name );
+            if( it != m_data.memNameMap.end() && it->second->data.size() == dataSz && it->second->frees.size() == freesSz )
+            {
+                mem.emplace_back( it->second, std::move( frees ) );
+            }
+        }
+    }
+
+    if( valid )
+    {
+        uint64_t digest;
+        f.Read( digest );
+        valid = digest == XXH3_64bits_digest( &hash );
+    }
+
+    if( !valid )
+    {
+        for( auto& v : m_data.sourceLocationZones ) v.second = SourceLocationZones();
+        m_data.ctxUsage.clear();
+        return;
+    }
+
+    m_statisticsCached = true;
+    if( !m_data.ctxUsage.empty() )
+    {
+        if( csCnt == cachedCsCnt && !m_data.ctxSwitch.empty() )
+        {
+            m_data.ctxUsageReady = true;
+        }
+        else
+        {
+            m_data.ctxUsage.clear();
+        }
+    }
+    for( auto& v : mem )
+    {
+        auto& memdata = *v.first;
+        auto& frees = v.second;
+        bool ok = true;
+        int64_t prev = 0;
+        for( auto idx : frees )
+        {
+            if( idx >= memdata.data.size() ) { ok = false; break; }
+            const auto t = memdata.data[idx].TimeFree();
+            if( t < prev ) { ok = false; break; }
+            prev = t;
+        }
+        if( ok ) memcpy( memdata.frees.data(), frees.data(), sizeof( uint32_t ) * frees.size() );
+    }
+}
+#endif
+
+// Upper bounds of the serialized size of one zone, without its children.
+enum { SaveZoneBytes = sizeof( int16_t ) + sizeof( ZoneEvent::extra ) + sizeof( uint32_t ) + 2 * sizeof( int64_t ) };
+enum { SaveGpuZoneBytes = 4 * sizeof( int64_t ) + sizeof( int16_t ) + sizeof( GpuEvent::callstack ) + sizeof( uint16_t ) + sizeof( uint64_t ) };
+
+template<typename W>
+static tracy_force_inline void WriteZoneHead( W& f, const ZoneEvent& v, int64_t& refTime )
+{
+    int16_t srcloc = v.SrcLoc();
+    f.Write( &srcloc, sizeof( srcloc ) );
+    WriteTimeOffset( f, refTime, v.Start() );
+    f.Write( &v.extra, sizeof( v.extra ) );
+}
+
+template<typename W>
+static tracy_force_inline void WriteZoneHead( W& f, const GpuEvent& v, int64_t& refTime, int64_t& refGpuTime )
+{
+    WriteTimeOffset( f, refTime, v.CpuStart() );
+    WriteTimeOffset( f, refGpuTime, v.GpuStart() );
+    const int16_t srcloc = v.SrcLoc();
+    f.Write( &srcloc, sizeof( srcloc ) );
+    f.Write( &v.callstack, sizeof( v.callstack ) );
+    const uint16_t thread = v.Thread();
+    f.Write( &thread, sizeof( thread ) );
+}
+
+void Worker::AddThreadData( PartWriter& pw, ThreadData& thread )
+{
+    pw.Add( 32, [&thread] ( BufferWrite& f ) {
+        f.Write( &thread.id, sizeof( thread.id ) );
+        f.Write( &thread.count, sizeof( thread.count ) );
+        f.Write( &thread.kernelSampleCnt, sizeof( thread.kernelSampleCnt ) );
+        f.Write( &thread.isFiber, sizeof( thread.isFiber ) );
+    } );
+    if( thread.count * SaveZoneBytes <= pw.PartBytes() )
+    {
+        pw.Add( sizeof( uint32_t ) + thread.count * SaveZoneBytes, [this, &thread] ( BufferWrite& f ) {
+            int64_t refTime = 0;
+            WriteTimeline( f, thread.timeline, refTime );
+        } );
+    }
+    else
+    {
+        AddTimeline( pw, thread.timeline, 0 );
+    }
+
+    pw.AddValue( uint64_t( thread.messages.size() ) );
+    pw.AddElements( thread.messages, sizeof( uint64_t ), [] ( const auto& ) { return 0; }, [] ( BufferWrite& f, const auto& v, int64_t& ) {
+        auto ptr = uint64_t( (const MessageData*)v );
+        f.Write( &ptr, sizeof( ptr ) );
+    } );
+
+    const auto writeSample = [] ( BufferWrite& f, const auto& v, int64_t& refTime ) {
+        WriteTimeOffset( f, refTime, v.time.Val() );
+        f.Write( &v.callstack, sizeof( v.callstack ) );
+    };
+    const auto sampleTime = [] ( const auto& v ) { return v.time.Val(); };
+    pw.AddValue( uint64_t( thread.ctxSwitchSamples.size() ) );
+    pw.AddElements( thread.ctxSwitchSamples, sizeof( int64_t ) + sizeof( Int24 ), sampleTime, writeSample );
+    if( m_inconsistentSamples )
+    {
+#ifdef NO_PARALLEL_SORT
+        pdqsort_branchless( thread.samples.begin(), thread.samples.end(), [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs.time.Val(); } );
+#else
+        std::sort( std::execution::par_unseq, thread.samples.begin(), thread.samples.end(), [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs.time.Val(); } );
+#endif
+    }
+    pw.AddValue( uint64_t( thread.samples.size() ) );
+    pw.AddElements( thread.samples, sizeof( int64_t ) + sizeof( Int24 ), sampleTime, writeSample );
+    pw.EndSection();
+}
+
+void Worker::AddGpuData( PartWriter& pw, const GpuCtxData& ctx )
+{
+    pw.Add( 64, [&ctx] ( BufferWrite& f ) {
+        f.Write( &ctx.thread, sizeof( ctx.thread ) );
+        uint8_t calibration = ctx.hasCalibration;
+        f.Write( &calibration, sizeof( calibration ) );
+        f.Write( &ctx.count, sizeof( ctx.count ) );
+        f.Write( &ctx.period, sizeof( ctx.period ) );
+        f.Write( &ctx.type, sizeof( ctx.type ) );
+        f.Write( &ctx.name, sizeof( ctx.name ) );
+        f.Write( &ctx.overflow, sizeof( ctx.overflow ) );
+    } );
+    pw.AddValue( uint64_t( ctx.threadData.size() ) );
+    for( auto& td : ctx.threadData )
+    {
+        pw.AddValue( uint64_t( td.first ) );
+        AddTimeline( pw, td.second.timeline, 0, 0 );
+    }
+    pw.EndSection();
+}
+
+// A zone list is split into ranges of zones with bounded subtrees. Zones with larger subtrees are
+// split further at their children. Time offsets continue from the end of the previous zone, or
+// from the start of the parent for the first child, which is what the previous part wrote last.
+void Worker::AddTimeline( PartWriter& pw, const Vector<short_ptr<ZoneEvent>>& vec, int64_t refTime )
+{
+    pw.AddValue( uint32_t( vec.size() ) );
+    const auto limit = std::max<size_t>( 2, pw.PartBytes() / SaveZoneBytes );
+    SplitZones( *this, vec, limit, [&] ( size_t begin, size_t end, bool large ) {
+        const auto ref = begin == 0 ? refTime : ZoneAt( vec, begin-1 ).End();
+        if( !large )
+        {
+            pw.Add( limit * SaveZoneBytes, [this, &vec, begin, end, ref] ( BufferWrite& f ) {
+                int64_t refTime = ref;
+                WriteTimeline( f, vec, begin, end, refTime );
+            } );
+            return;
+        }
+        auto& zone = ZoneAt( vec, begin );
+        pw.Add( SaveZoneBytes, [&zone, ref] ( BufferWrite& f ) {
+            int64_t refTime = ref;
+            WriteZoneHead( f, zone, refTime );
+        } );
+        auto& children = GetZoneChildren( zone.Child() );
+        AddTimeline( pw, children, zone.Start() );
+        pw.Add( sizeof( int64_t ), [&zone, ref = ZoneAt( children, children.size() - 1 ).End()] ( BufferWrite& f ) {
+            int64_t refTime = ref;
+            WriteTimeOffset( f, refTime, zone.End() );
+        } );
+    } );
+}
+
+void Worker::AddTimeline( PartWriter& pw, const Vector<short_ptr<GpuEvent>>& vec, int64_t refTime, int64_t refGpuTime )
+{
+    pw.AddValue( uint64_t( vec.size() ) );
+    const auto limit = std::max<size_t>( 2, pw.PartBytes() / SaveGpuZoneBytes );
+    SplitZones( *this, vec, limit, [&] ( size_t begin, size_t end, bool large ) {
+        const auto ref = begin == 0 ? refTime : ZoneAt( vec, begin-1 ).CpuEnd();
+        const auto refGpu = begin == 0 ? refGpuTime : ZoneAt( vec, begin-1 ).GpuEnd();
+        if( !large )
+        {
+            pw.Add( limit * SaveGpuZoneBytes, [this, &vec, begin, end, ref, refGpu] ( BufferWrite& f ) {
+                int64_t refTime = ref;
+                int64_t refGpuTime = refGpu;
+                WriteTimeline( f, vec, begin, end, refTime, refGpuTime );
+            } );
+            return;
+        }
+        auto& zone = ZoneAt( vec, begin );
+        pw.Add( SaveGpuZoneBytes, [&zone, ref, refGpu] ( BufferWrite& f ) {
+            int64_t refTime = ref;
+            int64_t refGpuTime = refGpu;
+            WriteZoneHead( f, zone, refTime, refGpuTime );
+        } );
+        auto& children = GetGpuChildren( zone.Child() );
+        AddTimeline( pw, children, zone.CpuStart(), zone.GpuStart() );
+        auto& last = ZoneAt( children, children.size() - 1 );
+        pw.Add( 2 * sizeof( int64_t ), [&zone, ref = last.CpuEnd(), refGpu = last.GpuEnd()] ( BufferWrite& f ) {
+            int64_t refTime = ref;
+            int64_t refGpuTime = refGpu;
+            WriteTimeOffset( f, refTime, zone.CpuEnd() );
+            WriteTimeOffset( f, refGpuTime, zone.GpuEnd() );
+        } );
+    } );
+}
+
+template<typename W>
+void Worker::WriteTimeline( W& f, const Vector<short_ptr<ZoneEvent>>& vec, int64_t& refTime )
 {
     uint32_t sz = uint32_t( vec.size() );
     f.Write( &sz, sizeof( sz ) );
+    WriteTimeline( f, vec, 0, vec.size(), refTime );
+}
+
+template<typename W>
+void Worker::WriteTimeline( W& f, const Vector<short_ptr<ZoneEvent>>& vec, size_t begin, size_t end, int64_t& refTime )
+{
     if( vec.is_magic() )
     {
-        WriteTimelineImpl<VectorAdapterDirect<ZoneEvent>>( f, *(Vector<ZoneEvent>*)( &vec ), refTime );
+        WriteTimelineImpl<VectorAdapterDirect<ZoneEvent>>( f, *(Vector<ZoneEvent>*)( &vec ), begin, end, refTime );
     }
     else
     {
-        WriteTimelineImpl<VectorAdapterPointer<ZoneEvent>>( f, vec, refTime );
+        WriteTimelineImpl<VectorAdapterPointer<ZoneEvent>>( f, vec, begin, end, refTime );
     }
 }
 
-template<typename Adapter, typename V>
-void Worker::WriteTimelineImpl( FileWrite& f, const V& vec, int64_t& refTime )
+template<typename Adapter, typename W, typename V>
+void Worker::WriteTimelineImpl( W& f, const V& vec, size_t begin, size_t end, int64_t& refTime )
 {
     Adapter a;
-    for( auto& val : vec )
-    {
-        auto& v = a(val);
-        int16_t srcloc = v.SrcLoc();
-        f.Write( &srcloc, sizeof( srcloc ) );
-        int64_t start = v.Start();
-        WriteTimeOffset( f, refTime, start );
-        f.Write( &v.extra, sizeof( v.extra ) );
+    for( size_t i=begin; i<end; i++ )
+    {
+        auto& v = a(vec[i]);
+        WriteZoneHead( f, v, refTime );
         if( !v.HasChildren() )
         {
             const uint32_t sz = 0;
@@ -8285,35 +9098,35 @@ void Worker::WriteTimelineImpl( FileWrite& f, const V& vec, int64_t& refTime )
     }
 }
 
-void Worker::WriteTimeline( FileWrite& f, const Vector<short_ptr<GpuEvent>>& vec, int64_t& refTime, int64_t& refGpuTime )
+template<typename W>
+void Worker::WriteTimeline( W& f, const Vector<short_ptr<GpuEvent>>& vec, int64_t& refTime, int64_t& refGpuTime )
 {
     uint64_t sz = vec.size();
     f.Write( &sz, sizeof( sz ) );
+    WriteTimeline( f, vec, 0, vec.size(), refTime, refGpuTime );
+}
+
+template<typename W>
+void Worker::WriteTimeline( W& f, const Vector<short_ptr<GpuEvent>>& vec, size_t begin, size_t end, int64_t& refTime, int64_t& refGpuTime )
+{
     if( vec.is_magic() )
     {
-        WriteTimelineImpl<VectorAdapterDirect<GpuEvent>>( f, *(Vector<GpuEvent>*)( &vec ), refTime, refGpuTime );
+        WriteTimelineImpl<VectorAdapterDirect<GpuEvent>>( f, *(Vector<GpuEvent>*)( &vec ), begin, end, refTime, refGpuTime );
     }
     else
     {
-        WriteTimelineImpl<VectorAdapterPointer<GpuEvent>>( f, vec, refTime, refGpuTime );
+        WriteTimelineImpl<VectorAdapterPointer<GpuEvent>>( f, vec, begin, end, refTime, refGpuTime );
     }
 }
 
-template<typename Adapter, typename V>
-void Worker::WriteTimelineImpl( FileWrite& f, const V& vec, int64_t& refTime, int64_t& refGpuTime )
+template<typename Adapter, typename W, typename V>
+void Worker::WriteTimelineImpl( W& f, const V& vec, size_t begin, size_t end, int64_t& refTime, int64_t& refGpuTime )
 {
     Adapter a;
-    for( auto& val : vec )
+    for( size_t i=begin; i<end; i++ )
     {
-        auto& v = a(val);
-        WriteTimeOffset( f, refTime, v.CpuStart() );
-        WriteTimeOffset( f, refGpuTime, v.GpuStart() );
-        const int16_t srcloc = v.SrcLoc();
-        f.Write( &srcloc, sizeof( srcloc ) );
-        f.Write( &v.callstack, sizeof( v.callstack ) );
-        const uint16_t thread = v.Thread();
-        f.Write( &thread, sizeof( thread ) );
-
+        auto& v = a(vec[i]);
+        WriteZoneHead( f, v, refTime, refGpuTime );
         if( v.Child() < 0 )
         {
             const uint64_t sz = 0;
@@ -1,6 +1,7 @@
 #ifndef __TRACYWORKER_HPP__
 #define __TRACYWORKER_HPP__
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <limits>
@@ -30,8 +31,10 @@
 namespace tracy
 {
 
+class BufferWrite;
 class FileRead;
 class FileWrite;
+class PartWriter;
 
 namespace EventType
 {
@@ -95,6 +98,14 @@ struct LoadProgress
     std::atomic<uint64_t> subProgress;
 };
 
+struct SaveProgress
+{
+    SaveProgress() : total( 0 ), progress( 0 ) {}
+
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> progress;
+};
+
 class Worker
 {
 public:
@@ -123,6 +134,13 @@ public:
         std::vector<std::pair<int64_t, double>> data;
     };
 
+    struct ImportEventFrames
+    {
+        std::string name;
+        bool continuous;
+        std::vector<std::pair<int64_t, int64_t>> frames;
+    };
+
     struct ZoneThreadData
     {
         tracy_force_inline ZoneEvent* Zone() const { return (ZoneEvent*)( _zone_thread >> 16 ); }
@@ -212,8 +230,15 @@ private:
         int64_t nonReentrantMax = std::numeric_limits<int64_t>::min();
         int64_t nonReentrantTotal = 0;
         unordered_flat_map<uint16_t, uint64_t> threadCnt;
+
+        // Time index over the start-sorted zones: maximum zone end time for each block of
+        // ZoneIndexBlock zones, and for each super block of ZoneIndexBlock blocks.
+        Vector<int64_t> blockEnd;
+        Vector<int64_t> superEnd;
     };
 
+    enum { ZoneIndexBlock = 64 };
+
     struct GpuSourceLocationZones
     {
         struct GpuZtdSort { bool operator()( const GpuZoneThreadData& lhs, const GpuZoneThreadData& rhs ) { return lhs.Zone()->GpuStart() < rhs.Zone()->GpuStart(); } };
@@ -305,15 +330,16 @@ private:
 
         unordered_flat_map<uint64_t, SourceLocation> sourceLocation;
         Vector<short_ptr<SourceLocation>> sourceLocationPayload;
-        unordered_flat_map<const SourceLocation*, int16_t, SourceLocationHasher, SourceLocationComparator> sourceLocationPayloadMap;
+        unordered_flat_map<const SourceLocation*, uint32_t, SourceLocationHasher, SourceLocationComparator> sourceLocationPayloadMap;
         Vector<uint64_t> sourceLocationExpand;
+        unordered_flat_map<uint32_t, int32_t> zoneWideSrcLoc;
 #ifndef TRACY_NO_STATISTICS
-        unordered_flat_map<int16_t, SourceLocationZones> sourceLocationZones;
+        unordered_flat_map<int32_t, SourceLocationZones> sourceLocationZones;
         bool sourceLocationZonesReady = false;
         unordered_flat_map<int16_t, GpuSourceLocationZones> gpuSourceLocationZones;
         bool gpuSourceLocationZonesReady = false;
 #else
-        unordered_flat_map<int16_t, uint64_t> sourceLocationZonesCnt;
+        unordered_flat_map<int32_t, uint64_t> sourceLocationZonesCnt;
         unordered_flat_map<int16_t, uint64_t> gpuSourceLocationZonesCnt;
 #endif
 
@@ -380,10 +406,10 @@ private:
         uint64_t checkSrclocLast = 0;
         std::pair<uint64_t, uint16_t> shrinkSrclocLast = std::make_pair( std::numeric_limits<uint64_t>::max(), 0 );
 #ifndef TRACY_NO_STATISTICS
-        std::pair<uint16_t, SourceLocationZones*> srclocZonesLast = std::make_pair( 0, nullptr );
+        std::pair<int32_t, SourceLocationZones*> srclocZonesLast = std::make_pair( 0, nullptr );
         std::pair<uint16_t, GpuSourceLocationZones*> gpuZonesLast = std::make_pair( 0, nullptr );
 #else
-        std::pair<uint16_t, uint64_t*> srclocCntLast = std::make_pair( 0, nullptr );
+        std::pair<int32_t, uint64_t*> srclocCntLast = std::make_pair( 0, nullptr );
         std::pair<uint16_t, uint64_t*> gpuCntLast = std::make_pair( 0, nullptr );
 #endif
 
@@ -420,7 +446,7 @@ private:
     struct FailureData
     {
         uint64_t thread;
-        int16_t srcloc;
+        int32_t srcloc;
         uint32_t callstack;
         std::string message;
     };
@@ -453,6 +479,7 @@ public:
     };
 
     Worker( const char* addr, uint16_t port, int64_t memoryLimit );
+    Worker( const char* name, const char* program );
     Worker( const char* name, const char* program, const std::vector<ImportEventTimeline>& timeline, const std::vector<ImportEventMessages>& messages, const std::vector<ImportEventPlots>& plots, const std::unordered_map<uint64_t, std::string>& threadNames );
     Worker( FileRead& f, EventType::Type eventMask = EventType::All, bool bgTasks = true, bool allowStringModification = false);
     ~Worker();
@@ -584,7 +611,8 @@ public:
     const char* GetThreadName( uint64_t id ) const;
     bool IsThreadLocal( uint64_t id );
     bool IsThreadFiber( uint64_t id );
-    const SourceLocation& GetSourceLocation( int16_t srcloc ) const;
+    const SourceLocation& GetSourceLocation( int32_t srcloc ) const;
+    tracy_force_inline int32_t GetZoneSrcLoc( const ZoneEvent& zone ) const { const auto srcloc = zone.SrcLoc(); return srcloc != SrcLocWide ? srcloc : GetZoneSrcLocWide( zone ); }
     std::pair<const char*, const char*> GetExternalName( uint64_t id ) const;
 
     const char* GetZoneName( const SourceLocation& srcloc ) const;
@@ -594,6 +622,15 @@ public:
 
     tracy_force_inline const Vector<short_ptr<ZoneEvent>>& GetZoneChildren( int32_t idx ) const { return m_data.zoneChildren[idx]; }
     tracy_force_inline const Vector<short_ptr<GpuEvent>>& GetGpuChildren( int32_t idx ) const { return m_data.gpuChildren[idx]; }
+
+    // Calls func( const ZoneEvent&, int depth ) for each zone of the thread which overlaps the
+    // [t0, t1] time range. Only the subtrees overlapping the range are visited. The walk is
+    // aborted when func returns false, in which case false is returned.
+    template<class T>
+    bool QueryThreadZones( const ThreadData& thread, int64_t t0, int64_t t1, T&& func ) const
+    {
+        return QueryThreadZones( thread.timeline, t0, t1, 0, func );
+    }
 #ifndef TRACY_NO_STATISTICS
     tracy_force_inline const Vector<GhostZone>& GetGhostChildren( int32_t idx ) const { return m_data.ghostChildren[idx]; }
     tracy_force_inline const GhostKey& GetGhostFrame( const Int24& frame ) const { return m_data.ghostFrames[frame.Val()]; }
@@ -602,14 +639,60 @@ public:
     tracy_force_inline const bool HasZoneExtra( const ZoneEvent& ev ) const { return ev.extra != 0; }
     tracy_force_inline const ZoneExtra& GetZoneExtra( const ZoneEvent& ev ) const { return m_data.zoneExtra[ev.extra]; }
 
-    std::vector<int16_t> GetMatchingSourceLocation( const char* query, bool ignoreCase ) const;
+    std::vector<int32_t> GetMatchingSourceLocation( const char* query, bool ignoreCase ) const;
 
     const unordered_flat_map<uint64_t, SymbolData>& GetSymbolMap() const { return m_data.symbolMap; }
 
 #ifndef TRACY_NO_STATISTICS
-    SourceLocationZones& GetZonesForSourceLocation( int16_t srcloc );
-    const SourceLocationZones& GetZonesForSourceLocation( int16_t srcloc ) const;
-    const unordered_flat_map<int16_t, SourceLocationZones>& GetSourceLocationZones() const { return m_data.sourceLocationZones; }
+    SourceLocationZones& GetZonesForSourceLocation( int32_t srcloc );
+    const SourceLocationZones& GetZonesForSourceLocation( int32_t srcloc ) const;
+    const unordered_flat_map<int32_t, SourceLocationZones>& GetSourceLocationZones() const { return m_data.sourceLocationZones; }
+
+    // Calls func( const ZoneThreadData& ) for each zone of the source location which overlaps
+    // the [t0, t1] time range, in start time order. Unfinished zones are treated as never ending.
+    template<class T>
+    void QueryZones( int32_t srcloc, int64_t t0, int64_t t1, T&& func )
+    {
+        auto& slz = GetZonesForSourceLocation( srcloc );
+        if( slz.zones.empty() ) return;
+        UpdateZoneTimeIndex( slz );
+
+        const auto zones = slz.zones.data();
+        const size_t hi = std::upper_bound( slz.zones.begin(), slz.zones.end(), t1, [] ( const auto& l, const auto& r ) { return l < r.Zone()->Start(); } ) - zones;
+        const size_t indexed = std::min<size_t>( hi, slz.blockEnd.size() * ZoneIndexBlock );
+        constexpr size_t SuperBlock = ZoneIndexBlock * ZoneIndexBlock;
+
+        size_t i = 0;
+        while( i < indexed )
+        {
+            if( i % SuperBlock == 0 && i / SuperBlock < slz.superEnd.size() && slz.superEnd[i / SuperBlock] < t0 )
+            {
+                i += SuperBlock;
+                continue;
+            }
+            if( slz.blockEnd[i / ZoneIndexBlock] < t0 )
+            {
+                i += ZoneIndexBlock;
+                continue;
+            }
+            const auto be = std::min<size_t>( i + ZoneIndexBlock, hi );
+            for( ; i<be; i++ )
+            {
+                if( ZoneEndOrMax( *zones[i].Zone() ) >= t0 ) func( zones[i] );
+            }
+        }
+        for( ; i<hi; i++ )
+        {
+            if( ZoneEndOrMax( *zones[i].Zone() ) >= t0 ) func( zones[i] );
+        }
+    }
+    // Brings the time index of the source location up to date. Afterwards QueryZones() only
+    // reads data and may be called from other threads, as long as no zones are added.
+    void PrepareQueryZones( int32_t srcloc )
+    {
+        auto& slz = GetZonesForSourceLocation( srcloc );
+        if( !slz.zones.empty() ) UpdateZoneTimeIndex( slz );
+    }
     const unordered_flat_map<int16_t, GpuSourceLocationZones>& GetGpuSourceLocationZones() const { return m_data.gpuSourceLocationZones; }
     bool AreSourceLocationZonesReady() const { return m_data.sourceLocationZonesReady; }
     bool AreGpuSourceLocationZonesReady() const { return m_data.gpuSourceLocationZonesReady; }
@@ -652,6 +735,7 @@ public:
     bool AreSamplesInconsistent() const { return m_inconsistentSamples; }
 
     static const LoadProgress& GetLoadProgress() { return s_loadProgress; }
+    const SaveProgress& GetSaveProgress() const { return m_saveProgress; }
     int64_t GetLoadTime() const { return m_loadTime; }
 
     void ClearFailure() { m_failure = Failure::None; }
@@ -678,6 +762,18 @@ public:
 
     StringLocation StoreString(const char* str, size_t sz);
 
+    // Incremental import into a worker created with the (name, program) constructor. Zones have
+    // to be passed in time order within each thread, and ImportFinish() has to be called last.
+    int32_t ImportSourceLocation( uint32_t name, uint32_t file, uint32_t line );
+    void ImportZoneBegin( uint64_t tid, int64_t time, int32_t srcloc, StringIdx text );
+    void ImportZoneEnd( uint64_t tid, int64_t time );
+    // Messages containing the word "frame" are turned into frames, unless frameMessages is false.
+    void ImportMessages( const std::vector<ImportEventMessages>& messages, bool frameMessages = true );
+    // An empty name selects the default frame set. Frames have to be sorted by start time.
+    void ImportFrames( const std::vector<ImportEventFrames>& frames );
+    void ImportPlots( const std::vector<ImportEventPlots>& plots );
+    void ImportFinish( const std::unordered_map<uint64_t, std::string>& threadNames );
+
 private:
     void Network();
     void Exec();
@@ -832,13 +928,47 @@ private:
 
     tracy_force_inline ThreadData* GetCurrentThreadData();
 
+    static tracy_force_inline int64_t ZoneEndOrMax( const ZoneEvent& zone ) { return zone.IsEndValid() ? zone.End() : std::numeric_limits<int64_t>::max(); }
+    static tracy_force_inline const ZoneEvent& ZoneRef( const ZoneEvent& zone ) { return zone; }
+    static tracy_force_inline const ZoneEvent& ZoneRef( const short_ptr<ZoneEvent>& zone ) { return *zone; }
+
+    template<class T>
+    bool QueryThreadZones( const Vector<short_ptr<ZoneEvent>>& vec, int64_t t0, int64_t t1, int depth, T& func ) const
+    {
+        if( vec.is_magic() )
+        {
+            return QueryThreadZonesImpl( *(const Vector<ZoneEvent>*)&vec, t0, t1, depth, func );
+        }
+        else
+        {
+            return QueryThreadZonesImpl( vec, t0, t1, depth, func );
+        }
+    }
+
+    template<class V, class T>
+    bool QueryThreadZonesImpl( const V& vec, int64_t t0, int64_t t1, int depth, T& func ) const
+    {
+        // Siblings don't overlap, so both start and end times are ordered.
+        auto it = std::lower_bound( vec.begin(), vec.end(), t0, [] ( const auto& l, const auto& r ) { return ZoneEndOrMax( ZoneRef( l ) ) < r; } );
+        for( ; it != vec.end(); ++it )
+        {
+            auto& zone = ZoneRef( *it );
+            if( zone.Start() > t1 ) break;
+            if( !func( zone, depth ) ) return false;
+            if( zone.HasChildren() && !QueryThreadZones( GetZoneChildren( zone.Child() ), t0, t1, depth+1, func ) ) return false;
+        }
+        return true;
+    }
+
 #ifndef TRACY_NO_STATISTICS
-    SourceLocationZones* GetSourceLocationZones( uint16_t srcloc )
+    void UpdateZoneTimeIndex( SourceLocationZones& slz );
+
+    SourceLocationZones* GetSourceLocationZones( int32_t srcloc )
     {
         if( m_data.srclocZonesLast.first == srcloc ) return m_data.srclocZonesLast.second;
         return GetSourceLocationZonesReal( srcloc );
     }
-    SourceLocationZones* GetSourceLocationZonesReal( uint16_t srcloc );
+    SourceLocationZones* GetSourceLocationZonesReal( int32_t srcloc );
 
     GpuSourceLocationZones* GetGpuSourceLocationZones( uint16_t srcloc )
     {
@@ -847,12 +977,12 @@ private:
     }
     GpuSourceLocationZones* GetGpuSourceLocationZonesReal( uint16_t srcloc );
 #else
-    uint64_t* GetSourceLocationZonesCnt( uint16_t srcloc )
+    uint64_t* GetSourceLocationZonesCnt( int32_t srcloc )
     {
         if( m_data.srclocCntLast.first == srcloc ) return m_data.srclocCntLast.second;
         return GetSourceLocationZonesCntReal( srcloc );
     }
-    uint64_t* GetSourceLocationZonesCntReal( uint16_t srcloc );
+    uint64_t* GetSourceLocationZonesCntReal( int32_t srcloc );
 
     uint64_t* GetGpuSourceLocationZonesCnt( uint16_t srcloc )
     {
@@ -898,7 +1028,7 @@ private:
     void HandlePostponedGhostZones();
 
     bool IsFailureThreadStringRetrieved();
-    bool IsSourceLocationRetrieved( int16_t srcloc );
+    bool IsSourceLocationRetrieved( int32_t srcloc );
     bool IsCallstackRetrieved( uint32_t callstack );
     bool HasAllFailureData();
     void HandleFailure( const char* ptr, const char* end );
@@ -919,6 +1049,9 @@ private:
 
 #ifndef TRACY_NO_STATISTICS
     void ReconstructContextSwitchUsage();
+    template<typename R> bool ReadSourceLocationZones( R& Read );
+    void WriteStatisticsCache( FileWrite& f );
+    void ReadStatisticsCache( FileRead& f );
     bool UpdateSampleStatistics( uint32_t callstack, uint32_t count, bool canPostpone );
     void UpdateSampleStatisticsPostponed( decltype(Worker::DataBlock::postponedSamples.begin())& it );
     void UpdateSampleStatisticsImpl( const CallstackFrameData** frames, uint16_t framesCount, uint32_t count, const VarArray<CallstackFrameId>& cs );
@@ -932,7 +1065,15 @@ private:
     tracy_force_inline void ReadTimelineHaveSize( FileRead& f, GpuEvent* zone, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx, uint64_t sz );
 
 #ifndef TRACY_NO_STATISTICS
-    tracy_force_inline void ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint16_t thread );
+    struct ZoneStackCount
+    {
+        uint8_t compact[64*1024];
+        unordered_flat_map<int32_t, uint8_t> wide;
+
+        tracy_force_inline uint8_t& operator[]( int32_t srcloc ) { return IsSrcLocCompact( srcloc ) ? compact[uint16_t(srcloc)] : wide[srcloc]; }
+    };
+
+    tracy_force_inline void ReconstructZoneStatistics( ZoneStackCount& countMap, ZoneEvent& zone, uint16_t thread );
     tracy_force_inline void ReconstructZoneStatistics( GpuEvent& zone, uint16_t thread );
 #else
     tracy_force_inline void CountZoneStatistics( ZoneEvent* zone );
@@ -943,6 +1084,9 @@ private:
     tracy_force_inline ZoneExtra& AllocZoneExtra( ZoneEvent& ev );
     tracy_force_inline ZoneExtra& RequestZoneExtra( ZoneEvent& ev );
 
+    int32_t GetZoneSrcLocWide( const ZoneEvent& zone ) const;
+    void SetZoneStartSrcLoc( ZoneEvent& zone, int64_t start, int32_t srcloc );
+
     int64_t GetZoneEndImpl( const ZoneEvent& ev );
     int64_t GetZoneEndImpl( const GpuEvent& ev );
 
@@ -951,12 +1095,22 @@ private:
     int64_t ReadTimeline( FileRead& f, Vector<short_ptr<ZoneEvent>>& vec, uint32_t size, int64_t refTime, int32_t& childIdx );
     void ReadTimeline( FileRead& f, Vector<short_ptr<GpuEvent>>& vec, uint64_t size, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx );
 
-    tracy_force_inline void WriteTimeline( FileWrite& f, const Vector<short_ptr<ZoneEvent>>& vec, int64_t& refTime );
-    tracy_force_inline void WriteTimeline( FileWrite& f, const Vector<short_ptr<GpuEvent>>& vec, int64_t& refTime, int64_t& refGpuTime );
-    template<typename Adapter, typename V>
-    void WriteTimelineImpl( FileWrite& f, const V& vec, int64_t& refTime );
-    template<typename Adapter, typename V>
-    void WriteTimelineImpl( FileWrite& f, const V& vec, int64_t& refTime, int64_t& refGpuTime );
+    void AddThreadData( PartWriter& pw, ThreadData& thread );
+    void AddGpuData( PartWriter& pw, const GpuCtxData& ctx );
+    void AddTimeline( PartWriter& pw, const Vector<short_ptr<ZoneEvent>>& vec, int64_t refTime );
+    void AddTimeline( PartWriter& pw, const Vector<short_ptr<GpuEvent>>& vec, int64_t refTime, int64_t refGpuTime );
+    template<typename W>
+    tracy_force_inline void WriteTimeline( W& f, const Vector<short_ptr<ZoneEvent>>& vec, int64_t& refTime );
+    template<typename W>
+    tracy_force_inline void WriteTimeline( W& f, const Vector<short_ptr<ZoneEvent>>& vec, size_t begin, size_t end, int64_t& refTime );
+    template<typename W>
+    tracy_force_inline void WriteTimeline( W& f, const Vector<short_ptr<GpuEvent>>& vec, int64_t& refTime, int64_t& refGpuTime );
+    template<typename W>
+    tracy_force_inline void WriteTimeline( W& f, const Vector<short_ptr<GpuEvent>>& vec, size_t begin, size_t end, int64_t& refTime, int64_t& refGpuTime );
+    template<typename Adapter, typename W, typename V>
+    void WriteTimelineImpl( W& f, const V& vec, size_t begin, size_t end, int64_t& refTime );
+    template<typename Adapter, typename W, typename V>
+    void WriteTimelineImpl( W& f, const V& vec, size_t begin, size_t end, int64_t& refTime, int64_t& refGpuTime );
 
     int64_t TscTime( int64_t tsc ) { return int64_t( ( tsc - m_data.baseTime ) * m_timerMul ); }
     int64_t TscTime( uint64_t tsc ) { return int64_t( ( tsc - m_data.baseTime ) * m_timerMul ); }
@@ -974,6 +1128,7 @@ private:
 
     std::atomic<bool> m_backgroundDone { true };
     std::thread m_threadBackground;
+    bool m_statisticsCached = false;
 
     int64_t m_delay;
     int64_t m_resolution;
@@ -1002,7 +1157,7 @@ private:
 
     short_ptr<GpuCtxData> m_gpuCtxMap[256];
     uint32_t m_pendingCallstackId = 0;
-    int16_t m_pendingSourceLocationPayload = 0;
+    int32_t m_pendingSourceLocationPayload = 0;
     Vector<uint64_t> m_sourceLocationQueue;
     unordered_flat_map<uint64_t, int16_t> m_sourceLocationShrink;
     unordered_flat_map<uint64_t, ThreadData*> m_threadMap;
@@ -1042,6 +1197,7 @@ private:
 
     static LoadProgress s_loadProgress;
     int64_t m_loadTime;
+    SaveProgress m_saveProgress;
 
     Failure m_failure = Failure::None;
     FailureData m_failureData = {};
@@ -0,0 +1,275 @@
+#ifndef __TRACYZONETREE_HPP__
+#define __TRACYZONETREE_HPP__
+
+#include <algorithm>
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "TracyWorker.hpp"
+
+namespace tracy
+{
+
+template<typename T>
+static tracy_force_inline const T& ZoneAt( const Vector<short_ptr<T>>& vec, size_t idx )
+{
+    return vec.is_magic() ? (*(const Vector<T>*)&vec)[idx] : *vec[idx];
+}
+
+// Number of zones in the subtree, counted up to the limit.
+static inline size_t CountZones( const Worker& worker, const ZoneEvent& zone, size_t limit )
+{
+    size_t cnt = 1;
+    if( zone.HasChildren() )
+    {
+        auto& children = worker.GetZoneChildren( zone.Child() );
+        for( size_t i=0; i<children.size() && cnt < limit; i++ )
+        {
+            cnt += CountZones( worker, ZoneAt( children, i ), limit - cnt );
+        }
+    }
+    return cnt;
+}
+
+static inline size_t CountZones( const Worker& worker, const GpuEvent& zone, size_t limit )
+{
+    size_t cnt = 1;
+    if( zone.Child() >= 0 )
+    {
+        auto& children = worker.GetGpuChildren( zone.Child() );
+        for( size_t i=0; i<children.size() && cnt < limit; i++ )
+        {
+            cnt += CountZones( worker, ZoneAt( children, i ), limit - cnt );
+        }
+    }
+    return cnt;
+}
+
+// Splits a list of zones into ranges of consecutive zones with at most limit zones in their
+// subtrees, calling func( begin, end, large ) for each range in order. A zone with a larger
+// subtree is passed on its own with the large flag set, the caller decides how to split it.
+template<typename T, typename F>
+static void SplitZones( const Worker& worker, const Vector<short_ptr<T>>& vec, size_t limit, F&& func )
+{
+    size_t begin = 0;
+    size_t zones = 0;
+    const auto size = vec.size();
+    for( size_t idx=0; idx<size; idx++ )
+    {
+        const auto cnt = CountZones( worker, ZoneAt( vec, idx ), limit );
+        if( cnt >= limit )
+        {
+            if( begin != idx ) func( begin, idx, false );
+            func( idx, idx + 1, true );
+            begin = idx + 1;
+            zones = 0;
+        }
+        else
+        {
+            if( zones + cnt > limit )
+            {
+                func( begin, idx, false );
+                begin = idx;
+                zones = 0;
+            }
+            zones += cnt;
+        }
+    }
+    if( begin != size ) func( begin, size, false );
+}
+
+// Depth first walk over the zone tree of a thread, limited to the zones overlapping the t0 to t1
+// range. The walk can be suspended when the budget runs out and resumed later, also in the
+// middle of a subtree. Each zone uses one unit of the budget.
+//
+// The visitor is called with:
+//   uint32_t Enter( const ZoneEvent& zone, int depth, uint32_t parent ) - before the children
+//   void Leave( const ZoneEvent& zone, int depth, uint32_t data ) - after all of the children
+// The value returned by Enter() is passed to Leave() and to the children as their parent. Top
+// level zones get the value passed to Walk().
+//
+// Zones which haven't ended yet are handled as selected by the Open mode.
+class ZoneTreeWalker
+{
+public:
+    enum class Open
+    {
+        Wait,       // the walk is suspended before the zone until it ends
+        Enter,      // the zone and its finished children are visited, Leave() is called once it ends
+        Ended       // the zone is treated as ended, as in saved traces, where it never will
+    };
+
+    ZoneTreeWalker( int64_t t0, int64_t t1, Open open )
+        : m_t0( t0 )
+        , m_t1( t1 )
+        , m_open( open )
+        , m_pos( std::numeric_limits<size_t>::max() )
+        , m_done( false )
+    {
+    }
+
+    // Returns true if all zones available at this point were visited.
+    template<typename V>
+    bool Walk( const Worker& worker, const Vector<short_ptr<ZoneEvent>>& timeline, uint32_t root, size_t& budget, V&& visitor )
+    {
+        if( m_done ) return true;
+        if( m_pos == std::numeric_limits<size_t>::max() ) m_pos = FirstZone( timeline );
+        for(;;)
+        {
+            if( m_stack.empty() )
+            {
+                if( m_pos == timeline.size() ) return true;
+                auto& zone = ZoneAt( timeline, m_pos );
+                if( zone.Start() > m_t1 )
+                {
+                    m_done = true;
+                    return true;
+                }
+                if( budget == 0 || !CanEnter( zone ) ) return false;
+                EnterZone( worker, zone, root, budget, visitor );
+            }
+            if( !WalkChildren( worker, timeline, budget, visitor ) ) return false;
+            m_pos++;
+        }
+    }
+
+    // Calls func( zone, depth, data ) for each zone which was entered, but not left yet, starting
+    // at the top level. The data is the value returned by Enter().
+    template<typename F>
+    void ForEachEntered( const Worker& worker, const Vector<short_ptr<ZoneEvent>>& timeline, F&& func ) const
+    {
+        for( size_t i=0; i<m_stack.size(); i++ )
+        {
+            func( FrameZone( worker, timeline, i ), int( i ), m_stack[i].data );
+        }
+    }
+
+private:
+    // Position in the children list of each zone on the path to the next zone to visit. Children
+    // lists are referenced by index, as the list of all children lists may be reallocated while
+    // the worker data lock is not held. Open zones without children yet have no list.
+    struct Frame
+    {
+        int32_t child;
+        uint32_t pos;
+        uint32_t data;
+    };
+
+    bool CanEnter( const ZoneEvent& zone ) const
+    {
+        return m_open != Open::Wait || zone.IsEndValid();
+    }
+
+    bool IsOpen( const ZoneEvent& zone ) const
+    {
+        return m_open == Open::Enter && !zone.IsEndValid();
+    }
+
+    // Index of the first zone which doesn't end before the range start.
+    size_t FirstZone( const Vector<short_ptr<ZoneEvent>>& vec ) const
+    {
+        if( m_t0 == std::numeric_limits<int64_t>::min() ) return 0;
+        auto cmp = [] ( const auto& l, const auto& r ) { auto& z = Ref( l ); return z.IsEndValid() && z.End() < r; };
+        if( vec.is_magic() )
+        {
+            auto& v = *(const Vector<ZoneEvent>*)&vec;
+            return std::distance( v.begin(), std::lower_bound( v.begin(), v.end(), m_t0, cmp ) );
+        }
+        else
+        {
+            return std::distance( vec.begin(), std::lower_bound( vec.begin(), vec.end(), m_t0, cmp ) );
+        }
+    }
+
+    static tracy_force_inline const ZoneEvent& Ref( const ZoneEvent& zone ) { return zone; }
+    static tracy_force_inline const ZoneEvent& Ref( const short_ptr<ZoneEvent>& zone ) { return *zone; }
+
+    // The zone of a frame is found through its parent, as zones are not referenced directly.
+    const ZoneEvent& FrameZone( const Worker& worker, const Vector<short_ptr<ZoneEvent>>& timeline, size_t idx ) const
+    {
+        if( idx == 0 ) return ZoneAt( timeline, m_pos );
+        auto& parent = m_stack[idx-1];
+        return ZoneAt( worker.GetZoneChildren( parent.child ), parent.pos - 1 );
+    }
+
+    template<typename V>
+    void EnterZone( const Worker& worker, const ZoneEvent& zone, uint32_t parent, size_t& budget, V& visitor )
+    {
+        const auto depth = int( m_stack.size() );
+        const auto data = visitor.Enter( zone, depth, parent );
+        budget--;
+        if( zone.HasChildren() )
+        {
+            const auto child = zone.Child();
+            m_stack.emplace_back( Frame { child, uint32_t( FirstZone( worker.GetZoneChildren( child ) ) ), data } );
+        }
+        else if( IsOpen( zone ) )
+        {
+            m_stack.emplace_back( Frame { -1, 0, data } );
+        }
+        else
+        {
+            visitor.Leave( zone, depth, data );
+        }
+    }
+
+    template<typename V>
+    void LeaveZone( const ZoneEvent& zone, V& visitor )
+    {
+        const auto depth = int( m_stack.size() - 1 );
+        const auto data = m_stack.back().data;
+        m_stack.pop_back();
+        visitor.Leave( zone, depth, data );
+    }
+
+    template<typename V>
+    bool WalkChildren( const Worker& worker, const Vector<short_ptr<ZoneEvent>>& timeline, size_t& budget, V& visitor )
+    {
+        while( !m_stack.empty() )
+        {
+            auto& frame = m_stack.back();
+            if( frame.child < 0 )
+            {
+                // Open zone, which had no children yet when it was entered.
+                auto& zone = FrameZone( worker, timeline, m_stack.size() - 1 );
+                if( zone.HasChildren() )
+                {
+                    frame.child = zone.Child();
+                    frame.pos = uint32_t( FirstZone( worker.GetZoneChildren( frame.child ) ) );
+                }
+                else
+                {
+                    if( IsOpen( zone ) ) return false;
+                    LeaveZone( zone, visitor );
+                    continue;
+                }
+            }
+            auto& vec = worker.GetZoneChildren( frame.child );
+            if( frame.pos == vec.size() || ZoneAt( vec, frame.pos ).Start() > m_t1 )
+            {
+                // An open zone may still get more children.
+                auto& zone = FrameZone( worker, timeline, m_stack.size() - 1 );
+                if( IsOpen( zone ) ) return false;
+                LeaveZone( zone, visitor );
+                continue;
+            }
+            auto& zone = ZoneAt( vec, frame.pos );
+            if( budget == 0 || !CanEnter( zone ) ) return false;
+            frame.pos++;
+            EnterZone( worker, zone, frame.data, budget, visitor );
+        }
+        return true;
+    }
+
+    int64_t m_t0, m_t1;
+    Open m_open;
+    size_t m_pos;
+    bool m_done;
+    std::vector<Frame> m_stack;
+};
+
+}
+
+#endif
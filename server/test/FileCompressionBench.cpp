@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../TracyFileRead.hpp"
+#include "../TracyFileWrite.hpp"
+#include "../TracyWorker.hpp"
+#include "../../zstd/zstd.h"
+
+// Compares the compression ratio and the decompression speed of the FileCompression modes on
+// a real trace. The trace is saved once in each mode to a scratch file, which is then read back
+// the same way the profiler loads it. Dictionary blocks can also be decompressed on their own,
+// so for them the time to decompress a random block is measured as well.
+//
+// Usage: tracy-filecompression-bench input.tracy [scratch file] [runs]
+
+struct Mode
+{
+    const char* name;
+    tracy::FileCompression comp;
+    int level;
+};
+
+static double Seconds( std::chrono::high_resolution_clock::time_point t0 )
+{
+    return std::chrono::duration<double>( std::chrono::high_resolution_clock::now() - t0 ).count();
+}
+
+static double Median( std::vector<double> v )
+{
+    std::sort( v.begin(), v.end() );
+    return v[v.size() / 2];
+}
+
+static size_t FileSize( const char* fn )
+{
+    auto f = fopen( fn, "rb" );
+    if( !f ) return 0;
+    fseek( f, 0, SEEK_END );
+    const auto sz = (size_t)ftell( f );
+    fclose( f );
+    return sz;
+}
+
+// Decompresses the whole file with FileRead, using a single stream.
+static size_t DecodeAll( const char* fn )
+{
+    auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( fn ) );
+    size_t size = 0;
+    const char* ptr;
+    while( const auto sz = f->ReadChunk( ptr ) ) size += sz;
+    return size;
+}
+
+// Decompresses randomly picked blocks of a ZstdDict file, each on its own. Returns the
+// median time per block.
+static double DecodeRandomBlocks( const char* fn, int count )
+{
+    std::vector<char> data( FileSize( fn ) );
+    auto f = fopen( fn, "rb" );
+    const auto read = fread( data.data(), 1, data.size(), f );
+    fclose( f );
+    if( read != data.size() ) return 0;
+
+    // header, compression type and stream count, then the dictionary and the blocks
+    size_t offset = sizeof( tracy::TracyHeader ) + 2;
+    uint32_t sz;
+    memcpy( &sz, data.data() + offset, sizeof( sz ) );
+    offset += sizeof( sz );
+    auto ddict = ZSTD_createDDict( data.data() + offset, sz );
+    offset += sz;
+
+    std::vector<std::pair<size_t, uint32_t>> blocks;
+    while( offset < data.size() )
+    {
+        memcpy( &sz, data.data() + offset, sizeof( sz ) );
+        offset += sizeof( sz );
+        blocks.emplace_back( offset, sz );
+        offset += sz;
+    }
+
+    auto dctx = ZSTD_createDCtx();
+    auto buf = std::make_unique<char[]>( tracy::FileBufSize );
+    std::mt19937 rng( 0 );
+    std::vector<double> times;
+    for( int i=0; i<count; i++ )
+    {
+        auto& block = blocks[rng() % blocks.size()];
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        const auto ret = ZSTD_decompress_usingDDict( dctx, buf.get(), tracy::FileBufSize, data.data() + block.first, block.second, ddict );
+        times.push_back( Seconds( t0 ) );
+        if( ZSTD_isError( ret ) )
+        {
+            fprintf( stderr, "Block decompression failed: %s\n", ZSTD_getErrorName( ret ) );
+            exit( 1 );
+        }
+    }
+    ZSTD_freeDCtx( dctx );
+    ZSTD_freeDDict( ddict );
+    return Median( times );
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: tracy-filecompression-bench input.tracy [scratch file] [runs]\n" );
+        return 1;
+    }
+    const char* input = argv[1];
+    const char* scratch = argc > 2 ? argv[2] : "tracy-filecompression-bench.tmp";
+    const int runs = argc > 3 ? atoi( argv[3] ) : 5;
+
+    auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( input ) );
+    if( !f )
+    {
+        fprintf( stderr, "Cannot open %s!\n", input );
+        return 1;
+    }
+    tracy::Worker worker( *f, tracy::EventType::All, false );
+    f.reset();
+
+    const Mode modes[] = {
+        { "lz4", tracy::FileCompression::Fast, 1 },
+        { "lz4hc", tracy::FileCompression::Slow, 1 },
+        { "zstd 1", tracy::FileCompression::Zstd, 1 },
+        { "zstd 3", tracy::FileCompression::Zstd, 3 },
+        { "zstd 9", tracy::FileCompression::Zstd, 9 },
+        { "dict zstd 1", tracy::FileCompression::ZstdDict, 1 },
+        { "dict zstd 3", tracy::FileCompression::ZstdDict, 3 },
+        { "dict zstd 9", tracy::FileCompression::ZstdDict, 9 },
+    };
+
+    printf( "%-12s %12s %8s %9s %12s %14s\n", "mode", "size", "ratio", "save", "decode", "random block" );
+    for( auto& mode : modes )
+    {
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        std::vector<char> dict;
+        if( mode.comp == tracy::FileCompression::ZstdDict )
+        {
+            auto sampler = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::OpenSampler() );
+            worker.Write( *sampler, false );
+            sampler->Finish();
+            dict = sampler->TrainDictionary();
+            if( dict.empty() )
+            {
+                fprintf( stderr, "Not enough data to train dictionary!\n" );
+                return 1;
+            }
+        }
+        auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( scratch, mode.comp, mode.level, 1, dict.empty() ? nullptr : &dict ) );
+        if( !w )
+        {
+            fprintf( stderr, "Cannot open %s!\n", scratch );
+            return 1;
+        }
+        worker.Write( *w, false );
+        w->Finish();
+        const auto raw = w->GetCompressionStatistics().first;
+        w.reset();
+        const auto tSave = Seconds( t0 );
+        const auto size = FileSize( scratch );
+
+        std::vector<double> times;
+        for( int i=0; i<runs; i++ )
+        {
+            const auto t1 = std::chrono::high_resolution_clock::now();
+            if( DecodeAll( scratch ) != raw )
+            {
+                fprintf( stderr, "Decompressed size mismatch in mode %s!\n", mode.name );
+                return 1;
+            }
+            times.push_back( Seconds( t1 ) );
+        }
+        const auto tDecode = Median( times );
+
+        char block[32] = "-";
+        if( mode.comp == tracy::FileCompression::ZstdDict )
+        {
+            snprintf( block, sizeof( block ), "%.1f us", DecodeRandomBlocks( scratch, 1000 ) * 1e6 );
+        }
+
+        printf( "%-12s %9.2f MB %7.2f%% %7.2f s %7.0f MB/s %14s\n", mode.name, size / ( 1024. * 1024 ), 100. * size / raw,
+            tSave, raw / ( 1024. * 1024 ) / tDecode, block );
+    }
+
+    remove( scratch );
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "TracyTest.hpp"
+#include "../TracyEvent.hpp"
+
+namespace tracy
+{
+
+static void CheckRange( const PlotLod& lod, const std::vector<PlotItem>& data, size_t i0, size_t i1 )
+{
+    uint32_t imin, imax;
+    double sum;
+    lod.Query( data.data(), i0, i1, imin, imax, sum );
+    TRACY_CHECK( imin >= i0 && imin < i1 );
+    TRACY_CHECK( imax >= i0 && imax < i1 );
+
+    double min = data[i0].val, max = data[i0].val, ref = 0;
+    for( size_t i=i0; i<i1; i++ )
+    {
+        min = std::min( min, data[i].val );
+        max = std::max( max, data[i].val );
+        ref += data[i].val;
+    }
+    TRACY_CHECK( data[imin].val == min );
+    TRACY_CHECK( data[imax].val == max );
+    TRACY_CHECK( fabs( sum - ref ) <= 1e-9 * ( i1 - i0 ) * 1000 );
+}
+
+static void CheckRanges( const PlotLod& lod, const std::vector<PlotItem>& data, uint32_t& seed )
+{
+    const auto rnd = [&seed] { seed = seed * 1664525 + 1013904223; return seed >> 8; };
+    for( int i=0; i<200; i++ )
+    {
+        const auto i0 = rnd() % data.size();
+        const auto len = i % 4 == 0 ? rnd() % 100 : rnd() % ( data.size() - i0 );
+        CheckRange( lod, data, i0, std::min( data.size(), i0 + 1 + len ) );
+    }
+    CheckRange( lod, data, 0, data.size() );
+}
+
+// Queries over any item range, covered by the summary or not, have to match a linear scan.
+static void TestQuery()
+{
+    uint32_t seed = 3;
+    const auto rnd = [&seed] { seed = seed * 1664525 + 1013904223; return seed >> 8; };
+    std::vector<PlotItem> data;
+    PlotLod lod;
+    TRACY_CHECK( lod.Covered() == 0 );
+    for( int step=0; step<20; step++ )
+    {
+        const auto cnt = rnd() % 5000;
+        for( uint32_t i=0; i<cnt; i++ ) data.emplace_back( PlotItem { Int48( int64_t( data.size() ) ), double( int( rnd() % 20001 ) - 10000 ) / 100 } );
+        if( data.empty() ) continue;
+        lod.Update( data.data(), data.size() );
+        TRACY_CHECK( lod.Covered() == data.size() / PlotLod::LeafSize * PlotLod::LeafSize );
+        CheckRanges( lod, data, seed );
+    }
+}
+
+// Items changed after they were summarized are handled by dropping the nodes covering them.
+static void TestInvalidate()
+{
+    uint32_t seed = 5;
+    std::vector<PlotItem> data;
+    for( int i=0; i<10000; i++ ) data.emplace_back( PlotItem { Int48( i ), sin( i * 0.01 ) * 100 } );
+    PlotLod lod;
+    lod.Update( data.data(), data.size() );
+
+    const size_t idx = 4321;
+    data[idx].val = 1000;
+    data[idx+500].val = -1000;
+    lod.Invalidate( idx );
+    TRACY_CHECK( lod.Covered() == idx / PlotLod::LeafSize * PlotLod::LeafSize );
+    CheckRanges( lod, data, seed );
+
+    lod.Update( data.data(), data.size() );
+    TRACY_CHECK( lod.Covered() == data.size() / PlotLod::LeafSize * PlotLod::LeafSize );
+    CheckRanges( lod, data, seed );
+
+    uint32_t imin, imax;
+    double sum;
+    lod.Query( data.data(), 0, data.size(), imin, imax, sum );
+    TRACY_CHECK( imax == idx && imin == idx + 500 );
+}
+
+}
+
+TRACY_TEST_MAIN( tracy::TestQuery, tracy::TestInvalidate )
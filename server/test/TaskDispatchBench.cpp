@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#include "../TracyTaskDispatch.hpp"
+
+// Measures the TaskDispatch overhead. Only Queue() and Sync() are used, so that the same
+// source can be built against older versions of the dispatcher for comparison.
+//
+// Usage: tracy-taskdispatch-bench [workers] [runs]
+
+static std::atomic<uint64_t> s_sink;
+
+static void Spin( int iterations )
+{
+    uint64_t v = 0;
+    for( int i=0; i<iterations; i++ ) v = v * 6364136223846793005ull + 1442695040888963407ull;
+    s_sink.fetch_add( v, std::memory_order_relaxed );
+}
+
+template<typename F>
+static void Measure( const char* name, int runs, const F& func )
+{
+    std::vector<double> times;
+    for( int i=0; i<runs; i++ )
+    {
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        func();
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        times.push_back( std::chrono::duration<double, std::milli>( t1 - t0 ).count() );
+    }
+    std::sort( times.begin(), times.end() );
+    printf( "%-32s median %9.2f ms   min %9.2f ms\n", name, times[times.size() / 2], times[0] );
+}
+
+int main( int argc, char** argv )
+{
+    const int workers = argc > 1 ? atoi( argv[1] ) : std::max<int>( 1, std::thread::hardware_concurrency() - 1 );
+    const int runs = argc > 2 ? atoi( argv[2] ) : 11;
+    printf( "%i workers, %i hardware threads, %i runs\n", workers, (int)std::thread::hardware_concurrency(), runs );
+
+    tracy::TaskDispatch td( workers, "Bench" );
+
+    Measure( "400k empty tasks", runs, [&td] {
+        for( int i=0; i<400000; i++ ) td.Queue( [] { s_sink.fetch_add( 1, std::memory_order_relaxed ); } );
+        td.Sync();
+    } );
+    Measure( "20k tasks of ~10 us", runs, [&td] {
+        for( int i=0; i<20000; i++ ) td.Queue( [] { Spin( 5000 ); } );
+        td.Sync();
+    } );
+    Measure( "10k rounds of 16 tasks + sync", runs, [&td] {
+        for( int r=0; r<10000; r++ )
+        {
+            for( int i=0; i<16; i++ ) td.Queue( [] { Spin( 100 ); } );
+            td.Sync();
+        }
+    } );
+    Measure( "200 tasks of ~1 ms", runs, [&td] {
+        for( int i=0; i<200; i++ ) td.Queue( [] { Spin( 500000 ); } );
+        td.Sync();
+    } );
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include <atomic>
+#include <chrono>
+#include <latch>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TracyTest.hpp"
+#include "../TracyTaskDispatch.hpp"
+
+namespace tracy
+{
+
+static void TestSync()
+{
+    TaskDispatch td( 3, "Test" );
+    std::atomic<int> sum = 0;
+    for( int i=0; i<10000; i++ ) td.Queue( [&sum, i] { sum.fetch_add( i, std::memory_order_relaxed ); } );
+    td.Sync();
+    TRACY_CHECK( sum.load() == 10000 * 9999 / 2 );
+
+    // The dispatch is reusable after a sync.
+    for( int i=0; i<100; i++ ) td.Queue( [&sum] { sum.fetch_add( 1, std::memory_order_relaxed ); } );
+    td.Sync();
+    TRACY_CHECK( sum.load() == 10000 * 9999 / 2 + 100 );
+}
+
+static void TestNoWorkers()
+{
+    // Without workers all tasks are executed by the thread calling Sync().
+    TaskDispatch td( 0, "Test" );
+    int cnt = 0;
+    for( int i=0; i<100; i++ ) td.Queue( [&cnt] { cnt++; } );
+    TRACY_CHECK( cnt == 0 );
+    td.Sync();
+    TRACY_CHECK( cnt == 100 );
+}
+
+static void TestLargeClosure()
+{
+    // Closures which don't fit the inline storage of Task are heap allocated.
+    TaskDispatch td( 2, "Test" );
+    std::atomic<int> sum = 0;
+    for( int i=0; i<1000; i++ )
+    {
+        int data[32];
+        for( int j=0; j<32; j++ ) data[j] = i;
+        td.Queue( [&sum, data] { sum.fetch_add( data[31], std::memory_order_relaxed ); } );
+    }
+    td.Sync();
+    TRACY_CHECK( sum.load() == 1000 * 999 / 2 );
+}
+
+static void TestPriority()
+{
+    // Tasks are queued on all workers while they are blocked, so the execution order shows
+    // that priorities are respected across the queues, not only within each one.
+    enum { Workers = 3, Tasks = 30 };
+    TaskDispatch td( Workers, "Test" );
+    std::latch blocked( Workers );
+    std::latch release( 1 );
+    for( int i=0; i<Workers; i++ ) td.Queue( [&blocked, &release] { blocked.count_down(); release.wait(); } );
+    blocked.wait();
+
+    // The calling thread drains the queues alone, as the workers are still blocked. The last
+    // task releases them.
+    std::mutex orderLock;
+    std::vector<int> order;
+    for( int i=0; i<Tasks; i++ )
+    {
+        const auto priority = TaskDispatch::Priority( i % 3 == 0 ? 2 : ( i % 3 == 1 ? 1 : 0 ) );
+        td.Queue( [&orderLock, &order, &release, priority] {
+            std::lock_guard<std::mutex> l( orderLock );
+            order.push_back( (int)priority );
+            if( order.size() == Tasks ) release.count_down();
+        }, priority );
+    }
+    td.Sync();
+
+    TRACY_CHECK( order.size() == Tasks );
+    bool sorted = true;
+    for( size_t i=1; i<order.size(); i++ ) if( order[i-1] > order[i] ) sorted = false;
+    TRACY_CHECK( sorted );
+}
+
+static void TestCancel()
+{
+    TaskDispatch td( 1, "Test" );
+    std::mutex lock;
+    lock.lock();
+    std::atomic<bool> started = false;
+    std::atomic<bool> sawCancel = false;
+    td.Queue( [&] { started = true; std::lock_guard<std::mutex> l( lock ); sawCancel = td.IsCancelled(); } );
+    while( !started.load() ) std::this_thread::yield();
+
+    std::atomic<int> cnt = 0;
+    for( int i=0; i<100; i++ ) td.Queue( [&cnt] { cnt++; } );
+    td.Cancel();
+    TRACY_CHECK( td.IsCancelled() );
+    lock.unlock();
+    td.Sync();
+
+    // Queued tasks are dropped, the running one completes and sees the cancellation.
+    TRACY_CHECK( cnt.load() == 0 );
+    TRACY_CHECK( sawCancel.load() );
+    TRACY_CHECK( !td.IsCancelled() );
+
+    td.Queue( [&cnt] { cnt++; } );
+    td.Sync();
+    TRACY_CHECK( cnt.load() == 1 );
+}
+
+
+static void TestGroups()
+{
+    // Each group only waits for its own tasks.
+    TaskDispatch td( 2, "Test" );
+    TaskGroup g1( td );
+    TaskGroup g2( td, TaskDispatch::Priority::Low );
+    std::latch release( 1 );
+    std::atomic<int> cnt1 = 0;
+    std::atomic<int> cnt2 = 0;
+    g2.Queue( [&release, &cnt2] { release.wait(); cnt2++; } );
+    for( int i=0; i<1000; i++ ) g1.Queue( [&cnt1] { cnt1.fetch_add( 1, std::memory_order_relaxed ); } );
+    g1.Sync();
+    TRACY_CHECK( cnt1.load() == 1000 );
+    TRACY_CHECK( cnt2.load() == 0 );
+    release.count_down();
+    g2.Sync();
+    TRACY_CHECK( cnt2.load() == 1 );
+}
+
+static void TestGroupCancel()
+{
+    TaskDispatch td( 1, "Test" );
+    TaskGroup g1( td );
+    TaskGroup g2( td );
+    std::mutex lock;
+    lock.lock();
+    std::atomic<bool> started = false;
+    std::atomic<bool> sawCancel = false;
+    g1.Queue( [&] { started = true; std::lock_guard<std::mutex> l( lock ); sawCancel = g1.IsCancelled(); } );
+    while( !started.load() ) std::this_thread::yield();
+
+    std::atomic<int> cnt1 = 0;
+    std::atomic<int> cnt2 = 0;
+    for( int i=0; i<100; i++ ) g1.Queue( [&cnt1] { cnt1++; } );
+    for( int i=0; i<100; i++ ) g2.Queue( [&cnt2] { cnt2++; } );
+    g1.Cancel();
+    TRACY_CHECK( g1.IsCancelled() );
+    TRACY_CHECK( !g2.IsCancelled() );
+    lock.unlock();
+    g1.Sync();
+
+    // Tasks queued before the cancellation are skipped, the running one completes and sees it.
+    // The other group is not affected.
+    TRACY_CHECK( sawCancel.load() );
+    TRACY_CHECK( !g1.IsCancelled() );
+    g1.Queue( [&cnt1] { cnt1 += 1000; } );
+    g1.Sync();
+    g2.Sync();
+    TRACY_CHECK( cnt1.load() == 1000 );
+    TRACY_CHECK( cnt2.load() == 100 );
+}
+
+static void TestGroupLock()
+{
+    TaskDispatch td( 1, "Test" );
+    TaskGroup group( td );
+    std::mutex lock;
+    std::atomic<int> taken = 0;
+    const auto task = [&] {
+        std::unique_lock<std::mutex> l( lock, std::defer_lock );
+        if( group.Lock( l ) ) taken++;
+    };
+
+    // The lock is taken once it is released, but not after the group is cancelled.
+    lock.lock();
+    group.Queue( task );
+    std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    lock.unlock();
+    group.Sync();
+    TRACY_CHECK( taken.load() == 1 );
+
+    lock.lock();
+    group.Queue( task );
+    std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    group.Cancel();
+    group.Sync();
+    lock.unlock();
+    TRACY_CHECK( taken.load() == 1 );
+}
+
+}
+
+TRACY_TEST_MAIN( tracy::TestSync, tracy::TestNoWorkers, tracy::TestLargeClosure, tracy::TestPriority, tracy::TestCancel, tracy::TestGroups, tracy::TestGroupCancel, tracy::TestGroupLock )
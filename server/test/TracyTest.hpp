@@ -0,0 +1,25 @@
+#ifndef __TRACYTEST_HPP__
+#define __TRACYTEST_HPP__
+
+#include <stdio.h>
+
+// Minimal check macros for the unit tests. Checks are also evaluated in release builds, and
+// failures are counted instead of aborting, so that a single run reports all of them.
+
+namespace tracy
+{
+inline int TestFailures = 0;
+}
+
+#define TRACY_CHECK( expr ) do { if( !( expr ) ) { fprintf( stderr, "%s:%i: check failed: %s\n", __FILE__, __LINE__, #expr ); tracy::TestFailures++; } } while( 0 )
+
+#define TRACY_TEST_MAIN( ... ) \
+    int main() \
+    { \
+        void (*tests[])() = { __VA_ARGS__ }; \
+        for( auto test : tests ) test(); \
+        if( tracy::TestFailures != 0 ) fprintf( stderr, "%i checks failed\n", tracy::TestFailures ); \
+        return tracy::TestFailures == 0 ? 0 : 1; \
+    }
+
+#endif
@@ -0,0 +1,144 @@
+#include <limits>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TracyTest.hpp"
+#include "../TracyZoneTree.hpp"
+
+namespace tracy
+{
+
+// Top level zones of 1000 ns, each with children of 100 ns, which have leaves of 10 ns. The last
+// top level zone can be left without an end.
+static std::unique_ptr<Worker> MakeWorker( int topLevel, int children, bool lastOpen = false )
+{
+    std::vector<Worker::ImportEventTimeline> events;
+    const auto add = [&] ( uint64_t t, const char* name, bool end ) { events.emplace_back( Worker::ImportEventTimeline { 1, t, end ? "" : name, "", end, end ? "" : "test.cpp", end ? 0u : 1u } ); };
+    for( int i=0; i<topLevel; i++ )
+    {
+        const uint64_t t = 10000 + i * 2000;
+        add( t, "Top", false );
+        for( int j=0; j<children; j++ )
+        {
+            add( t + j * 100 + 1, "Child", false );
+            add( t + j * 100 + 2, "Leaf", false );
+            add( t + j * 100 + 12, "", true );
+            add( t + j * 100 + 50, "", true );
+        }
+        if( !lastOpen || i != topLevel - 1 ) add( t + 1000, "", true );
+    }
+    return std::make_unique<Worker>( "test", "test", events, std::vector<Worker::ImportEventMessages>(), std::vector<Worker::ImportEventPlots>(), std::unordered_map<uint64_t, std::string>() );
+}
+
+// Records the visited zones as (start, depth, parent) on enter, and (start, depth, -1) on leave.
+struct Recorder
+{
+    struct Event
+    {
+        int64_t start;
+        int depth;
+        int64_t parent;
+        bool operator==( const Event& ) const = default;
+    };
+
+    uint32_t Enter( const ZoneEvent& zone, int depth, uint32_t parent )
+    {
+        events.emplace_back( Event { zone.Start(), depth, parent } );
+        return uint32_t( events.size() );
+    }
+
+    void Leave( const ZoneEvent& zone, int depth, uint32_t )
+    {
+        events.emplace_back( Event { zone.Start(), depth, -1 } );
+    }
+
+    std::vector<Event> events;
+};
+
+static std::vector<Recorder::Event> WalkAll( const Worker& worker, int64_t t0, int64_t t1, size_t step )
+{
+    auto& td = *worker.GetThreadData()[0];
+    ZoneTreeWalker walker( t0, t1, ZoneTreeWalker::Open::Wait );
+    Recorder rec;
+    for(;;)
+    {
+        size_t budget = step;
+        const auto done = walker.Walk( worker, td.timeline, 0, budget, rec );
+        TRACY_CHECK( done || budget == 0 );
+        if( done ) break;
+    }
+    return rec.events;
+}
+
+static void TestWalk()
+{
+    auto worker = MakeWorker( 10, 5 );
+    const auto all = WalkAll( *worker, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), std::numeric_limits<size_t>::max() );
+    TRACY_CHECK( all.size() == 10 * ( 1 + 5 * 2 ) * 2 );
+
+    // Children are visited between the enter and the leave of their parent, with its value.
+    TRACY_CHECK( ( all[0] == Recorder::Event { 10000, 0, 0 } ) );
+    TRACY_CHECK( ( all[1] == Recorder::Event { 10001, 1, 1 } ) );
+    TRACY_CHECK( ( all[2] == Recorder::Event { 10002, 2, 2 } ) );
+    TRACY_CHECK( ( all[3] == Recorder::Event { 10002, 2, -1 } ) );
+    TRACY_CHECK( ( all[4] == Recorder::Event { 10001, 1, -1 } ) );
+    TRACY_CHECK( ( all[21] == Recorder::Event { 10000, 0, -1 } ) );
+
+    // Resuming in the middle of subtrees gives the same walk.
+    TRACY_CHECK( WalkAll( *worker, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), 3 ) == all );
+}
+
+static void TestRange()
+{
+    // The range starts after the second child of the second top level zone and ends in the
+    // first child of the third one.
+    auto worker = MakeWorker( 10, 5 );
+    const auto events = WalkAll( *worker, 12160, 14020, 2 );
+    std::vector<int64_t> entered;
+    for( auto& v : events ) if( v.parent >= 0 ) entered.push_back( v.start );
+    const std::vector<int64_t> expected = {
+        12000, 12201, 12202, 12301, 12302, 12401, 12402,
+        14000, 14001, 14002,
+    };
+    TRACY_CHECK( entered == expected );
+    TRACY_CHECK( events.size() == expected.size() * 2 );
+}
+
+static void TestOpen()
+{
+    auto worker = MakeWorker( 3, 5, true );
+    auto& td = *worker->GetThreadData()[0];
+    const auto walk = [&] ( ZoneTreeWalker& walker, Recorder& rec ) {
+        size_t budget = std::numeric_limits<size_t>::max();
+        return walker.Walk( *worker, td.timeline, 0, budget, rec );
+    };
+
+    // The walk stops before the open zone.
+    ZoneTreeWalker wait( std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), ZoneTreeWalker::Open::Wait );
+    Recorder waitRec;
+    TRACY_CHECK( !walk( wait, waitRec ) );
+    TRACY_CHECK( waitRec.events.size() == 2 * 22 );
+
+    // The open zone and its children are visited, but the zone is not left.
+    ZoneTreeWalker enter( std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), ZoneTreeWalker::Open::Enter );
+    Recorder enterRec;
+    TRACY_CHECK( !walk( enter, enterRec ) );
+    TRACY_CHECK( enterRec.events.size() == 2 * 22 + 21 );
+    TRACY_CHECK( ( enterRec.events.back() == Recorder::Event { 14401, 1, -1 } ) );
+    std::vector<int64_t> entered;
+    enter.ForEachEntered( *worker, td.timeline, [&] ( const ZoneEvent& zone, int depth, uint32_t ) { entered.push_back( zone.Start() ); TRACY_CHECK( depth == 0 ); } );
+    TRACY_CHECK( entered == std::vector<int64_t> { 14000 } );
+
+    // The open zone is treated as a finished one.
+    ZoneTreeWalker ended( std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), ZoneTreeWalker::Open::Ended );
+    Recorder endedRec;
+    TRACY_CHECK( walk( ended, endedRec ) );
+    TRACY_CHECK( endedRec.events.size() == 3 * 22 );
+}
+
+}
+
+TRACY_TEST_MAIN( tracy::TestWalk, tracy::TestRange, tracy::TestOpen )
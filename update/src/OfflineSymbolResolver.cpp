@@ -1,11 +1,14 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <thread>
 #include <unordered_map>
 
+#include "../../server/TracyTaskDispatch.hpp"
 #include "../../server/TracyWorker.hpp"
 #include "../../zstd/zstd.h"
 
@@ -74,8 +77,15 @@ bool PatchSymbolsWithRegex( tracy::Worker& worker, const PathSubstitutionList& p
 
     std::cout << "Batched into " << entriesPerImageIdx.size() << " unique image groups" << std::endl;
 
-    // FIXME: the resolving of symbols here can be slow and could be done in parallel per "image"
-    // - be careful with string allocation though as that would be not safe to do in parallel
+    struct ImageJob
+    {
+        std::string imagePath;
+        FrameEntryList* entries;
+        SymbolEntryList resolvedEntries;
+    };
+
+    std::vector<ImageJob> jobs;
+    jobs.reserve( entriesPerImageIdx.size() );
     for( FrameEntriesPerImageIdx::iterator imageIt = entriesPerImageIdx.begin(),
          imageItEnd = entriesPerImageIdx.end(); imageIt != imageItEnd; ++imageIt )
     {
@@ -94,13 +104,30 @@ bool PatchSymbolsWithRegex( tracy::Worker& worker, const PathSubstitutionList& p
             std::cout << "\tPath substituted to: '" << imagePath << "'" << std::endl;
         }
 
-        SymbolEntryList resolvedEntries;
-        ResolveSymbols( imagePath, entries, resolvedEntries );
+        jobs.push_back( { std::move( imagePath ), &entries } );
+    }
+
+    // the images are resolved in parallel, the strings are stored afterwards as that is not thread safe
+    std::sort( jobs.begin(), jobs.end(), []( const auto& lhs, const auto& rhs ) { return lhs.entries->size() > rhs.entries->size(); } );
+    {
+        tracy::TaskDispatch td( std::max<int>( 1, std::thread::hardware_concurrency() - 1 ), "Symbol resolver" );
+        for( auto& job : jobs )
+        {
+            td.Queue( [&job] { ResolveSymbols( job.imagePath, *job.entries, job.resolvedEntries ); } );
+        }
+        td.Sync();
+    }
+
+    for( auto& job : jobs )
+    {
+        const std::string& imagePath = job.imagePath;
+        FrameEntryList& entries = *job.entries;
+        const SymbolEntryList& resolvedEntries = job.resolvedEntries;
 
         if( resolvedEntries.size() != entries.size() )
         {
-            std::cerr << " failed to resolve all entries! (got: " 
-                      << resolvedEntries.size() << ")" << std::endl;
+            std::cerr << "Failed to resolve all entries of image '" << imagePath << "'! (got: "
+                      << resolvedEntries.size() << " of " << entries.size() << ")" << std::endl;
             continue;
         }
 
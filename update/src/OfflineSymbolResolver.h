@@ -32,6 +32,12 @@ using SymbolEntryList = std::vector<SymbolEntry>;
 bool ResolveSymbols( const std::string& imagePath, const FrameEntryList& inputEntryList,
                      SymbolEntryList& resolvedEntries );
 
+#ifndef _WIN32
+// spawns addr2line, used for images the in-process resolver can't load
+bool ResolveSymbolsAddr2Line( const std::string& imagePath, const FrameEntryList& inputEntryList,
+                              SymbolEntryList& resolvedEntries );
+#endif
+
 void PatchSymbols( tracy::Worker& worker, const std::vector<std::string>& pathSubstitutionsStrings, bool verbose = false );
 
 using PathSubstitutionList = std::vector<std::pair<std::regex, std::string> >;
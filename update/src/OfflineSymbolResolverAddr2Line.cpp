@@ -104,8 +104,8 @@ private:
     std::string m_addr2LinePath;
 };
 
-bool ResolveSymbols( const std::string& imagePath, const FrameEntryList& inputEntryList,
-                     SymbolEntryList& resolvedEntries )
+bool ResolveSymbolsAddr2Line( const std::string& imagePath, const FrameEntryList& inputEntryList,
+                             SymbolEntryList& resolvedEntries )
 {
     static SymbolResolver symbolResolver;
     return symbolResolver.ResolveSymbols( imagePath, inputEntryList, resolvedEntries );
@@ -12,6 +12,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <windows.h>
+#include <mutex>
 #include <string>
 
 #include "OfflineSymbolResolver.h"
@@ -125,6 +126,9 @@ char SymbolResolver::s_symbolResolutionBuffer[symbolResolutionBufferSize];
 bool ResolveSymbols( const std::string& imagePath, const FrameEntryList& inputEntryList,
                     SymbolEntryList& resolvedEntries )
 {
+    // DbgHelp functions are single threaded
+    static std::mutex lock;
+    std::lock_guard guard( lock );
     static SymbolResolver resolver;
     return resolver.ResolveSymbolsForModule( imagePath, inputEntryList, resolvedEntries );
 }
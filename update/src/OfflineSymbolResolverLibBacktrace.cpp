@@ -0,0 +1,249 @@
+#ifndef _WIN32
+
+#include "OfflineSymbolResolver.h"
+
+#ifdef __APPLE__
+
+bool ResolveSymbols( const std::string& imagePath, const FrameEntryList& inputEntryList,
+                     SymbolEntryList& resolvedEntries )
+{
+    return ResolveSymbolsAddr2Line( imagePath, inputEntryList, resolvedEntries );
+}
+
+#else
+
+#include <algorithm>
+#include <cxxabi.h>
+#include <elf.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+
+#include "../../public/libbacktrace/backtrace.hpp"
+
+template<typename Ehdr, typename Shdr>
+static std::string ReadBuildIdImpl( FILE* f )
+{
+    Ehdr ehdr;
+    if( fseek( f, 0, SEEK_SET ) != 0 || fread( &ehdr, 1, sizeof( ehdr ), f ) != sizeof( ehdr ) ) return {};
+    if( ehdr.e_shentsize != sizeof( Shdr ) || ehdr.e_shnum == 0 ) return {};
+
+    std::vector<Shdr> shdrs( ehdr.e_shnum );
+    if( fseek( f, ehdr.e_shoff, SEEK_SET ) != 0 ||
+        fread( shdrs.data(), sizeof( Shdr ), shdrs.size(), f ) != shdrs.size() ) return {};
+
+    for( const auto& sh : shdrs )
+    {
+        if( sh.sh_type != SHT_NOTE || sh.sh_size == 0 || sh.sh_size > 64 * 1024 ) continue;
+
+        std::vector<char> note( sh.sh_size );
+        if( fseek( f, sh.sh_offset, SEEK_SET ) != 0 || fread( note.data(), 1, note.size(), f ) != note.size() ) continue;
+
+        // ELF32_Nhdr and ELF64_Nhdr have the same layout
+        size_t pos = 0;
+        while( pos + sizeof( Elf32_Nhdr ) <= note.size() )
+        {
+            Elf32_Nhdr nhdr;
+            memcpy( &nhdr, note.data() + pos, sizeof( nhdr ) );
+            pos += sizeof( nhdr );
+            const size_t namePos = pos;
+            pos += ( nhdr.n_namesz + 3 ) & ~3;
+            const size_t descPos = pos;
+            pos += ( nhdr.n_descsz + 3 ) & ~3;
+            if( pos > note.size() ) break;
+
+            if( nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == 4 && memcmp( note.data() + namePos, "GNU", 4 ) == 0 )
+            {
+                static const char hex[] = "0123456789abcdef";
+                std::string id;
+                id.reserve( nhdr.n_descsz * 2 );
+                for( uint32_t i = 0; i < nhdr.n_descsz; i++ )
+                {
+                    const uint8_t v = note[descPos + i];
+                    id.push_back( hex[v >> 4] );
+                    id.push_back( hex[v & 0xF] );
+                }
+                return id;
+            }
+        }
+    }
+    return {};
+}
+
+// Returns the hex-encoded GNU build-id of an ELF image, or an empty string if it has none.
+static std::string ReadBuildId( const std::string& imagePath )
+{
+    FILE* f = fopen( imagePath.c_str(), "rb" );
+    if( !f ) return {};
+
+    std::string id;
+    unsigned char ident[EI_NIDENT];
+    if( fread( ident, 1, EI_NIDENT, f ) == EI_NIDENT && memcmp( ident, ELFMAG, SELFMAG ) == 0 )
+    {
+        if( ident[EI_CLASS] == ELFCLASS64 ) id = ReadBuildIdImpl<Elf64_Ehdr, Elf64_Shdr>( f );
+        else if( ident[EI_CLASS] == ELFCLASS32 ) id = ReadBuildIdImpl<Elf32_Ehdr, Elf32_Shdr>( f );
+    }
+    fclose( f );
+    return id;
+}
+
+static std::string Demangle( const char* name )
+{
+    int status;
+    char* demangled = abi::__cxa_demangle( name, nullptr, nullptr, &status );
+    if( !demangled ) return name;
+    std::string ret( demangled );
+    free( demangled );
+    return ret;
+}
+
+class LibBacktraceSymbolResolver
+{
+    // The vendored libbacktrace is built without thread-safe state, so an image is
+    // only ever resolved by one thread at a time. Different images are independent.
+    struct Image
+    {
+        std::mutex lock;
+        std::string path;
+        tracy::backtrace_state* state = nullptr;
+        bool failed = false;
+        std::unordered_map<uint64_t, SymbolEntry> cache;
+    };
+
+public:
+    bool ResolveSymbols( const std::string& imagePath, const FrameEntryList& inputEntryList,
+                         SymbolEntryList& resolvedEntries )
+    {
+        Image& image = GetImage( imagePath );
+        std::lock_guard lock( image.lock );
+
+        if( !image.state && !image.failed )
+        {
+            image.state = tracy::backtrace_create_state( image.path.c_str(), 0, ErrorCallback, nullptr );
+            if( !image.state || !tracy::backtrace_initialize_image( image.state, image.path.c_str(), ErrorCallback, nullptr ) )
+            {
+                std::cerr << "Failed to load '" << imagePath << "', falling back to addr2line" << std::endl;
+                image.failed = true;
+            }
+        }
+        if( image.failed )
+        {
+            return ResolveSymbolsAddr2Line( imagePath, inputEntryList, resolvedEntries );
+        }
+
+        // resolve in address order to keep the lookups into the debug info data local
+        std::vector<uint64_t> offsets;
+        offsets.reserve( inputEntryList.size() );
+        for( const FrameEntry& entry : inputEntryList )
+        {
+            if( image.cache.find( entry.symbolOffset ) == image.cache.end() ) offsets.push_back( entry.symbolOffset );
+        }
+        std::sort( offsets.begin(), offsets.end() );
+        offsets.erase( std::unique( offsets.begin(), offsets.end() ), offsets.end() );
+
+        for( uint64_t offset : offsets )
+        {
+            image.cache.emplace( offset, Resolve( image.state, offset ) );
+        }
+
+        resolvedEntries.reserve( resolvedEntries.size() + inputEntryList.size() );
+        for( const FrameEntry& entry : inputEntryList )
+        {
+            resolvedEntries.push_back( image.cache.find( entry.symbolOffset )->second );
+        }
+
+        return true;
+    }
+
+private:
+    Image& GetImage( const std::string& imagePath )
+    {
+        std::lock_guard lock( m_lock );
+
+        auto pit = m_pathToKey.find( imagePath );
+        if( pit == m_pathToKey.end() )
+        {
+            // images with the same build-id share their debug info and already resolved addresses
+            std::string key = ReadBuildId( imagePath );
+            if( key.empty() ) key = "path:" + imagePath;
+            pit = m_pathToKey.emplace( imagePath, std::move( key ) ).first;
+        }
+
+        auto& image = m_images[pit->second];
+        if( !image )
+        {
+            image = std::make_unique<Image>();
+            image->path = imagePath;
+        }
+        return *image;
+    }
+
+    static SymbolEntry Resolve( tracy::backtrace_state* state, uint64_t offset )
+    {
+        struct Result
+        {
+            SymbolEntry entry;
+            int frames = 0;
+        } result;
+
+        // the first callback describes the innermost inlined function, the following ones its callers
+        auto fileLineCallback = []( void* data, uintptr_t, uintptr_t, const char* file, int line, const char* function ) -> int {
+            auto& result = *(Result*)data;
+            if( result.frames++ == 0 )
+            {
+                if( function ) result.entry.name = Demangle( function );
+                if( file )
+                {
+                    result.entry.file = file;
+                    result.entry.line = line;
+                }
+            }
+            return 0;
+        };
+        tracy::backtrace_pcinfo( state, offset, fileLineCallback, SilentErrorCallback, &result );
+
+        // outside of inlined code prefer the symbol table, which has the full signature like addr2line prints
+        if( result.frames <= 1 )
+        {
+            auto symInfoCallback = []( void* data, uintptr_t, const char* symname, uintptr_t, uintptr_t ) {
+                if( symname ) ((SymbolEntry*)data)->name = Demangle( symname );
+            };
+            tracy::backtrace_syminfo( state, offset, symInfoCallback, SilentErrorCallback, &result.entry );
+        }
+
+        SymbolEntry& entry = result.entry;
+        if( entry.name.empty() )
+        {
+            entry.name = "[unknown] + " + std::to_string( offset );
+        }
+        return entry;
+    }
+
+    static void ErrorCallback( void*, const char* msg, int errnum )
+    {
+        if( errnum > 0 ) std::cerr << "libbacktrace: " << msg << ": " << strerror( errnum ) << std::endl;
+        else if( errnum == 0 ) std::cerr << "libbacktrace: " << msg << std::endl;
+    }
+
+    // missing debug info for single addresses is expected, addr2line reports them as '??' too
+    static void SilentErrorCallback( void*, const char*, int ) {}
+
+    std::mutex m_lock;
+    std::unordered_map<std::string, std::string> m_pathToKey;
+    std::unordered_map<std::string, std::unique_ptr<Image>> m_images;
+};
+
+bool ResolveSymbols( const std::string& imagePath, const FrameEntryList& inputEntryList,
+                     SymbolEntryList& resolvedEntries )
+{
+    static LibBacktraceSymbolResolver symbolResolver;
+    return symbolResolver.ResolveSymbols( imagePath, inputEntryList, resolvedEntries );
+}
+
+#endif // #ifdef __APPLE__
+
+#endif // #ifndef _WIN32
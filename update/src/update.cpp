@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../../public/common/TracyVersion.hpp"
 #include "../../server/TracyFileRead.hpp"
@@ -23,6 +24,64 @@
 #  define ftello64(x) _ftelli64(x)
 #endif
 
+static void Benchmark( const char* output )
+{
+    auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( output ) );
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    uint64_t size = 0;
+    const char* ptr;
+    while( const auto sz = f->ReadChunk( ptr ) ) size += sz;
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    const auto tDecode = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count();
+    printf( "Decompression: %s in %s, %s/s\n", tracy::MemSizeToString( size ), tracy::TimeToString( tDecode ),
+        tracy::MemSizeToString( int64_t( size * 1e9 / std::max<int64_t>( 1, tDecode ) ) ) );
+}
+
+// Traces in the current format that don't need any processing are not parsed. The decompressed
+// data is passed straight to the new compression, so only the compression blocks are in memory.
+static bool Recompress( const char* input, const char* output, tracy::FileRead& f, tracy::FileCompression clev, int zstdLevel, int streams )
+{
+    static const char header[8] = { 't', 'r', 'a', 'c', 'y', tracy::Version::Major, tracy::Version::Minor, tracy::Version::Patch };
+
+    const char* ptr;
+    auto sz = f.ReadChunk( ptr );
+    if( sz < sizeof( header ) || memcmp( ptr, header, sizeof( header ) ) != 0 ) return false;
+
+    printf( "Recompressing...\r" );
+    fflush( stdout );
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output, clev, zstdLevel, streams ) );
+    if( !w )
+    {
+        fprintf( stderr, "Cannot open output file!\n" );
+        exit( 1 );
+    }
+    do
+    {
+        w->Write( ptr, sz );
+    }
+    while( ( sz = f.ReadChunk( ptr ) ) != 0 );
+    w->Finish();
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    const auto stats = w->GetCompressionStatistics();
+    w.reset();
+
+    FILE* in = fopen( input, "rb" );
+    fseek( in, 0, SEEK_END );
+    const auto inSize = ftello64( in );
+    fclose( in );
+
+    FILE* out = fopen( output, "rb" );
+    fseek( out, 0, SEEK_END );
+    const auto outSize = ftello64( out );
+    fclose( out );
+
+    printf( "%s {%s} -> %s {%s, %.2f%%}  %s recompress, %.2f%% change\n",
+        input, tracy::MemSizeToString( inSize ), output, tracy::MemSizeToString( outSize ), 100.f * stats.second / stats.first,
+        tracy::TimeToString( std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() ), float( outSize ) / inSize * 100 );
+    return true;
+}
+
 void Usage()
 {
     printf( "Usage: update [options] input.tracy output.tracy\n\n" );
@@ -30,6 +89,7 @@ void Usage()
     printf( "  -h: enable LZ4HC compression\n" );
     printf( "  -e: enable extreme LZ4HC compression (very slow)\n" );
     printf( "  -z level: use Zstd compression with given compression level\n" );
+    printf( "  -D: train Zstd dictionary on trace data and compress small blocks independently\n" );
     printf( "  -d: build dictionary for frame images\n" );
     printf( "  -s flags: strip selected data from capture:\n" );
     printf( "      l: locks, m: messages, p: plots, M: memory, i: frame images\n" );
@@ -38,6 +98,7 @@ void Usage()
     printf( "  -r: resolve symbols and patch callstack frames\n");
     printf( "  -p: substitute symbol resolution path with an alternative: \"REGEX_MATCH;REPLACEMENT\"\n");
     printf( "  -j: number of threads to use for compression (-1 to use all cores)\n" );
+    printf( "  -b: measure decompression speed of the output file\n" );
 
     exit( 1 );
 }
@@ -57,12 +118,14 @@ int main( int argc, char** argv )
     int zstdLevel = 3;
     int streams = 4;
     bool buildDict = false;
+    bool dataDict = false;
+    bool benchmark = false;
     bool cacheSource = false;
     bool resolveSymbols = false;
     std::vector<std::string> pathSubstitutions;
 
     int c;
-    while( ( c = getopt( argc, argv, "4hez:ds:crp:j:" ) ) != -1 )
+    while( ( c = getopt( argc, argv, "4hez:Dds:crp:j:b" ) ) != -1 )
     {
         switch( c )
         {
@@ -84,6 +147,9 @@ int main( int argc, char** argv )
                 exit( 1 );
             }
             break;
+        case 'D':
+            dataDict = true;
+            break;
         case 'd':
             buildDict = true;
             break;
@@ -141,6 +207,9 @@ int main( int argc, char** argv )
         case 'j':
             streams = atoi( optarg );
             break;
+        case 'b':
+            benchmark = true;
+            break;
         default:
             Usage();
             break;
@@ -148,6 +217,11 @@ int main( int argc, char** argv )
     }
 
     if (argc != optind + 2) Usage();
+    if( dataDict && clev != tracy::FileCompression::Zstd )
+    {
+        fprintf( stderr, "Dictionary training requires Zstd compression!\n" );
+        exit( 1 );
+    }
 
     const char* input = argv[optind];
     const char* output = argv[optind+1];
@@ -161,6 +235,32 @@ int main( int argc, char** argv )
         exit( 1 );
     }
 
+    if( events == tracy::EventType::All && !buildDict && !dataDict && !cacheSource && !resolveSymbols )
+    {
+        bool done;
+        try
+        {
+            done = Recompress( input, output, *f, clev, zstdLevel, streams );
+        }
+        catch( const tracy::FileReadError& e )
+        {
+            fprintf( stderr, "The file you are trying to open is corrupted.\n" );
+            exit( 1 );
+        }
+        if( done )
+        {
+            if( benchmark ) Benchmark( output );
+            return 0;
+        }
+        // older trace versions have to be upgraded by loading them
+        f.reset( tracy::FileRead::Open( input ) );
+        if( !f )
+        {
+            fprintf( stderr, "Cannot open input file!\n" );
+            exit( 1 );
+        }
+    }
+
     try
     {
         int64_t tLoad, tSave;
@@ -181,7 +281,26 @@ int main( int argc, char** argv )
             if( cacheSource ) worker.CacheSourceFiles();
             if( resolveSymbols ) PatchSymbols( worker, pathSubstitutions );
 
-            auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output, clev, zstdLevel, streams ) );
+            std::vector<char> dict;
+            if( dataDict )
+            {
+                printf( "Training...\r" );
+                fflush( stdout );
+                auto sampler = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::OpenSampler() );
+                worker.Write( *sampler, false );
+                sampler->Finish();
+                dict = sampler->TrainDictionary();
+                if( dict.empty() )
+                {
+                    fprintf( stderr, "Not enough data to train dictionary, using regular Zstd compression.\n" );
+                }
+                else
+                {
+                    clev = tracy::FileCompression::ZstdDict;
+                }
+            }
+
+            auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output, clev, zstdLevel, streams, dict.empty() ? nullptr : &dict ) );
             if( !w )
             {
                 fprintf( stderr, "Cannot open output file!\n" );
@@ -213,6 +332,8 @@ int main( int argc, char** argv )
             input, inVer >> 16, ( inVer >> 8 ) & 0xFF, inVer & 0xFF, tracy::MemSizeToString( inSize ),
             output, tracy::Version::Major, tracy::Version::Minor, tracy::Version::Patch, tracy::MemSizeToString( outSize ), ratio,
             tracy::TimeToString( tLoad ), tracy::TimeToString( tSave ), float( outSize ) / inSize * 100 );
+
+        if( benchmark ) Benchmark( output );
     }
     catch( const tracy::UnsupportedVersion& e )
     {